@@ -52,9 +52,8 @@ async function forceSensorReadNow() {
         console.log("Response status:", response.status);
         
         if (response.ok) {
+            // The new reading arrives as a state event, which hides the spinners
             console.log("Sensor reading requested successfully");
-            // Then fetch the newly updated data
-            await fetchSensorData();
         } else {
             console.error("Error response:", response.status, response.statusText);
             document.querySelectorAll('.loading-spinner').forEach(spinner => {
@@ -117,9 +116,6 @@ async function controlRelay(relayId, state) {
         });
         const result = await response.json();
         console.log('Relay control response:', result);
-        
-        // Refresh data to show updated status
-        fetchSensorData();
     } catch (error) {
         console.error('Error controlling relay:', error);
     }
@@ -138,14 +134,33 @@ async function waterNow() {
         });
         
         console.log("Water now response:", response.status);
-        
-        // Refresh data to show updated status
-        fetchSensorData();
     } catch (error) {
         console.error('Error starting watering:', error);
     }
 }
 
+// Subscribe to the device's state events; one arrives on connect and then
+// on every reading, relay change and watering countdown tick
+function connectEvents() {
+    if (!window.EventSource) {
+        // No Server-Sent Events support: fall back to polling
+        fetchSensorData();
+        setInterval(fetchSensorData, 5000);
+        return;
+    }
+    
+    const source = new EventSource(`${apiUrl}/events`);
+    source.addEventListener('state', event => {
+        updateUI(JSON.parse(event.data));
+        document.querySelectorAll('.loading-spinner').forEach(spinner => {
+            spinner.classList.remove('visible');
+        });
+    });
+    
+    // EventSource reconnects by itself
+    source.onerror = () => console.warn('Event stream interrupted, reconnecting');
+}
+
 // Set up event listeners when the document is loaded
 document.addEventListener('DOMContentLoaded', function() {
     console.log("Initializing Garden Monitor interface");
@@ -198,10 +213,6 @@ document.addEventListener('DOMContentLoaded', function() {
         waterNowButton.addEventListener('click', waterNow);
     }
     
-    // Initial fetch of sensor data
-    fetchSensorData();
-    
-    // Fetch sensor data automatically every 5 seconds
-    const autoRefreshInterval = 5000; // Check every 5 seconds
-    setInterval(fetchSensorData, autoRefreshInterval);
+    // Live updates pushed by the device
+    connectEvents();
 });
\ No newline at end of file
@@ -2,57 +2,58 @@
 #define CONFIG_H
 
 #include <Arduino.h>
-#include <LittleFS.h>
 #include <ArduinoJson.h>
+#include <mutex>
+#include "hal.h"
+#include "soil_moisture.h"
+#include "config_schema.h"
+#include "storage/config_store.h"
+
+static_assert(sizeof(ConfigRecord) <= ConfigStore::maxRecordSize, "config record exceeds its slot");
 
 class Config {
+public:
+    static const uint16_t recordVersion = 1;
+    
 private:
-    // Flag to determine if this is first run
-    bool isFirstRun = true;
-    
-    // Device settings
-    String deviceName = "GartenIrrigationSystem";
-    String username = "user";
-    String password = "pass";
-    int touchSensorThreshold = 40;
-    int soilMoisturePin = 36;
-    int soilMoisturePowerPin = 27;
-    int touchPin = 4;
-    int i2cSdaPin = 21;
-    int i2cSclPin = 22;
-    int relay1Pin = 25;
-    int relay2Pin = 26;
-    int relay3Pin = 32;
-    int relay4Pin = 33;
-    String relay1Name = "Aux";
-    String relay2Name = "Pump 1";
-    String relay3Name = "Pump 2";
-    String relay4Name = "Sensor";
-    int soilMoistureDry = 2350;
-    int soilMoistureWet = 815;
-    int wateringDuration = 60;
-    int wateringStartHour = 8;
-    int wateringStartMinute = 0;
-    int wateringEndHour = 9;
-    int wateringEndMinute = 0;
-    float soilMoistureThreshold = 50.0;
-    const char* configFile = "/config.json";
+    // Read by the control task, written by the web handlers, saved by the
+    // io task; every access to the record holds the lock
+    ConfigRecord record;
+    std::mutex lock;
+    typedef std::lock_guard<std::mutex> Guard;
+    
+    // Binary record in two slots; /config.json is the old format, imported once
+    ConfigStore store = ConfigStore("/config.a", "/config.b", recordVersion);
+    const char* legacyConfigFile = "/config.json";
+    
+    String readString(const char *field) {
+        Guard guard(lock);
+        return String(field);
+    }
+    
+    void writeString(char *dest, size_t capacity, const String &value) {
+        Guard guard(lock);
+        snprintf(dest, capacity, "%s", value.c_str());
+    }
     
 public:
     // Initialize configuration system
     bool begin() {
         // Initialize filesystem
-        if (!LittleFS.begin(true)) {
+        if (!hal::fsBegin()) {
             Serial.println("Failed to mount filesystem");
             return false;
         }
         
-        // Check if config file exists
-        if (LittleFS.exists(configFile)) {
-            if (loadConfig()) {
-                Serial.println("Configuration loaded successfully");
-                return true;
-            }
+        if (loadConfig()) {
+            Serial.println("Configuration loaded successfully");
+            return true;
+        }
+        
+        // Config saved by firmware from before the binary record
+        if (hal::fsExists(legacyConfigFile) && importLegacyConfig()) {
+            Serial.println("Configuration imported from config.json");
+            return true;
         }
         
         // If we reach here, either file doesn't exist or couldn't be loaded
@@ -60,258 +61,292 @@ public:
         return true;
     }
     
-    // Save configuration to filesystem
+    // Commit the configuration to flash; the previous copy survives a
+    // power cut during the write. A copy is written, so the CRC and the
+    // bytes match and nobody waits on the flash for the lock.
     bool saveConfig() {
-        DynamicJsonDocument doc(2048);
-        
-        // CRITICAL: Save the first-time setup flag
-        doc["isFirstRun"] = isFirstRun;
-        
-        // Add all settings to JSON document
-        doc["deviceName"] = deviceName;
-        doc["username"] = username;
-        doc["password"] = password;
-        
-        // Pin assignments
-        doc["soilMoisturePin"] = soilMoisturePin;
-        doc["soilMoisturePowerPin"] = soilMoisturePowerPin;
-        doc["touchPin"] = touchPin;
-        doc["i2cSdaPin"] = i2cSdaPin;
-        doc["i2cSclPin"] = i2cSclPin;
-        doc["relay1Pin"] = relay1Pin;
-        doc["relay2Pin"] = relay2Pin;
-        doc["relay3Pin"] = relay3Pin;
-        doc["relay4Pin"] = relay4Pin;
-        
-        // Relay names
-        doc["relay1Name"] = relay1Name;
-        doc["relay2Name"] = relay2Name;
-        doc["relay3Name"] = relay3Name;
-        doc["relay4Name"] = relay4Name;
-        
-        // Soil moisture calibration
-        doc["soilMoistureDry"] = soilMoistureDry;
-        doc["soilMoistureWet"] = soilMoistureWet;
-        
-        // Watering settings
-        doc["wateringDuration"] = wateringDuration;
-        doc["wateringStartHour"] = wateringStartHour;
-        doc["wateringStartMinute"] = wateringStartMinute;
-        doc["wateringEndHour"] = wateringEndHour;
-        doc["wateringEndMinute"] = wateringEndMinute;
-        doc["soilMoistureThreshold"] = soilMoistureThreshold;
-        
-        // Open file for writing
-        File file = LittleFS.open(configFile, "w");
-        if (!file) {
-            Serial.println("Failed to create config file");
-            return false;
-        }
-        
-        // Serialize JSON to file
-        if (serializeJson(doc, file) == 0) {
+        ConfigRecord saved = getRecord();
+        if (!store.commit(&saved, sizeof(saved))) {
             Serial.println("Failed to write config file");
-            file.close();
             return false;
         }
         
-        file.close();
         Serial.println("Configuration saved successfully");
         return true;
     }
     
-    // Load configuration from filesystem
+    // Load configuration from filesystem; no parsing and no allocation
     bool loadConfig() {
-        File file = LittleFS.open(configFile, "r");
-        if (!file) {
-            Serial.println("No config file found");
+        ConfigRecord stored;
+        if (!store.load(&stored, sizeof(stored))) {
+            return false;
+        }
+        if (stored.soilCalibrationCount > SoilMoistureSensor::maxCalibrationPoints) {
+            stored.soilCalibrationCount = 0;
+        }
+        Guard guard(lock);
+        record = stored;
+        return true;
+    }
+    
+    // Convert /config.json to the binary record and drop it once committed
+    bool importLegacyConfig() {
+        char buffer[2048];
+        size_t length = 0;
+        if (!hal::fsReadFile(legacyConfigFile, (uint8_t *)buffer, sizeof(buffer), &length)) {
             return false;
         }
         
-        // Parse JSON
         DynamicJsonDocument doc(2048);
-        DeserializationError error = deserializeJson(doc, file);
-        file.close();
-        
+        DeserializationError error = deserializeJson(doc, (const char *)buffer, length);
         if (error) {
             Serial.println("Failed to parse config file");
             return false;
         }
         
-        // CRITICAL: Load the first-time setup flag
-        isFirstRun = doc["isFirstRun"] | isFirstRun;
-        
-        // Load all settings from JSON
-        deviceName = doc["deviceName"] | deviceName;
-        username = doc["username"] | username;
-        password = doc["password"] | password;
-        
-        // Pin assignments
-        soilMoisturePin = doc["soilMoisturePin"] | soilMoisturePin;
-        soilMoisturePowerPin = doc["soilMoisturePowerPin"] | soilMoisturePowerPin;
-        touchPin = doc["touchPin"] | touchPin;
-        i2cSdaPin = doc["i2cSdaPin"] | i2cSdaPin;
-        i2cSclPin = doc["i2cSclPin"] | i2cSclPin;
-        relay1Pin = doc["relay1Pin"] | relay1Pin;
-        relay2Pin = doc["relay2Pin"] | relay2Pin;
-        relay3Pin = doc["relay3Pin"] | relay3Pin;
-        relay4Pin = doc["relay4Pin"] | relay4Pin;
-        
-        // Relay names
-        relay1Name = doc["relay1Name"] | relay1Name;
-        relay2Name = doc["relay2Name"] | relay2Name;
-        relay3Name = doc["relay3Name"] | relay3Name;
-        relay4Name = doc["relay4Name"] | relay4Name;
-        
-        // Soil moisture calibration
-        soilMoistureDry = doc["soilMoistureDry"] | soilMoistureDry;
-        soilMoistureWet = doc["soilMoistureWet"] | soilMoistureWet;
-        
-        // Watering settings
-        wateringDuration = doc["wateringDuration"] | wateringDuration;
-        
-        // Support both old and new format for backward compatibility
-        if (doc.containsKey("wateringTimeStart")) {
-            // Old format
-            wateringStartHour = doc["wateringTimeStart"] | wateringStartHour;
-            wateringStartMinute = 0;
-        } else {
-            // New format
-            wateringStartHour = doc["wateringStartHour"] | wateringStartHour;
-            wateringStartMinute = doc["wateringStartMinute"] | wateringStartMinute;
+        importJson(doc);
+        if (!saveConfig()) {
+            return false;
         }
-        
-        if (doc.containsKey("wateringTimeEnd")) {
-            // Old format
-            wateringEndHour = doc["wateringTimeEnd"] | wateringEndHour;
-            wateringEndMinute = 0;
-        } else {
-            // New format
-            wateringEndHour = doc["wateringEndHour"] | wateringEndHour;
-            wateringEndMinute = doc["wateringEndMinute"] | wateringEndMinute;
+        hal::fsRemove(legacyConfigFile);
+        return true;
+    }
+    
+    // Settings as JSON, for export: every field in the schema but the
+    // legacy keys, plus the calibration curve
+    void exportJson(JsonDocument &doc) {
+        ConfigRecord current = getRecord();
+        for (int i = 0; i < configFieldCount; i++) {
+            if (!(configFields[i].flags & CONFIG_ALIAS)) {
+                getConfigField(current, configFields[i], doc);
+            }
         }
         
-        if (doc.containsKey("waterAtPercent")) {
-            // Old name
-            soilMoistureThreshold = doc["waterAtPercent"] | soilMoistureThreshold;
-        } else {
-            // New name
-            soilMoistureThreshold = doc["soilMoistureThreshold"] | soilMoistureThreshold;
+        JsonArray calibration = doc.createNestedArray("soilCalibration");
+        for (int i = 0; i < current.soilCalibrationCount; i++) {
+            JsonObject point = calibration.createNestedObject();
+            point["raw"] = current.soilCalibration[i].raw;
+            point["percent"] = current.soilCalibration[i].percent;
+        }
+    }
+    
+    // Settings for the web pages: no internal fields, legacy keys included
+    void writeApiJson(JsonDocument &doc) {
+        ConfigRecord current = getRecord();
+        for (int i = 0; i < configFieldCount; i++) {
+            if (!(configFields[i].flags & CONFIG_INTERNAL)) {
+                getConfigField(current, configFields[i], doc);
+            }
+        }
+    }
+    
+    // Set one setting by key from a form value or a JSON value. False for
+    // an unknown key, an internal one unless allowed, or a rejected value.
+    template <typename Value>
+    bool setField(const char *key, size_t length, Value value, bool allowInternal = false) {
+        Guard guard(lock);
+        return stageField(record, key, length, value, allowInternal);
+    }
+    
+    // The same on a copy from getRecord(), for a change made of several
+    // settings that is then swapped in whole with applyRecord()
+    template <typename Value>
+    static bool stageField(ConfigRecord &staged, const char *key, size_t length, Value value, bool allowInternal = false) {
+        const ConfigField *field = findConfigField(key, length);
+        if (field == NULL || ((field->flags & CONFIG_INTERNAL) && !allowInternal)) {
+            return false;
+        }
+        if (!setConfigField(staged, *field, value)) {
+            Serial.printf("Config: rejected value for %s\n", field->key);
+            return false;
         }
-        
         return true;
     }
     
+    // Partial update from the API, all or nothing: unknown, internal and
+    // out-of-range keys are listed in 'rejected' and nothing changes.
+    // Otherwise 'changes' gets the ConfigApply bits of what changed.
+    bool patchJson(JsonObject values, uint8_t &changes, String &rejected) {
+        ConfigRecord staged = getRecord();
+        for (JsonPair pair : values) {
+            const ConfigField *field = findConfigField(pair.key().c_str(), pair.key().size());
+            if (field == NULL || (field->flags & CONFIG_INTERNAL) || !setConfigField(staged, *field, pair.value())) {
+                if (rejected.length() > 0) {
+                    rejected += ",";
+                }
+                rejected += pair.key().c_str();
+            }
+        }
+        if (rejected.length() > 0) {
+            return false;
+        }
+        changes = applyRecord(staged);
+        return true;
+    }
+    
+    // Swap in settings staged on a getRecord() copy and return the
+    // ConfigApply bits of what changed. The calibration curve belongs to
+    // the io task and is kept from the live record.
+    uint8_t applyRecord(ConfigRecord staged) {
+        Guard guard(lock);
+        staged.soilCalibrationCount = record.soilCalibrationCount;
+        memcpy(staged.soilCalibration, record.soilCalibration, sizeof(staged.soilCalibration));
+        uint8_t changes = configChanges(record, staged);
+        record = staged;
+        return changes;
+    }
+    
+    // Consistent copy of every setting
+    ConfigRecord getRecord() {
+        Guard guard(lock);
+        return record;
+    }
+    
+    // Settings from JSON (an export or the old config file); missing keys
+    // keep their current value, unknown ones are ignored
+    void importJson(JsonDocument &doc) {
+        ConfigRecord staged = getRecord();
+        for (JsonPair pair : doc.as<JsonObject>()) {
+            stageField(staged, pair.key().c_str(), pair.key().size(), pair.value(), true);
+        }
+        
+        if (doc.containsKey("soilCalibration")) {
+            staged.soilCalibrationCount = 0;
+            for (JsonObject point : doc["soilCalibration"].as<JsonArray>()) {
+                if (staged.soilCalibrationCount < SoilMoistureSensor::maxCalibrationPoints) {
+                    staged.soilCalibration[staged.soilCalibrationCount].raw = point["raw"] | 0;
+                    staged.soilCalibration[staged.soilCalibrationCount].percent = point["percent"] | 0.0f;
+                    staged.soilCalibrationCount++;
+                }
+            }
+        }
+        Guard guard(lock);
+        record = staged;
+    }
+    
     // Reset to default settings and mark as first run
     void resetToDefaults() {
-        LittleFS.remove(configFile);
-        isFirstRun = true;
-        
-        // Reset all values to defaults
-        deviceName = "GartenIrrigationSystem";
-        username = "user";
-        password = "pass";
-        soilMoisturePin = 36;
-        soilMoisturePowerPin = 27;
-        touchPin = 4;
-        i2cSdaPin = 21;
-        i2cSclPin = 22;
-        relay1Pin = 25;
-        relay2Pin = 26;
-        relay3Pin = 32;
-        relay4Pin = 33;
-        relay1Name = "Aux";
-        relay2Name = "Pump 1";
-        relay3Name = "Pump 2";
-        relay4Name = "Sensor";
-        soilMoistureDry = 2350;
-        soilMoistureWet = 815;
-        wateringDuration = 60;
-        wateringStartHour = 8;
-        wateringStartMinute = 0;
-        wateringEndHour = 9;
-        wateringEndMinute = 0;
-        soilMoistureThreshold = 50.0;
+        store.erase();
+        hal::fsRemove(legacyConfigFile);
+        Guard guard(lock);
+        record = ConfigRecord();
     }
     
     // Getters and setters for all configuration parameters
-    bool isFirstTimeSetup() { return isFirstRun; }
-    void setFirstTimeSetup(bool value) { isFirstRun = value; }
+    bool isFirstTimeSetup() { Guard guard(lock); return record.isFirstRun; }
+    void setFirstTimeSetup(bool value) { Guard guard(lock); record.isFirstRun = value; }
     
     // Device name
-    String getDeviceName() { return deviceName; }
-    void setDeviceName(const String &value) { deviceName = value; }
+    String getDeviceName() { return readString(record.deviceName); }
+    void setDeviceName(const String &value) { writeString(record.deviceName, sizeof(record.deviceName), value); }
     
     // Authentication
-    String getUsername() { return username; }
-    void setUsername(const String &value) { username = value; }
-    String getPassword() { return password; }
-    void setPassword(const String &value) { password = value; }
+    String getUsername() { return readString(record.username); }
+    void setUsername(const String &value) { writeString(record.username, sizeof(record.username), value); }
+    String getPassword() { return readString(record.password); }
+    void setPassword(const String &value) { writeString(record.password, sizeof(record.password), value); }
     
     // Pin assignments
-    int getSoilMoistureSensorPin() { return soilMoisturePin; }
-    void setSoilMoistureSensorPin(int value) { soilMoisturePin = value; }
-    int getSoilMoisturePowerPin() { return soilMoisturePowerPin; }
-    void setSoilMoisturePowerPin(int value) { soilMoisturePowerPin = value; }
-    int getTouchSensorPin() { return touchPin; }
-    void setTouchSensorPin(int value) { touchPin = value; }
-    int getTouchSensorThreshold() { return touchSensorThreshold; }
-    void setTouchSensorThreshold(int value) { touchSensorThreshold = value; }
-    int getI2cSdaPin() { return i2cSdaPin; }
-    void setI2cSdaPin(int value) { i2cSdaPin = value; }
-    int getI2cSclPin() { return i2cSclPin; }
-    void setI2cSclPin(int value) { i2cSclPin = value; }
+    int getSoilMoistureSensorPin() { Guard guard(lock); return record.soilMoisturePin; }
+    void setSoilMoistureSensorPin(int value) { Guard guard(lock); record.soilMoisturePin = value; }
+    int getSoilMoisturePowerPin() { Guard guard(lock); return record.soilMoisturePowerPin; }
+    void setSoilMoisturePowerPin(int value) { Guard guard(lock); record.soilMoisturePowerPin = value; }
+    int getTouchSensorPin() { Guard guard(lock); return record.touchPin; }
+    void setTouchSensorPin(int value) { Guard guard(lock); record.touchPin = value; }
+    int getTouchSensorThreshold() { Guard guard(lock); return record.touchSensorThreshold; }
+    void setTouchSensorThreshold(int value) { Guard guard(lock); record.touchSensorThreshold = value; }
+    int getI2cSdaPin() { Guard guard(lock); return record.i2cSdaPin; }
+    void setI2cSdaPin(int value) { Guard guard(lock); record.i2cSdaPin = value; }
+    int getI2cSclPin() { Guard guard(lock); return record.i2cSclPin; }
+    void setI2cSclPin(int value) { Guard guard(lock); record.i2cSclPin = value; }
     
     // Relay pins
-    int getRelay1Pin() { return relay1Pin; }
-    void setRelay1Pin(int value) { relay1Pin = value; }
-    int getRelay2Pin() { return relay2Pin; }
-    void setRelay2Pin(int value) { relay2Pin = value; }
-    int getRelay3Pin() { return relay3Pin; }
-    void setRelay3Pin(int value) { relay3Pin = value; }
-    int getRelay4Pin() { return relay4Pin; }
-    void setRelay4Pin(int value) { relay4Pin = value; }
+    int getRelay1Pin() { Guard guard(lock); return record.relayPins[0]; }
+    void setRelay1Pin(int value) { Guard guard(lock); record.relayPins[0] = value; }
+    int getRelay2Pin() { Guard guard(lock); return record.relayPins[1]; }
+    void setRelay2Pin(int value) { Guard guard(lock); record.relayPins[1] = value; }
+    int getRelay3Pin() { Guard guard(lock); return record.relayPins[2]; }
+    void setRelay3Pin(int value) { Guard guard(lock); record.relayPins[2] = value; }
+    int getRelay4Pin() { Guard guard(lock); return record.relayPins[3]; }
+    void setRelay4Pin(int value) { Guard guard(lock); record.relayPins[3] = value; }
     
     // Relay names
-    String getRelay1Name() { return relay1Name; }
-    void setRelay1Name(const String &value) { relay1Name = value; }
-    String getRelay2Name() { return relay2Name; }
-    void setRelay2Name(const String &value) { relay2Name = value; }
-    String getRelay3Name() { return relay3Name; }
-    void setRelay3Name(const String &value) { relay3Name = value; }
-    String getRelay4Name() { return relay4Name; }
-    void setRelay4Name(const String &value) { relay4Name = value; }
+    String getRelay1Name() { return readString(record.relayNames[0]); }
+    void setRelay1Name(const String &value) { writeString(record.relayNames[0], sizeof(record.relayNames[0]), value); }
+    String getRelay2Name() { return readString(record.relayNames[1]); }
+    void setRelay2Name(const String &value) { writeString(record.relayNames[1], sizeof(record.relayNames[1]), value); }
+    String getRelay3Name() { return readString(record.relayNames[2]); }
+    void setRelay3Name(const String &value) { writeString(record.relayNames[2], sizeof(record.relayNames[2]), value); }
+    String getRelay4Name() { return readString(record.relayNames[3]); }
+    void setRelay4Name(const String &value) { writeString(record.relayNames[3], sizeof(record.relayNames[3]), value); }
     
     // Soil moisture calibration
-    int getSoilMoistureDryValue() { return soilMoistureDry; }
-    void setSoilMoistureDryValue(int value) { soilMoistureDry = value; }
-    int getSoilMoistureWetValue() { return soilMoistureWet; }
-    void setSoilMoistureWetValue(int value) { soilMoistureWet = value; }
+    int getSoilMoistureDryValue() { Guard guard(lock); return record.soilMoistureDry; }
+    void setSoilMoistureDryValue(int value) { Guard guard(lock); record.soilMoistureDry = value; }
+    int getSoilMoistureWetValue() { Guard guard(lock); return record.soilMoistureWet; }
+    void setSoilMoistureWetValue(int value) { Guard guard(lock); record.soilMoistureWet = value; }
+    
+    // Multi-point soil calibration curve
+    // Copies the curve into 'points' (maxCalibrationPoints long); returns its length
+    int getSoilCalibration(SoilCalibrationPoint *points) {
+        Guard guard(lock);
+        memcpy(points, record.soilCalibration, sizeof(record.soilCalibration));
+        return record.soilCalibrationCount;
+    }
+    int getSoilCalibrationCount() { Guard guard(lock); return record.soilCalibrationCount; }
+    void clearSoilCalibration() { Guard guard(lock); record.soilCalibrationCount = 0; }
+    
+    // Add a point, replacing one at the same moisture; false when the table is full
+    bool addSoilCalibrationPoint(int raw, float percent) {
+        Guard guard(lock);
+        for (int i = 0; i < record.soilCalibrationCount; i++) {
+            if (fabsf(record.soilCalibration[i].percent - percent) < 0.5f) {
+                record.soilCalibration[i] = { raw, percent };
+                return true;
+            }
+        }
+        if (record.soilCalibrationCount >= SoilMoistureSensor::maxCalibrationPoints) {
+            return false;
+        }
+        record.soilCalibration[record.soilCalibrationCount++] = { raw, percent };
+        return true;
+    }
     
     // Watering settings
-    int getWateringDuration() { return wateringDuration; }
-    void setWateringDuration(int value) { wateringDuration = value; }
+    int getWateringDuration() { Guard guard(lock); return record.wateringDuration; }
+    void setWateringDuration(int value) { Guard guard(lock); record.wateringDuration = value; }
     
     // Watering time getters/setters - hour/minute format for more flexibility
-    int getWateringStartHour() { return wateringStartHour; }
-    void setWateringStartHour(int value) { wateringStartHour = value; }
-    int getWateringStartMinute() { return wateringStartMinute; }
-    void setWateringStartMinute(int value) { wateringStartMinute = value; }
-    int getWateringEndHour() { return wateringEndHour; }
-    void setWateringEndHour(int value) { wateringEndHour = value; }
-    int getWateringEndMinute() { return wateringEndMinute; }
-    void setWateringEndMinute(int value) { wateringEndMinute = value; }
+    int getWateringStartHour() { Guard guard(lock); return record.wateringStartHour; }
+    void setWateringStartHour(int value) { Guard guard(lock); record.wateringStartHour = value; }
+    int getWateringStartMinute() { Guard guard(lock); return record.wateringStartMinute; }
+    void setWateringStartMinute(int value) { Guard guard(lock); record.wateringStartMinute = value; }
+    int getWateringEndHour() { Guard guard(lock); return record.wateringEndHour; }
+    void setWateringEndHour(int value) { Guard guard(lock); record.wateringEndHour = value; }
+    int getWateringEndMinute() { Guard guard(lock); return record.wateringEndMinute; }
+    void setWateringEndMinute(int value) { Guard guard(lock); record.wateringEndMinute = value; }
+    
+    // Window in minutes since midnight; both ends from the same settings
+    void getWateringWindow(int &startMinutes, int &endMinutes) {
+        Guard guard(lock);
+        startMinutes = record.wateringStartHour * 60 + record.wateringStartMinute;
+        endMinutes = record.wateringEndHour * 60 + record.wateringEndMinute;
+    }
     
     // Soil moisture threshold for watering
-    float getSoilMoistureThreshold() { return soilMoistureThreshold; }
-    void setSoilMoistureThreshold(float value) { soilMoistureThreshold = value; }
+    float getSoilMoistureThreshold() { Guard guard(lock); return record.soilMoistureThreshold; }
+    void setSoilMoistureThreshold(float value) { Guard guard(lock); record.soilMoistureThreshold = value; }
+    
+    // Duty-cycle (deep sleep) mode
+    bool isDutyCycleMode() { Guard guard(lock); return record.dutyCycleMode; }
+    void setDutyCycleMode(bool value) { Guard guard(lock); record.dutyCycleMode = value; }
     
     // For backward compatibility
     bool isWateringEnabled() { return true; } // Always enabled, can be controlled by soil threshold
     
     // For legacy or simpler use cases
-    int getWateringTimeStart() { return wateringStartHour; }
-    int getWateringTimeEnd() { return wateringEndHour; }
+    int getWateringTimeStart() { Guard guard(lock); return record.wateringStartHour; }
+    int getWateringTimeEnd() { Guard guard(lock); return record.wateringEndHour; }
 };
 
 #endif // CONFIG_H
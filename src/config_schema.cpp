@@ -0,0 +1,267 @@
+#include "config_schema.h"
+#include <stddef.h>
+
+// One line per setting. Keys are dispatched through a perfect hash found
+// at compile time, so a new key cannot collide with an existing one. The
+// last column says what a change made at run time has to redo.
+#define CONFIG_FIELD(key, member, type, min, max, flags, apply) \
+    { key, type, flags, apply, offsetof(ConfigRecord, member), sizeof(ConfigRecord::member), min, max }
+
+constexpr ConfigField configFields[] = {
+    CONFIG_FIELD("isFirstRun", isFirstRun, CONFIG_BOOL, 0, 1, CONFIG_INTERNAL, APPLY_RESTART),
+
+    // Device and authentication settings
+    CONFIG_FIELD("deviceName", deviceName, CONFIG_STRING, 0, 0, 0, APPLY_RESTART),
+    CONFIG_FIELD("username", username, CONFIG_STRING, 0, 0, 0, APPLY_AUTH),
+    CONFIG_FIELD("password", password, CONFIG_STRING, 0, 0, 0, APPLY_AUTH),
+
+    // Pin assignments
+    CONFIG_FIELD("soilMoisturePin", soilMoisturePin, CONFIG_INT, 0, 39, 0, APPLY_SOIL_SENSOR),
+    CONFIG_FIELD("soilMoisturePowerPin", soilMoisturePowerPin, CONFIG_INT, 0, 39, 0, APPLY_SOIL_SENSOR),
+    CONFIG_FIELD("touchPin", touchPin, CONFIG_INT, 0, 39, 0, APPLY_TOUCH),
+    CONFIG_FIELD("touchSensorThreshold", touchSensorThreshold, CONFIG_INT, 0, 32767, 0, APPLY_TOUCH),
+    CONFIG_FIELD("i2cSdaPin", i2cSdaPin, CONFIG_INT, 0, 39, 0, APPLY_RESTART),
+    CONFIG_FIELD("i2cSclPin", i2cSclPin, CONFIG_INT, 0, 39, 0, APPLY_RESTART),
+    CONFIG_FIELD("relay1Pin", relayPins[0], CONFIG_INT, 0, 39, 0, APPLY_RELAYS),
+    CONFIG_FIELD("relay2Pin", relayPins[1], CONFIG_INT, 0, 39, 0, APPLY_RELAYS),
+    CONFIG_FIELD("relay3Pin", relayPins[2], CONFIG_INT, 0, 39, 0, APPLY_RELAYS),
+    CONFIG_FIELD("relay4Pin", relayPins[3], CONFIG_INT, 0, 39, 0, APPLY_RELAYS),
+
+    // Relay names
+    CONFIG_FIELD("relay1Name", relayNames[0], CONFIG_STRING, 0, 0, 0, APPLY_ON_USE),
+    CONFIG_FIELD("relay2Name", relayNames[1], CONFIG_STRING, 0, 0, 0, APPLY_ON_USE),
+    CONFIG_FIELD("relay3Name", relayNames[2], CONFIG_STRING, 0, 0, 0, APPLY_ON_USE),
+    CONFIG_FIELD("relay4Name", relayNames[3], CONFIG_STRING, 0, 0, 0, APPLY_ON_USE),
+
+    // Soil moisture calibration (the curve is an array, handled by Config)
+    CONFIG_FIELD("soilMoistureDry", soilMoistureDry, CONFIG_INT, 0, 4095, 0, APPLY_SOIL_SENSOR),
+    CONFIG_FIELD("soilMoistureWet", soilMoistureWet, CONFIG_INT, 0, 4095, 0, APPLY_SOIL_SENSOR),
+
+    // Watering settings, with the old setup page's hour-only keys
+    CONFIG_FIELD("wateringDuration", wateringDuration, CONFIG_INT, 1, 3600, 0, APPLY_SCHEDULE),
+    CONFIG_FIELD("wateringTimeStart", wateringStartHour, CONFIG_INT, 0, 23, CONFIG_ALIAS | CONFIG_HOUR_ONLY, APPLY_SCHEDULE),
+    CONFIG_FIELD("wateringTimeEnd", wateringEndHour, CONFIG_INT, 0, 23, CONFIG_ALIAS | CONFIG_HOUR_ONLY, APPLY_SCHEDULE),
+    CONFIG_FIELD("waterAtPercent", soilMoistureThreshold, CONFIG_FLOAT, 0, 100, CONFIG_ALIAS, APPLY_SCHEDULE),
+    CONFIG_FIELD("wateringStartHour", wateringStartHour, CONFIG_INT, 0, 23, 0, APPLY_SCHEDULE),
+    CONFIG_FIELD("wateringStartMinute", wateringStartMinute, CONFIG_INT, 0, 59, 0, APPLY_SCHEDULE),
+    CONFIG_FIELD("wateringEndHour", wateringEndHour, CONFIG_INT, 0, 23, 0, APPLY_SCHEDULE),
+    CONFIG_FIELD("wateringEndMinute", wateringEndMinute, CONFIG_INT, 0, 59, 0, APPLY_SCHEDULE),
+    CONFIG_FIELD("soilMoistureThreshold", soilMoistureThreshold, CONFIG_FLOAT, 0, 100, 0, APPLY_SCHEDULE),
+
+    // Power
+    CONFIG_FIELD("dutyCycleMode", dutyCycleMode, CONFIG_BOOL, 0, 1, 0, APPLY_RESTART),
+};
+
+constexpr int configFieldCount = sizeof(configFields) / sizeof(configFields[0]);
+
+static_assert(configFieldCount < 255, "field index must fit the hash slots");
+
+// CONFIG_HOUR_ONLY clears the single byte stored after the hour, which
+// must be that hour's minute
+static_assert(offsetof(ConfigRecord, wateringStartMinute) ==
+                  offsetof(ConfigRecord, wateringStartHour) + sizeof(ConfigRecord::wateringStartHour) &&
+              sizeof(ConfigRecord::wateringStartMinute) == 1,
+              "wateringStartMinute must be the byte after wateringStartHour");
+static_assert(offsetof(ConfigRecord, wateringEndMinute) ==
+                  offsetof(ConfigRecord, wateringEndHour) + sizeof(ConfigRecord::wateringEndHour) &&
+              sizeof(ConfigRecord::wateringEndMinute) == 1,
+              "wateringEndMinute must be the byte after wateringEndHour");
+
+// Perfect hash over the keys: seeded FNV-1a into hashBuckets slots, with
+// the seed searched at compile time. Written as single-return constexpr
+// functions so the firmware's C++11 can evaluate them.
+static const uint32_t hashBuckets = 256;
+static const uint32_t firstSeed = 2166136261u;   // FNV offset basis
+static const uint32_t seedsToTry = 200;
+
+static constexpr uint32_t keyHash(const char *key, size_t length, uint32_t hash) {
+    return length == 0 ? hash : keyHash(key + 1, length - 1, (hash ^ (uint8_t)*key) * 16777619u);
+}
+
+static constexpr size_t keyLength(const char *key) {
+    return *key ? 1 + keyLength(key + 1) : 0;
+}
+
+static constexpr uint32_t bucketOf(int field, uint32_t seed) {
+    return keyHash(configFields[field].key, keyLength(configFields[field].key), seed) % hashBuckets;
+}
+
+// No field from 'other' on shares a bucket with 'field'
+static constexpr bool bucketFree(int field, int other, uint32_t seed) {
+    return other >= configFieldCount ||
+           (bucketOf(field, seed) != bucketOf(other, seed) && bucketFree(field, other + 1, seed));
+}
+
+static constexpr bool isPerfect(int field, uint32_t seed) {
+    return field >= configFieldCount || (bucketFree(field, field + 1, seed) && isPerfect(field + 1, seed));
+}
+
+static constexpr uint32_t findSeed(uint32_t seed) {
+    return seed - firstSeed >= seedsToTry || isPerfect(0, seed) ? seed : findSeed(seed + 1);
+}
+
+static constexpr uint32_t hashSeed = findSeed(firstSeed);
+static_assert(hashSeed - firstSeed < seedsToTry, "no perfect hash for the config keys; raise hashBuckets");
+
+// Bucket -> field index + 1 (0 for an empty bucket), built into flash
+struct ConfigHashSlots {
+    uint8_t field[hashBuckets];
+};
+
+static constexpr uint8_t fieldInBucket(uint32_t bucket, int field) {
+    return field >= configFieldCount ? 0 :
+           bucketOf(field, hashSeed) == bucket ? field + 1 : fieldInBucket(bucket, field + 1);
+}
+
+template <uint32_t... Buckets>
+struct BucketList {};
+
+template <uint32_t N, uint32_t... Buckets>
+struct MakeBucketList : MakeBucketList<N - 1, N - 1, Buckets...> {};
+
+template <uint32_t... Buckets>
+struct MakeBucketList<0, Buckets...> {
+    typedef BucketList<Buckets...> type;
+};
+
+template <uint32_t... Buckets>
+static constexpr ConfigHashSlots makeSlots(BucketList<Buckets...>) {
+    return ConfigHashSlots{ { fieldInBucket(Buckets, 0)... } };
+}
+
+static constexpr ConfigHashSlots hashSlots = makeSlots(MakeBucketList<hashBuckets>::type());
+
+const ConfigField *findConfigField(const char *key, size_t length) {
+    uint8_t slot = hashSlots.field[keyHash(key, length, hashSeed) % hashBuckets];
+    if (slot == 0) {
+        return NULL;
+    }
+    const ConfigField &field = configFields[slot - 1];
+    return strncmp(field.key, key, length) == 0 && field.key[length] == 0 ? &field : NULL;
+}
+
+static uint8_t *fieldData(ConfigRecord &record, const ConfigField &field) {
+    return (uint8_t *)&record + field.offset;
+}
+
+static bool storeInt(ConfigRecord &record, const ConfigField &field, long value) {
+    if (value < field.min || value > field.max) {
+        return false;
+    }
+    uint8_t *data = fieldData(record, field);
+    if (field.size == 1) {
+        *data = value;
+    } else if (field.size == 2) {
+        int16_t narrow = value;
+        memcpy(data, &narrow, 2);
+    } else {
+        int32_t wide = value;
+        memcpy(data, &wide, 4);
+    }
+    if (field.flags & CONFIG_HOUR_ONLY) {
+        data[field.size] = 0;
+    }
+    return true;
+}
+
+static bool storeNumber(ConfigRecord &record, const ConfigField &field, double value) {
+    if (isnan(value)) {
+        return false;
+    }
+    switch (field.type) {
+        case CONFIG_BOOL:
+            *fieldData(record, field) = value != 0;
+            return true;
+        case CONFIG_INT:
+            return value >= field.min && value <= field.max && storeInt(record, field, (long)value);
+        case CONFIG_FLOAT: {
+            if (value < field.min || value > field.max) {
+                return false;
+            }
+            float narrow = value;
+            memcpy(fieldData(record, field), &narrow, sizeof(narrow));
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool setConfigField(ConfigRecord &record, const ConfigField &field, const char *text) {
+    if (field.type == CONFIG_STRING) {
+        snprintf((char *)fieldData(record, field), field.size, "%s", text);
+        return true;
+    }
+    if (field.type == CONFIG_BOOL) {
+        // Checkbox values, as well as JSON-style literals
+        bool on = strcmp(text, "1") == 0 || strcmp(text, "true") == 0 || strcmp(text, "on") == 0;
+        *fieldData(record, field) = on;
+        return true;
+    }
+
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text) {
+        return false;
+    }
+    return storeNumber(record, field, value);
+}
+
+bool setConfigField(ConfigRecord &record, const ConfigField &field, JsonVariant value) {
+    if (value.isNull()) {
+        return false;
+    }
+    if (value.is<const char *>()) {
+        return setConfigField(record, field, value.as<const char *>());
+    }
+    if (field.type == CONFIG_STRING) {
+        return false;
+    }
+    if (value.is<bool>()) {
+        return storeNumber(record, field, value.as<bool>() ? 1 : 0);
+    }
+    return storeNumber(record, field, value.as<double>());
+}
+
+uint8_t configChanges(const ConfigRecord &before, const ConfigRecord &after) {
+    uint8_t apply = 0;
+    for (int i = 0; i < configFieldCount; i++) {
+        const ConfigField &field = configFields[i];
+        if (memcmp((const uint8_t *)&before + field.offset, (const uint8_t *)&after + field.offset, field.size) != 0) {
+            apply |= field.apply;
+        }
+    }
+    return apply;
+}
+
+void getConfigField(const ConfigRecord &record, const ConfigField &field, JsonDocument &doc) {
+    const uint8_t *data = (const uint8_t *)&record + field.offset;
+    switch (field.type) {
+        case CONFIG_BOOL:
+            doc[field.key] = *data != 0;
+            break;
+        case CONFIG_INT:
+            if (field.size == 1) {
+                doc[field.key] = *data;
+            } else if (field.size == 2) {
+                int16_t value;
+                memcpy(&value, data, 2);
+                doc[field.key] = value;
+            } else {
+                int32_t value;
+                memcpy(&value, data, 4);
+                doc[field.key] = value;
+            }
+            break;
+        case CONFIG_FLOAT: {
+            float value;
+            memcpy(&value, data, sizeof(value));
+            doc[field.key] = value;
+            break;
+        }
+        case CONFIG_STRING:
+            // A char * is copied into the document; a const char * would be referenced
+            doc[field.key] = (char *)data;
+            break;
+    }
+}
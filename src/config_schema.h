@@ -0,0 +1,101 @@
+#ifndef CONFIG_SCHEMA_H
+#define CONFIG_SCHEMA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "soil_moisture.h"
+
+// Every setting in one fixed-layout record, stored on flash as is. Change
+// the layout only together with Config::recordVersion and a migration.
+struct __attribute__((packed, aligned(4))) ConfigRecord {
+    // 4-byte fields first so that none is misaligned
+    SoilCalibrationPoint soilCalibration[SoilMoistureSensor::maxCalibrationPoints] = {};
+    float soilMoistureThreshold = 50.0;
+    int32_t wateringDuration = 60;
+    
+    // Device settings
+    int16_t touchSensorThreshold = 40;
+    int16_t soilMoisturePin = 36;
+    int16_t soilMoisturePowerPin = 27;
+    int16_t touchPin = 4;
+    int16_t i2cSdaPin = 21;
+    int16_t i2cSclPin = 22;
+    int16_t relayPins[4] = { 25, 26, 32, 33 };
+    int16_t soilMoistureDry = 2350;
+    int16_t soilMoistureWet = 815;
+    uint8_t soilCalibrationCount = 0;   // Below two, wet and dry define the curve
+    uint8_t wateringStartHour = 8;
+    uint8_t wateringStartMinute = 0;
+    uint8_t wateringEndHour = 9;
+    uint8_t wateringEndMinute = 0;
+    
+    // Flag to determine if this is first run
+    bool isFirstRun = true;
+    
+    // Power
+    bool dutyCycleMode = false;   // Deep sleep between readings and watering windows
+    
+    // Strings, NUL-terminated; the device name is also the AP SSID (32 max)
+    char deviceName[33] = "GartenIrrigationSystem";
+    char username[33] = "user";
+    char password[65] = "pass";
+    char relayNames[4][25] = { "Aux", "Pump 1", "Pump 2", "Sensor" };
+};
+
+enum ConfigFieldType : uint8_t {
+    CONFIG_BOOL,
+    CONFIG_INT,      // Unsigned in 1 byte, signed in 2 or 4
+    CONFIG_FLOAT,
+    CONFIG_STRING    // Fixed char array, always NUL-terminated
+};
+
+enum ConfigFieldFlags : uint8_t {
+    CONFIG_INTERNAL = 1,    // Not read or written through the web API
+    CONFIG_ALIAS = 2,       // Legacy key of another field: accepted, sent to old pages, not exported
+    CONFIG_HOUR_ONLY = 4    // Legacy hour key; also zeroes the minute stored after the hour
+};
+
+// What the running system redoes when a setting changes; settings read
+// where they are used (names, the login) need nothing
+enum ConfigApply : uint8_t {
+    APPLY_ON_USE = 0,
+    APPLY_RELAYS = 1,        // Re-pin the relays whose pin changed
+    APPLY_SOIL_SENSOR = 2,   // Probe pins and dry/wet calibration
+    APPLY_TOUCH = 4,         // Touch pad pin and threshold
+    APPLY_SCHEDULE = 8,      // Re-plan the next watering check
+    APPLY_AUTH = 16,         // Credentials copied into the event stream
+    APPLY_RESTART = 128      // Only read at boot: I2C bus, AP name, duty cycle
+};
+
+// One setting: its key, where it lives in ConfigRecord and what it may hold
+struct ConfigField {
+    const char *key;
+    ConfigFieldType type;
+    uint8_t flags;
+    uint8_t apply;    // ConfigApply bits
+    uint16_t offset;
+    uint16_t size;    // Bytes; for strings, the capacity with the terminator
+    int32_t min;      // Range of numbers, inclusive
+    int32_t max;
+};
+
+// The settings, in the order the API and exports list them (config_schema.cpp)
+extern const ConfigField configFields[];
+extern const int configFieldCount;
+
+// Field for a key of the given length (not necessarily NUL-terminated),
+// found through a perfect hash computed at compile time; NULL if unknown
+const ConfigField *findConfigField(const char *key, size_t length);
+
+// Store a form value or a JSON value; false, leaving the setting as it
+// was, if it does not parse or is out of range. Strings are cut to fit.
+bool setConfigField(ConfigRecord &record, const ConfigField &field, const char *text);
+bool setConfigField(ConfigRecord &record, const ConfigField &field, JsonVariant value);
+
+// doc[field.key] = the setting's value
+void getConfigField(const ConfigRecord &record, const ConfigField &field, JsonDocument &doc);
+
+// ConfigApply bits of every field that differs between the two records
+uint8_t configChanges(const ConfigRecord &before, const ConfigRecord &after);
+
+#endif
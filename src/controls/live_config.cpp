@@ -0,0 +1,90 @@
+#include "live_config.h"
+
+LiveConfig::LiveConfig(Config &config, Relay &relay1, Relay &relay2, Relay &relay3, Relay &relay4,
+                       WateringController &watering, SoilMoistureSensor &soil, SensorAcquisition &acquisition,
+                       TouchControl &touch)
+    : config(config), relays{ &relay1, &relay2, &relay3, &relay4 }, watering(watering), soil(soil),
+      acquisition(acquisition), touch(touch) {
+}
+
+uint8_t LiveConfig::targets(uint8_t changes) {
+    if (changes & APPLY_RESTART) {
+        return 0;
+    }
+    uint8_t targets = TARGET_IO;
+    if (changes & (APPLY_RELAYS | APPLY_SCHEDULE)) {
+        targets |= TARGET_CONTROL;
+    }
+    return targets;
+}
+
+void LiveConfig::applyControl(uint8_t changes, uint32_t requestedAt) {
+    if (changes & APPLY_RELAYS) {
+        int pins[] = { config.getRelay1Pin(), config.getRelay2Pin(), config.getRelay3Pin(), config.getRelay4Pin() };
+        for (int i = 0; i < 4; i++) {
+            if (relays[i]->getRelayPin() == pins[i]) {
+                continue;
+            }
+            bool on = relays[i]->getState();
+            relays[i]->turnOff();
+            relays[i]->setRelayPin(pins[i]);
+            if (on) {
+                relays[i]->turnOn();
+            }
+        }
+    }
+    if (changes & APPLY_SCHEDULE) {
+        watering.reschedule();
+    }
+    Serial.printf("Config: relays and schedule applied %.1f ms after the request\n",
+                  (hal::micros() - requestedAt) / 1000.0);
+}
+
+bool LiveConfig::applyIo(uint8_t changes, uint32_t requestedAt) {
+    // An unchanged record is not rewritten
+    uint32_t started = hal::micros();
+    bool saved = config.saveConfig();
+    if (!saved) {
+        Serial.println("Failed to save configuration");
+    }
+    Serial.printf("Config: saved in %.1f ms, %.1f ms after the request\n",
+                  (hal::micros() - started) / 1000.0, (hal::micros() - requestedAt) / 1000.0);
+
+    if (changes & (APPLY_SOIL_SENSOR | APPLY_TOUCH)) {
+        pendingSensorChanges |= changes & (APPLY_SOIL_SENSOR | APPLY_TOUCH);
+        pendingSensorRequestedAt = requestedAt;
+        applySensors();
+    }
+    return saved;
+}
+
+void LiveConfig::applySensors() {
+    if (pendingSensorChanges == 0 || acquisition.isBusy()) {
+        return;
+    }
+
+    if (pendingSensorChanges & APPLY_SOIL_SENSOR) {
+        soil.powerOff();
+        soil.setSensorPin(config.getSoilMoistureSensorPin());
+        soil.setPowerPin(config.getSoilMoisturePowerPin());
+        soil.calibrateDry(config.getSoilMoistureDryValue());
+        soil.calibrateWet(config.getSoilMoistureWetValue());
+        soil.init();
+    }
+
+    if (pendingSensorChanges & APPLY_TOUCH) {
+        touch.setTouchPin(config.getTouchSensorPin());
+        touch.setThreshold(config.getTouchSensorThreshold());
+        touch.reattachInterrupt();
+    }
+
+    Serial.printf("Config: sensors applied %.1f ms after the request\n",
+                  (hal::micros() - pendingSensorRequestedAt) / 1000.0);
+    pendingSensorChanges = 0;
+}
+
+void LiveConfig::applySoilCalibration() {
+    SoilCalibrationPoint curve[SoilMoistureSensor::maxCalibrationPoints];
+    int count = config.getSoilCalibration(curve);
+    soil.setCalibrationCurve(curve, count);
+}
@@ -0,0 +1,63 @@
+#ifndef LIVE_CONFIG_H
+#define LIVE_CONFIG_H
+
+#include <Arduino.h>
+#include "hal.h"
+#include "config.h"
+#include "relay.h"
+#include "touch.h"
+#include "soil_moisture.h"
+#include "sensor_acquisition.h"
+#include "watering_controller.h"
+
+// Applies a settings change to the running controller, each part on the
+// task that owns the hardware it affects: relay pins and the watering
+// plan on the control task; the saved record, the soil probe and the
+// touch pad on the io task, the probe once no acquisition is using it.
+// The firmware posts the two parts through the tasks' queues, the sim
+// runs them directly; both apply them here.
+class LiveConfig {
+public:
+    // Tasks a change goes to; none when it only takes effect after a restart
+    enum Target : uint8_t {
+        TARGET_CONTROL = 1,   // applyControl()
+        TARGET_IO = 2         // applyIo(); every change is saved
+    };
+
+private:
+    Config &config;
+    Relay *relays[4];
+    WateringController &watering;
+    SoilMoistureSensor &soil;
+    SensorAcquisition &acquisition;
+    TouchControl &touch;
+
+    // Sensor settings changed while an acquisition was running (io task only)
+    uint8_t pendingSensorChanges = 0;
+    uint32_t pendingSensorRequestedAt = 0;
+
+public:
+    LiveConfig(Config &config, Relay &relay1, Relay &relay2, Relay &relay3, Relay &relay4,
+               WateringController &watering, SoilMoistureSensor &soil, SensorAcquisition &acquisition,
+               TouchControl &touch);
+
+    static uint8_t targets(uint8_t changes);
+
+    // Control task: move each relay whose pin changed, switching the old
+    // pin off first (a relay that was on, the pump mid-cycle, stays on),
+    // and re-plan watering. requestedAt is micros() when the change arrived.
+    void applyControl(uint8_t changes, uint32_t requestedAt);
+
+    // Io task: save the record, then re-init the probe and touch pad.
+    // False if the save failed.
+    bool applyIo(uint8_t changes, uint32_t requestedAt);
+
+    // Io task, once per pass: sensor changes held back by a running
+    // acquisition are applied once it has finished
+    void applySensors();
+
+    // Load the configured curve into the probe's lookup table
+    void applySoilCalibration();
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define RELAY_H
 
 #include <Arduino.h>
+#include "hal.h"
 
 class Relay {
 private:
@@ -16,9 +17,9 @@ public:
         
         // Immediately configure pin if set in constructor
         if (relayPin >= 0) {
-            pinMode(relayPin, OUTPUT);
+            hal::pinMode(relayPin, OUTPUT);
             // Ensure relay is OFF at instantiation - critical for power-up
-            digitalWrite(relayPin, activeHigh ? LOW : HIGH);
+            hal::digitalWrite(relayPin, activeHigh ? LOW : HIGH);
         }
     }
     
@@ -29,10 +30,10 @@ public:
     void init() {
         if (relayPin >= 0) {  // IMPORTANT: Keep this check
             // Set pin as OUTPUT first
-            pinMode(relayPin, OUTPUT);
+            hal::pinMode(relayPin, OUTPUT);
             
             // Immediately drive to inactive state
-            digitalWrite(relayPin, activeHigh ? LOW : HIGH);
+            hal::digitalWrite(relayPin, activeHigh ? LOW : HIGH);
             
             // Initialize state
             state = false;
@@ -45,7 +46,7 @@ public:
         if (relayPin >= 0) {
             // For active HIGH relays, we set HIGH to turn ON
             // For active LOW relays, we set LOW to turn ON
-            digitalWrite(relayPin, activeHigh ? HIGH : LOW);
+            hal::digitalWrite(relayPin, activeHigh ? HIGH : LOW);
             state = true;
             Serial.printf("Relay pin %d turned ON\n", relayPin);
         }
@@ -55,7 +56,7 @@ public:
         if (relayPin >= 0) {
             // For active HIGH relays, we set LOW to turn OFF
             // For active LOW relays, we set HIGH to turn OFF
-            digitalWrite(relayPin, activeHigh ? LOW : HIGH);
+            hal::digitalWrite(relayPin, activeHigh ? LOW : HIGH);
             state = false;
             Serial.printf("Relay pin %d turned OFF\n", relayPin);
         }
@@ -76,19 +77,21 @@ public:
     void syncState() {
         if (relayPin >= 0) {
             // Read the current pin value
-            int pinValue = digitalRead(relayPin);
+            int pinValue = hal::digitalRead(relayPin);
             // Determine the logical state based on activeHigh setting
             state = (activeHigh && pinValue == HIGH) || (!activeHigh && pinValue == LOW);
         }
     }
     
+    int getRelayPin() { return relayPin; }
+    
     void setRelayPin(int pin) { 
         relayPin = pin; 
         // When pin is changed, immediately configure it
         if (relayPin >= 0) {
-            pinMode(relayPin, OUTPUT);
+            hal::pinMode(relayPin, OUTPUT);
             // Ensure relay is OFF when pin is set
-            digitalWrite(relayPin, activeHigh ? LOW : HIGH);
+            hal::digitalWrite(relayPin, activeHigh ? LOW : HIGH);
             state = false;
         }
     }
@@ -99,7 +102,7 @@ public:
             activeHigh = high;
             // Reapply current state with new logic
             if (relayPin >= 0) {
-                digitalWrite(relayPin, state ? 
+                hal::digitalWrite(relayPin, state ? 
                     (activeHigh ? HIGH : LOW) : 
                     (activeHigh ? LOW : HIGH));
                 Serial.printf("Relay %d logic changed to active %s\n", 
@@ -2,12 +2,14 @@
 #define TOUCH_H
 
 #include <Arduino.h>
+#include "hal.h"
 
 class TouchControl {
 private:
     int touchPin;
     int threshold = 40;  // Default touch threshold
     unsigned long lastTouchTime = 0;
+    void (*interruptHandler)() = NULL;
     const unsigned long debounceDelay = 500; // Debounce time in milliseconds
     
 public:
@@ -27,14 +29,14 @@ public:
     
     bool isTouched() {
         // Read touch value (ESP32 returns lower values when touched)
-        int touchValue = touchRead(touchPin);
+        int touchValue = hal::touchRead(touchPin);
         
         // Check if below threshold (touched) and debounce
         bool touched = (touchValue < threshold);
         
         if (touched) {
             // Debouncing logic
-            unsigned long currentTime = millis();
+            unsigned long currentTime = hal::millis();
             if (currentTime - lastTouchTime > debounceDelay) {
                 lastTouchTime = currentTime;
                 Serial.printf("Touch detected on pin %d (value: %d)\n", touchPin, touchValue);
@@ -45,6 +47,20 @@ public:
         return false;
     }
     
+    // Call handler from an interrupt when a reading drops below the threshold
+    void attachInterrupt(void (*handler)()) {
+        interruptHandler = handler;
+        hal::touchAttachInterrupt(touchPin, handler, threshold);
+    }
+
+    // Attach the same handler after a pin or threshold change; the old
+    // pad's interrupt stays attached, it only wakes the network task
+    void reattachInterrupt() {
+        if (interruptHandler != NULL) {
+            hal::touchAttachInterrupt(touchPin, interruptHandler, threshold);
+        }
+    }
+    
     // Check for touch and perform action when detected
     bool checkForTouch() {
         if (isTouched()) {
@@ -64,7 +80,7 @@ public:
     }
     
     int getRawValue() {
-        return touchRead(touchPin);
+        return hal::touchRead(touchPin);
     }
     // Add to TouchControl class
     void setTouchPin(int pin) { touchPin = pin; }
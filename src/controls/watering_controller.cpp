@@ -0,0 +1,275 @@
+#include "watering_controller.h"
+#include <algorithm>
+
+WateringController::WateringController(Config &config, Relay &pump, Timekeeper &clock)
+    : config(config), pump(pump), clock(clock) {
+}
+
+void WateringController::updateReadings(const SensorReadings &newReadings) {
+    readings = newReadings;
+
+    // Calculate heat index based on temperature and humidity
+    heatIndex = calculateHeatIndex(readings.temperature, readings.humidity);
+
+    Serial.println("\n--- UPDATING SENSOR READINGS ---");
+    Serial.printf("Temperature: %.2f°C, Humidity: %.2f%%, Pressure: %.2f hPa\n",
+                  readings.temperature, readings.humidity, readings.pressure);
+    Serial.printf("Heat Index: %.2f°C\n", heatIndex);
+    Serial.printf("Soil Moisture: %.2f%% (Raw: %d)\n",
+                  readings.soilMoisturePercent, readings.soilMoistureRaw);
+
+    // Update timestamp for last sensor reading
+    lastSensorUpdate = hal::millis();
+    sensorsReady = true;
+    changed = true;
+
+    // Soil moisture decides whether an open window waters
+    scheduleChecked = false;
+}
+
+void WateringController::tick() {
+    // Check if watering is in progress
+    if (watering) {
+        checkWateringStatus();
+        return;
+    }
+
+    // Check if watering should start (autonomous watering)
+    unsigned long now = hal::millis();
+    if (!scheduleChecked || now - lastScheduleCheck >= nextScheduleCheckDelay) {
+        hal::WallTime wall = clock.now();
+        lastScheduleCheck = now;
+        scheduleChecked = true;
+
+        if (shouldWaterAt(wall)) {
+            startWatering();
+        } else {
+            nextScheduleCheckDelay = msUntilWindowOpens(wall);
+        }
+    }
+}
+
+unsigned long WateringController::msUntilNextEvent() {
+    unsigned long now = hal::millis();
+
+    if (watering) {
+        unsigned long elapsed = now - wateringStartTime;
+        return (elapsed < wateringDuration) ? wateringDuration - elapsed : 0;
+    }
+
+    if (!scheduleChecked) {
+        return 0;
+    }
+    unsigned long sinceCheck = now - lastScheduleCheck;
+    return (sinceCheck < nextScheduleCheckDelay) ? nextScheduleCheckDelay - sinceCheck : 0;
+}
+
+void WateringController::reschedule() {
+    scheduleChecked = false;
+}
+
+// Time until the window next opens on a day that may still be watered,
+// i.e. the next time shouldWaterAt() can turn true without a new reading
+unsigned long WateringController::msUntilWindowOpens(const hal::WallTime &now) {
+    if (!config.isWateringEnabled()) {
+        return maxScheduleCheckDelay;
+    }
+
+    // Configured window, clipped to daytime (07:00 - 21:59)
+    int startMinutes, endMinutes;
+    config.getWateringWindow(startMinutes, endMinutes);
+    startMinutes = std::max(startMinutes, 7 * 60);
+    endMinutes = std::min(endMinutes, 22 * 60 - 1);
+    if (startMinutes > endMinutes) {
+        return maxScheduleCheckDelay;
+    }
+
+    long secondsToday = (now.hour * 60L + now.minute) * 60 + now.second;
+    for (int days = 0; days <= 7; days++) {
+        // No watering on Sundays
+        if ((now.dayOfWeek + days) % 7 == 0) {
+            continue;
+        }
+
+        // Today is out once watered or once the window has opened; inside
+        // the window only a new reading can change the outcome
+        if (days == 0 && (lastWateringDay == now.day || secondsToday >= startMinutes * 60L)) {
+            continue;
+        }
+
+        unsigned long seconds = days * 86400L + startMinutes * 60L - secondsToday;
+        return seconds < maxScheduleCheckDelay / 1000 ? seconds * 1000 : maxScheduleCheckDelay;
+    }
+    return maxScheduleCheckDelay;
+}
+
+bool WateringController::shouldWater() {
+    return shouldWaterAt(clock.now());
+}
+
+bool WateringController::shouldWaterAt(const hal::WallTime &now) {
+    // Only check if automatic watering is enabled
+    if (!config.isWateringEnabled()) {
+        return false;
+    }
+
+    // Soil moisture is unknown until the first acquisition cycle completes
+    if (!sensorsReady) {
+        return false;
+    }
+
+    // Check if we already watered today
+    if (lastWateringDay == now.day) {
+        return false;
+    }
+
+    // Don't water on Sundays (day 0)
+    if (now.dayOfWeek == 0) {
+        return false;
+    }
+
+    // Don't water at night (22:00 - 07:00)
+    if (now.hour >= 22 || now.hour < 7) {
+        return false;
+    }
+
+    // Convert time to minutes since midnight for easier comparison
+    int currentTimeMinutes = now.hour * 60 + now.minute;
+    int startTimeMinutes, endTimeMinutes;
+    config.getWateringWindow(startTimeMinutes, endTimeMinutes);
+
+    // Check if current time is within watering window
+    if (currentTimeMinutes < startTimeMinutes || currentTimeMinutes > endTimeMinutes) {
+        return false;
+    }
+
+    // Check soil moisture
+    if (readings.soilMoisturePercent > config.getSoilMoistureThreshold()) {
+        return false;
+    }
+
+    // All conditions met, should water now
+    return true;
+}
+
+void WateringController::startWatering() {
+    if (watering) {
+        return; // Already watering
+    }
+
+    Serial.println("Starting watering cycle");
+
+    // Record today as the watering day
+    lastWateringDay = clock.now().day;
+
+    // Turn on pump
+    pump.turnOn();
+
+    // Set watering state
+    watering = true;
+    wateringStartTime = hal::millis();
+    wateringDuration = config.getWateringDuration() * 1000UL; // Convert to milliseconds
+    changed = true;
+
+    Serial.printf("Watering will run for %d seconds\n", config.getWateringDuration());
+}
+
+void WateringController::stopWatering() {
+    if (!watering) {
+        return; // Not watering
+    }
+
+    Serial.println("Stopping watering cycle");
+
+    // Turn off pump
+    pump.turnOff();
+
+    // Reset watering state
+    watering = false;
+    changed = true;
+    scheduleChecked = false;
+
+    Serial.println("Watering cycle complete");
+}
+
+void WateringController::checkWateringStatus() {
+    if (!watering) {
+        return;
+    }
+
+    // Check if watering duration has elapsed
+    unsigned long elapsed = hal::millis() - wateringStartTime;
+    if (elapsed >= wateringDuration) {
+        stopWatering();
+    }
+}
+
+bool WateringController::takeChanged() {
+    bool wasChanged = changed;
+    changed = false;
+    return wasChanged;
+}
+
+void WateringController::markChanged() {
+    changed = true;
+}
+
+const SensorReadings &WateringController::getReadings() {
+    return readings;
+}
+
+float WateringController::getHeatIndex() {
+    return heatIndex;
+}
+
+unsigned long WateringController::getLastSensorUpdate() {
+    return lastSensorUpdate;
+}
+
+bool WateringController::isWatering() {
+    return watering;
+}
+
+unsigned long WateringController::getWateringStartTime() {
+    return wateringStartTime;
+}
+
+unsigned long WateringController::getWateringDuration() {
+    return wateringDuration;
+}
+
+int WateringController::getLastWateringDay() {
+    return lastWateringDay;
+}
+
+void WateringController::setLastWateringDay(int day) {
+    lastWateringDay = day;
+    scheduleChecked = false;
+}
+
+float calculateHeatIndex(float temperature, float humidity) {
+    // Only calculate heat index if temperature is high enough
+    // Below about 26.7°C (80°F), the heat index equals the temperature
+    if (temperature < 26.7) {
+        return temperature;
+    }
+
+    // Heat index calculation (simplified equation)
+    // Source: https://www.wpc.ncep.noaa.gov/html/heatindex_equation.shtml
+    float hIndex = 0.5 * (temperature + 61.0 + ((temperature - 68.0) * 1.2) + (humidity * 0.094));
+
+    // If the humidity is high enough and temperature high enough, use full equation
+    if (humidity > 40 && temperature >= 27) {
+        hIndex = -42.379 +
+            2.04901523 * temperature +
+            10.14333127 * humidity -
+            0.22475541 * temperature * humidity -
+            0.00683783 * temperature * temperature -
+            0.05481717 * humidity * humidity +
+            0.00122874 * temperature * temperature * humidity +
+            0.00085282 * temperature * humidity * humidity -
+            0.00000199 * temperature * temperature * humidity * humidity;
+    }
+
+    return hIndex;
+}
@@ -0,0 +1,82 @@
+#ifndef WATERING_CONTROLLER_H
+#define WATERING_CONTROLLER_H
+
+#include <Arduino.h>
+#include "hal.h"
+#include "config.h"
+#include "relay.h"
+#include "sensor_acquisition.h"
+#include "timekeeper.h"
+
+// Autonomous watering logic: decides when to water from the configured
+// schedule and the latest soil reading, and runs the pump for the
+// configured duration. Hardware access goes through the HAL only, so the
+// same controller runs on the device and in the native simulation.
+class WateringController {
+private:
+    Config &config;
+    Relay &pump;
+    Timekeeper &clock;
+
+    // Latest readings
+    SensorReadings readings;
+    float heatIndex = 0;
+    bool sensorsReady = false;       // Set once the first complete reading arrives
+    unsigned long lastSensorUpdate = 0;
+
+    // Watering state
+    bool watering = false;
+    unsigned long wateringStartTime = 0;
+    unsigned long wateringDuration = 0;
+    int lastWateringDay = -1;        // Day of month when watering last occurred
+
+    // The schedule only changes with a new reading or when the watering
+    // window opens, so it is evaluated then rather than on every tick
+    static const unsigned long maxScheduleCheckDelay = 3600000UL; // Notice clock and config changes
+    unsigned long lastScheduleCheck = 0;
+    unsigned long nextScheduleCheckDelay = 0; // ms from lastScheduleCheck
+    bool scheduleChecked = false;
+
+    bool changed = true;
+
+    bool shouldWaterAt(const hal::WallTime &now);
+    unsigned long msUntilWindowOpens(const hal::WallTime &now);
+
+public:
+    WateringController(Config &config, Relay &pump, Timekeeper &clock);
+
+    // Accept a completed set of readings from the acquisition engine
+    void updateReadings(const SensorReadings &newReadings);
+
+    // One control iteration: finish an elapsed cycle or start a scheduled one
+    void tick();
+
+    // Milliseconds until tick() next has work to do
+    unsigned long msUntilNextEvent();
+
+    // The window, duration or threshold changed: check again on the next
+    // tick. A running cycle keeps the duration it started with.
+    void reschedule();
+
+    bool shouldWater();
+    void startWatering();
+    void stopWatering();
+    void checkWateringStatus();
+
+    // True once after any change to readings or watering state
+    bool takeChanged();
+    void markChanged();
+
+    const SensorReadings &getReadings();
+    float getHeatIndex();
+    unsigned long getLastSensorUpdate();
+    bool isWatering();
+    unsigned long getWateringStartTime();
+    unsigned long getWateringDuration();
+    int getLastWateringDay();
+    void setLastWateringDay(int day);   // Restored after deep sleep
+};
+
+float calculateHeatIndex(float temperature, float humidity);
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+// Thin hardware abstraction layer.
+// The controller reaches clock, GPIO, ADC, touch, I2C, RTC, filesystem and
+// deep sleep only through these calls. hal_esp32.cpp implements them on the device;
+// sim/hal_sim.cpp implements them for the native build on a virtual clock.
+namespace hal {
+
+// Civil time as kept by the RTC
+struct WallTime {
+    uint16_t year;
+    uint8_t month;      // 1-12
+    uint8_t day;        // 1-31
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t dayOfWeek;  // 0 = Sunday
+    uint32_t unixtime;
+};
+
+// Conversions shared by all backends (hal_time.cpp)
+WallTime wallTimeFromUnix(uint32_t unixtime);
+WallTime makeWallTime(int year, int month, int day, int hour, int minute, int second);
+
+// Clock
+unsigned long millis();
+unsigned long micros();
+uint64_t uptimeMicros();  // Since boot; does not wrap
+void delay(unsigned long ms);
+void yieldTick();         // Blocks the calling task for one scheduler tick, so lower-priority tasks can run
+uint32_t cycleCount();    // CPU cycles on the calling core; wraps (about 18 s at 240 MHz)
+uint32_t cpuMhz();
+
+// GPIO, ADC and touch
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+int analogRead(int pin);
+size_t analogReadBurst(int pin, uint16_t *samples, size_t count);  // Back-to-back conversions
+int analogToMillivolts(int pin, int raw);                          // eFuse ADC calibration
+int touchRead(int pin);
+void touchAttachInterrupt(int pin, void (*handler)(), int threshold);  // Fires on a reading below threshold
+
+// I2C master
+bool i2cBegin(int sdaPin, int sclPin);
+bool i2cWrite(uint8_t address, const uint8_t *data, size_t len);
+bool i2cReadRegisters(uint8_t address, uint8_t reg, uint8_t *data, size_t len);
+
+// Transactions since boot, RTC reads and writes included, and how many of
+// them failed (no acknowledge or a short read; the RTC library reports none)
+struct I2cStats {
+    uint32_t transactions;
+    uint32_t errors;
+};
+I2cStats i2cStats();
+
+// Battery-backed real-time clock
+bool rtcBegin();
+WallTime rtcNow();
+void rtcAdjust(const WallTime &time);
+
+// Filesystem
+bool fsBegin();
+bool fsExists(const char *path);
+bool fsReadFile(const char *path, uint8_t *buffer, size_t capacity, size_t *length);
+bool fsWriteFile(const char *path, const uint8_t *data, size_t len);
+bool fsRemove(const char *path);
+bool fsRename(const char *from, const char *to);
+bool fsMkdir(const char *path);
+long fsSize(const char *path);  // -1 if the file does not exist
+
+// Random access for record-oriented files; each call is a complete
+// open/write/close so an append is committed when it returns
+bool fsAppend(const char *path, const uint8_t *data, size_t len);
+bool fsReadAt(const char *path, size_t offset, uint8_t *buffer, size_t len);
+bool fsWriteAt(const char *path, size_t offset, const uint8_t *data, size_t len);  // Within the file
+
+// Calls back with the name (without directory) and size of each file
+bool fsListDir(const char *path, std::function<void(const char *name, size_t size)> callback);
+
+size_t fsTotalBytes();
+size_t fsUsedBytes();
+
+// Heap (byte-addressable memory)
+struct HeapStats {
+    size_t freeBytes;
+    size_t largestBlock;   // Largest single allocation that can succeed now
+    size_t minimumFree;    // Lowest free since boot
+};
+HeapStats heapStats();
+
+// Deep sleep. Only the RTC domain keeps running: its timer, the touch pad
+// wake-up and a small block of retained memory. Everything else is lost
+// and the board boots from the start when it wakes.
+enum WakeCause {
+    WAKE_POWER_ON,   // Power-on, reset or any other boot; nothing retained
+    WAKE_TIMER,
+    WAKE_TOUCH
+};
+
+const size_t retainedMemorySize = 1024;
+uint8_t *retainedMemory();       // Survives deep sleep; contents undefined after power-on
+WakeCause wakeCause();
+uint64_t microsSinceSleep();     // From entering deep sleep until now, boot included; 0 after power-on
+void holdPin(int pin, bool hold);  // Keep an output at its level through deep sleep
+
+// Sleep until the timer runs out or the pad reads below the threshold
+// (touchPin < 0 for the timer only). Does not return on the device; the
+// simulator returns and reboots the controller itself.
+void deepSleep(uint64_t micros, int touchPin, int touchThreshold);
+
+}
+
+#endif
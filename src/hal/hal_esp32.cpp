@@ -0,0 +1,366 @@
+#include "hal.h"
+#include <Arduino.h>
+#include <Wire.h>
+#include <LittleFS.h>
+#include "esp_timer.h"
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
+#include "esp_sleep.h"
+#include "driver/rtc_io.h"
+#include <sys/time.h>
+#include <atomic>
+#include "esp_heap_caps.h"
+#include "ds3231.h"
+
+// ESP32 backend: forwards to the Arduino core, Wire, RTClib and LittleFS
+namespace hal {
+
+unsigned long millis() {
+    return ::millis();
+}
+
+unsigned long micros() {
+    return ::micros();
+}
+
+uint64_t uptimeMicros() {
+    return esp_timer_get_time();
+}
+
+void delay(unsigned long ms) {
+    ::delay(ms);
+}
+
+void yieldTick() {
+    vTaskDelay(1);
+}
+
+uint32_t cycleCount() {
+    return ESP.getCycleCount();
+}
+
+uint32_t cpuMhz() {
+    return getCpuFrequencyMhz();
+}
+
+void pinMode(int pin, int mode) {
+    ::pinMode(pin, mode);
+}
+
+void digitalWrite(int pin, int value) {
+    ::digitalWrite(pin, value);
+}
+
+int digitalRead(int pin) {
+    return ::digitalRead(pin);
+}
+
+int analogRead(int pin) {
+    return ::analogRead(pin);
+}
+
+// ADC1 is read directly, a few microseconds per conversion. ADC2 is shared
+// with WiFi and goes through the core one conversion at a time.
+size_t analogReadBurst(int pin, uint16_t *samples, size_t count) {
+    static int configuredChannel = -1;
+    int8_t channel = digitalPinToAnalogChannel(pin);
+
+    if (channel >= 0 && channel < ADC1_CHANNEL_MAX) {
+        if (channel != configuredChannel) {
+            adc1_config_width(ADC_WIDTH_BIT_12);
+            adc1_config_channel_atten((adc1_channel_t)channel, ADC_ATTEN_DB_11);
+            configuredChannel = channel;
+        }
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = adc1_get_raw((adc1_channel_t)channel);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = ::analogRead(pin);
+        }
+    }
+    return count;
+}
+
+int analogToMillivolts(int pin, int raw) {
+    static esp_adc_cal_characteristics_t characteristics[2];
+    static bool characterized[2] = { false, false };
+    int8_t channel = digitalPinToAnalogChannel(pin);
+    int unit = (channel >= 0 && channel < ADC1_CHANNEL_MAX) ? 0 : 1;
+
+    // Two-point or Vref values burned into eFuse at the factory, if present
+    if (!characterized[unit]) {
+        esp_adc_cal_value_t source = esp_adc_cal_characterize(unit == 0 ? ADC_UNIT_1 : ADC_UNIT_2, ADC_ATTEN_DB_11,
+                                                              ADC_WIDTH_BIT_12, 1100, &characteristics[unit]);
+        Serial.printf("ADC%d calibration: %s\n", unit + 1,
+                      source == ESP_ADC_CAL_VAL_EFUSE_TP ? "eFuse two-point" :
+                      source == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse Vref" : "default Vref");
+        characterized[unit] = true;
+    }
+    return esp_adc_cal_raw_to_voltage(raw, &characteristics[unit]);
+}
+
+int touchRead(int pin) {
+    return ::touchRead(pin);
+}
+
+void touchAttachInterrupt(int pin, void (*handler)(), int threshold) {
+    ::touchAttachInterrupt(pin, handler, threshold);
+}
+
+bool i2cBegin(int sdaPin, int sclPin) {
+    return Wire.begin(sdaPin, sclPin);
+}
+
+// The io task drives the bus, but a settings change may set the RTC
+static std::atomic<uint32_t> i2cTransactions{0};
+static std::atomic<uint32_t> i2cErrors{0};
+
+bool i2cWrite(uint8_t address, const uint8_t *data, size_t len) {
+    i2cTransactions++;
+    Wire.beginTransmission(address);
+    Wire.write(data, len);
+    if (Wire.endTransmission() != 0) {
+        i2cErrors++;
+        return false;
+    }
+    return true;
+}
+
+bool i2cReadRegisters(uint8_t address, uint8_t reg, uint8_t *data, size_t len) {
+    i2cTransactions++;
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0) {
+        i2cErrors++;
+        return false;
+    }
+
+    if (Wire.requestFrom(address, (uint8_t)len) != len) {
+        i2cErrors++;
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        data[i] = Wire.read();
+    }
+    return true;
+}
+
+I2cStats i2cStats() {
+    I2cStats stats = { i2cTransactions.load(), i2cErrors.load() };
+    return stats;
+}
+
+HeapStats heapStats() {
+    HeapStats stats;
+    stats.freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    stats.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    stats.minimumFree = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    return stats;
+}
+
+bool rtcBegin() {
+    return rtc.begin();
+}
+
+WallTime rtcNow() {
+    i2cTransactions++;
+    DateTime now = rtc.now();
+    WallTime time;
+    time.year = now.year();
+    time.month = now.month();
+    time.day = now.day();
+    time.hour = now.hour();
+    time.minute = now.minute();
+    time.second = now.second();
+    time.dayOfWeek = now.dayOfTheWeek();
+    time.unixtime = now.unixtime();
+    return time;
+}
+
+void rtcAdjust(const WallTime &time) {
+    i2cTransactions++;
+    rtc.adjust(DateTime(time.year, time.month, time.day, time.hour, time.minute, time.second));
+}
+
+// Config and setup() both ask; mount only once
+bool fsBegin() {
+    static bool mounted = false;
+    if (!mounted) {
+        mounted = LittleFS.begin(true);
+    }
+    return mounted;
+}
+
+bool fsExists(const char *path) {
+    return LittleFS.exists(path);
+}
+
+bool fsReadFile(const char *path, uint8_t *buffer, size_t capacity, size_t *length) {
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    size_t size = file.size();
+    if (size > capacity) {
+        file.close();
+        return false;
+    }
+
+    *length = file.read(buffer, size);
+    file.close();
+    return *length == size;
+}
+
+bool fsWriteFile(const char *path, const uint8_t *data, size_t len) {
+    File file = LittleFS.open(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    size_t written = file.write(data, len);
+    file.close();
+    return written == len;
+}
+
+bool fsRemove(const char *path) {
+    return LittleFS.remove(path);
+}
+
+bool fsRename(const char *from, const char *to) {
+    return LittleFS.rename(from, to);
+}
+
+bool fsMkdir(const char *path) {
+    return LittleFS.exists(path) || LittleFS.mkdir(path);
+}
+
+long fsSize(const char *path) {
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        return -1;
+    }
+
+    long size = file.size();
+    file.close();
+    return size;
+}
+
+bool fsAppend(const char *path, const uint8_t *data, size_t len) {
+    File file = LittleFS.open(path, "a");
+    if (!file) {
+        return false;
+    }
+
+    size_t written = file.write(data, len);
+    file.close();
+    return written == len;
+}
+
+bool fsReadAt(const char *path, size_t offset, uint8_t *buffer, size_t len) {
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    bool ok = file.seek(offset) && file.read(buffer, len) == len;
+    file.close();
+    return ok;
+}
+
+bool fsWriteAt(const char *path, size_t offset, const uint8_t *data, size_t len) {
+    File file = LittleFS.open(path, "r+");
+    if (!file) {
+        return false;
+    }
+
+    bool ok = file.seek(offset) && file.write(data, len) == len;
+    file.close();
+    return ok;
+}
+
+bool fsListDir(const char *path, std::function<void(const char *name, size_t size)> callback) {
+    File dir = LittleFS.open(path);
+    if (!dir || !dir.isDirectory()) {
+        return false;
+    }
+
+    File file = dir.openNextFile();
+    while (file) {
+        if (!file.isDirectory()) {
+            callback(file.name(), file.size());
+        }
+        file = dir.openNextFile();
+    }
+    dir.close();
+    return true;
+}
+
+size_t fsTotalBytes() {
+    return LittleFS.totalBytes();
+}
+
+size_t fsUsedBytes() {
+    return LittleFS.usedBytes();
+}
+
+// RTC slow memory: loaded from the image on power-on, kept through deep sleep
+RTC_DATA_ATTR static uint8_t retained[retainedMemorySize] __attribute__((aligned(8)));
+RTC_DATA_ATTR static int64_t sleepStartMicros = 0;
+
+// gettimeofday() runs from the RTC timer through deep sleep
+static int64_t rtcTimerMicros() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+uint8_t *retainedMemory() {
+    return retained;
+}
+
+WakeCause wakeCause() {
+    switch (esp_sleep_get_wakeup_cause()) {
+        case ESP_SLEEP_WAKEUP_TIMER: return WAKE_TIMER;
+        case ESP_SLEEP_WAKEUP_TOUCHPAD: return WAKE_TOUCH;
+        default: return WAKE_POWER_ON;
+    }
+}
+
+uint64_t microsSinceSleep() {
+    if (wakeCause() == WAKE_POWER_ON) {
+        return 0;
+    }
+    int64_t elapsed = rtcTimerMicros() - sleepStartMicros;
+    return elapsed > 0 ? elapsed : 0;
+}
+
+void holdPin(int pin, bool hold) {
+    gpio_num_t gpio = (gpio_num_t)pin;
+    if (rtc_gpio_is_valid_gpio(gpio)) {
+        if (hold) rtc_gpio_hold_en(gpio); else rtc_gpio_hold_dis(gpio);
+    } else {
+        if (hold) gpio_hold_en(gpio); else gpio_hold_dis(gpio);
+    }
+}
+
+static void onTouchWake() {
+}
+
+void deepSleep(uint64_t micros, int touchPin, int touchThreshold) {
+    esp_sleep_enable_timer_wakeup(micros);
+    if (touchPin >= 0) {
+        ::touchAttachInterrupt(touchPin, onTouchWake, touchThreshold);
+        esp_sleep_enable_touchpad_wakeup();
+    }
+
+    // Held digital pads stay held only with this set
+    gpio_deep_sleep_hold_en();
+
+    Serial.flush();
+    sleepStartMicros = rtcTimerMicros();
+    esp_deep_sleep_start();
+}
+
+}
@@ -0,0 +1,45 @@
+#include "hal.h"
+
+namespace hal {
+
+// Days since 1970-01-01 for a civil date (proleptic Gregorian)
+static long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+WallTime wallTimeFromUnix(uint32_t unixtime) {
+    WallTime time;
+    long days = unixtime / 86400;
+    uint32_t secondsOfDay = unixtime % 86400;
+
+    time.unixtime = unixtime;
+    time.hour = secondsOfDay / 3600;
+    time.minute = (secondsOfDay % 3600) / 60;
+    time.second = secondsOfDay % 60;
+    time.dayOfWeek = (days + 4) % 7; // 1970-01-01 was a Thursday
+
+    // Inverse of daysFromCivil
+    days += 719468;
+    long era = days / 146097;
+    long dayOfEra = days - era * 146097;
+    long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    long monthIndex = (5 * dayOfYear + 2) / 153;
+
+    time.day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    time.month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    time.year = yearOfEra + era * 400 + (time.month <= 2);
+    return time;
+}
+
+WallTime makeWallTime(int year, int month, int day, int hour, int minute, int second) {
+    long days = daysFromCivil(year, month, day);
+    return wallTimeFromUnix(days * 86400UL + hour * 3600UL + minute * 60UL + second);
+}
+
+}
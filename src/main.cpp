@@ -6,15 +6,34 @@
 #include <ESPAsyncWebServer.h>
 #include <AsyncTCP.h>
 #include <ArduinoJson.h>
+#include <memory>
 
 // Include our components
 #include "config.h"
 #include "utils/wifi_manager.h"
 #include "sensors/bme280.h"
 #include "sensors/soil_moisture.h"
+#include "sensors/sensor_acquisition.h"
 #include "sensors/ds3231.h"
 #include "controls/relay.h"
 #include "controls/touch.h"
+#include "controls/watering_controller.h"
+#include "controls/live_config.h"
+#include "hal/hal.h"
+#include "utils/task_monitor.h"
+#include "utils/system_state.h"
+#include "utils/timekeeper.h"
+#include "utils/scheduler.h"
+#include "utils/duty_cycle.h"
+#include "utils/boot_profile.h"
+#include "storage/history_store.h"
+#include "storage/rollup_store.h"
+#include "web/state_json.h"
+#include "web/request_body.h"
+#include "web/static_assets.h"
+#include "web/asset_cache.h"
+#include "web/page_template.h"
+#include "web/metrics.h"
 
 // Add after the includes but before any function declarations
 
@@ -28,44 +47,179 @@ const int RELAY4_PIN = 33;  // Fixed hardware pin for relay 4
 Config config;
 WiFiManager wifiManager;
 SoilMoistureSensor soilSensor;
+Bme280 bme280;
 TouchControl touchSensor;
 Relay relay1, relay2, relay3, relay4;
 AsyncWebServer server(80);
 
-// RTC and BME globals (declared in their header files)
-extern RTC_DS3231 rtc;
-extern Adafruit_BME280 bme;
+// Wall clock from the local timer, synced to the DS3231 by the io task
+Timekeeper timekeeper;
 
-// State variables
-bool isWatering = false;
-unsigned long wateringStartTime = 0;
-unsigned long wateringDuration = 0;
-unsigned long lastSensorUpdate = 0;
+// Gzipped pages, scripts and styles from tools/build_assets.py, by URL
+StaticAssets staticAssets;
+
+// The gzipped files most recently requested, held in RAM (24 KB holds all of them)
+AssetCache assetCache(24 * 1024);
+
+// Pushes the state JSON to open dashboards whenever it changes (network task)
+AsyncEventSource events("/api/events");
+
+// Serialized state, rebuilt once per change for every request and event
+StateJsonCache stateJsonCache(config, timekeeper);
+
+// The dashboard with the state spliced in, so it draws on arrival
+PageTemplate indexTemplate;
+
+// Handler latency of every route, for /api/metrics
+RouteMetrics routeMetrics;
+
+// Non-blocking acquisition engine, advanced one step at a time by the I/O task
+SensorAcquisition sensorAcquisition(bme280, soilSensor);
+
+// Watering logic; the pump is relay 2
+WateringController wateringController(config, relay2, timekeeper);
+
+// Settings changes applied without a restart, on the control and io tasks
+LiveConfig liveConfig(config, relay1, relay2, relay3, relay4, wateringController, soilSensor,
+                      sensorAcquisition, touchSensor);
+
+// Task layout:
+//   io      (core 0) - sensor acquisition and flash writes
+//   network (core 0) - captive portal DNS, touch pad, hotspot timeout, dashboard pushes
+//   control (core 1) - watering schedule and relays, highest priority
+// AsyncTCP runs the web handlers on its own task; they only post commands.
+// Each task sleeps until its next deadline (from its timer wheel or the
+// acquisition engine) or until another task or an interrupt wakes it.
+const int ioTaskCore = 0;
+const int networkTaskCore = 0;
+const int controlTaskCore = 1;
+const UBaseType_t ioTaskPriority = 2;
+const UBaseType_t networkTaskPriority = 1;
+const UBaseType_t controlTaskPriority = 5;
+const uint32_t ioTaskStack = 6144;
+const uint32_t networkTaskStack = 6144;   // Brings WiFi and the web server up after a fast boot
+const uint32_t controlTaskStack = 4096;
+const unsigned long dnsPeriod = 10;              // ms between captive portal DNS polls, hotspot only
+const unsigned long idleWakeup = 60000;          // Longest sleep of the control and network tasks
+const size_t maxConfigBodySize = 2048;           // Largest JSON body /api/config accepts
+
+// Commands handled by the control task
+enum ControlCommandType {
+  CMD_START_WATERING,
+  CMD_SET_RELAY,
+  CMD_NEW_READINGS,  // Wake-up only; the readings are in sensorQueue
+  CMD_APPLY_CONFIG   // Settings changed: re-pin relays, re-plan watering
+};
+
+struct ControlCommand {
+  ControlCommandType type;
+  int relayId;
+  bool state;
+  uint8_t changes;      // CMD_APPLY_CONFIG: ConfigApply bits of the changed settings
+  uint32_t requestedAt; // CMD_APPLY_CONFIG: micros() when the change arrived
+};
+
+// Commands handled by the I/O task
+enum IoCommandType {
+  IO_READ_NOW,
+  IO_SAVE_CONFIG_AND_RESTART,
+  IO_CAPTURE_SOIL_POINT,      // value: moisture percent of the soil the probe is in
+  IO_CLEAR_SOIL_CALIBRATION,
+  IO_APPLY_CONFIG             // Save the settings, re-init the soil probe and touch pad
+};
+
+struct IoCommand {
+  IoCommandType type;
+  float value;
+  uint8_t changes;      // IO_APPLY_CONFIG: ConfigApply bits of the changed settings
+  uint32_t requestedAt; // IO_APPLY_CONFIG: micros() when the change arrived
+};
+
+QueueHandle_t controlQueue = NULL;  // web/network -> control
+QueueHandle_t ioQueue = NULL;       // web -> io
+QueueHandle_t sensorQueue = NULL;   // io -> control, holds only the latest readings
+
+// Held by the io task while it runs a command or records a reading, so
+// the control task never puts the board to sleep in a flash write
+SemaphoreHandle_t ioWork = NULL;
+
+TaskMonitor taskMonitor;
+int ioTaskSlot = -1;
+int networkTaskSlot = -1;
+int controlTaskSlot = -1;
+TaskHandle_t networkTaskHandle = NULL;
+
+// Timer wheels of the control and network tasks, each used by its own task only
+Scheduler controlScheduler;
+Scheduler networkScheduler;
+int wateringJob = -1;
+int dnsJob = -1;
+int hotspotJob = -1;
+int countdownJob = -1;
+
+// State variables (written only by the control task)
 const unsigned long sensorUpdateInterval = 60000; // 1 minute
-int lastWateringDay = -1;  // Day of month when watering last occurred
+bool stateDirty = true;    // Snapshot needs republishing at the end of this control period
+bool readingsThisBoot = false;  // A reading reached the controller since boot (or wake)
+
+// millis() the current or last sensor cycle started (io task)
+unsigned long lastSensorCycle = 0;
+
+// Moisture to pair with the next soil reading as a calibration point (io task only)
+float pendingCalibrationPercent = NAN;
+uint32_t pendingCalibrationAfter = 0;   // Only a cycle numbered above this one
+
+// Consistent snapshot of the controller and relay state for readers on other tasks
+SystemStatePublisher systemState;
+
+// One record per completed sensor cycle, written by the io task
+HistoryStore historyStore;
 
-// Sensor readings
-float temperature = 0;
-float humidity = 0;
-float pressure = 0;
-float heatIndex = 0;
-int soilMoistureRaw = 0;
-float soilMoisturePercent = 0;
+// 15 min / 1 h / 1 day aggregates of the same records
+RollupStore rollupStore;
+
+// Deep sleep between readings when the duty-cycle mode is on
+DutyCycle dutyCycle(timekeeper, sensorAcquisition, wateringController, rollupStore);
+
+// WiFi and the web server are up; a timer wake in duty-cycle mode skips
+// them until a touch (network task only)
+bool networkStarted = false;
+
+// Where this boot's time went, served at /api/boot-profile
+BootProfile bootProfile;
+
+// History and rollups are open (io task only)
+bool storageStarted = false;
 
 // Function prototypes
+void startNetwork();
 void setupWebServer();
-void updateSensorReadings();
-bool shouldWater();
-void startWatering();
-void stopWatering();
-void checkWateringStatus();
+bool sendAsset(AsyncWebServerRequest *request, const char *url);
+bool sendIndexPage(AsyncWebServerRequest *request);
+bool writeMetrics(int item, String &out);
+void beginSensors();
+void beginStorage();
+void startTasks();
+void ioTask(void *param);
+void networkTask(void *param);
+void controlTask(void *param);
+void handleControlCommand(const ControlCommand &cmd);
+void handleIoCommand(const IoCommand &cmd);
+bool sendControlCommand(ControlCommandType type, int relayId = 0, bool state = false);
+bool sendIoCommand(IoCommandType type, float value = 0);
+bool applyConfigChanges(uint8_t changes, uint32_t requestedAt);
+void publishState();
+void recordHistory(const SensorReadings &readings);
+void pushState();
 void checkTouchSensor();
-void readAllBME280Sensors();
-float calculateHeatIndex(float temperature, float humidity);
-float readAveragedTemperature();  
-float readAveragedHumidity();     
-float readAveragedPressure(); 
+void sleepIfIdle();
+void scheduleNetworkJobs();
+void onTouch();
 
+// Boot order: relays safe, then what the control loop needs (config,
+// clock), then the tasks. Sensors, history and the network come up on
+// their own tasks in parallel, so neither the first reading nor the web
+// server waits for the other or for a history replay.
 void setup() {
   // Configure relays with internal pull-ups first
   //pinMode(RELAY1_PIN, INPUT_PULLUP);
@@ -74,27 +228,40 @@ void setup() {
   //pinMode(RELAY4_PIN, INPUT_PULLUP);
   
   // Configure relay pins immediately to prevent clicking
-  pinMode(RELAY1_PIN, OUTPUT);
-  pinMode(RELAY2_PIN, OUTPUT);
-  pinMode(RELAY3_PIN, OUTPUT);
-  pinMode(RELAY4_PIN, OUTPUT);
-  
-  // Drive all relays LOW (off) for active HIGH relays
-  digitalWrite(RELAY1_PIN, LOW);
-  digitalWrite(RELAY2_PIN, LOW);
-  digitalWrite(RELAY3_PIN, LOW);
-  digitalWrite(RELAY4_PIN, LOW);
-  delay(20);
+  {
+    BootProfile::Phase phase(bootProfile, "relays_safe");
+    hal::pinMode(RELAY1_PIN, OUTPUT);
+    hal::pinMode(RELAY2_PIN, OUTPUT);
+    hal::pinMode(RELAY3_PIN, OUTPUT);
+    hal::pinMode(RELAY4_PIN, OUTPUT);
+    
+    // Drive all relays LOW (off) for active HIGH relays
+    hal::digitalWrite(RELAY1_PIN, LOW);
+    hal::digitalWrite(RELAY2_PIN, LOW);
+    hal::digitalWrite(RELAY3_PIN, LOW);
+    hal::digitalWrite(RELAY4_PIN, LOW);
+    hal::delay(20);
+  }
   Serial.begin(115200);
   
   // Initialize LittleFS first (needed for config)
-  if (!LittleFS.begin()) {
-    Serial.println("Failed to mount file system");
+  {
+    BootProfile::Phase phase(bootProfile, "fs_mount");
+    if (!hal::fsBegin()) {
+      Serial.println("Failed to mount file system");
+    }
   }
   
   // Initialize configuration (needed for relay pins)
-  if (!config.begin()) {
-    Serial.println("Failed to initialize configuration");
+  bool resumed;
+  {
+    BootProfile::Phase phase(bootProfile, "config");
+    if (!config.begin()) {
+      Serial.println("Failed to initialize configuration");
+    }
+    
+    // A wake from duty-cycle sleep carries the clock, filters and open rollups over
+    resumed = dutyCycle.begin(config.isDutyCycleMode());
   }
   
   // IMPORTANT: Initialize relays first to prevent clicking
@@ -114,59 +281,68 @@ void setup() {
   relay3.init();
   relay4.init();
   
+  // Held off through deep sleep; driven LOW again above, so let go
+  hal::holdPin(config.getRelay1Pin(), false);
+  hal::holdPin(config.getRelay2Pin(), false);
+  hal::holdPin(config.getRelay3Pin(), false);
+  hal::holdPin(config.getRelay4Pin(), false);
+  
   Serial.println("\n\nGarden Monitor System Starting...");
   
   // Configure I2C pins from config
-  Wire.begin(config.getI2cSdaPin(), config.getI2cSclPin());
-  
-  // Initialize RTC
-  if (!rtc.begin()) {
-    Serial.println("Couldn't find RTC");
-  }
-  
-  // Initialize BME280 with multiple address attempts
-  bool bmeFound = false;
-  
-  // Try default address 0x76 first
-  Serial.println("Trying BME280 at address 0x76...");
-  if (bme.begin(0x76, &Wire)) {
-    bmeFound = true;
-    Serial.println("BME280 found at address 0x76");
-  } else {
-    // Try alternative address 0x77
-    delay(100);
-    Serial.println("Trying BME280 at address 0x77...");
-    if (bme.begin(0x77, &Wire)) {
-      bmeFound = true;
-      Serial.println("BME280 found at address 0x77");
+  {
+    BootProfile::Phase phase(bootProfile, "clock");
+    hal::i2cBegin(config.getI2cSdaPin(), config.getI2cSclPin());
+    
+    // Initialize RTC; one read, the io task refines the anchor
+    if (!hal::rtcBegin()) {
+      Serial.println("Couldn't find RTC");
+    }
+    if (resumed) {
+      dutyCycle.restore();
+    } else {
+      timekeeper.begin();
     }
   }
   
-  if (!bmeFound) {
-    Serial.println("Could not find a valid BME280 sensor");
-  } else {
-    // Set BME280 to sleep mode to save power
-    bme.setSampling(
-      Adafruit_BME280::MODE_FORCED,
-      Adafruit_BME280::SAMPLING_X1, // temperature
-      Adafruit_BME280::SAMPLING_X1, // pressure
-      Adafruit_BME280::SAMPLING_X1, // humidity
-      Adafruit_BME280::FILTER_OFF
-    );
-  }
-  
-  // Initialize soil moisture sensor
+  // Soil moisture sensor settings; the io task powers the probe up
   soilSensor.setSensorPin(config.getSoilMoistureSensorPin());
   soilSensor.setPowerPin(config.getSoilMoisturePowerPin());
   soilSensor.calibrateDry(config.getSoilMoistureDryValue());
   soilSensor.calibrateWet(config.getSoilMoistureWetValue());
-  soilSensor.init();
+  liveConfig.applySoilCalibration();
   
   // Initialize touch sensor
   touchSensor.setTouchPin(config.getTouchSensorPin());
   touchSensor.setThreshold(config.getTouchSensorThreshold());
   touchSensor.init();
   
+  // Queues must exist before the web server can post commands
+  controlQueue = xQueueCreate(8, sizeof(ControlCommand));
+  ioQueue = xQueueCreate(4, sizeof(IoCommand));
+  sensorQueue = xQueueCreate(1, sizeof(SensorReadings));
+  ioWork = xSemaphoreCreateMutex();
+  
+  // Publish the initial state before any handler can read it
+  publishState();
+  
+  // Hand over to the pinned tasks; the first sensor cycle starts immediately
+  // and the network task brings WiFi up alongside it
+  startTasks();
+  
+  Serial.println("Setup complete");
+}
+
+void loop() {
+  // All work runs in the pinned tasks created by startTasks()
+  vTaskDelete(NULL);
+}
+
+// WiFi, hotspot and web server; at the start of the network task, or on a
+// touch after a fast boot
+void startNetwork() {
+  BootProfile::Phase phase(bootProfile, "network");
+  
   // Initialize WiFi manager
   wifiManager.setAPCredentials(config.getDeviceName(), "gardening123");
   wifiManager.begin();
@@ -186,509 +362,985 @@ void setup() {
   
   // Set up web server routes and start server
   setupWebServer();
-  
-  // Take initial sensor readings
-  updateSensorReadings();
-  
-  Serial.println("Setup complete");
+  networkStarted = true;
+  bootProfile.milestone("http_ready");
 }
 
-void loop() {
-  // Process DNS requests for captive portal
-  wifiManager.processDNS();
+void startTasks() {
+  TaskHandle_t handle = NULL;
   
-  // Check if we need to update sensor readings
-  if (millis() - lastSensorUpdate > sensorUpdateInterval) {
-    updateSensorReadings();
-  }
+  wateringJob = controlScheduler.addJob("watering", [](void *) {
+    wateringController.tick();
+    controlScheduler.scheduleIn(wateringJob, wateringController.msUntilNextEvent());
+  });
+  controlScheduler.scheduleIn(wateringJob, 0);
   
-  // Check if watering is in progress
-  if (isWatering) {
-    checkWateringStatus();
-  }
+  dnsJob = networkScheduler.addJob("dns", [](void *) { wifiManager.processDNS(); });
+  hotspotJob = networkScheduler.addJob("hotspot-timeout", [](void *) { wifiManager.checkHotspotTimeout(); });
+  countdownJob = networkScheduler.addJob("countdown", [](void *) { pushState(); });
   
-  // Check if watering should start (autonomous watering)
-  if (!isWatering && shouldWater()) {
-    startWatering();
-  }
+  xTaskCreatePinnedToCore(controlTask, "control", controlTaskStack, NULL,
+                          controlTaskPriority, &handle, controlTaskCore);
+  controlTaskSlot = taskMonitor.registerTask("control", handle);
   
-  // Check touch sensor to activate hotspot
-  checkTouchSensor();
+  xTaskCreatePinnedToCore(ioTask, "io", ioTaskStack, NULL,
+                          ioTaskPriority, &handle, ioTaskCore);
+  ioTaskSlot = taskMonitor.registerTask("io", handle);
   
-  // Check for hotspot inactivity timeout
-  wifiManager.checkHotspotTimeout();
+  xTaskCreatePinnedToCore(networkTask, "network", networkTaskStack, NULL,
+                          networkTaskPriority, &handle, networkTaskCore);
+  networkTaskSlot = taskMonitor.registerTask("network", handle);
+  networkTaskHandle = handle;
   
-  // Small delay to prevent CPU hogging
-  delay(10);
+  // A touch wakes the network task instead of it polling the pad
+  touchSensor.attachInterrupt(onTouch);
 }
 
-void updateSensorReadings() {
-  Serial.println("\n--- UPDATING SENSOR READINGS ---");
+// Control task on core 1, so actuation timing does not depend on how long
+// a sensor read or HTTP request takes. Sleeps until the next watering
+// event (window opening, cycle end) or a command.
+void controlTask(void *param) {
+  bootProfile.milestone("control");
+  
+  for (;;) {
+    ControlCommand cmd;
+    TickType_t wait = pdMS_TO_TICKS(controlScheduler.msUntilNext(idleWakeup));
+    bool hasCommand = xQueueReceive(controlQueue, &cmd, wait) == pdTRUE;
+    bool woken = hasCommand;
+    taskMonitor.beginWork(controlTaskSlot);
+    
+    // Take the latest completed reading, if any
+    SensorReadings readings;
+    if (xQueueReceive(sensorQueue, &readings, 0) == pdTRUE) {
+      wateringController.updateReadings(readings);
+      readingsThisBoot = true;
+      woken = true;
+    }
+    
+    // Apply pending commands from the web handlers
+    while (hasCommand) {
+      handleControlCommand(cmd);
+      hasCommand = xQueueReceive(controlQueue, &cmd, 0) == pdTRUE;
+    }
+    
+    // A reading or command can bring the next watering event forward
+    if (woken) {
+      controlScheduler.scheduleIn(wateringJob, wateringController.msUntilNextEvent());
+    }
+    
+    // Finish an elapsed watering cycle or start a scheduled one
+    controlScheduler.runDue();
+    
+    // Publish one snapshot covering everything that changed
+    if (wateringController.takeChanged() || stateDirty) {
+      publishState();
+    }
+    
+    sleepIfIdle();
+    taskMonitor.endWork(controlTaskSlot);
+  }
+}
+
+// Duty-cycle mode: once this boot's reading has been acted on, sleep until
+// the next reading or watering event unless something is still running
+void sleepIfIdle() {
+  if (!dutyCycle.isEnabled() || !readingsThisBoot || wateringController.isWatering() ||
+      relay1.getState() || relay2.getState() || relay3.getState() || relay4.getState() ||
+      wifiManager.isHotspotRunning() || sensorAcquisition.isBusy() ||
+      uxQueueMessagesWaiting(controlQueue) > 0) {
+    return;
+  }
   
-  // Use the new combined BME280 reading function
-  readAllBME280Sensors();
-  yield();
+  uint64_t sleepMicros = dutyCycle.sleepDuration(sensorUpdateInterval, wateringController.msUntilNextEvent());
+  if (sleepMicros == 0) {
+    return;
+  }
   
-  // Calculate heat index based on temperature and humidity
-  heatIndex = calculateHeatIndex(temperature, humidity);
-  Serial.printf("Heat Index: %.2f°C\n", heatIndex);
+  // A command is dequeued only once the io task holds ioWork, so with it
+  // taken here and the queue empty no flash work is running or pending.
+  // Kept until the board sleeps, so none starts either.
+  if (xSemaphoreTake(ioWork, 0) != pdTRUE) {
+    return;
+  }
+  if (uxQueueMessagesWaiting(ioQueue) > 0) {
+    xSemaphoreGive(ioWork);
+    return;
+  }
   
-  // Read soil moisture
-  Serial.println("Reading soil moisture sensor...");
-  soilMoistureRaw = soilSensor.readAveragedRaw();
-  yield();
+  // The relays are off; keep their inputs driven LOW while asleep
+  hal::holdPin(config.getRelay1Pin(), true);
+  hal::holdPin(config.getRelay2Pin(), true);
+  hal::holdPin(config.getRelay3Pin(), true);
+  hal::holdPin(config.getRelay4Pin(), true);
+  dutyCycle.sleep(sleepMicros, config.getTouchSensorPin(), config.getTouchSensorThreshold());
+}
+
+// BME280 and soil probe, at the start of the io task
+void beginSensors() {
+  BootProfile::Phase phase(bootProfile, "sensors");
   
-  // Calculate soil moisture percentage  
-  soilMoisturePercent = soilSensor.readPercentage();
-  Serial.printf("Soil Moisture: %.2f%% (Raw: %d)\n", soilMoisturePercent, soilMoistureRaw);
+  // Initialize BME280 (0x76 or 0x77)
+  bme280.begin();
+  soilSensor.init();
+}
+
+// History and rollups, opened in the first gap of the first acquisition
+// (or before its reading is recorded) rather than ahead of it
+void beginStorage() {
+  if (storageStarted) {
+    return;
+  }
+  storageStarted = true;
+  BootProfile::Phase phase(bootProfile, "storage");
   
-  // Update timestamp for last sensor reading
-  lastSensorUpdate = millis();
+  // Sensor history log (recovers the active segment after a power loss)
+  if (!historyStore.begin()) {
+    Serial.println("Failed to initialize history store");
+  }
+  if (!rollupStore.begin(historyStore, dutyCycle.getRetainedRollups())) {
+    Serial.println("Failed to initialize rollups");
+  }
+}
+
+// I/O task: sensor acquisition and flash writes on core 0
+void ioTask(void *param) {
+  beginSensors();
+  lastSensorCycle = millis();
+  sensorAcquisition.start();
+  
+  for (;;) {
+    // Sleep until the next acquisition step, the next cycle, or a command
+    unsigned long waitMs;
+    if (sensorAcquisition.isBusy()) {
+      waitMs = sensorAcquisition.msUntilNextStep();
+    } else {
+      unsigned long sinceLast = millis() - lastSensorCycle;
+      waitMs = (sinceLast >= sensorUpdateInterval) ? 0 : sensorUpdateInterval - sinceLast;
+    }
+    
+    // The clock's edge search right after boot polls the RTC
+    waitMs = std::min(waitMs, timekeeper.msUntilUpdate());
+    
+    // Open storage while the first acquisition waits on its sensors
+    if (!storageStarted && waitMs > 0 && sensorAcquisition.isBusy()) {
+      taskMonitor.beginWork(ioTaskSlot);
+      beginStorage();
+      taskMonitor.endWork(ioTaskSlot);
+      continue;
+    }
+    
+    // The command stays queued until ioWork is held; see sleepIfIdle()
+    IoCommand cmd;
+    TickType_t wait = pdMS_TO_TICKS(waitMs);
+    bool hasCommand = xQueuePeek(ioQueue, &cmd, wait) == pdTRUE;
+    xSemaphoreTake(ioWork, portMAX_DELAY);
+    if (hasCommand) {
+      xQueueReceive(ioQueue, &cmd, 0);
+    }
+    taskMonitor.beginWork(ioTaskSlot);
+    
+    if (hasCommand) {
+      if (cmd.type == IO_READ_NOW) {
+        lastSensorCycle = millis();
+      }
+      handleIoCommand(cmd);
+    }
+    
+    // Sensor settings wait for the acquisition in progress to finish
+    liveConfig.applySensors();
+    
+    // Re-read the RTC when the hourly sync or the edge search is due
+    timekeeper.update();
+    
+    // Check if we need to start a new sensor reading cycle
+    if (!sensorAcquisition.isBusy() && millis() - lastSensorCycle >= sensorUpdateInterval) {
+      lastSensorCycle = millis();
+      sensorAcquisition.start();
+    }
+    
+    // Advance the acquisition and hand completed readings to the control
+    // task, after they are on flash since it may put the board to sleep
+    if (sensorAcquisition.poll()) {
+      bootProfile.milestone("first_reading");
+      beginStorage();
+      recordHistory(sensorAcquisition.getReadings());
+      dutyCycle.recordReading(lastSensorCycle);
+      
+      // Pair a requested calibration moisture with this fresh reading
+      const SensorReadings &readings = sensorAcquisition.getReadings();
+      bool freshCycle = sensorAcquisition.getCycleNumber() > pendingCalibrationAfter;
+      if (!isnan(pendingCalibrationPercent) && readings.soilValid && freshCycle) {
+        if (config.addSoilCalibrationPoint(readings.soilMoistureRaw, pendingCalibrationPercent)) {
+          Serial.printf("Soil calibration: raw %d = %.1f%%\n", readings.soilMoistureRaw,
+                        pendingCalibrationPercent);
+          liveConfig.applySoilCalibration();
+          config.saveConfig();
+        } else {
+          Serial.println("Soil calibration table full");
+        }
+        pendingCalibrationPercent = NAN;
+      }
+      
+      // A point requested mid-cycle gets a cycle of its own right away
+      if (!isnan(pendingCalibrationPercent) && !freshCycle) {
+        lastSensorCycle = millis();
+        sensorAcquisition.start();
+      }
+      
+      xQueueOverwrite(sensorQueue, &readings);
+      sendControlCommand(CMD_NEW_READINGS);
+    }
+    
+    taskMonitor.endWork(ioTaskSlot);
+    xSemaphoreGive(ioWork);
+  }
 }
 
-float calculateHeatIndex(float temperature, float humidity) {
-  // Only calculate heat index if temperature is high enough
-  // Below about 26.7°C (80°F), the heat index equals the temperature
-  if (temperature < 26.7) {
-    return temperature;
+// Network task: captive portal, hotspot management and dashboard pushes on
+// core 0. Sleeps until its next job, a touch or a new state snapshot.
+void networkTask(void *param) {
+  // A timer wake in duty-cycle mode takes one reading and sleeps again
+  if (dutyCycle.isFastBoot()) {
+    Serial.println("Duty cycle: timer wake, WiFi stays off");
+  } else {
+    startNetwork();
   }
   
-  // Heat index calculation (simplified equation)
-  // Source: https://www.wpc.ncep.noaa.gov/html/heatindex_equation.shtml
-  float hIndex = 0.5 * (temperature + 61.0 + ((temperature - 68.0) * 1.2) + (humidity * 0.094));
-  
-  // If the humidity is high enough and temperature high enough, use full equation
-  if (humidity > 40 && temperature >= 27) {
-    hIndex = -42.379 +
-      2.04901523 * temperature +
-      10.14333127 * humidity -
-      0.22475541 * temperature * humidity -
-      0.00683783 * temperature * temperature -
-      0.05481717 * humidity * humidity +
-      0.00122874 * temperature * temperature * humidity +
-      0.00085282 * temperature * humidity * humidity -
-      0.00000199 * temperature * temperature * humidity * humidity;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(networkScheduler.msUntilNext(idleWakeup)));
+    taskMonitor.beginWork(networkTaskSlot);
+    
+    // Check touch sensor to activate hotspot
+    checkTouchSensor();
+    dutyCycle.tick(wifiManager.isHotspotRunning());
+    
+    // DNS polling, hotspot timeout, watering countdown
+    networkScheduler.runDue();
+    
+    // Send any state change to the dashboards
+    pushState();
+    
+    scheduleNetworkJobs();
+    taskMonitor.endWork(networkTaskSlot);
+  }
+}
+
+// Keep the network jobs in line with the hotspot and watering state
+void scheduleNetworkJobs() {
+  if (wifiManager.isHotspotRunning()) {
+    if (!networkScheduler.isPending(dnsJob)) {
+      networkScheduler.scheduleIn(dnsJob, dnsPeriod);
+    }
+    if (!networkScheduler.isPending(hotspotJob)) {
+      networkScheduler.scheduleIn(hotspotJob, wifiManager.msUntilHotspotTimeout());
+    }
+  } else {
+    networkScheduler.cancel(dnsJob);
+    networkScheduler.cancel(hotspotJob);
   }
   
-  return hIndex;
+  // Wake when the remaining watering time drops to the next second
+  SystemState state = systemState.read();
+  if (state.isWatering && events.count() > 0) {
+    if (!networkScheduler.isPending(countdownJob)) {
+      unsigned long elapsed = millis() - state.wateringStartTime;
+      unsigned long left = elapsed < state.wateringDuration ? state.wateringDuration - elapsed : 0;
+      networkScheduler.scheduleIn(countdownJob, left % 1000 + 1);
+    }
+  } else {
+    networkScheduler.cancel(countdownJob);
   }
+}
 
-  void checkTouchSensor() {
-  if (touchSensor.isTouched()) {
-    Serial.println("Touch detected! Starting hotspot...");
-    wifiManager.startHotspot();
-    wifiManager.resetClientActivityTimer();
+void IRAM_ATTR onTouch() {
+  BaseType_t woken = pdFALSE;
+  if (networkTaskHandle != NULL) {
+    vTaskNotifyGiveFromISR(networkTaskHandle, &woken);
   }
+  if (woken) {
+    portYIELD_FROM_ISR();
   }
+}
 
-  bool shouldWater() {
-  // Only check if automatic watering is enabled
-  if (!config.isWateringEnabled()) {
+bool sendControlCommand(ControlCommandType type, int relayId, bool state) {
+  ControlCommand cmd = { type, relayId, state };
+  return xQueueSend(controlQueue, &cmd, 0) == pdTRUE;
+}
+
+bool sendIoCommand(IoCommandType type, float value) {
+  IoCommand cmd = { type, value };
+  return xQueueSend(ioQueue, &cmd, 0) == pdTRUE;
+}
+
+// Hand changed settings to the tasks that own the hardware they affect
+// (LiveConfig applies them there). False if they only take effect after a
+// restart, which this then starts.
+bool applyConfigChanges(uint8_t changes, uint32_t requestedAt) {
+  uint8_t targets = LiveConfig::targets(changes);
+  if (targets == 0) {
+    // The I/O task saves the configuration, then restarts the device
+    sendIoCommand(IO_SAVE_CONFIG_AND_RESTART);
     return false;
   }
   
-  // Get current time
-  DateTime now = rtc.now();
-  uint8_t currentHour = now.hour();
-  uint8_t currentMinute = now.minute();
-  uint8_t currentDay = now.dayOfTheWeek();
-  int currentDayOfMonth = now.day(); 
-  
-    // Check if we already watered today
-  if (lastWateringDay == currentDayOfMonth) {  // Add this check
-    return false;  // Already watered today
+  // The event stream keeps its own copy of the credentials (called on
+  // the AsyncTCP task, which is the one that checks them)
+  if (changes & APPLY_AUTH) {
+    events.setAuthentication(config.getUsername().c_str(), config.getPassword().c_str());
+  }
+  if (targets & LiveConfig::TARGET_CONTROL) {
+    ControlCommand cmd = { CMD_APPLY_CONFIG, 0, false, changes, requestedAt };
+    xQueueSend(controlQueue, &cmd, 0);
+  }
+  if (targets & LiveConfig::TARGET_IO) {
+    IoCommand cmd = { IO_APPLY_CONFIG, 0, changes, requestedAt };
+    xQueueSend(ioQueue, &cmd, 0);
   }
+  return true;
+}
 
-  // Don't water on Sundays (day 0)
-  if (currentDay == 0) {
-    return false;
+void handleControlCommand(const ControlCommand &cmd) {
+  switch (cmd.type) {
+    case CMD_START_WATERING:
+      wateringController.startWatering();
+      break;
+      
+    case CMD_NEW_READINGS:
+      break;
+      
+    case CMD_APPLY_CONFIG:
+      liveConfig.applyControl(cmd.changes, cmd.requestedAt);
+      stateDirty = true;
+      break;
+      
+    case CMD_SET_RELAY: {
+      Relay *relays[] = { &relay1, &relay2, &relay3, &relay4 };
+      if (cmd.relayId >= 0 && cmd.relayId <= 3) {
+        if (cmd.state) relays[cmd.relayId]->turnOn(); else relays[cmd.relayId]->turnOff();
+        stateDirty = true;
+      }
+      break;
+    }
   }
-  
-  // Don't water at night (22:00 - 07:00)
-  if (currentHour >= 22 || currentHour < 7) {
-    return false;
+}
+
+void handleIoCommand(const IoCommand &cmd) {
+  switch (cmd.type) {
+    case IO_READ_NOW:
+      sensorAcquisition.start();
+      break;
+      
+    case IO_CAPTURE_SOIL_POINT:
+      // Take a fresh reading rather than one from before the probe was
+      // placed: a cycle already running is not paired, the next one is
+      pendingCalibrationPercent = cmd.value;
+      pendingCalibrationAfter = sensorAcquisition.getCycleNumber();
+      sensorAcquisition.start();
+      break;
+      
+    case IO_CLEAR_SOIL_CALIBRATION:
+      config.clearSoilCalibration();
+      liveConfig.applySoilCalibration();
+      config.saveConfig();
+      break;
+      
+    case IO_APPLY_CONFIG:
+      liveConfig.applyIo(cmd.changes, cmd.requestedAt);
+      break;
+      
+    case IO_SAVE_CONFIG_AND_RESTART:
+      if (config.saveConfig()) {
+        Serial.println("Configuration saved successfully");
+      } else {
+        Serial.println("Failed to save configuration");
+      }
+      
+      // Short delay to ensure the HTTP response is sent
+      delay(500);
+      
+      // Restart the device
+      ESP.restart();
+      break;
+  }
+}
+
+void publishState() {
+  const SensorReadings &readings = wateringController.getReadings();
+  
+  SystemState snapshot;
+  snapshot.temperature = readings.temperature;
+  snapshot.humidity = readings.humidity;
+  snapshot.pressure = readings.pressure;
+  snapshot.heatIndex = wateringController.getHeatIndex();
+  snapshot.soilMoistureRaw = readings.soilMoistureRaw;
+  snapshot.soilMillivolts = readings.soilMillivolts;
+  snapshot.soilMoisturePercent = readings.soilMoisturePercent;
+  snapshot.lastSensorUpdate = wateringController.getLastSensorUpdate();
+  snapshot.relays[0] = relay1.getState();
+  snapshot.relays[1] = relay2.getState();
+  snapshot.relays[2] = relay3.getState();
+  snapshot.relays[3] = relay4.getState();
+  snapshot.isWatering = wateringController.isWatering();
+  snapshot.wateringStartTime = wateringController.getWateringStartTime();
+  snapshot.wateringDuration = wateringController.getWateringDuration();
+  
+  systemState.publish(snapshot);
+  stateDirty = false;
+  
+  // Let the network task push it to the dashboards
+  if (networkTaskHandle != NULL) {
+    xTaskNotifyGive(networkTaskHandle);
+  }
+}
+
+void recordHistory(const SensorReadings &readings) {
+  // Relay states come from the latest published snapshot
+  SystemState state = systemState.read();
+  uint8_t relays = 0;
+  for (int i = 0; i < 4; i++) {
+    if (state.relays[i]) {
+      relays |= 1 << i;
+    }
   }
   
-  // Check if it's watering time
-  int startHour = config.getWateringStartHour();
-  int startMinute = config.getWateringStartMinute();
-  int endHour = config.getWateringEndHour();
-  int endMinute = config.getWateringEndMinute();
+  HistoryRecord record = HistoryRecord::make(timekeeper.unixtime(), readings.temperature,
+                                             readings.humidity, readings.pressure,
+                                             readings.soilMoistureRaw, readings.soilMoisturePercent,
+                                             relays);
+  if (!historyStore.append(record)) {
+    Serial.println("Failed to record sensor history");
+  }
+  rollupStore.add(record);
+}
+
+// Push a "state" event on a new snapshot (reading, relay or watering change)
+// and once a second while watering for the countdown. Nothing is built
+// while no dashboard is connected.
+void pushState() {
+  static uint32_t lastGeneration = 0;
+  static unsigned long lastRemaining = 0;
+  
+  if (events.count() == 0) {
+    lastGeneration = 0;
+    return;
+  }
   
-  // Convert time to minutes since midnight for easier comparison
-  int currentTimeMinutes = currentHour * 60 + currentMinute;
-  int startTimeMinutes = startHour * 60 + startMinute;
-  int endTimeMinutes = endHour * 60 + endMinute;
+  SystemState state = systemState.read();
+  unsigned long remaining = state.wateringRemaining(millis());
+  if (state.generation == lastGeneration && remaining == lastRemaining) {
+    return;
+  }
+  lastGeneration = state.generation;
+  lastRemaining = remaining;
   
-  // Check if current time is within watering window
-  bool isWateringTime = (currentTimeMinutes >= startTimeMinutes && currentTimeMinutes <= endTimeMinutes);
+  events.send(stateJsonCache.get(state)->json, "state", state.generation);
   
-  if (!isWateringTime) {
-    return false;
+  // An open dashboard counts as client activity for the hotspot timeout
+  wifiManager.resetClientActivityTimer();
+}
+
+void checkTouchSensor() {
+  if (touchSensor.isTouched()) {
+    // After a fast boot WiFi is off; bringing it up starts the hotspot
+    if (!networkStarted) {
+      Serial.println("Touch detected! Starting network...");
+      startNetwork();
+      return;
+    }
+    Serial.println("Touch detected! Starting hotspot...");
+    wifiManager.startHotspot();
+    wifiManager.resetClientActivityTimer();
   }
-  
-  // Check soil moisture 
-  if (soilMoisturePercent > config.getSoilMoistureThreshold()) {
+}
+
+// Send an asset from the manifest: 304 if the client holds this version,
+// otherwise the gzipped file as stored. False if the URL is not in it.
+bool sendAsset(AsyncWebServerRequest *request, const char *url) {
+  const StaticAsset *asset = staticAssets.find(url);
+  if (asset == NULL) {
     return false;
   }
   
-  // All conditions met, should water now
-  return true;
+  AsyncWebServerResponse *response;
+  AsyncWebHeader *ifNoneMatch = request->getHeader("If-None-Match");
+  if (ifNoneMatch != NULL && StaticAssets::isCurrent(*asset, ifNoneMatch->value().c_str())) {
+    response = request->beginResponse(304);
+  } else {
+    // From RAM when cached; the response holds a reference, so an eviction
+    // during a slow send cannot free it underneath
+    std::shared_ptr<const CachedAsset> cached = assetCache.get(*asset);
+    if (cached) {
+      response = request->beginResponse(asset->type, cached->length,
+          [cached](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        size_t chunk = min(maxLen, cached->length - index);
+        memcpy(buffer, cached->data.get() + index, chunk);
+        return chunk;
+      });
+    } else {
+      response = request->beginResponse(LittleFS, asset->file, asset->type);
+    }
+    response->addHeader("Content-Encoding", "gzip");
   }
+  response->addHeader("ETag", asset->etag);
+  response->addHeader("Cache-Control", StaticAssets::cacheControl(*asset));
+  request->send(response);
+  return true;
+}
 
-  void startWatering() {
-  if (isWatering) {
-    return; // Already watering
+// Send the dashboard with the current state in place of its marker: the
+// gzipped head from the template, then the tail built for this state.
+// False without a template.
+bool sendIndexPage(AsyncWebServerRequest *request) {
+  if (!indexTemplate.isLoaded()) {
+    return false;
   }
   
-  Serial.println("Starting watering cycle");
+  SystemState state = systemState.read();
+  std::shared_ptr<const PageState> page = indexTemplate.get(stateJsonCache.get(state));
   
-    // Record today as the watering day
-  DateTime now = rtc.now();
-  lastWateringDay = now.day();
+  AsyncWebServerResponse *response;
+  AsyncWebHeader *ifNoneMatch = request->getHeader("If-None-Match");
+  if (ifNoneMatch != NULL && ifNoneMatch->value() == page->etag) {
+    response = request->beginResponse(304);
+  } else {
+    // The response holds the tail, so a state change during a slow send
+    // cannot change it underneath; the head never changes
+    const uint8_t *head = indexTemplate.getHead();
+    size_t headLength = indexTemplate.getHeadLength();
+    response = request->beginResponse("text/html", headLength + page->length,
+        [page, head, headLength](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      size_t sent = 0;
+      if (index < headLength) {
+        sent = min(maxLen, headLength - index);
+        memcpy(buffer, head + index, sent);
+      }
+      if (index + sent >= headLength) {
+        size_t tailIndex = index + sent - headLength;
+        size_t rest = min(maxLen - sent, page->length - tailIndex);
+        memcpy(buffer + sent, page->bytes + tailIndex, rest);
+        sent += rest;
+      }
+      return sent;
+    });
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", page->etag);
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+  return true;
+}
 
-  // Turn on pump (relay2)
-  relay2.turnOn();
-  
-  // Set watering state
-  isWatering = true;
-  wateringStartTime = millis();
-  wateringDuration = config.getWateringDuration() * 1000; // Convert to milliseconds
-  
-  Serial.printf("Watering will run for %d seconds\n", config.getWateringDuration());
+const char *methodName(WebRequestMethodComposite method) {
+  switch (method) {
+    case HTTP_GET: return "GET";
+    case HTTP_POST: return "POST";
+    case HTTP_PUT: return "PUT";
+    case HTTP_PATCH: return "PATCH";
+    case HTTP_DELETE: return "DELETE";
+    default: return "ANY";
   }
+}
 
-  void stopWatering() {
-  if (!isWatering) {
-    return; // Not watering
+// server.on() with the handlers' run time recorded against the route. A
+// body handler runs once per chunk, so it gets its own series.
+AsyncCallbackWebHandler &route(const char *path, WebRequestMethodComposite method,
+                               ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload = NULL,
+                               ArBodyHandlerFunction onBody = NULL) {
+  LatencyHistogram *latency = routeMetrics.add(path, methodName(method), "request");
+  if (latency != NULL) {
+    ArRequestHandlerFunction handler = onRequest;
+    onRequest = [latency, handler](AsyncWebServerRequest *request) {
+      unsigned long start = micros();
+      handler(request);
+      latency->record(micros() - start);
+    };
   }
   
-  Serial.println("Stopping watering cycle");
-  
-  // Turn off pump (relay2)
-  relay2.turnOff();
-  
-  // Reset watering state
-  isWatering = false;
-  
-  Serial.println("Watering cycle complete");
+  LatencyHistogram *bodyLatency = onBody ? routeMetrics.add(path, methodName(method), "body") : NULL;
+  if (bodyLatency != NULL) {
+    ArBodyHandlerFunction handler = onBody;
+    onBody = [bodyLatency, handler](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+      unsigned long start = micros();
+      handler(request, data, len, index, total);
+      bodyLatency->record(micros() - start);
+    };
   }
+  return server.on(path, method, onRequest, onUpload, onBody);
+}
 
-  void checkWateringStatus() {
-  if (!isWatering) {
-    return;
+// One part of the /api/metrics text per item, so the response is built a
+// part at a time; false past the last
+bool writeMetrics(int item, String &out) {
+  PrometheusText text(out);
+  const String none;
+  
+  if (item == 0) {
+    hal::HeapStats heap = hal::heapStats();
+    hal::I2cStats i2c = hal::i2cStats();
+    AssetCache::Stats cache = assetCache.getStats();
+    text.family("garden_uptime_seconds", "gauge", "Time since boot.");
+    text.sample("garden_uptime_seconds", none, hal::uptimeMicros() / 1e6);
+    text.family("garden_heap_free_bytes", "gauge", "Free heap.");
+    text.sample("garden_heap_free_bytes", none, (uint64_t)heap.freeBytes);
+    text.family("garden_heap_largest_free_block_bytes", "gauge", "Largest allocation that can succeed.");
+    text.sample("garden_heap_largest_free_block_bytes", none, (uint64_t)heap.largestBlock);
+    text.family("garden_heap_min_free_bytes", "gauge", "Lowest free heap since boot.");
+    text.sample("garden_heap_min_free_bytes", none, (uint64_t)heap.minimumFree);
+    text.family("garden_wifi_clients", "gauge", "Stations connected to the hotspot.");
+    text.sample("garden_wifi_clients", none, (uint64_t)wifiManager.getClientCount());
+    text.family("garden_i2c_transactions_total", "counter", "I2C transactions, RTC included.");
+    text.sample("garden_i2c_transactions_total", none, (uint64_t)i2c.transactions);
+    text.family("garden_i2c_errors_total", "counter", "I2C transactions that failed.");
+    text.sample("garden_i2c_errors_total", none, (uint64_t)i2c.errors);
+    text.family("garden_asset_cache_hits_total", "counter", "Static files sent from RAM.");
+    text.sample("garden_asset_cache_hits_total", none, (uint64_t)cache.hits);
+    text.family("garden_asset_cache_misses_total", "counter", "Static files read from flash.");
+    text.sample("garden_asset_cache_misses_total", none, (uint64_t)cache.misses);
+    return true;
   }
   
-  // Check if watering duration has elapsed
-  unsigned long elapsed = millis() - wateringStartTime;
-  if (elapsed >= wateringDuration) {
-    stopWatering();
+  // Each task's loop pass, start of work to going back to sleep
+  if (item == 1) {
+    text.family("garden_task_work_seconds", "summary", "Length of each pass of a task's loop.");
+    for (int i = 0; i < taskMonitor.getTaskCount(); i++) {
+      TaskReport report = taskMonitor.getReport(i);
+      if (report.cpuPercent >= 0) {
+        text.summary("garden_task_work_seconds", PrometheusText::label("task", report.name),
+                     taskMonitor.getWorkTimes(i).snapshot());
+      }
+    }
+    text.family("garden_task_stack_free_bytes", "gauge", "Least free stack seen.");
+    for (int i = 0; i < taskMonitor.getTaskCount(); i++) {
+      TaskReport report = taskMonitor.getReport(i);
+      text.sample("garden_task_stack_free_bytes", PrometheusText::label("task", report.name),
+                  (uint64_t)report.stackHighWater);
+    }
+    return true;
+  }
+  
+  if (item == 2) {
+    text.family("garden_sensor_step_seconds", "histogram", "Each I2C or ADC step of an acquisition.");
+    text.histogram("garden_sensor_step_seconds", none, sensorAcquisition.getStepTimes().snapshot());
+    text.family("garden_sensor_cycle_seconds", "histogram", "Start of an acquisition to its readings.");
+    text.histogram("garden_sensor_cycle_seconds", none, sensorAcquisition.getCycleTimes().snapshot());
+    return true;
+  }
+  
+  int index = item - 3;
+  if (index >= routeMetrics.getCount()) {
+    return false;
+  }
+  if (index == 0) {
+    text.family("garden_http_handler_seconds", "histogram", "Time in each route's handlers.");
   }
+  const RouteMetrics::Route &entry = routeMetrics.getRoute(index);
+  String labels = PrometheusText::label("path", entry.path);
+  labels.concat(',');
+  labels.concat(PrometheusText::label("method", entry.method));
+  labels.concat(',');
+  labels.concat(PrometheusText::label("handler", entry.handler));
+  text.histogram("garden_http_handler_seconds", labels, entry.latency.snapshot());
+  return true;
 }
 
-// New function to read all BME280 sensors with a single power-up cycle
-void readAllBME280Sensors() {
-    Serial.println("Reading BME280 sensor with single power cycle...");
-    
-    // Put BME280 in forced mode once for all readings
-    bme.setSampling(
-        Adafruit_BME280::MODE_FORCED,
-        Adafruit_BME280::SAMPLING_X1, // temperature
-        Adafruit_BME280::SAMPLING_X1, // pressure
-        Adafruit_BME280::SAMPLING_X1, // humidity
-        Adafruit_BME280::FILTER_OFF
-    );
-    
-    // Wake up sensor and take initial measurement
-    if (bme.takeForcedMeasurement()) {
-        // Break up stabilization delay
-        const int smallDelay = 20; // 20ms chunks
-        for (int i = 0; i < 5; i++) {
-            delay(smallDelay);
-            yield();
-        }
-        
-        // Take all readings in single wake/sleep cycle
-        const int numReadings = 5;
-        float tempSum = 0, humiditySum = 0, pressureSum = 0;
-        int validTempReadings = 0, validHumidityReadings = 0, validPressureReadings = 0;
-        
-        Serial.println("Taking averaged BME280 readings...");
-        for (int i = 0; i < numReadings; i++) {
-            yield();
-            
-            // Read temperature
-            float tempReading = bme.readTemperature();
-            if (!isnan(tempReading) && tempReading >= -40 && tempReading <= 85) {
-                tempSum += tempReading;
-                validTempReadings++;
-                Serial.printf("Reading %d: %.2f°C, ", i + 1, tempReading);
-            }
-            
-            // Read humidity
-            float humidityReading = bme.readHumidity();
-            if (!isnan(humidityReading) && humidityReading >= 0 && humidityReading <= 100) {
-                humiditySum += humidityReading;
-                validHumidityReadings++;
-                Serial.printf("%.2f%%, ", humidityReading);
-            }
-            
-            // Read pressure
-            float pressureReading = bme.readPressure() / 100.0F;
-            if (!isnan(pressureReading) && pressureReading >= 300 && pressureReading <= 1100) {
-                pressureSum += pressureReading;
-                validPressureReadings++;
-                Serial.printf("%.2f hPa\n", pressureReading);
-            } else {
-                Serial.println();
-            }
-            
-            // Small delay between readings
-            if (i < numReadings - 1) {
-                delay(50);
-                yield();
-            }
-        }
-        
-        // Calculate averages
-        temperature = (validTempReadings > 0) ? (tempSum / validTempReadings) : 0;
-        humidity = (validHumidityReadings > 0) ? (humiditySum / validHumidityReadings) : 0;
-        pressure = (validPressureReadings > 0) ? (pressureSum / validPressureReadings) : 0;
-        
-        Serial.printf("Average temperature: %.2f°C (from %d readings)\n", temperature, validTempReadings);
-        Serial.printf("Average humidity: %.2f%% (from %d readings)\n", humidity, validHumidityReadings);
-        Serial.printf("Average pressure: %.2f hPa (from %d readings)\n", pressure, validPressureReadings);
-    } else {
-        Serial.println("Failed to perform forced measurement");
-    }
+void setupWebServer() {
+  if (!staticAssets.begin()) {
+    Serial.println("No asset manifest, serving data/ files as they are");
+  }
+  if (!indexTemplate.begin("/index.html.tpl")) {
+    Serial.println("No dashboard template, the page fetches its first state");
+  }
+  
+  // IMPORTANT: Define API endpoints BEFORE the static file handler
+  
+  // API endpoint: Get sensor data
+  route("/api/sensor-data", HTTP_GET, [](AsyncWebServerRequest *request) {
+    // Take a consistent copy of the state published by the control task
+    SystemState state = systemState.read();
+    std::shared_ptr<const StateJson> body = stateJsonCache.get(state);
     
-    // Put BME280 back to sleep mode
-    bme.setSampling(
-        Adafruit_BME280::MODE_SLEEP,
-        Adafruit_BME280::SAMPLING_X1,
-        Adafruit_BME280::SAMPLING_X1,
-        Adafruit_BME280::SAMPLING_X1,
-        Adafruit_BME280::FILTER_OFF
-    );
-}
-// BME280 averaged reading functions
-float readAveragedTemperature() {
-    const int numReadings = 5;
-    const int readingInterval = 100; // ms
-    
-    float sum = 0;
-    int validReadings = 0;
-    
-    Serial.println("Taking averaged temperature readings...");
-    for (int i = 0; i < numReadings; i++) {
-        if (bme.takeForcedMeasurement()) {
-            delay(100); // Wait for measurement to complete
-            float reading = bme.readTemperature();
-            
-            if (!isnan(reading) && reading >= -40 && reading <= 85) {
-                sum += reading;
-                validReadings++;
-                Serial.printf("Reading %d: %.2f°C\n", i + 1, reading);
-            } else {
-                Serial.printf("Reading %d: Invalid value, ignored\n", i + 1);
-            }
-        }
-        
-        // Wait between readings if not the last one
-        if (i < numReadings - 1) {
-            delay(readingInterval);
-        }
+    // Client already has this body
+    AsyncWebHeader *ifNoneMatch = request->getHeader("If-None-Match");
+    if (ifNoneMatch != NULL && ifNoneMatch->value() == body->etag) {
+      AsyncWebServerResponse *response = request->beginResponse(304);
+      response->addHeader("ETag", body->etag);
+      request->send(response);
+      wifiManager.resetClientActivityTimer();
+      return;
     }
     
-    // Calculate average (or return 0 if no valid readings)
-    float average = (validReadings > 0) ? (sum / validReadings) : 0;
-    Serial.printf("Average temperature: %.2f°C (from %d valid readings)\n", 
-                  average, validReadings);
+    // Stream straight from the cached body; the response holds a reference
+    // so a rebuild during a slow send cannot change it underneath
+    AsyncWebServerResponse *response = request->beginResponse("application/json", body->length,
+        [body](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      size_t chunk = min(maxLen, body->length - index);
+      memcpy(buffer, body->json + index, chunk);
+      return chunk;
+    });
+    response->addHeader("ETag", body->etag);
+    response->addHeader("Cache-Control", "no-cache");
+    response->addHeader("X-State-Generation", String(state.generation));
+    request->send(response);
     
-    return average;
-}
-
-float readAveragedHumidity() {
-    const int numReadings = 5;
-    const int readingInterval = 100; // ms
-    
-    float sum = 0;
-    int validReadings = 0;
-    
-    Serial.println("Taking averaged humidity readings...");
-    for (int i = 0; i < numReadings; i++) {
-        if (bme.takeForcedMeasurement()) {
-            delay(100); // Wait for measurement to complete
-            float reading = bme.readHumidity();
-            
-            if (!isnan(reading) && reading >= 0 && reading <= 100) {
-                sum += reading;
-                validReadings++;
-                Serial.printf("Reading %d: %.2f%%\n", i + 1, reading);
-            } else {
-                Serial.printf("Reading %d: Invalid value, ignored\n", i + 1);
-            }
-        }
-        
-        // Wait between readings if not the last one
-        if (i < numReadings - 1) {
-            delay(readingInterval);
-        }
+    // Reset client activity timer
+    wifiManager.resetClientActivityTimer();
+  });
+  
+  // API endpoint: Get configuration data
+  route("/api/config", HTTP_GET, [](AsyncWebServerRequest *request) {
+    DynamicJsonDocument doc(1024);
+    
+    // Every setting in the schema, with the keys older pages still read
+    config.writeApiJson(doc);
+    
+    String jsonResponse;
+    serializeJson(doc, jsonResponse);
+    
+    request->send(200, "application/json", jsonResponse);
+    
+    // Reset client activity timer
+    wifiManager.resetClientActivityTimer();
+  });
+  
+  // API endpoint: Sensor history, streamed as chunks straight from flash
+  // GET /api/history?from=<unix>&to=<unix> (defaults to the last 24 hours)
+  //   &resolution=<seconds>: served from the coarsest rollup tier that fits,
+  //   one row per bucket with min/max/mean/last of each metric
+  route("/api/history", HTTP_GET, [](AsyncWebServerRequest *request) {
+    uint32_t to = historyStore.getNewestTimestamp();
+    if (request->hasParam("to")) {
+      to = request->getParam("to")->value().toInt();
+    }
+    uint32_t from = to > 86400 ? to - 86400 : 0;
+    if (request->hasParam("from")) {
+      from = request->getParam("from")->value().toInt();
+    }
+    int tier = -1;
+    if (request->hasParam("resolution")) {
+      tier = rollupStore.selectTier(request->getParam("resolution")->value().toInt());
     }
     
-    // Calculate average (or return 0 if no valid readings)
-    float average = (validReadings > 0) ? (sum / validReadings) : 0;
-    Serial.printf("Average humidity: %.2f%% (from %d valid readings)\n", 
-                 average, validReadings);
+    struct HistoryStream {
+      HistoryStore::Cursor cursor;
+      HistoryRecord records[16];
+      int tier;
+      uint32_t next;
+      uint32_t to;
+      RollupRecord rollups[6];
+      char text[1024];
+      size_t textLength = 0;
+      size_t textOffset = 0;
+      bool firstRow = true;
+      bool finished = false;
+    };
+    std::shared_ptr<HistoryStream> stream = std::make_shared<HistoryStream>();
+    stream->tier = tier;
+    stream->next = from;
+    stream->to = to;
+    if (tier < 0) {
+      historyStore.seek(stream->cursor, from, to);
+      stream->textLength = snprintf(stream->text, sizeof(stream->text),
+          "{\"from\":%lu,\"to\":%lu,\"resolution\":60,\"columns\":[\"timestamp\",\"temperature\","
+          "\"humidity\",\"pressure\",\"soil_raw\",\"soil_moisture\",\"relays\"],\"rows\":[",
+          (unsigned long)from, (unsigned long)to);
+    } else {
+      stream->textLength = snprintf(stream->text, sizeof(stream->text),
+          "{\"from\":%lu,\"to\":%lu,\"resolution\":%lu,\"columns\":[\"timestamp\",\"count\","
+          "\"temperature_min\",\"temperature_max\",\"temperature_mean\",\"temperature_last\","
+          "\"humidity_min\",\"humidity_max\",\"humidity_mean\",\"humidity_last\","
+          "\"pressure_min\",\"pressure_max\",\"pressure_mean\",\"pressure_last\","
+          "\"soil_moisture_min\",\"soil_moisture_max\",\"soil_moisture_mean\",\"soil_moisture_last\"],"
+          "\"rows\":[",
+          (unsigned long)from, (unsigned long)to, (unsigned long)RollupStore::tiers[tier].period);
+    }
     
-    return average;
-}
-
-float readAveragedPressure() {
-    const int numReadings = 5;
-    const int readingInterval = 100; // ms
-    
-    float sum = 0;
-    int validReadings = 0;
-    
-    Serial.println("Taking averaged pressure readings...");
-    for (int i = 0; i < numReadings; i++) {
-        if (bme.takeForcedMeasurement()) {
-            delay(100); // Wait for measurement to complete
-            float reading = bme.readPressure() / 100.0F; // Convert Pa to hPa
-            
-            if (!isnan(reading) && reading >= 300 && reading <= 1100) {
-                sum += reading;
-                validReadings++;
-                Serial.printf("Reading %d: %.2f hPa\n", i + 1, reading);
-            } else {
-                Serial.printf("Reading %d: Invalid value, ignored\n", i + 1);
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+        [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      size_t written = 0;
+      while (written < maxLen) {
+        // Refill the text buffer with the next batch of rows
+        if (stream->textOffset == stream->textLength) {
+          if (stream->finished) {
+            break;
+          }
+          stream->textOffset = 0;
+          stream->textLength = 0;
+          bool done;
+          if (stream->tier < 0) {
+            size_t count = historyStore.read(stream->cursor, stream->records, 16);
+            for (size_t i = 0; i < count; i++) {
+              const HistoryRecord &r = stream->records[i];
+              stream->textLength += snprintf(stream->text + stream->textLength,
+                  sizeof(stream->text) - stream->textLength,
+                  "%s[%lu,%.2f,%.2f,%.1f,%u,%.2f,%u]", stream->firstRow ? "" : ",",
+                  (unsigned long)r.timestamp, r.getTemperature(), r.getHumidity(),
+                  r.getPressure(), r.soilRaw, r.getSoilPercent(), r.relays);
+              stream->firstRow = false;
             }
+            done = count == 0 && stream->cursor.done;
+          } else {
+            size_t count = rollupStore.read(stream->tier, stream->next, stream->to, stream->rollups, 6);
+            for (size_t i = 0; i < count; i++) {
+              const RollupRecord &r = stream->rollups[i];
+              stream->textLength += snprintf(stream->text + stream->textLength,
+                  sizeof(stream->text) - stream->textLength,
+                  "%s[%lu,%u", stream->firstRow ? "" : ",", (unsigned long)r.start, r.count);
+              for (int m = 0; m < ROLLUP_METRIC_COUNT; m++) {
+                RollupMetric metric = (RollupMetric)m;
+                const char *format = metric == ROLLUP_PRESSURE ? ",%.1f,%.1f,%.1f,%.1f" : ",%.2f,%.2f,%.2f,%.2f";
+                stream->textLength += snprintf(stream->text + stream->textLength,
+                    sizeof(stream->text) - stream->textLength, format,
+                    RollupStore::statValue(metric, r.stats[m].min),
+                    RollupStore::statValue(metric, r.stats[m].max),
+                    RollupStore::statValue(metric, r.stats[m].mean),
+                    RollupStore::statValue(metric, r.stats[m].last));
+              }
+              stream->textLength += snprintf(stream->text + stream->textLength,
+                  sizeof(stream->text) - stream->textLength, "]");
+              stream->firstRow = false;
+            }
+            done = count == 0;
+          }
+          if (done) {
+            stream->textLength = snprintf(stream->text, sizeof(stream->text), "]}");
+            stream->finished = true;
+          }
         }
         
-        // Wait between readings if not the last one
-        if (i < numReadings - 1) {
-            delay(readingInterval);
-        }
+        size_t chunk = min(maxLen - written, stream->textLength - stream->textOffset);
+        memcpy(buffer + written, stream->text + stream->textOffset, chunk);
+        stream->textOffset += chunk;
+        written += chunk;
+      }
+      return written;
+    });
+    request->send(response);
+    
+    // Reset client activity timer
+    wifiManager.resetClientActivityTimer();
+  });
+  
+  // API endpoint: Task stack and CPU usage
+  route("/api/tasks", HTTP_GET, [](AsyncWebServerRequest *request) {
+    DynamicJsonDocument doc(1536);
+    
+    JsonArray tasks = doc.createNestedArray("tasks");
+    for (int i = 0; i < taskMonitor.getTaskCount(); i++) {
+      TaskReport report = taskMonitor.getReport(i);
+      JsonObject task = tasks.createNestedObject();
+      task["name"] = report.name;
+      task["stack_free"] = report.stackHighWater;
+      if (report.cpuPercent >= 0) {
+        task["cpu_percent"] = report.cpuPercent;
+      }
     }
     
-    // Calculate average (or return 0 if no valid readings)
-    float average = (validReadings > 0) ? (sum / validReadings) : 0;
-    Serial.printf("Average pressure: %.2f hPa (from %d valid readings)\n", 
-                 average, validReadings);
+    // Timer wheel jobs; lateness is from due time to start
+    JsonArray jobs = doc.createNestedArray("jobs");
+    Scheduler *schedulers[] = { &controlScheduler, &networkScheduler };
+    for (Scheduler *scheduler : schedulers) {
+      for (int i = 0; i < scheduler->getJobCount(); i++) {
+        Scheduler::JobReport report = scheduler->getReport(i);
+        JsonObject job = jobs.createNestedObject();
+        job["name"] = report.name;
+        job["runs"] = report.runs;
+        job["last_late_us"] = report.lastLatenessUs;
+        job["max_late_us"] = report.maxLatenessUs;
+      }
+    }
     
-    return average;
-}
-
-void setupWebServer() {
-  // IMPORTANT: Define API endpoints BEFORE the static file handler
+    // Longest single acquisition step, i.e. the worst-case stall it can cause
+    doc["acquisition_max_step_us"] = sensorAcquisition.getMaxStepMicros();
+    doc["uptime_ms"] = millis();
+    
+    String jsonResponse;
+    serializeJson(doc, jsonResponse);
+    
+    request->send(200, "application/json", jsonResponse);
+    
+    // Reset client activity timer
+    wifiManager.resetClientActivityTimer();
+  });
   
-  // API endpoint: Get sensor data
-  server.on("/api/sensor-data", HTTP_GET, [](AsyncWebServerRequest *request) {
-    // Create JSON response
-    DynamicJsonDocument doc(1024);
+  // API endpoint: Time awake, with the radio up and asleep since power-on,
+  // the supply current those imply, and wake-to-reading latency
+  route("/api/power", HTTP_GET, [](AsyncWebServerRequest *request) {
+    DutyCycle::Report report = dutyCycle.getReport();
+    DynamicJsonDocument doc(512);
+    
+    doc["mode"] = report.enabled ? "duty_cycle" : "continuous";
+    doc["wakes"] = report.wakes;
+    doc["readings"] = report.readings;
+    doc["awake_s"] = report.activeMicros / 1000000.0;
+    doc["radio_s"] = report.radioMicros / 1000000.0;
+    doc["sleep_s"] = report.sleepMicros / 1000000.0;
+    doc["average_ma"] = report.averageMa;
+    doc["latency_mean_ms"] = report.latencyMeanMs;
+    doc["latency_max_ms"] = report.latencyMaxMs;
+    
+    String jsonResponse;
+    serializeJson(doc, jsonResponse);
+    
+    request->send(200, "application/json", jsonResponse);
+    
+    // Reset client activity timer
+    wifiManager.resetClientActivityTimer();
+  });
+  
+  // API endpoint: Boot phases (start from power-on or wake, length from
+  // the cycle counter) and when the control loop, first reading and web
+  // server became ready
+  route("/api/boot-profile", HTTP_GET, [](AsyncWebServerRequest *request) {
+    DynamicJsonDocument doc(2048);
     
-    // Add device information
-    doc["deviceName"] = config.getDeviceName();
-    
-    // BME280 sensor data
-    doc["temperature"] = temperature;
-    doc["humidity"] = humidity;
-    doc["pressure"] = pressure;
-    doc["heat_index"] = heatIndex;
-    
-    // Soil data
-    doc["soil_raw"] = soilMoistureRaw;
-    doc["soil_moisture"] = soilMoisturePercent;
-    
-    // Get current time from RTC
-    DateTime now = rtc.now();
-    char timeStr[20];
-    sprintf(timeStr, "%02d/%02d/%04d %02d:%02d:%02d", 
-            now.day(), now.month(), now.year(),
-            now.hour(), now.minute(), now.second());
-    doc["time_str"] = timeStr;
-    doc["timestamp"] = now.unixtime();
-    
-    // Relay status
-    JsonArray relays = doc.createNestedArray("relays");
-    relays.add(relay1.getState());
-    relays.add(relay2.getState());
-    relays.add(relay3.getState());
-    relays.add(relay4.getState());
-    
-    // Relay names
-    JsonArray relayNames = doc.createNestedArray("relay_names");
-    relayNames.add(config.getRelay1Name());
-    relayNames.add(config.getRelay2Name());
-    relayNames.add(config.getRelay3Name());
-    relayNames.add(config.getRelay4Name());
-    
-    // Watering status
-    doc["watering_active"] = isWatering;
-    if (isWatering) {
-      unsigned long elapsed = millis() - wateringStartTime;
-      unsigned long remaining = (elapsed < wateringDuration) ? 
-                              (wateringDuration - elapsed) / 1000 : 0;
-      doc["watering_remaining"] = remaining;
+    JsonArray phases = doc.createNestedArray("phases");
+    JsonObject milestones = doc.createNestedObject("milestones");
+    for (int i = 0; i < bootProfile.getCount(); i++) {
+      BootProfile::Entry entry = bootProfile.getEntry(i);
+      if (entry.milestone) {
+        milestones[entry.name] = entry.startMicros;
+        continue;
+      }
+      JsonObject phase = phases.createNestedObject();
+      phase["name"] = entry.name;
+      phase["start_us"] = entry.startMicros;
+      phase["duration_us"] = entry.micros;
     }
+    doc["cpu_mhz"] = hal::cpuMhz();
     
-    // Serialize JSON to string
     String jsonResponse;
     serializeJson(doc, jsonResponse);
     
-    // Send response
     request->send(200, "application/json", jsonResponse);
     
     // Reset client activity timer
     wifiManager.resetClientActivityTimer();
   });
   
-  // API endpoint: Get configuration data
-  server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest *request) {
-    DynamicJsonDocument doc(1024);
+  // API endpoint: Counters and latency histograms in Prometheus text
+  // format, produced a part at a time while the response is sent
+  route("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+    std::shared_ptr<MetricsStream> stream = std::make_shared<MetricsStream>(writeMetrics);
+    AsyncWebServerResponse *response = request->beginChunkedResponse("text/plain; version=0.0.4",
+        [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      return stream->read(buffer, maxLen);
+    });
+    request->send(response);
+    
+    // Reset client activity timer
+    wifiManager.resetClientActivityTimer();
+  });
+  
+  // API endpoint: Static asset cache use since boot
+  route("/api/asset-cache", HTTP_GET, [](AsyncWebServerRequest *request) {
+    AssetCache::Stats stats = assetCache.getStats();
+    DynamicJsonDocument doc(256);
     
-    // Device and authentication settings
-    doc["deviceName"] = config.getDeviceName();
-    doc["username"] = config.getUsername();
-    doc["password"] = config.getPassword();
-    
-    // Pin assignments
-    doc["soilMoisturePin"] = config.getSoilMoistureSensorPin();
-    doc["soilMoisturePowerPin"] = config.getSoilMoisturePowerPin();
-    doc["touchPin"] = config.getTouchSensorPin();
-    doc["touchSensorThreshold"] = config.getTouchSensorThreshold();
-    doc["i2cSdaPin"] = config.getI2cSdaPin();
-    doc["i2cSclPin"] = config.getI2cSclPin();
-    doc["relay1Pin"] = config.getRelay1Pin();
-    doc["relay2Pin"] = config.getRelay2Pin();
-    doc["relay3Pin"] = config.getRelay3Pin();
-    doc["relay4Pin"] = config.getRelay4Pin();
-    
-    // Relay names
-    doc["relay1Name"] = config.getRelay1Name();
-    doc["relay2Name"] = config.getRelay2Name();
-    doc["relay3Name"] = config.getRelay3Name();
-    doc["relay4Name"] = config.getRelay4Name();
-    
-    // Soil moisture calibration
-    doc["soilMoistureDry"] = config.getSoilMoistureDryValue();
-    doc["soilMoistureWet"] = config.getSoilMoistureWetValue();
-    
-    // Watering settings
-    doc["wateringDuration"] = config.getWateringDuration();
-    
-    // Add compatibility fields for the legacy form fields
-    doc["wateringTimeStart"] = config.getWateringStartHour();
-    doc["wateringTimeEnd"] = config.getWateringEndHour();
-    doc["waterAtPercent"] = config.getSoilMoistureThreshold();
-    
-    // Add new format fields too
-    doc["wateringStartHour"] = config.getWateringStartHour();
-    doc["wateringStartMinute"] = config.getWateringStartMinute();
-    doc["wateringEndHour"] = config.getWateringEndHour();
-    doc["wateringEndMinute"] = config.getWateringEndMinute();
-    doc["soilMoistureThreshold"] = config.getSoilMoistureThreshold();
+    doc["hits"] = stats.hits;
+    doc["misses"] = stats.misses;
+    doc["evictions"] = stats.evictions;
+    doc["entries"] = stats.entries;
+    doc["bytes"] = stats.bytes;
     
     String jsonResponse;
     serializeJson(doc, jsonResponse);
@@ -700,7 +1352,7 @@ void setupWebServer() {
   });
   
   // API endpoint: Control relay
-  server.on("/api/relay", HTTP_POST, [](AsyncWebServerRequest *request) {
+  route("/api/relay", HTTP_POST, [](AsyncWebServerRequest *request) {
     // Require authentication if not in setup mode
     if (!config.isFirstTimeSetup() && 
         !request->authenticate(config.getUsername().c_str(), config.getPassword().c_str())) {
@@ -721,19 +1373,8 @@ void setupWebServer() {
       return request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid relay ID\"}");
     }
     
-    // Control appropriate relay
-    bool success = true;
-    if (relayId == 0) {
-      if (state) relay1.turnOn(); else relay1.turnOff();
-    } else if (relayId == 1) {
-      if (state) relay2.turnOn(); else relay2.turnOff();
-    } else if (relayId == 2) {
-      if (state) relay3.turnOn(); else relay3.turnOff();
-    } else if (relayId == 3) {
-      if (state) relay4.turnOn(); else relay4.turnOff();
-    } else {
-      success = false;
-    }
+    // Hand the change to the control task, which owns the relays
+    bool success = sendControlCommand(CMD_SET_RELAY, relayId, state != 0);
     
     // Create JSON response
     DynamicJsonDocument doc(128);
@@ -752,7 +1393,7 @@ void setupWebServer() {
   });
   
   // API endpoint: Start watering
-  server.on("/api/water-now", HTTP_POST, [](AsyncWebServerRequest *request) {
+  route("/api/water-now", HTTP_POST, [](AsyncWebServerRequest *request) {
     // Require authentication if not in setup mode
     if (!config.isFirstTimeSetup() && 
         !request->authenticate(config.getUsername().c_str(), config.getPassword().c_str())) {
@@ -761,7 +1402,7 @@ void setupWebServer() {
     
     // Start watering with configured duration
     Serial.println("Watering requested via API");
-    startWatering();
+    sendControlCommand(CMD_START_WATERING);
     
     request->send(200, "text/plain", "Watering started");
     
@@ -770,7 +1411,7 @@ void setupWebServer() {
   });
 
   // API endpoint: Force sensor reading now
-  server.on("/api/read-now", HTTP_POST, [](AsyncWebServerRequest *request) {
+  route("/api/read-now", HTTP_POST, [](AsyncWebServerRequest *request) {
     // Require authentication if not in setup mode
     if (!config.isFirstTimeSetup() && 
         !request->authenticate(config.getUsername().c_str(), config.getPassword().c_str())) {
@@ -779,8 +1420,8 @@ void setupWebServer() {
     
     Serial.println("\n!!! SENSOR READING REQUESTED VIA READ NOW BUTTON !!!");
     
-    // Trigger a sensor update immediately
-    updateSensorReadings();
+    // Start a sensor cycle immediately; the I/O task completes it without blocking this handler
+    sendIoCommand(IO_READ_NOW);
     
     // Send success response
     request->send(200, "application/json", "{\"success\":true}");
@@ -789,8 +1430,74 @@ void setupWebServer() {
     wifiManager.resetClientActivityTimer();
   });
   
+  // API endpoint: Soil calibration curve and the reading it applies to
+  route("/api/soil-calibration", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!config.isFirstTimeSetup() && 
+        !request->authenticate(config.getUsername().c_str(), config.getPassword().c_str())) {
+      return request->requestAuthentication();
+    }
+    
+    DynamicJsonDocument doc(768);
+    JsonArray points = doc.createNestedArray("points");
+    SoilCalibrationPoint curve[SoilMoistureSensor::maxCalibrationPoints];
+    int count = config.getSoilCalibration(curve);
+    for (int i = 0; i < count; i++) {
+      JsonObject point = points.createNestedObject();
+      point["raw"] = curve[i].raw;
+      point["percent"] = curve[i].percent;
+    }
+    doc["wet"] = config.getSoilMoistureWetValue();
+    doc["dry"] = config.getSoilMoistureDryValue();
+    
+    SystemState state = systemState.read();
+    doc["soil_raw"] = state.soilMoistureRaw;
+    doc["soil_moisture"] = state.soilMoisturePercent;
+    
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+    wifiManager.resetClientActivityTimer();
+  });
+  
+  // API endpoint: Capture a calibration point, percent = moisture of the soil the probe is in now
+  route("/api/soil-calibration", HTTP_POST, [](AsyncWebServerRequest *request) {
+    if (!config.isFirstTimeSetup() && 
+        !request->authenticate(config.getUsername().c_str(), config.getPassword().c_str())) {
+      return request->requestAuthentication();
+    }
+    
+    AsyncWebParameter *param = request->getParam("percent", true);
+    if (param == NULL) {
+      param = request->getParam("percent");
+    }
+    float percent = param ? param->value().toFloat() : -1;
+    if (param == NULL || percent < 0 || percent > 100) {
+      request->send(400, "application/json", "{\"success\":false,\"error\":\"percent must be 0-100\"}");
+      return;
+    }
+    
+    // The I/O task takes a fresh reading and stores the point when it completes
+    bool queued = sendIoCommand(IO_CAPTURE_SOIL_POINT, percent);
+    request->send(queued ? 202 : 503, "application/json",
+                  queued ? "{\"success\":true}" : "{\"success\":false}");
+    wifiManager.resetClientActivityTimer();
+  });
+  
+  // API endpoint: Drop the curve and go back to the wet/dry calibration
+  route("/api/soil-calibration", HTTP_DELETE, [](AsyncWebServerRequest *request) {
+    if (!config.isFirstTimeSetup() && 
+        !request->authenticate(config.getUsername().c_str(), config.getPassword().c_str())) {
+      return request->requestAuthentication();
+    }
+    
+    bool queued = sendIoCommand(IO_CLEAR_SOIL_CALIBRATION);
+    request->send(queued ? 200 : 503, "application/json",
+                  queued ? "{\"success\":true}" : "{\"success\":false}");
+    wifiManager.resetClientActivityTimer();
+  });
+  
   // API endpoint: Reset device to setup mode
-  server.on("/api/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+  route("/api/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
     // Require authentication if not in setup mode
     if (!config.isFirstTimeSetup() && 
         !request->authenticate(config.getUsername().c_str(), config.getPassword().c_str())) {
@@ -800,24 +1507,16 @@ void setupWebServer() {
     // Reset configuration and set first-time setup flag
     config.setFirstTimeSetup(true);
     
-    // Save configuration BEFORE restarting
-    if (!config.saveConfig()) {
-      Serial.println("Failed to save configuration before reset");
-    }
-    
     // Send response before restarting
     request->send(200, "text/plain", "Device will restart in setup mode");
     
-    // Short delay to ensure response is sent
-    delay(500);
-    
-    // Restart the device
-    ESP.restart();
+    // The I/O task saves the configuration, then restarts the device
+    sendIoCommand(IO_SAVE_CONFIG_AND_RESTART);
   });
   
   // API endpoint: Save configuration (for setup page)
   // This handles both form-encoded data AND JSON data
-  server.on("/api/config", HTTP_POST, 
+  route("/api/config", HTTP_POST, 
     // Handler for form-encoded data
     [](AsyncWebServerRequest *request) {
       // This handler is only for form-encoded data, not JSON
@@ -828,6 +1527,9 @@ void setupWebServer() {
       }
       
       Serial.println("Received setup configuration (form-encoded)");
+      uint32_t requestedAt = micros();
+      // Built on a copy and swapped in whole; the control task reads the live one
+      ConfigRecord staged = config.getRecord();
       
       // Process all form fields
       int params = request->params();
@@ -837,15 +1539,8 @@ void setupWebServer() {
         if (p->isPost()) {
           Serial.printf("Setup parameter: %s = %s\n", p->name().c_str(), p->value().c_str());
           
-          // Device name
-          if (p->name() == "deviceName") {
-            config.setDeviceName(p->value());
-          }
-          // Date and Time settings
-          else if (p->name() == "date") {
-            // Store the date param for later processing with time
-          }
-          else if (p->name() == "time") {
+          // Date and time set the RTC once both are known
+          if (p->name() == "time") {
             // If we have both date and time, set the RTC
             if (request->hasParam("date", true)) {
               String dateStr = request->getParam("date", true)->value();
@@ -874,126 +1569,29 @@ void setupWebServer() {
                   hour >= 0 && hour <= 23 && minute >= 0 && minute <= 59 && second >= 0 && second <= 59) {
                 
                 // Set the RTC
-                rtc.adjust(DateTime(year, month, day, hour, minute, second));
+                timekeeper.adjust(hal::makeWallTime(year, month, day, hour, minute, second));
                 Serial.println("RTC time set successfully");
               } else {
                 Serial.println("Invalid date/time format");
               }
             }
           }
-          // GPIO pin settings
-          else if (p->name() == "soilMoisturePin") {
-            config.setSoilMoistureSensorPin(p->value().toInt());
-          }
-          else if (p->name() == "soilMoisturePowerPin") {
-            config.setSoilMoisturePowerPin(p->value().toInt());
-          }
-          else if (p->name() == "touchPin") {
-            config.setTouchSensorPin(p->value().toInt());
-          }
-          else if (p->name() == "touchSensorThreshold") {
-            config.setTouchSensorThreshold(p->value().toInt());
-          }
-          else if (p->name() == "i2cSdaPin") {
-            config.setI2cSdaPin(p->value().toInt());
-          }
-          else if (p->name() == "i2cSclPin") {
-            config.setI2cSclPin(p->value().toInt());
-          }
-          else if (p->name() == "relay1Pin") {
-            config.setRelay1Pin(p->value().toInt());
-          }
-          else if (p->name() == "relay2Pin") {
-            config.setRelay2Pin(p->value().toInt());
-          }
-          else if (p->name() == "relay3Pin") {
-            config.setRelay3Pin(p->value().toInt());
-          }
-          else if (p->name() == "relay4Pin") {
-            config.setRelay4Pin(p->value().toInt());
-          }
-          // Relay names
-          else if (p->name() == "relay1Name") {
-            config.setRelay1Name(p->value());
-          }
-          else if (p->name() == "relay2Name") {
-            config.setRelay2Name(p->value());
-          }
-          else if (p->name() == "relay3Name") {
-            config.setRelay3Name(p->value());
-          }
-          else if (p->name() == "relay4Name") {
-            config.setRelay4Name(p->value());
-          }
-          // Soil moisture calibration
-          else if (p->name() == "soilMoistureDry") {
-            config.setSoilMoistureDryValue(p->value().toInt());
-          }
-          else if (p->name() == "soilMoistureWet") {
-            config.setSoilMoistureWetValue(p->value().toInt());
-          }
-          // Watering configuration - support both legacy and new formats
-          else if (p->name() == "wateringDuration") {
-            config.setWateringDuration(p->value().toInt());
-          }
-          else if (p->name() == "wateringTimeStart") {
-            // Legacy format - just hour
-            config.setWateringStartHour(p->value().toInt());
-            config.setWateringStartMinute(0); // Default to 0 minutes
-          }
-          else if (p->name() == "wateringTimeEnd") {
-            // Legacy format - just hour
-            config.setWateringEndHour(p->value().toInt());
-            config.setWateringEndMinute(0); // Default to 0 minutes
-          }
-          else if (p->name() == "waterAtPercent") {
-            // Legacy format for threshold
-            config.setSoilMoistureThreshold(p->value().toFloat());
-          }
-          // New format fields
-          else if (p->name() == "wateringStartHour") {
-            config.setWateringStartHour(p->value().toInt());
-          }
-          else if (p->name() == "wateringStartMinute") {
-            config.setWateringStartMinute(p->value().toInt());
-          }
-          else if (p->name() == "wateringEndHour") {
-            config.setWateringEndHour(p->value().toInt());
-          }
-          else if (p->name() == "wateringEndMinute") {
-            config.setWateringEndMinute(p->value().toInt());
-          }
-          else if (p->name() == "soilMoistureThreshold") {
-            config.setSoilMoistureThreshold(p->value().toFloat());
-          }
-          // Authorization
-          else if (p->name() == "username") {
-            config.setUsername(p->value());
-          }
-          else if (p->name() == "password") {
-            config.setPassword(p->value());
+          // Everything else by key, through the config schema
+          else if (p->name() != "date") {
+            Config::stageField(staged, p->name().c_str(), p->name().length(), p->value().c_str());
           }
         }
       }
       
-      // Complete setup
-      config.setFirstTimeSetup(false);
+      // Complete setup; leaving setup mode takes a restart
+      staged.isFirstRun = false;
       
-      // Save configuration
-      if (config.saveConfig()) {
-        Serial.println("Configuration saved successfully");
+      // Applied live unless a setting only read at boot changed
+      if (applyConfigChanges(config.applyRecord(staged), requestedAt)) {
+        request->send(200, "text/plain", "Configuration applied.");
       } else {
-        Serial.println("Failed to save configuration");
+        request->send(200, "text/plain", "Configuration saved. The device will restart.");
       }
-      
-      // Send response
-      request->send(200, "text/plain", "Configuration saved. The device will restart.");
-      
-      // Short delay to ensure response is sent
-      delay(500);
-      
-      // Restart the device
-      ESP.restart();
     },
     // Handler for file uploads (none for this endpoint)
     NULL,
@@ -1004,11 +1602,25 @@ void setupWebServer() {
         return; // Skip - not JSON
       }
       
+      // Parse once the whole body is in; it may come in several chunks
+      switch (collectRequestBody(request->_tempObject, data, len, index, total, maxConfigBodySize)) {
+        case BODY_COMPLETE:
+          break;
+        case BODY_TOO_LARGE:
+          request->send(413, "text/plain", "Configuration too large");
+          return;
+        default:
+          return;
+      }
+      RequestBody *body = (RequestBody *)request->_tempObject;
+      
       Serial.println("Received setup configuration (JSON)");
+      uint32_t requestedAt = micros();
+      ConfigRecord staged = config.getRecord();
       
-      // Parse JSON data
+      // Parse JSON data in place; its strings point into the body
       DynamicJsonDocument doc(2048);
-      DeserializationError error = deserializeJson(doc, data, len);
+      DeserializationError error = deserializeJson(doc, body->bytes(), body->total);
       
       if (error) {
         Serial.print("JSON parsing failed: ");
@@ -1017,11 +1629,6 @@ void setupWebServer() {
         return;
       }
       
-      // Process device name
-      if (doc.containsKey("deviceName")) {
-        config.setDeviceName(doc["deviceName"].as<String>());
-      }
-      
       // Process date and time
       if (doc.containsKey("date") && doc.containsKey("time")) {
         String dateStr = doc["date"].as<String>();
@@ -1050,133 +1657,90 @@ void setupWebServer() {
             hour >= 0 && hour <= 23 && minute >= 0 && minute <= 59 && second >= 0 && second <= 59) {
           
           // Set the RTC
-          rtc.adjust(DateTime(year, month, day, hour, minute, second));
+          timekeeper.adjust(hal::makeWallTime(year, month, day, hour, minute, second));
           Serial.println("RTC time set successfully");
         } else {
           Serial.println("Invalid date/time format");
         }
       }
       
-      // Process all other config values from JSON
-      if (doc.containsKey("soilMoisturePin")) {
-        config.setSoilMoistureSensorPin(doc["soilMoisturePin"].as<int>());
-      }
-      if (doc.containsKey("soilMoisturePowerPin")) {
-        config.setSoilMoisturePowerPin(doc["soilMoisturePowerPin"].as<int>());
-      }
-      if (doc.containsKey("touchPin")) {
-        config.setTouchSensorPin(doc["touchPin"].as<int>());
-      }
-      if (doc.containsKey("touchSensorThreshold")) {
-        config.setTouchSensorThreshold(doc["touchSensorThreshold"].as<int>());
-      }
-      if (doc.containsKey("i2cSdaPin")) {
-        config.setI2cSdaPin(doc["i2cSdaPin"].as<int>());
-      }
-      if (doc.containsKey("i2cSclPin")) {
-        config.setI2cSclPin(doc["i2cSclPin"].as<int>());
-      }
-      if (doc.containsKey("relay1Pin")) {
-        config.setRelay1Pin(doc["relay1Pin"].as<int>());
-      }
-      if (doc.containsKey("relay2Pin")) {
-        config.setRelay2Pin(doc["relay2Pin"].as<int>());
-      }
-      if (doc.containsKey("relay3Pin")) {
-        config.setRelay3Pin(doc["relay3Pin"].as<int>());
-      }
-      if (doc.containsKey("relay4Pin")) {
-        config.setRelay4Pin(doc["relay4Pin"].as<int>());
+      // Everything else by key, through the config schema
+      for (JsonPair pair : doc.as<JsonObject>()) {
+        Config::stageField(staged, pair.key().c_str(), pair.key().size(), pair.value());
       }
       
-      // Relay names
-      if (doc.containsKey("relay1Name")) {
-        config.setRelay1Name(doc["relay1Name"].as<String>());
-      }
-      if (doc.containsKey("relay2Name")) {
-        config.setRelay2Name(doc["relay2Name"].as<String>());
-      }
-      if (doc.containsKey("relay3Name")) {
-        config.setRelay3Name(doc["relay3Name"].as<String>());
-      }
-      if (doc.containsKey("relay4Name")) {
-        config.setRelay4Name(doc["relay4Name"].as<String>());
-      }
-      
-      // Soil moisture calibration
-      if (doc.containsKey("soilMoistureDry")) {
-        config.setSoilMoistureDryValue(doc["soilMoistureDry"].as<int>());
-      }
-      if (doc.containsKey("soilMoistureWet")) {
-        config.setSoilMoistureWetValue(doc["soilMoistureWet"].as<int>());
-      }
-      
-      // Watering settings
-      if (doc.containsKey("wateringDuration")) {
-        config.setWateringDuration(doc["wateringDuration"].as<int>());
-      }
+      // Complete setup; leaving setup mode takes a restart
+      staged.isFirstRun = false;
       
-      // Legacy format support
-      if (doc.containsKey("wateringTimeStart")) {
-        config.setWateringStartHour(doc["wateringTimeStart"].as<int>());
-        config.setWateringStartMinute(0);
-      }
-      if (doc.containsKey("wateringTimeEnd")) {
-        config.setWateringEndHour(doc["wateringTimeEnd"].as<int>());
-        config.setWateringEndMinute(0);
-      }
-      if (doc.containsKey("waterAtPercent")) {
-        config.setSoilMoistureThreshold(doc["waterAtPercent"].as<float>());
-      }
-      
-      // New format fields
-      if (doc.containsKey("wateringStartHour")) {
-        config.setWateringStartHour(doc["wateringStartHour"].as<int>());
-      }
-      if (doc.containsKey("wateringStartMinute")) {
-        config.setWateringStartMinute(doc["wateringStartMinute"].as<int>());
+      // Applied live unless a setting only read at boot changed
+      if (applyConfigChanges(config.applyRecord(staged), requestedAt)) {
+        request->send(200, "text/plain", "Configuration applied.");
+      } else {
+        request->send(200, "text/plain", "Configuration saved. The device will restart.");
       }
-      if (doc.containsKey("wateringEndHour")) {
-        config.setWateringEndHour(doc["wateringEndHour"].as<int>());
+    }
+  );
+  
+  // API endpoint: Change some settings without a restart
+  // PATCH /api/config with a JSON object of just the keys to change. All
+  // or nothing: unknown keys and out-of-range values are refused with 400.
+  // Relays, sensors and the watering plan take the change live; a setting
+  // only read at boot (I2C pins, device name, duty cycle) saves and
+  // restarts as a POST does.
+  route("/api/config", HTTP_PATCH,
+    [](AsyncWebServerRequest *request) {
+      // Answered by the body handler, which an empty body never reaches
+      if (request->contentLength() == 0) {
+        request->send(400, "application/json", "{\"success\":false,\"error\":\"empty body\"}");
       }
-      if (doc.containsKey("wateringEndMinute")) {
-        config.setWateringEndMinute(doc["wateringEndMinute"].as<int>());
+    },
+    NULL,
+    [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+      // Checked on the first chunk; the rest of a refused body is ignored
+      if (index == 0 && !config.isFirstTimeSetup() &&
+          !request->authenticate(config.getUsername().c_str(), config.getPassword().c_str())) {
+        return request->requestAuthentication();
       }
-      if (doc.containsKey("soilMoistureThreshold")) {
-        config.setSoilMoistureThreshold(doc["soilMoistureThreshold"].as<float>());
+      switch (collectRequestBody(request->_tempObject, data, len, index, total, maxConfigBodySize)) {
+        case BODY_COMPLETE:
+          break;
+        case BODY_TOO_LARGE:
+          request->send(413, "application/json", "{\"success\":false,\"error\":\"body too large\"}");
+          return;
+        default:
+          return;
       }
+      RequestBody *body = (RequestBody *)request->_tempObject;
+      uint32_t requestedAt = micros();
       
-      // Authentication
-      if (doc.containsKey("username")) {
-        config.setUsername(doc["username"].as<String>());
-      }
-      if (doc.containsKey("password")) {
-        config.setPassword(doc["password"].as<String>());
+      DynamicJsonDocument doc(2048);
+      if (deserializeJson(doc, body->bytes(), body->total) || !doc.is<JsonObject>()) {
+        request->send(400, "application/json", "{\"success\":false,\"error\":\"invalid JSON\"}");
+        return;
       }
       
-      // Complete setup
-      config.setFirstTimeSetup(false);
+      uint8_t changes = 0;
+      String rejected;
+      bool accepted = config.patchJson(doc.as<JsonObject>(), changes, rejected);
       
-      // Save configuration
-      if (config.saveConfig()) {
-        Serial.println("Configuration saved successfully");
+      DynamicJsonDocument reply(256);
+      reply["success"] = accepted;
+      if (accepted) {
+        reply["restart"] = !applyConfigChanges(changes, requestedAt);
       } else {
-        Serial.println("Failed to save configuration");
+        reply["rejected"] = rejected;
       }
+      String response;
+      serializeJson(reply, response);
+      request->send(accepted ? 200 : 400, "application/json", response);
       
-      // Send response
-      request->send(200, "text/plain", "Configuration saved. The device will restart.");
-      
-      // Short delay to ensure response is sent
-      delay(500);
-      
-      // Restart the device
-      ESP.restart();
+      // Reset client activity timer
+      wifiManager.resetClientActivityTimer();
     }
   );
   
   // IMPORTANT: Setup authentication handler for index.html
-  server.on("/index.html", HTTP_GET, [](AsyncWebServerRequest *request) {
+  route("/index.html", HTTP_GET, [](AsyncWebServerRequest *request) {
     // If we're in setup mode, redirect to setup page
     if (config.isFirstTimeSetup()) {
       request->redirect("/setup.html");
@@ -1188,15 +1752,17 @@ void setupWebServer() {
       return request->requestAuthentication();
     }
     
-    // If authenticated, serve the file
-    request->send(LittleFS, "/index.html", "text/html");
+    // If authenticated, serve the file, with the current state when possible
+    if (!sendIndexPage(request) && !sendAsset(request, "/index.html")) {
+      request->send(LittleFS, "/index.html", "text/html");
+    }
     
     // Reset client activity timer
     wifiManager.resetClientActivityTimer();
   });
   
   // Redirect root to either setup.html or index.html
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
+  route("/", HTTP_GET, [](AsyncWebServerRequest *request) {
     if (config.isFirstTimeSetup()) {
       request->redirect("/setup.html");
     } else {
@@ -1208,38 +1774,74 @@ void setupWebServer() {
   });
   
   // Handle captive portal detection files
-  server.on("/hotspot-detect.html", HTTP_GET, [](AsyncWebServerRequest *request) {
+  route("/hotspot-detect.html", HTTP_GET, [](AsyncWebServerRequest *request) {
     request->redirect("/");
     // Reset client activity timer
     wifiManager.resetClientActivityTimer();
   });
   
-  server.on("/generate_204", HTTP_GET, [](AsyncWebServerRequest *request) {
+  route("/generate_204", HTTP_GET, [](AsyncWebServerRequest *request) {
     request->redirect("/");
     wifiManager.resetClientActivityTimer();
   }); 
   
-  server.on("/connectivity-check.html", HTTP_GET, [](AsyncWebServerRequest *request) {
+  route("/connectivity-check.html", HTTP_GET, [](AsyncWebServerRequest *request) {
     request->redirect("/");
     wifiManager.resetClientActivityTimer();
   });
   
   // Additional captive portal detection handlers
-  server.on("/success.txt", HTTP_GET, [](AsyncWebServerRequest *request) {
+  route("/success.txt", HTTP_GET, [](AsyncWebServerRequest *request) {
     request->redirect("/");
     wifiManager.resetClientActivityTimer();
   });
   
-  server.on("/ncsi.txt", HTTP_GET, [](AsyncWebServerRequest *request) {
+  route("/ncsi.txt", HTTP_GET, [](AsyncWebServerRequest *request) {
     request->redirect("/");
     wifiManager.resetClientActivityTimer();
   });
 
+  // Event stream: a "state" event on connect, then one per change
+  if (!config.isFirstTimeSetup()) {
+    events.setAuthentication(config.getUsername().c_str(), config.getPassword().c_str());
+  }
+  events.onConnect([](AsyncEventSourceClient *client) {
+    SystemState state = systemState.read();
+    client->send(stateJsonCache.get(state)->json, "state", state.generation, 5000);
+    wifiManager.resetClientActivityTimer();
+    
+    // Start the countdown if watering is in progress
+    if (networkTaskHandle != NULL) {
+      xTaskNotifyGive(networkTaskHandle);
+    }
+  });
+  server.addHandler(&events);
+  
+  // Every other asset in the manifest, gzipped and cache-validated
+  // (/index.html keeps its login check above)
+  for (int i = 0; i < staticAssets.getCount(); i++) {
+    const char *url = staticAssets.getAsset(i).url;
+    route(url, HTTP_GET, [url](AsyncWebServerRequest *request) {
+      sendAsset(request, url);
+      wifiManager.resetClientActivityTimer();
+    });
+  }
+  
   // NOTE: Static file handler MUST be last!
-  // This allows all API endpoints defined above to be handled properly first
+  // This allows all API endpoints defined above to be handled properly first;
+  // it also serves a filesystem built without the asset manifest
   server.serveStatic("/", LittleFS, "/");
   
   // Start the server
   server.begin();
   Serial.println("Web server started");
+  
+  // Web handlers run on the AsyncTCP task, which the server just started;
+  // report its stack but not its CPU share
+  TaskHandle_t asyncTcpHandle = xTaskGetHandle("async_tcp");
+  if (asyncTcpHandle != NULL) {
+    taskMonitor.registerTask("async_tcp", asyncTcpHandle, false);
+  } else {
+    Serial.println("Task monitor: async_tcp task not found");
+  }
 }
\ No newline at end of file
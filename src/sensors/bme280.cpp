@@ -1,24 +1,158 @@
 #include "bme280.h"
 
-// Define the global BME280 object
-Adafruit_BME280 bme;
-
-bool bme280_init() {
-    bool status = bme.begin(0x76);
-    if (!status) {
-        Serial.println("Could not find a valid BME280 sensor, check wiring!");
-        status = bme.begin(0x77);
-        if (!status) {
-            return false;
+bool Bme280::begin() {
+    const uint8_t addresses[] = { 0x76, 0x77 };
+    address = 0;
+    for (uint8_t candidate : addresses) {
+        uint8_t id = 0;
+        if (hal::i2cReadRegisters(candidate, regChipId, &id, 1) && id == chipId) {
+            address = candidate;
+            break;
         }
     }
-    
-    bme.setSampling(Adafruit_BME280::MODE_FORCED,
-                    Adafruit_BME280::SAMPLING_X1,
-                    Adafruit_BME280::SAMPLING_X1,
-                    Adafruit_BME280::SAMPLING_X1,
-                    Adafruit_BME280::FILTER_OFF,
-                    Adafruit_BME280::STANDBY_MS_1000);
-    
+    if (address == 0) {
+        Serial.println("Could not find a valid BME280 sensor");
+        return false;
+    }
+
+    // Reset and wait for the NVM copy to finish
+    writeRegister(regReset, resetCommand);
+    uint8_t status = 0x01;
+    for (int i = 0; i < 10 && (status & 0x01); i++) {
+        hal::delay(2);
+        if (!hal::i2cReadRegisters(address, regStatus, &status, 1)) {
+            status = 0x01;
+        }
+    }
+
+    if (!readCalibration()) {
+        Serial.println("Failed to read BME280 calibration");
+        address = 0;
+        return false;
+    }
+
+    // Written in sleep mode; ctrl_hum takes effect with the next ctrl_meas write
+    bool ok = writeRegister(regConfig, filterCoefficient << 2) &&
+              writeRegister(regCtrlHum, humidityOversampling);
+
+    Serial.printf("BME280 found at address 0x%02X\n", address);
+    return ok;
+}
+
+bool Bme280::writeRegister(uint8_t reg, uint8_t value) {
+    uint8_t data[] = { reg, value };
+    return hal::i2cWrite(address, data, sizeof(data));
+}
+
+bool Bme280::readCalibration() {
+    uint8_t block1[26];
+    uint8_t block2[7];
+    if (!hal::i2cReadRegisters(address, regCalibration1, block1, sizeof(block1)) ||
+        !hal::i2cReadRegisters(address, regCalibration2, block2, sizeof(block2))) {
+        return false;
+    }
+    parseCalibration(block1, block2, calibration);
+    return calibration.t1 != 0 && calibration.p1 != 0;
+}
+
+void Bme280::parseCalibration(const uint8_t *block1, const uint8_t *block2, Calibration &cal) {
+    auto u16 = [](const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); };
+
+    cal.t1 = u16(block1 + 0);
+    cal.t2 = (int16_t)u16(block1 + 2);
+    cal.t3 = (int16_t)u16(block1 + 4);
+    cal.p1 = u16(block1 + 6);
+    cal.p2 = (int16_t)u16(block1 + 8);
+    cal.p3 = (int16_t)u16(block1 + 10);
+    cal.p4 = (int16_t)u16(block1 + 12);
+    cal.p5 = (int16_t)u16(block1 + 14);
+    cal.p6 = (int16_t)u16(block1 + 16);
+    cal.p7 = (int16_t)u16(block1 + 18);
+    cal.p8 = (int16_t)u16(block1 + 20);
+    cal.p9 = (int16_t)u16(block1 + 22);
+    cal.h1 = block1[25];   // 0xA1; 0xA0 is unused
+
+    // H4 and H5 are 12-bit values sharing 0xE5
+    cal.h2 = (int16_t)u16(block2 + 0);
+    cal.h3 = block2[2];
+    cal.h4 = (int16_t)((int8_t)block2[3] * 16 | (block2[4] & 0x0F));
+    cal.h5 = (int16_t)((int8_t)block2[5] * 16 | (block2[4] >> 4));
+    cal.h6 = (int8_t)block2[6];
+}
+
+bool Bme280::startForcedMeasurement() {
+    if (address == 0) {
+        return false;
+    }
+    return writeRegister(regCtrlMeas, temperatureOversampling << 5 | pressureOversampling << 2 | 0x01);
+}
+
+unsigned long Bme280::measurementTimeMs() {
+    // 1.25 ms + 2.3 ms per sample, + 0.575 ms each for pressure and humidity
+    unsigned long micros = 1250 +
+        2300 * (1UL << (temperatureOversampling - 1)) +
+        2300 * (1UL << (pressureOversampling - 1)) + 575 +
+        2300 * (1UL << (humidityOversampling - 1)) + 575;
+    return (micros + 999) / 1000;
+}
+
+bool Bme280::read(Measurement &measurement) {
+    uint8_t data[8];
+    if (address == 0 || !hal::i2cReadRegisters(address, regData, data, sizeof(data))) {
+        return false;
+    }
+
+    int32_t adcP = (int32_t)data[0] << 12 | data[1] << 4 | data[2] >> 4;
+    int32_t adcT = (int32_t)data[3] << 12 | data[4] << 4 | data[5] >> 4;
+    int32_t adcH = (int32_t)data[6] << 8 | data[7];
+
+    // Reset values, i.e. nothing measured yet
+    if (adcT == 0x80000 || adcP == 0x80000 || adcH == 0x8000) {
+        return false;
+    }
+
+    int32_t tFine;
+    measurement.temperature = compensateTemperature(calibration, adcT, tFine) / 100.0f;
+    measurement.pressure = compensatePressure(calibration, adcP, tFine) / 25600.0f;
+    measurement.humidity = compensateHumidity(calibration, adcH, tFine) / 1024.0f;
     return true;
-}
\ No newline at end of file
+}
+
+int32_t Bme280::compensateTemperature(const Calibration &cal, int32_t adcT, int32_t &tFine) {
+    int32_t var1 = (((adcT >> 3) - ((int32_t)cal.t1 << 1)) * (int32_t)cal.t2) >> 11;
+    int32_t var2 = (((((adcT >> 4) - (int32_t)cal.t1) * ((adcT >> 4) - (int32_t)cal.t1)) >> 12) *
+                    (int32_t)cal.t3) >> 14;
+    tFine = var1 + var2;
+    return (tFine * 5 + 128) >> 8;
+}
+
+uint32_t Bme280::compensatePressure(const Calibration &cal, int32_t adcP, int32_t tFine) {
+    int64_t var1 = (int64_t)tFine - 128000;
+    int64_t var2 = var1 * var1 * cal.p6;
+    var2 = var2 + ((var1 * cal.p5) * 131072);
+    var2 = var2 + ((int64_t)cal.p4 * 34359738368LL);
+    // Shifted, not divided, as in Bosch's code: a negative term rounds down
+    var1 = ((var1 * var1 * cal.p3) >> 8) + ((var1 * cal.p2) * 4096);
+    var1 = (((((int64_t)1) << 47) + var1) * cal.p1) >> 33;
+    if (var1 == 0) {
+        return 0;  // Avoid division by zero
+    }
+
+    int64_t p = 1048576 - adcP;
+    p = (((p << 31) - var2) * 3125) / var1;
+    var1 = ((int64_t)cal.p9 * (p >> 13) * (p >> 13)) >> 25;
+    var2 = ((int64_t)cal.p8 * p) >> 19;
+    p = ((p + var1 + var2) >> 8) + ((int64_t)cal.p7 << 4);
+    return (uint32_t)p;
+}
+
+uint32_t Bme280::compensateHumidity(const Calibration &cal, int32_t adcH, int32_t tFine) {
+    int32_t x = tFine - 76800;
+    x = (((((adcH << 14) - ((int32_t)cal.h4 << 20) - ((int32_t)cal.h5 * x)) + 16384) >> 15) *
+         (((((((x * (int32_t)cal.h6) >> 10) * (((x * (int32_t)cal.h3) >> 11) + 32768)) >> 10) +
+            2097152) * (int32_t)cal.h2 + 8192) >> 14));
+    x = x - (((((x >> 15) * (x >> 15)) >> 7) * (int32_t)cal.h1) >> 4);
+    x = x < 0 ? 0 : x;
+    x = x > 419430400 ? 419430400 : x;
+    return (uint32_t)(x >> 12);
+}
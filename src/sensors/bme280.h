@@ -1,14 +1,89 @@
 #ifndef BME280_H
 #define BME280_H
 
-#include <Wire.h>
-#include <Adafruit_Sensor.h>
-#include <Adafruit_BME280.h>
+#include <Arduino.h>
+#include "hal.h"
 
-// Global BME280 sensor instance
-extern Adafruit_BME280 bme;
+// BME280 driver over the HAL I2C bus, used on the device and, against a
+// simulated register file, in the native build.
+//
+// Calibration is read once at begin(). A measurement is one register
+// write to trigger it and one burst read of 0xF7..0xFE, which the sensor
+// shadows so pressure, temperature and humidity come from the same
+// conversion. Noise is reduced by the sensor's oversampling and IIR filter
+// rather than by repeated reads, and the raw values are compensated with
+// Bosch's integer formulas.
+class Bme280 {
+public:
+    struct Calibration {
+        uint16_t t1;
+        int16_t t2, t3;
+        uint16_t p1;
+        int16_t p2, p3, p4, p5, p6, p7, p8, p9;
+        uint8_t h1;
+        int16_t h2;
+        uint8_t h3;
+        int16_t h4, h5;
+        int8_t h6;
+    };
 
-// Function declarations only, no implementation
-bool bme280_init();
+    struct Measurement {
+        float temperature;   // °C
+        float humidity;      // %RH
+        float pressure;      // hPa
+    };
 
-#endif
\ No newline at end of file
+    // Register map
+    static const uint8_t regCalibration1 = 0x88;  // 26 bytes, T1..H1
+    static const uint8_t regChipId = 0xD0;
+    static const uint8_t regReset = 0xE0;
+    static const uint8_t regCalibration2 = 0xE1;  // 7 bytes, H2..H6
+    static const uint8_t regCtrlHum = 0xF2;
+    static const uint8_t regStatus = 0xF3;
+    static const uint8_t regCtrlMeas = 0xF4;
+    static const uint8_t regConfig = 0xF5;
+    static const uint8_t regData = 0xF7;           // 8 bytes, press/temp/hum
+    static const uint8_t chipId = 0x60;
+    static const uint8_t resetCommand = 0xB6;
+
+    // Oversampling settings are register codes: n gives 2^(n-1) samples.
+    // One forced measurement a minute, so the filter smooths across minutes.
+    static const uint8_t temperatureOversampling = 3;  // x4
+    static const uint8_t pressureOversampling = 5;     // x16
+    static const uint8_t humidityOversampling = 5;     // x16
+    static const uint8_t filterCoefficient = 1;        // IIR coefficient 2
+
+private:
+    uint8_t address = 0;
+    Calibration calibration;
+
+    bool writeRegister(uint8_t reg, uint8_t value);
+    bool readCalibration();
+
+public:
+    // Probe 0x76 and 0x77, reset, load the calibration and set up sampling
+    bool begin();
+
+    // Trigger one forced measurement; the sensor sleeps again afterwards
+    bool startForcedMeasurement();
+
+    // Worst-case conversion time for the oversampling above (datasheet 9.1)
+    static unsigned long measurementTimeMs();
+
+    // Read and compensate the last measurement; false on bus error or
+    // when the sensor has not measured since reset
+    bool read(Measurement &measurement);
+
+    bool isPresent() const { return address != 0; }
+    const Calibration &getCalibration() const { return calibration; }
+
+    // Parse the two calibration blocks as laid out in the NVM
+    static void parseCalibration(const uint8_t *block1, const uint8_t *block2, Calibration &calibration);
+
+    // Bosch reference compensation (datasheet 4.2.3)
+    static int32_t compensateTemperature(const Calibration &cal, int32_t adcT, int32_t &tFine);  // 0.01 °C
+    static uint32_t compensatePressure(const Calibration &cal, int32_t adcP, int32_t tFine);     // Pa, Q24.8
+    static uint32_t compensateHumidity(const Calibration &cal, int32_t adcH, int32_t tFine);     // %RH, Q22.10
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "sensor_acquisition.h"
+
+SensorAcquisition::SensorAcquisition(Bme280 &bme, SoilMoistureSensor &soil)
+    : bme(bme), soil(soil) {
+}
+
+void SensorAcquisition::start() {
+    if (state != IDLE) {
+        return; // Cycle already in progress
+    }
+
+    state = BME_TRIGGER;
+    deadline = hal::millis();
+    cycleStartMicros = hal::micros();
+    cycleNumber++;
+}
+
+bool SensorAcquisition::deadlineReached(unsigned long now) {
+    // Signed difference keeps this correct across hal::millis() rollover
+    return (long)(now - deadline) >= 0;
+}
+
+bool SensorAcquisition::poll() {
+    if (state == IDLE) {
+        return false;
+    }
+
+    unsigned long now = hal::millis();
+    if (!deadlineReached(now)) {
+        return false;
+    }
+
+    unsigned long stepStart = hal::micros();
+    bool completed = false;
+
+    switch (state) {
+        case BME_TRIGGER:
+            beginBme(now);
+            break;
+
+        case BME_READ:
+            finishBme(now, true);
+            break;
+
+        case SOIL_POWER_UP:
+            soil.beginBurst();
+            state = SOIL_SAMPLE;
+            break;
+
+        case SOIL_SAMPLE:
+            // The deadline stays passed, so the next chunk is due at once
+            if (soil.sampleBurst()) {
+                finishSoil(now);
+                completed = true;
+            }
+            break;
+
+        default:
+            state = IDLE;
+            break;
+    }
+
+    // hal::micros() wraps at 32 bits; where unsigned long is wider (the
+    // native sim) the difference must be cut back to 32 bits as well
+    unsigned long stepEnd = hal::micros();
+    lastStepMicros = (uint32_t)(stepEnd - stepStart);
+    if (lastStepMicros > maxStepMicros) {
+        maxStepMicros = lastStepMicros;
+    }
+    stepTimes.record(lastStepMicros);
+    if (completed) {
+        cycleTimes.record((uint32_t)(stepEnd - cycleStartMicros));
+    }
+
+    return completed;
+}
+
+void SensorAcquisition::beginBme(unsigned long now) {
+    // One forced measurement; the sensor does the averaging
+    if (bme.startForcedMeasurement()) {
+        state = BME_READ;
+        deadline = now + Bme280::measurementTimeMs();
+    } else {
+        Serial.println("Failed to perform forced measurement");
+        finishBme(now, false);
+    }
+}
+
+void SensorAcquisition::finishBme(unsigned long now, bool measured) {
+    Bme280::Measurement measurement;
+    bool valid = measured && bme.read(measurement);
+
+    // Keep the previous value for any channel whose filter drops the reading
+    pending.temperature = published.temperature;
+    pending.humidity = published.humidity;
+    pending.pressure = published.pressure;
+    if (valid) {
+        if (temperatureFilter.process(measurement.temperature)) {
+            pending.temperature = measurement.temperature;
+        }
+        if (humidityFilter.process(measurement.humidity)) {
+            pending.humidity = measurement.humidity;
+        }
+        if (pressureFilter.process(measurement.pressure)) {
+            pending.pressure = measurement.pressure;
+        }
+    }
+
+    beginSoil(now);
+}
+
+void SensorAcquisition::beginSoil(unsigned long now) {
+    // Power on the probe once for all samples
+    soil.powerOn();
+    state = SOIL_POWER_UP;
+    deadline = soil.hasPowerPin() ? now + soilPowerUpTime : now;
+}
+
+void SensorAcquisition::finishSoil(unsigned long now) {
+    SoilMoistureSensor::BurstReading burst;
+    bool valid = soil.finishBurst(burst);
+    soil.powerOff();
+    pending.soilValid = valid;
+
+    // Fall back to the dry value if the burst was mostly invalid
+    if (valid) {
+        pending.soilMoistureRaw = (int)lroundf(burst.raw);
+        pending.soilMillivolts = burst.millivolts;
+    } else {
+        Serial.printf("Soil probe: only %d of %d samples valid\n", burst.validSamples,
+                      (int)SoilMoistureSensor::burstSamples);
+        pending.soilMoistureRaw = soil.getDryValue();
+        pending.soilMillivolts = 0;
+    }
+    pending.soilMoisturePercent = soil.rawToPercentage(pending.soilMoistureRaw);
+    pending.completedAt = now;
+
+    published = pending;
+    hasPublished = true;
+    state = IDLE;
+}
+
+bool SensorAcquisition::isBusy() {
+    return state != IDLE;
+}
+
+unsigned long SensorAcquisition::msUntilNextStep() {
+    if (state == IDLE) {
+        return 0;
+    }
+
+    long remaining = (long)(deadline - hal::millis());
+    return (remaining > 0) ? remaining : 0;
+}
+
+bool SensorAcquisition::hasReadings() {
+    return hasPublished;
+}
+
+const SensorReadings &SensorAcquisition::getReadings() {
+    return published;
+}
+
+void SensorAcquisition::retain(Retained &retained) const {
+    retained.temperatureFilter = temperatureFilter;
+    retained.humidityFilter = humidityFilter;
+    retained.pressureFilter = pressureFilter;
+    retained.published = published;
+    retained.hasPublished = hasPublished;
+}
+
+void SensorAcquisition::restore(const Retained &retained) {
+    temperatureFilter = retained.temperatureFilter;
+    humidityFilter = retained.humidityFilter;
+    pressureFilter = retained.pressureFilter;
+    published = retained.published;
+    published.completedAt = 0;
+    hasPublished = retained.hasPublished;
+}
+
+unsigned long SensorAcquisition::getLastStepMicros() {
+    return lastStepMicros;
+}
+
+unsigned long SensorAcquisition::getMaxStepMicros() {
+    return maxStepMicros;
+}
+
+void SensorAcquisition::resetStepStats() {
+    lastStepMicros = 0;
+    maxStepMicros = 0;
+}
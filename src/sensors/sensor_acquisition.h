@@ -0,0 +1,127 @@
+#ifndef SENSOR_ACQUISITION_H
+#define SENSOR_ACQUISITION_H
+
+#include <Arduino.h>
+#include "hal.h"
+#include "soil_moisture.h"
+#include "bme280.h"
+#include "filters.h"
+#include "latency_histogram.h"
+
+// One complete set of readings, published when an acquisition cycle finishes
+struct SensorReadings {
+    float temperature = 0;
+    float humidity = 0;
+    float pressure = 0;
+    int soilMoistureRaw = 0;
+    int soilMillivolts = 0;
+    bool soilValid = false;        // False when the burst failed and raw is the dry fallback
+    float soilMoisturePercent = 0;
+    unsigned long completedAt = 0; // millis() when the set was published
+};
+
+// Incremental sensor acquisition engine.
+// Every call to poll() performs at most one short I2C or ADC step and then
+// returns; waits between steps are millis() deadlines instead of delay(),
+// so loop() keeps servicing DNS, touch and watering while a cycle runs.
+class SensorAcquisition {
+public:
+    // Longest a step should hold the calling task; the sim fails a run
+    // whose p99 step time exceeds it
+    static const unsigned long stepBudgetMicros = 1000;
+
+    // One BME280 value per cycle; isolated outliers against the last
+    // readings are replaced. Humidity has no hardware IIR, hence the EWMA.
+    typedef Pipeline<RangeGate<-40, 85>, Hampel<9>> TemperatureFilter;
+    typedef Pipeline<RangeGate<0, 100>, Hampel<9>, Ewma<1, 2>> HumidityFilter;
+    typedef Pipeline<RangeGate<300, 1100>, Hampel<9>> PressureFilter;
+
+    // Filter windows and the last published set, kept across deep sleep
+    // so a wake neither restarts the filters nor reports zeros
+    struct Retained {
+        TemperatureFilter temperatureFilter;
+        HumidityFilter humidityFilter;
+        PressureFilter pressureFilter;
+        SensorReadings published;
+        bool hasPublished;
+    };
+
+    enum State {
+        IDLE,
+        BME_TRIGGER,      // Next step starts a forced BME280 measurement
+        BME_READ,         // Measurement running; next step reads all three values
+        SOIL_POWER_UP,    // Probe powered, waiting for it to stabilise
+        SOIL_SAMPLE       // Each step takes one chunk of the ADC burst
+    };
+
+private:
+    Bme280 &bme;
+    SoilMoistureSensor &soil;
+
+    State state = IDLE;
+    unsigned long deadline = 0;
+    uint32_t cycleNumber = 0;
+
+    TemperatureFilter temperatureFilter;
+    HumidityFilter humidityFilter;
+    PressureFilter pressureFilter;
+
+    SensorReadings pending;
+    SensorReadings published;
+    bool hasPublished = false;
+
+    // Per-step timing, so the loop budget can be checked at runtime
+    unsigned long lastStepMicros = 0;
+    unsigned long maxStepMicros = 0;
+    LatencyHistogram stepTimes;
+    LatencyHistogram cycleTimes;        // From start() to the published set
+    unsigned long cycleStartMicros = 0;
+
+    // The BME280 averages in hardware (oversampling), so one measurement
+    // per cycle; the soil probe is read in one ADC burst once it has
+    // settled, split over back-to-back steps
+    const unsigned long soilPowerUpTime = 500;   // ms for probe to stabilise
+
+    bool deadlineReached(unsigned long now);
+    void beginBme(unsigned long now);
+    void finishBme(unsigned long now, bool measured);
+    void beginSoil(unsigned long now);
+    void finishSoil(unsigned long now);
+
+public:
+    SensorAcquisition(Bme280 &bme, SoilMoistureSensor &soil);
+
+    // Start a new cycle; ignored if one is already running
+    void start();
+
+    // Advance the cycle by at most one step.
+    // Returns true exactly once per cycle, when a new set has been published.
+    bool poll();
+
+    bool isBusy();
+
+    // Cycles started since boot; the running or last published set is
+    // from cycle getCycleNumber()
+    uint32_t getCycleNumber() const { return cycleNumber; }
+
+    // Milliseconds until the next step is due (0 if due now or idle)
+    unsigned long msUntilNextStep();
+    bool hasReadings();
+    const SensorReadings &getReadings();
+
+    // Copy state out before sleeping and back in after a wake; completedAt
+    // refers to the old boot's millis() and is cleared on restore
+    void retain(Retained &retained) const;
+    void restore(const Retained &retained);
+
+    // Step timing statistics (microseconds)
+    unsigned long getLastStepMicros();
+    unsigned long getMaxStepMicros();
+    void resetStepStats();
+
+    // Every step and every cycle since boot; readable from any task
+    const LatencyHistogram &getStepTimes() const { return stepTimes; }
+    const LatencyHistogram &getCycleTimes() const { return cycleTimes; }
+};
+
+#endif
@@ -1,39 +1,77 @@
 #include "soil_moisture.h"
+#include "filters.h"
+#include <algorithm>
+
+SoilMoistureSensor::SoilMoistureSensor() {
+    buildLut();
+}
 
 void SoilMoistureSensor::init() {
     if (sensorPin >= 0) {
-        pinMode(sensorPin, INPUT);
+        hal::pinMode(sensorPin, INPUT);
     }
     
     if (powerPin >= 0) {
-        pinMode(powerPin, OUTPUT);
-        digitalWrite(powerPin, LOW); // Start with power off
+        hal::pinMode(powerPin, OUTPUT);
+        hal::digitalWrite(powerPin, LOW); // Start with power off
     }
 }
 
 // New method to read raw value without power management
 int SoilMoistureSensor::readRawWithoutPower() {
     // Just read the analog value without power management
-    int value = analogRead(sensorPin);
+    int value = hal::analogRead(sensorPin);
     yield(); // Add yield after reading
     return value;
 }
 
+void SoilMoistureSensor::beginBurst() {
+    burstCount = 0;
+}
+
+// Next chunk of the burst; true once it is complete (or a read came up short)
+bool SoilMoistureSensor::sampleBurst() {
+    size_t count = std::min(burstChunk, burstSamples - burstCount);
+    size_t taken = hal::analogReadBurst(sensorPin, samples + burstCount, count);
+    burstCount += taken;
+    return taken < count || burstCount >= burstSamples;
+}
+
+// Rail readings (open or shorted probe) are dropped; the interquartile
+// mean of the rest rejects spikes and averages the noise down. Fails if
+// fewer than half of a full burst are valid.
+bool SoilMoistureSensor::finishBurst(BurstReading &reading) {
+    size_t valid = 0;
+    for (size_t i = 0; i < burstCount; i++) {
+        if (samples[i] > 0 && samples[i] < 4095) {
+            samples[valid++] = samples[i];
+        }
+    }
+    reading.validSamples = valid;
+    if (valid < burstSamples / 2) {
+        return false;
+    }
+
+    reading.raw = trimmedMean(samples, valid, valid / 4);
+    reading.millivolts = hal::analogToMillivolts(sensorPin, (int)lroundf(reading.raw));
+    return true;
+}
+
 int SoilMoistureSensor::readRaw() {
     // Power on the sensor if a power pin is configured
     if (powerPin >= 0) {
-        digitalWrite(powerPin, HIGH);
-        delay(500); // Increase to 750-1000ms for more reliable readings
+        hal::digitalWrite(powerPin, HIGH);
+        hal::delay(500); // Increase to 750-1000ms for more reliable readings
         yield(); // Add yield after delay to prevent watchdog timeout
     }
     
     // Read the analog value
-    int value = analogRead(sensorPin);
+    int value = hal::analogRead(sensorPin);
     yield(); // Add yield after reading
     
     // Turn off power to save energy
     if (powerPin >= 0) {
-        digitalWrite(powerPin, LOW);
+        hal::digitalWrite(powerPin, LOW);
     }
     
     return value;
@@ -43,107 +81,50 @@ float SoilMoistureSensor::readPercentage() {
     int rawValue = readRaw();
     yield(); // Add yield after raw reading
     
-    // Map the raw value to 0-100% range
-    // Note: higher raw value = drier soil, so we invert the logic
-    float percentage = map(rawValue, wetValue, dryValue, 100, 0);
-    
-    // Constrain to valid range
-    if (percentage > 100) percentage = 100;
-    if (percentage < 0) percentage = 0;
-    
-    return percentage;
+    return rawToPercentage(rawValue);
 }
 
-float SoilMoistureSensor::readAveragedPercentage() {
-    Serial.println("Taking averaged soil moisture readings...");
-    
-    float sum = 0;
-    int validReadings = 0;
-    
-    for (int i = 0; i < numReadings; i++) {
-        float reading = readPercentage();
-        yield(); // Add yield after each reading
-        
-        // Only include readings within valid range
-        if (reading >= 0 && reading <= 100) {
-            sum += reading;
-            validReadings++;
-            Serial.printf("Reading %d: %.1f%%\n", i + 1, reading);
-        } else {
-            Serial.printf("Reading %d: Invalid value (%.1f), ignored\n", i + 1, reading);
-        }
-        
-        // Wait between readings if not the last reading
-        if (i < numReadings - 1) {
-            delay(readingInterval);
-            yield(); // Add yield after delay
-        }
-    }
-    
-    // Calculate average (or return 0 if no valid readings)
-    float average = (validReadings > 0) ? (sum / validReadings) : 0;
-    Serial.printf("Average soil moisture: %.1f%% (from %d valid readings)\n", 
-                  average, validReadings);
-    
-    return average;
+float SoilMoistureSensor::rawToPercentage(int rawValue) {
+    if (rawValue < 0) rawValue = 0;
+    if (rawValue >= adcLevels) rawValue = adcLevels - 1;
+    return percentLut[rawValue] / (float)lutScale;
 }
 
-int SoilMoistureSensor::readAveragedRaw() {
-    Serial.println("Taking averaged raw soil moisture readings...");
-    
-    // Power on the sensor ONCE at the beginning
-    if (powerPin >= 0) {
-        digitalWrite(powerPin, HIGH);
-        
-        // Break up the 500ms delay into smaller chunks with yield calls
-        Serial.println("Powering up soil moisture sensor...");
-        const int smallDelay = 50; // 50ms chunks
-        for (int i = 0; i < 10; i++) { // 10 * 50ms = 500ms
-            delay(smallDelay);
-            yield();
-        }
-        Serial.println("Sensor powered up, taking readings...");
+// Linear between neighbouring calibration points, flat beyond the outer
+// ones, clamped to 0-100 %. Higher raw means drier soil for the usual
+// capacitive probe, but the curve only needs distinct raw values.
+void SoilMoistureSensor::buildLut() {
+    SoilCalibrationPoint points[maxCalibrationPoints];
+    int count = std::min(curveCount, (int)maxCalibrationPoints);
+    if (count >= 2) {
+        std::copy(curve, curve + count, points);
+    } else {
+        points[0] = { wetValue, 100 };
+        points[1] = { dryValue, 0 };
+        count = 2;
     }
-    
-    long sum = 0;
-    int validReadings = 0;
-    
-    for (int i = 0; i < numReadings; i++) {
-        yield(); // Add yield before each reading
-        
-        // Use readRawWithoutPower() since the sensor is already on
-        int reading = readRawWithoutPower();
-        yield(); // Add yield after reading
-        
-        // Use a simple validity check (non-zero and within ADC range)
-        if (reading > 0 && reading < 4096) {
-            sum += reading;
-            validReadings++;
-            Serial.printf("Raw reading %d: %d\n", i + 1, reading);
-        } else {
-            Serial.printf("Raw reading %d: Invalid value (%d), ignored\n", i + 1, reading);
+    std::sort(points, points + count,
+              [](const SoilCalibrationPoint &a, const SoilCalibrationPoint &b) { return a.raw < b.raw; });
+
+    int segment = 0;
+    for (int raw = 0; raw < adcLevels; raw++) {
+        while (segment < count - 2 && raw >= points[segment + 1].raw) {
+            segment++;
         }
-        
-        // Wait between readings if not the last reading
-        if (i < numReadings - 1) {
-            // Smaller delay between readings
-            delay(readingInterval);
-            yield();
+        const SoilCalibrationPoint &low = points[segment];
+        const SoilCalibrationPoint &high = points[segment + 1];
+
+        float percent;
+        if (raw <= low.raw) {
+            percent = low.percent;
+        } else if (raw >= high.raw || high.raw == low.raw) {
+            percent = high.percent;
+        } else {
+            percent = low.percent + (high.percent - low.percent) * (raw - low.raw) / (high.raw - low.raw);
         }
+        percent = constrain(percent, 0.0f, 100.0f);
+        percentLut[raw] = (uint16_t)lroundf(percent * lutScale);
     }
-    
-    // Power off the sensor at the end
-    if (powerPin >= 0) {
-        digitalWrite(powerPin, LOW);
-        Serial.println("Soil moisture sensor powered down");
-    }
-    
-    // Calculate average (or return max value if no valid readings)
-    int average = (validReadings > 0) ? (sum / validReadings) : dryValue;
-    Serial.printf("Average raw soil moisture: %d (from %d valid readings)\n", 
-                 average, validReadings);
-    
-    return average;
 }
 
 float SoilMoistureSensor::temperatureCompensation(float moisture, float temperature) {
@@ -169,12 +150,40 @@ float SoilMoistureSensor::temperatureCompensation(float moisture, float temperat
     return compensatedMoisture;
 }
 
+void SoilMoistureSensor::powerOn() {
+    if (powerPin >= 0) {
+        hal::digitalWrite(powerPin, HIGH);
+    }
+}
+
+void SoilMoistureSensor::powerOff() {
+    if (powerPin >= 0) {
+        hal::digitalWrite(powerPin, LOW);
+    }
+}
+
+bool SoilMoistureSensor::hasPowerPin() {
+    return powerPin >= 0;
+}
+
+int SoilMoistureSensor::getDryValue() {
+    return dryValue;
+}
+
 void SoilMoistureSensor::calibrateDry(int value) {
     dryValue = value;
+    buildLut();
 }
 
 void SoilMoistureSensor::calibrateWet(int value) {
     wetValue = value;
+    buildLut();
+}
+
+void SoilMoistureSensor::setCalibrationCurve(const SoilCalibrationPoint *points, int count) {
+    curveCount = std::max(0, std::min(count, (int)maxCalibrationPoints));
+    std::copy(points, points + curveCount, curve);
+    buildLut();
 }
 
 void SoilMoistureSensor::setSensorPin(int pin) { 
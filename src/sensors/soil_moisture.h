@@ -2,31 +2,74 @@
 #define SOIL_MOISTURE_H
 
 #include <Arduino.h>
+#include "hal.h"
+
+// Raw reading of the probe at a known moisture, captured on site
+struct SoilCalibrationPoint {
+    int raw;
+    float percent;
+};
 
 class SoilMoistureSensor {
+public:
+    static const int maxCalibrationPoints = 8;
+    static const int adcLevels = 4096;
+    static const int lutScale = 100;   // LUT entries are in 1/100 %
+
+    // Conversions per reading, taken burstChunk at a time (about 20 us
+    // each) so no acquisition step holds the io task for a millisecond
+    static const size_t burstSamples = 256;
+    static const size_t burstChunk = 32;
+
+    struct BurstReading {
+        float raw;          // Interquartile mean of the valid samples
+        int millivolts;     // Calibrated probe voltage
+        int validSamples;
+    };
+
 private:
     int sensorPin = -1;
     int powerPin = -1;
     int wetValue = 815;   // Default calibration value for wet soil
     int dryValue = 2350;   // Default calibration value for dry soil
-    const int numReadings = 5;        // Number of readings to average
-    const int readingInterval = 100;  // ms between readings
+    uint16_t samples[burstSamples];
+    size_t burstCount = 0;
+
+    // Optional multi-point curve; without one, wet and dry are its two points
+    SoilCalibrationPoint curve[maxCalibrationPoints];
+    int curveCount = 0;
+
+    // Percentage for every raw value, rebuilt when the calibration changes
+    uint16_t percentLut[adcLevels];
+    void buildLut();
 
 public:
-    SoilMoistureSensor() = default;
+    SoilMoistureSensor();
     
     // Function declarations only (no implementations)
     void init();
     int readRaw();
     int readRawWithoutPower();
+    
+    // A burst in steps, with the probe powered: beginBurst(), then
+    // sampleBurst() until it returns true, then finishBurst()
+    void beginBurst();
+    bool sampleBurst();
+    bool finishBurst(BurstReading &reading);
     float readPercentage();
-    float readAveragedPercentage();
-    int readAveragedRaw();
     float temperatureCompensation(float moisture, float temperature);
     
+    // Step-wise access for non-blocking acquisition
+    void powerOn();
+    void powerOff();
+    bool hasPowerPin();
+    float rawToPercentage(int rawValue);
+    int getDryValue();
+    
     // Calibration support
     void calibrateDry(int value);
     void calibrateWet(int value);
+    void setCalibrationCurve(const SoilCalibrationPoint *points, int count);
     
     // Pin configuration
     void setSensorPin(int pin);
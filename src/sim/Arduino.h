@@ -0,0 +1,119 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// Arduino core subset for the native build.
+// Only language-level helpers live here (String, Serial, map, yield);
+// hardware access goes through hal.h, which the simulator implements.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define F(string_literal) (string_literal)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+using std::isnan;
+
+class String : public std::string {
+public:
+    String() {}
+    String(const char *value) : std::string(value ? value : "") {}
+    String(const std::string &value) : std::string(value) {}
+    String(int value) : std::string(std::to_string(value)) {}
+    String(unsigned int value) : std::string(std::to_string(value)) {}
+    String(long value) : std::string(std::to_string(value)) {}
+    String(unsigned long value) : std::string(std::to_string(value)) {}
+    String(float value, unsigned int decimals = 2) : std::string(format(value, decimals)) {}
+    String(double value, unsigned int decimals = 2) : std::string(format(value, decimals)) {}
+
+    unsigned int length() const { return (unsigned int)size(); }
+    bool concat(const char *value) { append(value ? value : ""); return true; }
+    bool concat(char value) { push_back(value); return true; }
+    bool reserve(unsigned int capacity) { std::string::reserve(capacity); return true; }
+
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return (float)atof(c_str()); }
+
+    String substring(unsigned int from) const {
+        return from < size() ? String(substr(from)) : String();
+    }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) { unsigned int t = from; from = to; to = t; }
+        return from < size() ? String(substr(from, to - from)) : String();
+    }
+
+    int indexOf(char value, unsigned int from = 0) const {
+        size_t pos = find(value, from);
+        return pos == npos ? -1 : (int)pos;
+    }
+    int indexOf(const char *value, unsigned int from = 0) const {
+        size_t pos = find(value, from);
+        return pos == npos ? -1 : (int)pos;
+    }
+
+private:
+    static std::string format(double value, unsigned int decimals) {
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+        return buffer;
+    }
+};
+
+// Serial console mapped to stdout; the simulator can silence it for speed
+class SimSerial {
+public:
+    bool enabled = true;
+
+    void begin(unsigned long baud) { (void)baud; }
+
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        if (!enabled) return 0;
+        va_list args;
+        va_start(args, format);
+        int written = vprintf(format, args);
+        va_end(args);
+        return written;
+    }
+
+    void print(const char *value) { if (enabled) fputs(value, stdout); }
+    void print(const String &value) { print(value.c_str()); }
+    void print(char value) { if (enabled) putchar(value); }
+    void print(int value) { printf("%d", value); }
+    void print(unsigned int value) { printf("%u", value); }
+    void print(long value) { printf("%ld", value); }
+    void print(unsigned long value) { printf("%lu", value); }
+    void print(double value) { printf("%.2f", value); }
+
+    void println() { print("\n"); }
+    template <typename T>
+    void println(const T &value) { print(value); print("\n"); }
+};
+
+extern SimSerial Serial;
+
+inline void yield() {}
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+template <typename T, typename L, typename H>
+inline T constrain(T value, L low, H high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+#endif
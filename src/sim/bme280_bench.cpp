@@ -0,0 +1,128 @@
+#include "bme280_bench.h"
+#include <chrono>
+#include "sim.h"
+#include "sim_bme280.h"
+
+// Datasheet floating-point compensation (section 8.1)
+static double referenceTemperature(const Bme280::Calibration &cal, int32_t adcT, double &tFine) {
+    double var1 = (adcT / 16384.0 - cal.t1 / 1024.0) * cal.t2;
+    double var2 = (adcT / 131072.0 - cal.t1 / 8192.0) * (adcT / 131072.0 - cal.t1 / 8192.0) * cal.t3;
+    tFine = var1 + var2;
+    return (var1 + var2) / 5120.0;
+}
+
+static double referencePressure(const Bme280::Calibration &cal, int32_t adcP, double tFine) {
+    double var1 = tFine / 2.0 - 64000.0;
+    double var2 = var1 * var1 * cal.p6 / 32768.0;
+    var2 = var2 + var1 * cal.p5 * 2.0;
+    var2 = var2 / 4.0 + cal.p4 * 65536.0;
+    var1 = (cal.p3 * var1 * var1 / 524288.0 + cal.p2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * cal.p1;
+    if (var1 == 0.0) {
+        return 0;
+    }
+    double p = 1048576.0 - adcP;
+    p = (p - var2 / 4096.0) * 6250.0 / var1;
+    var1 = cal.p9 * p * p / 2147483648.0;
+    var2 = p * cal.p8 / 32768.0;
+    return p + (var1 + var2 + cal.p7) / 16.0;
+}
+
+static double referenceHumidity(const Bme280::Calibration &cal, int32_t adcH, double tFine) {
+    double h = tFine - 76800.0;
+    h = (adcH - (cal.h4 * 64.0 + cal.h5 / 16384.0 * h)) *
+        (cal.h2 / 65536.0 * (1.0 + cal.h6 / 67108864.0 * h * (1.0 + cal.h3 / 67108864.0 * h)));
+    h = h * (1.0 - cal.h1 * h / 524288.0);
+    return std::min(std::max(h, 0.0), 100.0);
+}
+
+int checkBme280Compensation() {
+    const Bme280::Calibration &cal = SimBme280::calibration();
+    int mismatches = 0;
+
+    // Datasheet example: adc_T 519888 -> 25.08 °C, adc_P 415148 -> 100653.27 Pa
+    int32_t tFine;
+    int32_t temperature = Bme280::compensateTemperature(cal, 519888, tFine);
+    uint32_t pressure = Bme280::compensatePressure(cal, 415148, tFine);
+    if (temperature != 2508 || tFine != 128422 || fabs(pressure / 256.0 - 100653.27) > 0.03) {
+        printf("BME280 datasheet example: %ld (t_fine %ld), %lu Pa/256\n",
+               (long)temperature, (long)tFine, (unsigned long)pressure);
+        mismatches++;
+    }
+
+    // Below 25 °C var1 is negative, and with a negative P3 so is its square
+    // term. Bosch's integer code shifts it, rounding down; dividing rounds
+    // toward zero and comes out one LSB low for this part and reading.
+    Bme280::Calibration negative = cal;
+    negative.p1 = 36295;
+    negative.p3 = -3024;
+    temperature = Bme280::compensateTemperature(negative, 400120, tFine);
+    pressure = Bme280::compensatePressure(negative, 391000, tFine);
+    if (temperature != -1261 || tFine != -64542 || pressure != 25581223) {
+        printf("BME280 negative-term vector: %ld (t_fine %ld), %lu Pa/256, expected -1261 (-64542), 25581223\n",
+               (long)temperature, (long)tFine, (unsigned long)pressure);
+        mismatches++;
+    }
+
+    // Sweep the operating range against the floating-point formulas
+    double maxErrorT = 0, maxErrorP = 0, maxErrorH = 0;
+    for (int32_t adcT = 380000; adcT <= 640000; adcT += 2600) {
+        double referenceFine;
+        double expectedT = referenceTemperature(cal, adcT, referenceFine);
+        int32_t actualT = Bme280::compensateTemperature(cal, adcT, tFine);
+        maxErrorT = std::max(maxErrorT, fabs(actualT / 100.0 - expectedT));
+
+        for (int32_t adcP = 250000; adcP <= 600000; adcP += 3500) {
+            double expectedP = referencePressure(cal, adcP, referenceFine);
+            if (expectedP >= 30000 && expectedP <= 110000) {
+                maxErrorP = std::max(maxErrorP, fabs(Bme280::compensatePressure(cal, adcP, tFine) / 256.0 - expectedP));
+            }
+        }
+        for (int32_t adcH = 20000; adcH <= 50000; adcH += 300) {
+            double expectedH = referenceHumidity(cal, adcH, referenceFine);
+            maxErrorH = std::max(maxErrorH, fabs(Bme280::compensateHumidity(cal, adcH, tFine) / 1024.0 - expectedH));
+        }
+    }
+    if (maxErrorT > 0.01 || maxErrorP > 0.25 || maxErrorH > 0.02) {
+        printf("BME280 compensation off the reference: %.4f °C, %.3f Pa, %.4f %%RH\n",
+               maxErrorT, maxErrorP, maxErrorH);
+        mismatches++;
+    }
+    return mismatches;
+}
+
+void benchBme280() {
+    Bme280 sensor;
+    if (!sensor.begin()) {
+        printf("BME280: no simulated sensor\n");
+        return;
+    }
+
+    // Bus traffic of one measurement as the acquisition engine makes it
+    uint32_t transactionsBefore = sim::i2cTransactionCount();
+    Bme280::Measurement measurement;
+    sensor.startForcedMeasurement();
+    sensor.read(measurement);
+    uint32_t transactions = sim::i2cTransactionCount() - transactionsBefore;
+
+    // Compensation cost alone
+    const Bme280::Calibration &cal = sensor.getCalibration();
+    const int iterations = 1000000;
+    volatile uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        int32_t tFine;
+        int32_t adcT = 500000 + (i & 0xFFFF);
+        sink += Bme280::compensateTemperature(cal, adcT, tFine);
+        sink += Bme280::compensatePressure(cal, 415148 + (i & 0xFFF), tFine);
+        sink += Bme280::compensateHumidity(cal, 30000 + (i & 0xFFF), tFine);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("BME280 driver:\n");
+    printf("  per measurement: %lu I2C transactions, 8-byte burst read, %lu ms conversion\n",
+           (unsigned long)transactions, Bme280::measurementTimeMs());
+    printf("  compensation:    %.0f ns for T, P and H (host)\n", seconds * 1e9 / iterations);
+    printf("  last reading:    %.2f °C, %.2f %%RH, %.2f hPa\n",
+           measurement.temperature, measurement.humidity, measurement.pressure);
+}
@@ -0,0 +1,13 @@
+#ifndef BME280_BENCH_H
+#define BME280_BENCH_H
+
+// Check the driver's integer compensation against Bosch's reference
+// values: the datasheet example for temperature and pressure, and the
+// datasheet's floating-point formulas over the sensor's range for all
+// three. Returns the number of mismatches.
+int checkBme280Compensation();
+
+// Time one measurement through the driver and count its I2C transactions
+void benchBme280();
+
+#endif
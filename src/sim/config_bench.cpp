@@ -0,0 +1,304 @@
+#include "config_bench.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static const char *checkPaths[2] = { "/config_check.a", "/config_check.b" };
+
+struct CheckRecord {
+    uint32_t value;
+    char text[12];
+};
+
+// Version 2 of CheckRecord adds a field after the old ones
+struct CheckRecordV2 {
+    uint32_t value;
+    char text[12];
+    uint32_t added;
+};
+
+static size_t migrateCheckRecord(uint8_t *record, size_t size) {
+    if (size != sizeof(CheckRecord)) {
+        return 0;
+    }
+    uint32_t added = 7;
+    memcpy(record + size, &added, sizeof(added));
+    return sizeof(CheckRecordV2);
+}
+
+// Keep the first half of a slot, as a power cut mid-write would
+static void tearSlot(int slot) {
+    uint8_t buffer[sizeof(ConfigSlotHeader) + ConfigStore::maxRecordSize];
+    size_t length = 0;
+    hal::fsReadFile(checkPaths[slot], buffer, sizeof(buffer), &length);
+    hal::fsWriteFile(checkPaths[slot], buffer, length / 2);
+}
+
+static uint32_t loadValue(ConfigStore &store) {
+    CheckRecord record = { 0, "" };
+    return store.load(&record, sizeof(record)) ? record.value : 0;
+}
+
+int checkConfigStore() {
+    int failures = 0;
+    ConfigStore store(checkPaths[0], checkPaths[1], 1);
+    store.erase();
+
+    CheckRecord first = { 1, "first" };
+    CheckRecord second = { 2, "second" };
+    CheckRecord third = { 3, "third" };
+    store.commit(&first, sizeof(first));
+    store.commit(&second, sizeof(second));
+    ConfigStore reader(checkPaths[0], checkPaths[1], 1);
+    if (loadValue(reader) != 2) {
+        printf("Config store: newest commit not loaded\n");
+        failures++;
+    }
+
+    // An unchanged record is not written again
+    uint32_t sequence = reader.getSequence();
+    reader.commit(&second, sizeof(second));
+    if (reader.getSequence() != sequence) {
+        printf("Config store: unchanged record rewritten\n");
+        failures++;
+    }
+
+    // A torn commit leaves the previous record, and the next commit
+    // replaces the torn slot rather than the intact one
+    reader.commit(&third, sizeof(third));
+    int torn = reader.getActiveSlot();
+    tearSlot(torn);
+    if (loadValue(reader) != 2) {
+        printf("Config store: torn commit lost the previous record\n");
+        failures++;
+    }
+    reader.commit(&third, sizeof(third));
+    if (reader.getActiveSlot() != torn || loadValue(reader) != 3) {
+        printf("Config store: commit after a torn write went to the wrong slot\n");
+        failures++;
+    }
+
+    // A flipped bit fails the CRC
+    uint8_t buffer[sizeof(ConfigSlotHeader) + ConfigStore::maxRecordSize];
+    size_t length = 0;
+    hal::fsReadFile(checkPaths[torn], buffer, sizeof(buffer), &length);
+    buffer[length - 1] ^= 0x10;
+    hal::fsWriteFile(checkPaths[torn], buffer, length);
+    if (loadValue(reader) != 2) {
+        printf("Config store: corrupted slot accepted\n");
+        failures++;
+    }
+
+    // Version 1 records come up through the migration hook
+    static const ConfigStore::Migration migrations[] = { migrateCheckRecord };
+    ConfigStore upgraded(checkPaths[0], checkPaths[1], 2, migrations);
+    CheckRecordV2 migrated = {};
+    if (!upgraded.load(&migrated, sizeof(migrated)) || migrated.value != 2 || migrated.added != 7 ||
+        strcmp(migrated.text, "second") != 0) {
+        printf("Config store: migration from version 1 failed\n");
+        failures++;
+    }
+
+    // Newer records are not read by older firmware
+    upgraded.commit(&migrated, sizeof(migrated));
+    ConfigStore older(checkPaths[0], checkPaths[1], 1);
+    if (loadValue(older) != 2) {
+        printf("Config store: version 2 record read as version 1\n");
+        failures++;
+    }
+    store.erase();
+
+    // Export and import carry every setting
+    Config exported;
+    exported.setDeviceName("Allotment 7");
+    exported.setPassword("a password of some length");
+    exported.setRelay3Pin(14);
+    exported.setRelay4Name("Valve");
+    exported.setWateringStartHour(18);
+    exported.setWateringStartMinute(30);
+    exported.setSoilMoistureThreshold(37.5f);
+    exported.setDutyCycleMode(true);
+    exported.addSoilCalibrationPoint(2400, 0);
+    exported.addSoilCalibrationPoint(900, 100);
+    DynamicJsonDocument doc(2048);
+    exported.exportJson(doc);
+    Config imported;
+    imported.importJson(doc);
+    if (imported.getDeviceName() != "Allotment 7" || imported.getPassword() != "a password of some length" ||
+        imported.getRelay3Pin() != 14 || imported.getRelay4Name() != "Valve" ||
+        imported.getWateringStartHour() != 18 || imported.getWateringStartMinute() != 30 ||
+        imported.getSoilMoistureThreshold() != 37.5f || !imported.isDutyCycleMode() ||
+        imported.getSoilCalibrationCount() != 2) {
+        printf("Config: JSON export/import round trip lost settings\n");
+        failures++;
+    }
+    SoilCalibrationPoint curve[SoilMoistureSensor::maxCalibrationPoints];
+    if (imported.getSoilCalibration(curve) != 2 || curve[1].raw != 900) {
+        printf("Config: JSON export/import round trip lost the calibration curve\n");
+        failures++;
+    }
+
+    // Strings longer than their field are cut, not overrun
+    imported.setDeviceName("A device name well beyond the thirty-two bytes an SSID allows");
+    if (imported.getDeviceName().length() != 32) {
+        printf("Config: long device name not truncated to 32 bytes\n");
+        failures++;
+    }
+    return failures;
+}
+
+int checkConfigSchema() {
+    int failures = 0;
+    for (int i = 0; i < configFieldCount; i++) {
+        const char *key = configFields[i].key;
+        if (findConfigField(key, strlen(key)) != &configFields[i]) {
+            printf("Config schema: key %s not dispatched to its field\n", key);
+            failures++;
+        }
+    }
+    const char *unknown[] = { "", "relay5Pin", "deviceNam", "deviceNames", "soilCalibration", "date" };
+    for (const char *key : unknown) {
+        if (findConfigField(key, strlen(key)) != NULL) {
+            printf("Config schema: unknown key '%s' matched a field\n", key);
+            failures++;
+        }
+    }
+    // Keys need not be NUL-terminated
+    if (findConfigField("touchPinX", 8) == NULL) {
+        printf("Config schema: key given by length not found\n");
+        failures++;
+    }
+
+    Config config;
+    config.setWateringStartMinute(45);
+    if (!config.setField("wateringTimeStart", 17, "6") || config.getWateringStartHour() != 6 ||
+        config.getWateringStartMinute() != 0) {
+        printf("Config schema: legacy wateringTimeStart did not set the hour and clear the minute\n");
+        failures++;
+    }
+    if (!config.setField("waterAtPercent", 14, "42.5") || config.getSoilMoistureThreshold() != 42.5f) {
+        printf("Config schema: legacy waterAtPercent did not set the threshold\n");
+        failures++;
+    }
+    if (config.setField("relay2Pin", 9, "99") || config.setField("wateringEndMinute", 17, "abc") ||
+        config.getRelay2Pin() != 26 || config.getWateringEndMinute() != 0) {
+        printf("Config schema: out-of-range or malformed value accepted\n");
+        failures++;
+    }
+    if (config.setField("isFirstRun", 10, "0") || !config.isFirstTimeSetup()) {
+        printf("Config schema: internal field written through the API\n");
+        failures++;
+    }
+
+    // JSON values, as the setup page posts them (NaN becomes null)
+    DynamicJsonDocument body(512);
+    deserializeJson(body, "{\"wateringDuration\":90,\"dutyCycleMode\":true,\"touchPin\":null,"
+                          "\"relay1Name\":\"Front bed\",\"soilMoistureDry\":\"2500\"}");
+    for (JsonPair pair : body.as<JsonObject>()) {
+        config.setField(pair.key().c_str(), pair.key().size(), pair.value());
+    }
+    if (config.getWateringDuration() != 90 || !config.isDutyCycleMode() || config.getTouchSensorPin() != 4 ||
+        config.getRelay1Name() != "Front bed" || config.getSoilMoistureDryValue() != 2500) {
+        printf("Config schema: JSON values not applied as sent\n");
+        failures++;
+    }
+
+    // The pages get the legacy keys but not the internal ones; exports the reverse
+    DynamicJsonDocument api(1024);
+    config.writeApiJson(api);
+    DynamicJsonDocument exported(2048);
+    config.exportJson(exported);
+    if (api["wateringTimeStart"].as<int>() != 6 || api.containsKey("isFirstRun") ||
+        exported.containsKey("wateringTimeStart") || !exported.containsKey("isFirstRun")) {
+        printf("Config schema: legacy or internal keys in the wrong document\n");
+        failures++;
+    }
+
+    // A change staged on a copy keeps a calibration point the io task
+    // added in the meantime
+    ConfigRecord staged = config.getRecord();
+    Config::stageField(staged, "wateringDuration", 16, "120");
+    config.addSoilCalibrationPoint(1800, 50);
+    config.applyRecord(staged);
+    if (config.getWateringDuration() != 120 || config.getSoilCalibrationCount() != 1) {
+        printf("Config schema: staged change lost a setting or a calibration point\n");
+        failures++;
+    }
+
+    // Another task reads the window from before or after a change, never half of each
+    int before, end;
+    config.getWateringWindow(before, end);
+    std::atomic<bool> done(false);
+    std::thread writer([&config, &done] {
+        for (int i = 0; i < 20000; i++) {
+            ConfigRecord next = config.getRecord();
+            next.wateringStartHour = i % 2 ? 8 : 18;
+            next.wateringStartMinute = i % 2 ? 15 : 45;
+            config.applyRecord(next);
+        }
+        done = true;
+    });
+    int torn = 0;
+    while (!done) {
+        int start;
+        config.getWateringWindow(start, end);
+        if (start != before && start != 8 * 60 + 15 && start != 18 * 60 + 45) {
+            torn++;
+        }
+    }
+    writer.join();
+    if (torn > 0) {
+        printf("Config schema: %d reads saw half of a change\n", torn);
+        failures++;
+    }
+    return failures;
+}
+
+// The lookup the schema replaces: compare against every key in turn
+static const ConfigField *findLinear(const char *key, size_t length) {
+    for (int i = 0; i < configFieldCount; i++) {
+        if (strncmp(configFields[i].key, key, length) == 0 && configFields[i].key[length] == 0) {
+            return &configFields[i];
+        }
+    }
+    return NULL;
+}
+
+void benchConfig(Config &config) {
+    const int rounds = 2000;
+    config.saveConfig();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        config.loadConfig();
+    }
+    double binarySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    DynamicJsonDocument doc(2048);
+    config.exportJson(doc);
+    String json;
+    serializeJson(doc, json);
+
+    printf("Config (host):\n");
+    printf("  binary record: %u bytes + %u header, load %.1f us (both slots read, CRC checked)\n",
+           (unsigned)sizeof(ConfigRecord), (unsigned)sizeof(ConfigSlotHeader), binarySeconds * 1e6 / rounds);
+    printf("  as JSON:       %u bytes\n", (unsigned)json.length());
+
+    // Every key once per round, as a full setup post would send them
+    const int lookups = 20000;
+    int found = 0;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < lookups; round++) {
+        const char *key = configFields[round % configFieldCount].key;
+        found += findConfigField(key, strlen(key)) != NULL;
+    }
+    double hashSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < lookups; round++) {
+        const char *key = configFields[round % configFieldCount].key;
+        found += findLinear(key, strlen(key)) != NULL;
+    }
+    double linearSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("  key dispatch:  %d fields, perfect hash %.0f ns, linear search %.0f ns per key (%d found)\n",
+           configFieldCount, hashSeconds * 1e9 / lookups, linearSeconds * 1e9 / lookups, found);
+}
@@ -0,0 +1,21 @@
+#ifndef CONFIG_BENCH_H
+#define CONFIG_BENCH_H
+
+#include "config.h"
+
+// Check the A/B config store against torn and corrupted slots, the
+// migration hook and the JSON import/export round trip. Returns the
+// number of failures.
+int checkConfigStore();
+
+// Check the settings schema: every key dispatches to its own field,
+// unknown and internal keys are refused, legacy keys behave as before
+// and out-of-range values leave the setting alone. Returns the number
+// of failures.
+int checkConfigSchema();
+
+// Time loading the binary config record against parsing the same
+// settings from JSON, and key dispatch against a linear search
+void benchConfig(Config &config);
+
+#endif
@@ -0,0 +1,204 @@
+#include "filter_bench.h"
+#include <Arduino.h>
+#include <chrono>
+#include "utils/filters.h"
+#include "sensors/soil_moisture.h"
+#include "sensors/sensor_acquisition.h"
+
+static uint32_t nextRandom(uint32_t &state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+// Probe ADC burst: uniform noise of +-amplitude around center, with
+// `spikes` samples replaced by garbage anywhere on the scale
+static void makeBurst(uint16_t *samples, size_t count, int center, int amplitude, int spikes,
+                      uint32_t &state) {
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = center + (int)(nextRandom(state) % (2 * amplitude + 1)) - amplitude;
+    }
+    for (int i = 0; i < spikes; i++) {
+        samples[nextRandom(state) % count] = nextRandom(state) % 4096;
+    }
+}
+
+int checkFilters() {
+    int failures = 0;
+
+    // Interquartile mean of a full soil burst, as the acquisition engine
+    // takes it; up to a quarter of the samples may be garbage
+    uint16_t samples[SoilMoistureSensor::burstSamples];
+    const size_t count = SoilMoistureSensor::burstSamples;
+    uint32_t state = 7;
+    const int spikeCounts[] = { 0, 8, 40 };
+    for (int spikes : spikeCounts) {
+        makeBurst(samples, count, 1800, 12, spikes, state);
+        float iqm = trimmedMean(samples, count, count / 4);
+        if (fabsf(iqm - 1800) > 2) {
+            printf("Soil burst IQM with %d spikes: %.1f, expected 1800\n", spikes, iqm);
+            failures++;
+        }
+    }
+    uint16_t small[] = { 9, 1, 5, 3, 7 };
+    if (trimmedMean(small, 5, 1) != 5 || !isnan(trimmedMean(small, 4, 2))) {
+        printf("trimmedMean: wrong result on a five-sample batch\n");
+        failures++;
+    }
+
+    // Temperature once a minute: slow ramp with a single glitch, then a
+    // real step, which must come through within half a window
+    SensorAcquisition::TemperatureFilter temperature;
+    float worstGlitch = 0;
+    float afterStep = 0;
+    for (int minute = 0; minute < 40; minute++) {
+        float truth = minute < 30 ? 20.0f + minute * 0.02f : 25.0f;
+        float value = (minute == 12) ? truth + 15.0f : truth;
+        temperature.process(value);
+        if (minute < 30) {
+            worstGlitch = std::max(worstGlitch, fabsf(value - truth));
+        } else if (minute == 34) {
+            afterStep = value;
+        }
+    }
+    if (worstGlitch > 0.1f || fabsf(afterStep - 25.0f) > 0.01f) {
+        printf("Temperature filter: glitch off by %.2f, %.2f four minutes after a step to 25\n",
+               worstGlitch, afterStep);
+        failures++;
+    }
+
+    // Out-of-range readings are dropped, not averaged in
+    SensorAcquisition::HumidityFilter humidity;
+    float value = 150;
+    if (humidity.process(value)) {
+        printf("Humidity filter passed %.0f %%RH\n", value);
+        failures++;
+    }
+
+    // Pressure as a front comes through: steady, one glitch inside the
+    // sensor's range and one outside it, then a real 6 hPa drop
+    SensorAcquisition::PressureFilter pressure;
+    worstGlitch = 0;
+    afterStep = 0;
+    int dropped = 0;
+    for (int minute = 0; minute < 40; minute++) {
+        float truth = minute < 30 ? 1013.0f + (minute % 3) * 0.1f : 1007.0f;
+        float reading = truth;
+        if (minute == 10) {
+            reading = truth + 60.0f;
+        } else if (minute == 20) {
+            reading = 250.0f;
+        }
+        if (!pressure.process(reading)) {
+            dropped++;
+            continue;
+        }
+        if (minute < 30) {
+            worstGlitch = std::max(worstGlitch, fabsf(reading - truth));
+        } else if (minute == 34) {
+            afterStep = reading;
+        }
+    }
+    if (dropped != 1 || worstGlitch > 0.2f || fabsf(afterStep - 1007.0f) > 0.01f) {
+        printf("Pressure filter: %d dropped, glitch off by %.2f, %.2f four minutes after a drop to 1007\n",
+               dropped, worstGlitch, afterStep);
+        failures++;
+    }
+    return failures;
+}
+
+int checkSoilCalibration() {
+    int failures = 0;
+
+    // Two points reproduce the old map(raw, wet, dry, 100, 0), less its truncation
+    SoilMoistureSensor sensor;
+    sensor.calibrateWet(815);
+    sensor.calibrateDry(2350);
+    for (int raw = 0; raw < SoilMoistureSensor::adcLevels; raw += 7) {
+        float expected = constrain(100.0f * (2350 - raw) / (2350 - 815), 0.0f, 100.0f);
+        float percent = sensor.rawToPercentage(raw);
+        if (fabsf(percent - expected) > 0.006f) {
+            printf("Soil two-point calibration: raw %d gives %.2f%%, expected %.2f%%\n",
+                   raw, percent, expected);
+            failures++;
+            break;
+        }
+    }
+
+    // A curve is followed exactly at its points and linearly between them,
+    // whatever order the points were captured in
+    const SoilCalibrationPoint curve[] = {
+        { 1400, 60 }, { 2400, 0 }, { 900, 100 }, { 1900, 20 },
+    };
+    sensor.setCalibrationCurve(curve, 4);
+    const SoilCalibrationPoint expected[] = {
+        { 0, 100 }, { 900, 100 }, { 1150, 80 }, { 1400, 60 }, { 1650, 40 },
+        { 1900, 20 }, { 2150, 10 }, { 2400, 0 }, { 4095, 0 },
+    };
+    for (const SoilCalibrationPoint &point : expected) {
+        float percent = sensor.rawToPercentage(point.raw);
+        if (fabsf(percent - point.percent) > 0.006f) {
+            printf("Soil calibration curve: raw %d gives %.2f%%, expected %.2f%%\n",
+                   point.raw, percent, point.percent);
+            failures++;
+        }
+    }
+
+    // Fewer than two points fall back to wet and dry
+    sensor.setCalibrationCurve(curve, 1);
+    if (sensor.rawToPercentage(815) != 100 || sensor.rawToPercentage(2350) != 0) {
+        printf("Soil calibration: a single point did not fall back to wet/dry\n");
+        failures++;
+    }
+    return failures;
+}
+
+template <typename Filter>
+static double nsPerSample(float center, float amplitude) {
+    const int samples = 2000000;
+    Filter filter;
+    uint32_t state = 1;
+    volatile float sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < samples; i++) {
+        state = state * 1664525u + 1013904223u;
+        float value = center + ((state >> 8) / 16777216.0f - 0.5f) * amplitude;
+        if (filter.process(value)) {
+            sink = sink + value;
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e9 / samples;
+}
+
+void benchFilters() {
+    printf("Filter pipelines (host, per sample):\n");
+    printf("  temp     RangeGate, Hampel<9>:          %.1f ns\n",
+           nsPerSample<SensorAcquisition::TemperatureFilter>(20, 1));
+    printf("  humidity RangeGate, Hampel<9>, Ewma:    %.1f ns\n",
+           nsPerSample<SensorAcquisition::HumidityFilter>(60, 2));
+    printf("  pressure RangeGate, Hampel<9>:          %.1f ns\n",
+           nsPerSample<SensorAcquisition::PressureFilter>(1013, 1));
+
+    // Soil reading noise: the original five spaced samples averaged
+    // against one burst through the interquartile mean (probe noise +-12)
+    const size_t count = SoilMoistureSensor::burstSamples;
+    const int trials = 20000;
+    uint16_t samples[count];
+    uint32_t state = 1;
+    double meanSquares = 0;
+    double iqmSquares = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int trial = 0; trial < trials; trial++) {
+        makeBurst(samples, count, 1800, 12, 1, state);
+        float five = 0;
+        for (int i = 0; i < 5; i++) {
+            five += samples[i * 50] / 5.0f;
+        }
+        float iqm = trimmedMean(samples, count, count / 4);
+        meanSquares += (five - 1800) * (five - 1800);
+        iqmSquares += (iqm - 1800) * (iqm - 1800);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("  soil reading noise (rms counts): mean of 5 %.2f, IQM of %d %.2f\n",
+           sqrt(meanSquares / trials), (int)count, sqrt(iqmSquares / trials));
+    printf("  soil burst IQM: %.1f us per reading, sort included\n", seconds * 1e6 / trials);
+}
@@ -0,0 +1,18 @@
+#ifndef FILTER_BENCH_H
+#define FILTER_BENCH_H
+
+// Check the soil burst's interquartile mean against spikes, and feed the
+// acquisition engine's temperature, humidity and pressure pipelines
+// series with glitches, out-of-range values and a genuine step: outliers
+// must be rejected and the step must come through. Returns the number of
+// failures.
+int checkFilters();
+
+// Check the soil calibration lookup table against the old two-point map()
+// and against a multi-point curve. Returns the number of failures.
+int checkSoilCalibration();
+
+// Time each channel's pipeline per sample
+void benchFilters();
+
+#endif
@@ -0,0 +1,90 @@
+#include "garden_model.h"
+#include "sim.h"
+#include "hal.h"
+#include <Arduino.h>
+
+static GardenModel *currentGarden = NULL;
+
+GardenModel *simGarden() {
+    return currentGarden;
+}
+
+void setSimGarden(GardenModel *garden) {
+    currentGarden = garden;
+}
+
+GardenModel::GardenModel(int soilSensorPin, int soilPowerPin, int pumpPin)
+    : soilSensorPin(soilSensorPin), soilPowerPin(soilPowerPin), pumpPin(pumpPin) {
+    lastUpdateMicros = sim::nowMicros();
+}
+
+double GardenModel::noise(double amplitude) {
+    // Deterministic LCG so runs are reproducible
+    noiseState = noiseState * 1664525u + 1013904223u;
+    return ((noiseState >> 8) / 16777216.0 - 0.5) * 2.0 * amplitude;
+}
+
+// Fraction of the day in [0, 1) for the current simulated wall time
+static double dayPhase() {
+    hal::WallTime now = hal::wallTimeFromUnix(sim::rtcUnixTime());
+    return (now.hour * 3600 + now.minute * 60 + now.second) / 86400.0;
+}
+
+float GardenModel::temperature() {
+    // Minimum around 05:00, maximum around 15:00
+    return 18.0 + 8.0 * sin(2 * M_PI * (dayPhase() - 0.375));
+}
+
+float GardenModel::humidity() {
+    // Humidity moves opposite to temperature
+    return 65.0 - 20.0 * sin(2 * M_PI * (dayPhase() - 0.375));
+}
+
+float GardenModel::pressure() {
+    return 1013.0 + 4.0 * sin(2 * M_PI * dayPhase() * 2);
+}
+
+void GardenModel::update() {
+    uint64_t now = sim::nowMicros();
+    double seconds = (now - lastUpdateMicros) / 1000000.0;
+    lastUpdateMicros = now;
+    if (seconds <= 0) {
+        return;
+    }
+
+    // Evaporation scales with temperature
+    double rate = baseDryRate * (1.0 + (temperature() - 20.0) / 20.0) / 86400.0;
+    soilMoisture -= rate * seconds;
+
+    if (sim::pinLevel(pumpPin) == HIGH) {
+        soilMoisture += pumpRate * seconds;
+    }
+
+    if (soilMoisture < 0) soilMoisture = 0;
+    if (soilMoisture > 100) soilMoisture = 100;
+}
+
+int GardenModel::analogRead(int pin) {
+    if (pin != soilSensorPin || (soilPowerPin >= 0 && sim::pinLevel(soilPowerPin) != HIGH)) {
+        return 0;
+    }
+
+    // Now and then the ADC returns a wild sample (WiFi on ADC2, probe settling)
+    if (noise(0.5) + 0.5 < spikeRate) {
+        return (int)(2048 + noise(2047));
+    }
+
+    int raw = expectedRaw() - (int)noise(12);
+    return constrain(raw, 0, 4095);
+}
+
+int GardenModel::expectedRaw() {
+    // Capacitive probes respond non-linearly: most of the swing is near dry
+    double fraction = soilMoisture / 100.0;
+    double response = sqrt(fraction);
+    return rawDry - (int)((rawDry - rawWet) * response);
+}
+
+double GardenModel::getSoilMoisture() {
+    return soilMoisture;
+}
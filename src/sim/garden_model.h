@@ -0,0 +1,53 @@
+#ifndef GARDEN_MODEL_H
+#define GARDEN_MODEL_H
+
+#include <stdint.h>
+
+// Simple physical model of the garden for the native simulation.
+// Weather follows a daily cycle; soil dries with temperature and daylight
+// and is wetted while the pump relay pin is driven HIGH.
+class GardenModel {
+private:
+    int soilSensorPin;
+    int soilPowerPin;
+    int pumpPin;
+
+    double soilMoisture = 60.0;       // Volumetric water, percent of field capacity
+    uint64_t lastUpdateMicros = 0;
+    uint32_t noiseState = 12345;
+
+    // Probe response: raw ADC counts at saturated and bone-dry soil
+    const int rawWet = 815;
+    const int rawDry = 2350;
+    const double spikeRate = 0.002;   // Fraction of ADC samples that are garbage
+
+    const double pumpRate = 0.5;      // Percent per second with the pump on
+    const double baseDryRate = 3.0;   // Percent per day at 20 °C
+
+    double noise(double amplitude);
+
+public:
+    GardenModel(int soilSensorPin, int soilPowerPin, int pumpPin);
+
+    // Integrate soil moisture up to the current simulated time
+    void update();
+
+    // Weather at the current simulated time
+    float temperature();
+    float humidity();
+    float pressure();
+
+    // ADC reading the probe would give right now (0 when unpowered)
+    int analogRead(int pin);
+
+    // Noise-free probe reading for the current moisture
+    int expectedRaw();
+
+    double getSoilMoisture();
+};
+
+// Model instance used by the simulated BME280 (sim_bme280.cpp)
+GardenModel *simGarden();
+void setSimGarden(GardenModel *garden);
+
+#endif
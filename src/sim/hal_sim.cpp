@@ -0,0 +1,513 @@
+#include "sim.h"
+#include "hal.h"
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <errno.h>
+#include <dirent.h>
+
+SimSerial Serial;
+
+namespace {
+
+const int pinCount = 40;
+
+struct SimState {
+    uint64_t micros = 0;
+    uint64_t bootMicros = 0;  // Virtual time the running boot started; uptime counts from here
+    uint32_t rtcBase = 0;     // Unix time at micros == 0
+    int64_t rtcOffset = 0;    // Seconds added by rtcAdjust()
+    double rtcDriftPpm = 0;   // RTC rate relative to the virtual clock
+    int pinModes[pinCount] = {};
+    int pinLevels[pinCount] = {};
+    uint64_t pinHighSince[pinCount] = {};
+    uint64_t pinHighTotal[pinCount] = {};
+    int touchValues[pinCount] = {};
+    void (*touchHandlers[pinCount])() = {};
+    int touchThresholds[pinCount] = {};
+    std::function<int(int)> analogSource;
+    std::map<uint8_t, sim::I2cDevice *> i2cDevices;
+    uint32_t i2cTransactions = 0;
+    uint32_t i2cErrors = 0;
+    std::string fsRoot = "sim_fs";
+    size_t fsCapacity = 0x160000;
+    std::map<std::string, FILE *> openFiles;  // Kept open across calls, as the journal reads record by record
+    alignas(8) uint8_t retained[hal::retainedMemorySize] = {};
+    hal::WakeCause wakeCause = hal::WAKE_POWER_ON;
+    uint64_t sleepStart = 0;
+    bool sleepPending = false;
+    uint64_t sleepMicros = 0;
+};
+
+SimState state;
+
+// What the DS3231 registers hold right now
+uint32_t rtcSeconds() {
+    double elapsed = state.micros / 1e6 * (1 + state.rtcDriftPpm / 1e6);
+    return (uint32_t)(state.rtcBase + state.rtcOffset + (int64_t)elapsed);
+}
+
+bool validPin(int pin) {
+    return pin >= 0 && pin < pinCount;
+}
+
+std::string hostPath(const char *path) {
+    return state.fsRoot + (path[0] == '/' ? "" : "/") + path;
+}
+
+// The cached handle for a file, opened on first use. Writes through it are
+// flushed so stat() and whole-file reads see them.
+FILE *openFile(const char *path, bool create) {
+    std::string host = hostPath(path);
+    auto found = state.openFiles.find(host);
+    if (found != state.openFiles.end()) {
+        return found->second;
+    }
+
+    FILE *file = fopen(host.c_str(), "r+b");
+    if (!file && create) {
+        file = fopen(host.c_str(), "w+b");
+    }
+    if (file) {
+        state.openFiles[host] = file;
+    }
+    return file;
+}
+
+void closeFile(const std::string &host) {
+    auto found = state.openFiles.find(host);
+    if (found != state.openFiles.end()) {
+        fclose(found->second);
+        state.openFiles.erase(found);
+    }
+}
+
+void closeAllFiles() {
+    for (auto &entry : state.openFiles) {
+        fclose(entry.second);
+    }
+    state.openFiles.clear();
+}
+
+}
+
+namespace sim {
+
+void reset(uint32_t startUnixTime) {
+    std::string fsRoot = state.fsRoot;
+    size_t fsCapacity = state.fsCapacity;
+    state = SimState();
+    state.fsRoot = fsRoot;
+    state.fsCapacity = fsCapacity;
+    state.rtcBase = startUnixTime;
+
+    // Untouched ESP32 touch pads read well above any sensible threshold
+    for (int i = 0; i < pinCount; i++) {
+        state.touchValues[i] = 80;
+    }
+}
+
+uint64_t nowMicros() {
+    return state.micros;
+}
+
+void advanceMicros(uint64_t micros) {
+    state.micros += micros;
+}
+
+void advanceMillis(unsigned long millis) {
+    state.micros += (uint64_t)millis * 1000;
+}
+
+int pinLevel(int pin) {
+    return validPin(pin) ? state.pinLevels[pin] : LOW;
+}
+
+uint64_t pinHighMicros(int pin) {
+    if (!validPin(pin)) {
+        return 0;
+    }
+    uint64_t total = state.pinHighTotal[pin];
+    if (state.pinLevels[pin] == HIGH) {
+        total += state.micros - state.pinHighSince[pin];
+    }
+    return total;
+}
+
+int pinMode(int pin) {
+    return validPin(pin) ? state.pinModes[pin] : 0;
+}
+
+void setAnalogSource(std::function<int(int pin)> source) {
+    state.analogSource = source;
+}
+
+void setTouchValue(int pin, int value) {
+    if (validPin(pin)) {
+        state.touchValues[pin] = value;
+        if (state.touchHandlers[pin] && value < state.touchThresholds[pin]) {
+            state.touchHandlers[pin]();
+        }
+    }
+}
+
+void attachI2cDevice(uint8_t address, I2cDevice *device) {
+    state.i2cDevices[address] = device;
+}
+
+uint32_t i2cTransactionCount() {
+    return state.i2cTransactions;
+}
+
+void setRtcDriftPpm(double ppm) {
+    state.rtcDriftPpm = ppm;
+}
+
+uint32_t rtcUnixTime() {
+    return rtcSeconds();
+}
+
+void setFsRoot(const char *directory) {
+    closeAllFiles();
+    state.fsRoot = directory;
+}
+
+void setFsCapacity(size_t bytes) {
+    state.fsCapacity = bytes;
+}
+
+void setLogEnabled(bool enabled) {
+    Serial.enabled = enabled;
+}
+
+bool sleepRequested() {
+    return state.sleepPending;
+}
+
+void wake() {
+    // RAM is gone, so are the interrupt handlers
+    for (int i = 0; i < pinCount; i++) {
+        state.touchHandlers[i] = NULL;
+    }
+    state.micros += state.sleepMicros + wakeBootMicros;
+    state.bootMicros = state.micros;
+    state.wakeCause = hal::WAKE_TIMER;
+    state.sleepPending = false;
+}
+
+}
+
+namespace hal {
+
+// millis() and micros() wrap at 32 bits exactly like on the ESP32
+unsigned long millis() {
+    return (uint32_t)((state.micros - state.bootMicros) / 1000);
+}
+
+unsigned long micros() {
+    return (uint32_t)(state.micros - state.bootMicros);
+}
+
+uint64_t uptimeMicros() {
+    return state.micros - state.bootMicros;
+}
+
+void delay(unsigned long ms) {
+    sim::advanceMillis(ms);
+}
+
+// Only a reader on another thread can meet a write in progress; it
+// lets the writer run without moving the virtual clock
+void yieldTick() {
+    std::this_thread::yield();
+}
+
+// Counts with the virtual clock, so work between delays takes no cycles
+uint32_t cycleCount() {
+    return (uint32_t)(uptimeMicros() * cpuMhz());
+}
+
+uint32_t cpuMhz() {
+    return 240;
+}
+
+void pinMode(int pin, int mode) {
+    if (validPin(pin)) {
+        state.pinModes[pin] = mode;
+    }
+}
+
+void digitalWrite(int pin, int value) {
+    if (validPin(pin)) {
+        int level = value ? HIGH : LOW;
+        if (level == HIGH && state.pinLevels[pin] != HIGH) {
+            state.pinHighSince[pin] = state.micros;
+        } else if (level != HIGH && state.pinLevels[pin] == HIGH) {
+            state.pinHighTotal[pin] += state.micros - state.pinHighSince[pin];
+        }
+        state.pinLevels[pin] = level;
+    }
+}
+
+int digitalRead(int pin) {
+    return sim::pinLevel(pin);
+}
+
+int analogRead(int pin) {
+    return state.analogSource ? state.analogSource(pin) : 0;
+}
+
+// adc1_get_raw takes about 20 us per conversion on the ESP32
+size_t analogReadBurst(int pin, uint16_t *samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = analogRead(pin);
+        sim::advanceMicros(20);
+    }
+    return count;
+}
+
+// Typical 11 dB attenuation curve without eFuse calibration
+int analogToMillivolts(int pin, int raw) {
+    (void)pin;
+    return 75 + raw * 3045 / 4095;
+}
+
+int touchRead(int pin) {
+    return validPin(pin) ? state.touchValues[pin] : 0;
+}
+
+void touchAttachInterrupt(int pin, void (*handler)(), int threshold) {
+    if (validPin(pin)) {
+        state.touchHandlers[pin] = handler;
+        state.touchThresholds[pin] = threshold;
+    }
+}
+
+bool i2cBegin(int sdaPin, int sclPin) {
+    (void)sdaPin;
+    (void)sclPin;
+    return true;
+}
+
+bool i2cWrite(uint8_t address, const uint8_t *data, size_t len) {
+    state.i2cTransactions++;
+    auto device = state.i2cDevices.find(address);
+    if (device == state.i2cDevices.end() || !device->second->write(data, len)) {
+        state.i2cErrors++;
+        return false;
+    }
+    return true;
+}
+
+bool i2cReadRegisters(uint8_t address, uint8_t reg, uint8_t *data, size_t len) {
+    state.i2cTransactions++;
+    auto device = state.i2cDevices.find(address);
+    if (device == state.i2cDevices.end() || !device->second->readRegisters(reg, data, len)) {
+        state.i2cErrors++;
+        return false;
+    }
+    return true;
+}
+
+I2cStats i2cStats() {
+    I2cStats stats = { state.i2cTransactions, state.i2cErrors };
+    return stats;
+}
+
+// The host heap is not the device's; nothing to report
+HeapStats heapStats() {
+    HeapStats stats = { 0, 0, 0 };
+    return stats;
+}
+
+bool rtcBegin() {
+    return true;
+}
+
+// The DS3231 sits on the I2C bus, so reads and writes count as transactions
+WallTime rtcNow() {
+    state.i2cTransactions++;
+    return wallTimeFromUnix(rtcSeconds());
+}
+
+void rtcAdjust(const WallTime &time) {
+    state.i2cTransactions++;
+    state.rtcOffset += (int64_t)time.unixtime - rtcSeconds();
+}
+
+bool fsBegin() {
+    // Like LittleFS.begin(true): create the backing store if missing
+    return mkdir(state.fsRoot.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool fsExists(const char *path) {
+    struct stat info;
+    return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool fsReadFile(const char *path, uint8_t *buffer, size_t capacity, size_t *length) {
+    FILE *file = fopen(hostPath(path).c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0 || (size_t)size > capacity) {
+        fclose(file);
+        return false;
+    }
+
+    *length = fread(buffer, 1, size, file);
+    fclose(file);
+    return *length == (size_t)size;
+}
+
+bool fsWriteFile(const char *path, const uint8_t *data, size_t len) {
+    closeFile(hostPath(path));
+    FILE *file = fopen(hostPath(path).c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    size_t written = fwrite(data, 1, len, file);
+    fclose(file);
+    return written == len;
+}
+
+bool fsRemove(const char *path) {
+    closeFile(hostPath(path));
+    return remove(hostPath(path).c_str()) == 0;
+}
+
+bool fsRename(const char *from, const char *to) {
+    closeFile(hostPath(from));
+    closeFile(hostPath(to));
+    return rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool fsMkdir(const char *path) {
+    return mkdir(hostPath(path).c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+long fsSize(const char *path) {
+    struct stat info;
+    if (stat(hostPath(path).c_str(), &info) != 0) {
+        return -1;
+    }
+    return info.st_size;
+}
+
+bool fsAppend(const char *path, const uint8_t *data, size_t len) {
+    FILE *file = openFile(path, true);
+    if (!file) {
+        return false;
+    }
+
+    bool ok = fseek(file, 0, SEEK_END) == 0 && fwrite(data, 1, len, file) == len;
+    return fflush(file) == 0 && ok;
+}
+
+bool fsReadAt(const char *path, size_t offset, uint8_t *buffer, size_t len) {
+    FILE *file = openFile(path, false);
+    if (!file) {
+        return false;
+    }
+
+    return fseek(file, offset, SEEK_SET) == 0 && fread(buffer, 1, len, file) == len;
+}
+
+bool fsWriteAt(const char *path, size_t offset, const uint8_t *data, size_t len) {
+    FILE *file = openFile(path, false);
+    if (!file) {
+        return false;
+    }
+
+    bool ok = fseek(file, offset, SEEK_SET) == 0 && fwrite(data, 1, len, file) == len;
+    return fflush(file) == 0 && ok;
+}
+
+bool fsListDir(const char *path, std::function<void(const char *name, size_t size)> callback) {
+    std::string directory = hostPath(path);
+    DIR *dir = opendir(directory.c_str());
+    if (!dir) {
+        return false;
+    }
+
+    while (struct dirent *entry = readdir(dir)) {
+        struct stat info;
+        std::string file = directory + "/" + entry->d_name;
+        if (stat(file.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+            callback(entry->d_name, info.st_size);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+// The simulated partition matches the 1.375 MB LittleFS area of the default
+// ESP32 partition table; usage is what the files under fsRoot occupy
+size_t fsTotalBytes() {
+    return state.fsCapacity;
+}
+
+size_t fsUsedBytes() {
+    size_t used = 0;
+    std::function<void(const std::string &)> walk = [&](const std::string &directory) {
+        DIR *dir = opendir(directory.c_str());
+        if (!dir) {
+            return;
+        }
+        while (struct dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            struct stat info;
+            std::string file = directory + "/" + entry->d_name;
+            if (stat(file.c_str(), &info) != 0) {
+                continue;
+            }
+            if (S_ISDIR(info.st_mode)) {
+                walk(file);
+            } else {
+                // LittleFS allocates whole 4 KB blocks
+                used += (info.st_size + 4095) / 4096 * 4096;
+            }
+        }
+        closedir(dir);
+    };
+    walk(state.fsRoot);
+    return used;
+}
+
+uint8_t *retainedMemory() {
+    return state.retained;
+}
+
+WakeCause wakeCause() {
+    return state.wakeCause;
+}
+
+uint64_t microsSinceSleep() {
+    return state.wakeCause == WAKE_POWER_ON ? 0 : state.micros - state.sleepStart;
+}
+
+// Levels simply stay as they are across wake()
+void holdPin(int pin, bool hold) {
+    (void)pin;
+    (void)hold;
+}
+
+// Touch wake-up is not modelled; the timer always ends the sleep
+void deepSleep(uint64_t micros, int touchPin, int touchThreshold) {
+    (void)touchPin;
+    (void)touchThreshold;
+    state.sleepStart = state.micros;
+    state.sleepMicros = micros;
+    state.sleepPending = true;
+}
+
+}
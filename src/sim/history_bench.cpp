@@ -0,0 +1,63 @@
+#include "history_bench.h"
+#include <chrono>
+
+void benchHistoryCodec(const std::vector<HistoryRecord> &samples) {
+    if (samples.empty()) {
+        printf("History codec: no samples\n");
+        return;
+    }
+
+    // Encode every sample the way the store does, one block at a time
+    std::vector<uint8_t> encoded;
+    uint8_t block[sizeof(HistoryBlockHeader) + historyBlockMaxPayload];
+    auto encodeStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < samples.size(); i += historyBlockRecords) {
+        size_t count = std::min(historyBlockRecords, samples.size() - i);
+        size_t size = encodeHistoryBlock(&samples[i], count, block, sizeof(block));
+        encoded.insert(encoded.end(), block, block + size);
+    }
+    double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - encodeStart).count();
+
+    // Decode all blocks repeatedly until enough time has passed to measure
+    static HistoryBlockDecoder decoder;
+    size_t decodedSamples = 0;
+    size_t mismatches = 0;
+    int passes = 0;
+    auto decodeStart = std::chrono::steady_clock::now();
+    double decodeSeconds = 0;
+    while (decodeSeconds < 0.5) {
+        size_t offset = 0;
+        size_t index = 0;
+        while (offset < encoded.size()) {
+            HistoryBlockHeader header;
+            memcpy(&header, &encoded[offset], sizeof(header));
+            if (!decoder.load(header, &encoded[offset + sizeof(header)])) {
+                mismatches++;
+                break;
+            }
+            HistoryRecord record;
+            while (decoder.next(record)) {
+                if (passes == 0 && memcmp(&record, &samples[index], sizeof(record) - 1) != 0) {
+                    mismatches++;
+                }
+                index++;
+            }
+            offset += sizeof(header) + header.payloadBytes;
+        }
+        decodedSamples += index;
+        passes++;
+        decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count();
+    }
+
+    double rawBytes = (double)samples.size() * sizeof(HistoryRecord);
+    double perSample = (double)encoded.size() / samples.size();
+    printf("History codec (%zu samples, %zu per block):\n", samples.size(), historyBlockRecords);
+    printf("  raw:         %.0f bytes (%zu bytes/sample)\n", rawBytes, sizeof(HistoryRecord));
+    printf("  compressed:  %zu bytes (%.2f bytes/sample, %.1fx)\n",
+           encoded.size(), perSample, rawBytes / encoded.size());
+    printf("  encode:      %.1f MB/s\n", rawBytes / encodeSeconds / 1e6);
+    printf("  decode:      %.1f MB/s (%.1f M samples/s)\n",
+           decodedSamples * sizeof(HistoryRecord) / decodeSeconds / 1e6,
+           decodedSamples / decodeSeconds / 1e6);
+    printf("  round trip:  %s\n", mismatches == 0 ? "exact" : "MISMATCH");
+}
@@ -0,0 +1,11 @@
+#ifndef HISTORY_BENCH_H
+#define HISTORY_BENCH_H
+
+#include <vector>
+#include "storage/history_block.h"
+
+// Encode the samples into compressed history blocks and time the decoder.
+// Prints bytes/sample, compression ratio and decode throughput.
+void benchHistoryCodec(const std::vector<HistoryRecord> &samples);
+
+#endif
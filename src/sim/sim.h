@@ -0,0 +1,66 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+// Control surface of the simulated HAL backend (hal_sim.cpp).
+// The native build drives the controller against a virtual clock and
+// fake GPIO, ADC, touch, I2C and RTC; files live under a host directory.
+namespace sim {
+
+// Reset all simulated hardware; the RTC starts at the given unix time
+void reset(uint32_t startUnixTime);
+
+// Virtual clock
+uint64_t nowMicros();
+void advanceMicros(uint64_t micros);
+void advanceMillis(unsigned long millis);
+
+// GPIO state as driven by the controller
+int pinLevel(int pin);
+int pinMode(int pin);
+uint64_t pinHighMicros(int pin);  // Total time driven HIGH since reset
+
+// Inputs
+void setAnalogSource(std::function<int(int pin)> source);
+void setTouchValue(int pin, int value);
+
+// I2C peripherals, addressed like the real bus
+class I2cDevice {
+public:
+    virtual ~I2cDevice() {}
+    virtual bool write(const uint8_t *data, size_t len) = 0;
+    virtual bool readRegisters(uint8_t reg, uint8_t *data, size_t len) = 0;
+};
+void attachI2cDevice(uint8_t address, I2cDevice *device);
+uint32_t i2cTransactionCount();  // Includes RTC reads and writes
+
+// DS3231 rate error against the virtual clock (the ESP32 crystal)
+void setRtcDriftPpm(double ppm);
+
+// RTC time without a bus transaction, for the environment model and checks
+uint32_t rtcUnixTime();
+
+// Filesystem root on the host; "/config.json" maps to "<root>/config.json"
+void setFsRoot(const char *directory);
+
+// Size reported by fsTotalBytes(); defaults to the LittleFS partition
+// of the standard 4 MB ESP32 partition table
+void setFsCapacity(size_t bytes);
+
+// Silence Serial output (large runs spend most of their time printing)
+void setLogEnabled(bool enabled);
+
+// Deep sleep. hal::deepSleep() only records the request; the simulation
+// loop then calls wake(), which runs the clock to the timer plus the boot
+// time, restarts uptime at zero and reports a timer wake. Retained memory
+// and held pin levels carry over; sim::reset() is a power-on.
+const uint64_t wakeBootMicros = 200000;  // ROM and bootloader, which checks the app image on every wake
+bool sleepRequested();
+void wake();
+
+}
+
+#endif
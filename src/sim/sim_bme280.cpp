@@ -0,0 +1,132 @@
+#include <Arduino.h>
+#include "sim_bme280.h"
+#include "garden_model.h"
+
+const Bme280::Calibration &SimBme280::calibration() {
+    static const Bme280::Calibration cal = {
+        27504, 26435, -1000,
+        36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000,
+        75, 362, 0, 313, 50, 30
+    };
+    return cal;
+}
+
+SimBme280::SimBme280() {
+    reset();
+}
+
+void SimBme280::reset() {
+    memset(registers, 0, sizeof(registers));
+    const Bme280::Calibration &cal = calibration();
+
+    // NVM layout, little endian
+    uint16_t words[] = { cal.t1, (uint16_t)cal.t2, (uint16_t)cal.t3, cal.p1,
+                         (uint16_t)cal.p2, (uint16_t)cal.p3, (uint16_t)cal.p4, (uint16_t)cal.p5,
+                         (uint16_t)cal.p6, (uint16_t)cal.p7, (uint16_t)cal.p8, (uint16_t)cal.p9 };
+    for (int i = 0; i < 12; i++) {
+        registers[Bme280::regCalibration1 + 2 * i] = words[i] & 0xFF;
+        registers[Bme280::regCalibration1 + 2 * i + 1] = words[i] >> 8;
+    }
+    registers[0xA1] = cal.h1;
+    registers[0xE1] = (uint16_t)cal.h2 & 0xFF;
+    registers[0xE2] = (uint16_t)cal.h2 >> 8;
+    registers[0xE3] = cal.h3;
+    registers[0xE4] = (cal.h4 >> 4) & 0xFF;
+    registers[0xE5] = (cal.h4 & 0x0F) | (cal.h5 & 0x0F) << 4;
+    registers[0xE6] = (cal.h5 >> 4) & 0xFF;
+    registers[0xE7] = (uint8_t)cal.h6;
+    registers[Bme280::regChipId] = Bme280::chipId;
+
+    // Data registers hold the skipped-measurement values until the first conversion
+    registers[0xF7] = 0x80;
+    registers[0xFA] = 0x80;
+    registers[0xFD] = 0x80;
+    filterPrimed = false;
+}
+
+// Registers are written as (register, value) pairs
+bool SimBme280::write(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        uint8_t reg = data[i];
+        uint8_t value = data[i + 1];
+        if (reg == Bme280::regReset) {
+            if (value == Bme280::resetCommand) {
+                reset();
+            }
+        } else if (reg == Bme280::regCtrlMeas && (value & 0x03) != 0) {
+            registers[reg] = value;
+            measure();
+            registers[reg] &= ~0x03;  // Back to sleep
+        } else {
+            registers[reg] = value;
+        }
+    }
+    return true;
+}
+
+bool SimBme280::readRegisters(uint8_t reg, uint8_t *data, size_t len) {
+    if (reg + len > sizeof(registers)) {
+        return false;
+    }
+    memcpy(data, registers + reg, len);
+    return true;
+}
+
+// Smallest raw value whose compensated output reaches the target; the
+// compensation is monotonic in the raw value
+template <typename Compensate>
+static int32_t invert(int32_t maxRaw, int64_t target, bool increasing, Compensate compensate) {
+    int32_t low = 0, high = maxRaw;
+    while (low < high) {
+        int32_t mid = low + (high - low) / 2;
+        int64_t value = compensate(mid);
+        if (increasing ? value < target : value > target) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void SimBme280::measure() {
+    GardenModel *garden = simGarden();
+    if (garden == NULL) {
+        return;
+    }
+    const Bme280::Calibration &cal = calibration();
+    int32_t tFine;
+
+    int32_t adcT = invert(0xFFFFF, lround(garden->temperature() * 100), true, [&](int32_t raw) {
+        return Bme280::compensateTemperature(cal, raw, tFine);
+    });
+    Bme280::compensateTemperature(cal, adcT, tFine);
+    int32_t adcP = invert(0xFFFFF, llround(garden->pressure() * 25600.0), false, [&](int32_t raw) {
+        return (int64_t)Bme280::compensatePressure(cal, raw, tFine);
+    });
+
+    // IIR filter on temperature and pressure: coefficient c keeps (c-1)/c of the old value
+    int coefficient = 1 << ((registers[Bme280::regConfig] >> 2) & 0x07);
+    if (!filterPrimed || coefficient == 1) {
+        filteredT = adcT;
+        filteredP = adcP;
+        filterPrimed = true;
+    } else {
+        filteredT = (filteredT * (int64_t)(coefficient - 1) + adcT) / coefficient;
+        filteredP = (filteredP * (int64_t)(coefficient - 1) + adcP) / coefficient;
+    }
+
+    Bme280::compensateTemperature(cal, filteredT, tFine);
+    int32_t adcH = invert(0xFFFF, lround(garden->humidity() * 1024), true, [&](int32_t raw) {
+        return (int64_t)Bme280::compensateHumidity(cal, raw, tFine);
+    });
+
+    registers[0xF7] = filteredP >> 12;
+    registers[0xF8] = (filteredP >> 4) & 0xFF;
+    registers[0xF9] = (filteredP & 0x0F) << 4;
+    registers[0xFA] = filteredT >> 12;
+    registers[0xFB] = (filteredT >> 4) & 0xFF;
+    registers[0xFC] = (filteredT & 0x0F) << 4;
+    registers[0xFD] = adcH >> 8;
+    registers[0xFE] = adcH & 0xFF;
+}
@@ -0,0 +1,32 @@
+#ifndef SIM_BME280_H
+#define SIM_BME280_H
+
+#include "sim.h"
+#include "sensors/bme280.h"
+
+// Simulated BME280 register file on the sim I2C bus. A forced measurement
+// turns the garden model's weather into raw ADC values through the
+// calibration below (with the sensor's IIR filter on temperature and
+// pressure), so the real driver reads and compensates them.
+class SimBme280 : public sim::I2cDevice {
+private:
+    uint8_t registers[256];
+    bool filterPrimed = false;
+    int32_t filteredT = 0, filteredP = 0;
+
+    void reset();
+    void measure();
+
+public:
+    static const uint8_t address = 0x76;
+
+    SimBme280();
+
+    bool write(const uint8_t *data, size_t len) override;
+    bool readRegisters(uint8_t reg, uint8_t *data, size_t len) override;
+
+    // Temperature and pressure from the datasheet example, humidity typical
+    static const Bme280::Calibration &calibration();
+};
+
+#endif
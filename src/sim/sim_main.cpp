@@ -0,0 +1,662 @@
+// Native simulation of the irrigation controller.
+//
+// Runs the real acquisition engine, watering controller, relays and config
+// against the simulated HAL and a garden model, jumping the virtual clock
+// from one event to the next. Checks the watering rules on every pump
+// switch and exits nonzero if any of them is violated. With --duty-cycle
+// the controller deep-sleeps between readings and is rebuilt from
+// retained memory on every wake, as the device reboots.
+//
+//   .pio/build/native/program [--days N] [--start UNIX] [--fs DIR] [--verbose] [--duty-cycle]
+
+#include <Arduino.h>
+#include <chrono>
+#include <new>
+#include "hal.h"
+#include "sim.h"
+#include "garden_model.h"
+#include "config.h"
+#include "sensors/soil_moisture.h"
+#include "sensors/sensor_acquisition.h"
+#include "sensors/bme280.h"
+#include "controls/relay.h"
+#include "controls/touch.h"
+#include "controls/watering_controller.h"
+#include "controls/live_config.h"
+#include "utils/timekeeper.h"
+#include "utils/scheduler.h"
+#include "utils/duty_cycle.h"
+#include "utils/boot_profile.h"
+#include "storage/history_store.h"
+#include "storage/rollup_store.h"
+#include "sim_bme280.h"
+#include "history_bench.h"
+#include "bme280_bench.h"
+#include "filter_bench.h"
+#include "web_bench.h"
+#include "config_bench.h"
+
+Config config;
+SoilMoistureSensor soilSensor;
+Bme280 bme280;
+TouchControl touchSensor;
+Relay relay1, relay2, relay3, relay4;
+SensorAcquisition sensorAcquisition(bme280, soilSensor);
+Timekeeper timekeeper;
+WateringController wateringController(config, relay2, timekeeper);
+LiveConfig liveConfig(config, relay1, relay2, relay3, relay4, wateringController, soilSensor,
+                      sensorAcquisition, touchSensor);
+HistoryStore historyStore;
+RollupStore rollupStore;
+DutyCycle dutyCycle(timekeeper, sensorAcquisition, wateringController, rollupStore);
+BootProfile bootProfile;
+
+const unsigned long sensorUpdateInterval = 60000;
+const int maxSoilErrorRaw = 10;  // Burst noise after the interquartile mean
+
+struct SimOptions {
+  unsigned long days = 365;
+  uint32_t start = 1735689600;  // 2025-01-01 00:00:00
+  const char *fsRoot = "sim_fs";
+  bool verbose = false;
+  bool bench = false;
+  double rtcDriftPpm = 0;
+  bool dutyCycle = false;
+};
+
+struct SimStats {
+  unsigned long iterations = 0;   // Wake-ups, i.e. scheduler deadlines
+  unsigned long sensorCycles = 0;
+  unsigned long wateringCycles = 0;
+  unsigned long pumpSeconds = 0;
+  float minMoisture = 100;
+  float maxMoisture = 0;
+  int32_t maxClockErrorMs = 0;
+  uint32_t firstReadingMicros = 0;  // Uptime of the first reading after power-on
+  int maxSoilErrorRaw = 0;
+  int violations = 0;
+};
+
+static bool parseOptions(int argc, char **argv, SimOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    String arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--days" && hasValue) {
+      options.days = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--start" && hasValue) {
+      options.start = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--fs" && hasValue) {
+      options.fsRoot = argv[++i];
+    } else if (arg == "--verbose") {
+      options.verbose = true;
+    } else if (arg == "--bench") {
+      options.bench = true;
+    } else if (arg == "--rtc-drift" && hasValue) {
+      options.rtcDriftPpm = atof(argv[++i]);
+    } else if (arg == "--duty-cycle") {
+      options.dutyCycle = true;
+    } else {
+      fprintf(stderr, "usage: %s [--days N] [--start UNIX] [--fs DIR] [--verbose] [--bench] [--rtc-drift PPM] "
+              "[--duty-cycle]\n", argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// True time for the checks; reading it is not a bus transaction
+static hal::WallTime rtcTime() {
+  return hal::wallTimeFromUnix(sim::rtcUnixTime());
+}
+
+static void violation(SimStats &stats, const hal::WallTime &now, const char *rule) {
+  fprintf(stderr, "VIOLATION %04d-%02d-%02d %02d:%02d:%02d: %s\n",
+          now.year, now.month, now.day, now.hour, now.minute, now.second, rule);
+  stats.violations++;
+}
+
+// The io and control tasks as jobs on one timer wheel; the clock jumps
+// from one deadline to the next
+struct SimTasks {
+  Scheduler scheduler;
+  int ioJob = -1;
+  int controlJob = -1;
+  unsigned long lastSensorCycle = 0;
+  bool readingsThisBoot = false;
+  bool storageStarted = false;
+  SimStats *stats = NULL;
+};
+
+// As beginStorage(): history and rollups open in the first acquisition's
+// first gap, or before its reading is recorded
+static void beginStorage(SimTasks &tasks) {
+  if (tasks.storageStarted) {
+    return;
+  }
+  tasks.storageStarted = true;
+  BootProfile::Phase phase(bootProfile, "storage");
+  if (!historyStore.begin()) {
+    Serial.println("Failed to initialize history store");
+  }
+  if (!rollupStore.begin(historyStore, dutyCycle.getRetainedRollups())) {
+    Serial.println("Failed to initialize rollups");
+  }
+}
+
+// As in ioTask()
+static void ioJob(void *context) {
+  SimTasks &tasks = *(SimTasks *)context;
+  SimStats &stats = *tasks.stats;
+
+  liveConfig.applySensors();
+  timekeeper.update();
+  if (!sensorAcquisition.isBusy() && hal::millis() - tasks.lastSensorCycle >= sensorUpdateInterval) {
+    tasks.lastSensorCycle = hal::millis();
+    sensorAcquisition.start();
+  }
+  if (sensorAcquisition.poll()) {
+    bootProfile.milestone("first_reading");
+    if (stats.sensorCycles == 0) {
+      stats.firstReadingMicros = bootProfile.getMilestone("first_reading");
+    }
+    beginStorage(tasks);
+    stats.sensorCycles++;
+    const SensorReadings &readings = sensorAcquisition.getReadings();
+
+    // ADC spikes must not reach the published soil reading
+    int soilError = abs(readings.soilMoistureRaw - simGarden()->expectedRaw());
+    stats.maxSoilErrorRaw = std::max(stats.maxSoilErrorRaw, soilError);
+    if (soilError > maxSoilErrorRaw) {
+      violation(stats, rtcTime(), "soil reading off the probe");
+    }
+
+    uint8_t relays = (relay1.getState() ? 1 : 0) | (relay2.getState() ? 2 : 0) |
+                     (relay3.getState() ? 4 : 0) | (relay4.getState() ? 8 : 0);
+    // The controller's clock must stay within a second or two of the RTC
+    int32_t clockErrorMs = labs((int64_t)timekeeper.unixtime() * 1000 - sim::rtcUnixTime() * 1000LL);
+    stats.maxClockErrorMs = std::max(stats.maxClockErrorMs, clockErrorMs);
+    if (clockErrorMs > Timekeeper::maxErrorMs) {
+      violation(stats, rtcTime(), "clock drifted from the RTC");
+    }
+
+    HistoryRecord record = HistoryRecord::make(timekeeper.unixtime(), readings.temperature,
+                                               readings.humidity, readings.pressure,
+                                               readings.soilMoistureRaw,
+                                               readings.soilMoisturePercent, relays);
+    if (!historyStore.append(record)) {
+      violation(stats, rtcTime(), "history append failed");
+    }
+    rollupStore.add(record);
+    dutyCycle.recordReading(tasks.lastSensorCycle);
+
+    // Hand over to the control task, as CMD_NEW_READINGS does
+    wateringController.updateReadings(readings);
+    tasks.readingsThisBoot = true;
+    tasks.scheduler.scheduleIn(tasks.controlJob, wateringController.msUntilNextEvent());
+  }
+
+  unsigned long wait;
+  if (sensorAcquisition.isBusy()) {
+    wait = sensorAcquisition.msUntilNextStep();
+  } else {
+    unsigned long sinceLast = hal::millis() - tasks.lastSensorCycle;
+    wait = (sinceLast >= sensorUpdateInterval) ? 0 : sensorUpdateInterval - sinceLast;
+  }
+  wait = std::min(wait, timekeeper.msUntilUpdate());
+  if (!tasks.storageStarted && wait > 0 && sensorAcquisition.isBusy()) {
+    beginStorage(tasks);
+  }
+  tasks.scheduler.scheduleIn(tasks.ioJob, wait > 0 ? wait : 1);
+}
+
+// As the watering job of controlTask(), followed by sleepIfIdle()
+static void controlJob(void *context) {
+  SimTasks &tasks = *(SimTasks *)context;
+  wateringController.tick();
+  wateringController.takeChanged();
+  tasks.scheduler.scheduleIn(tasks.controlJob, wateringController.msUntilNextEvent());
+
+  if (!dutyCycle.isEnabled() || !tasks.readingsThisBoot || wateringController.isWatering() ||
+      relay1.getState() || relay2.getState() || relay3.getState() || relay4.getState() ||
+      sensorAcquisition.isBusy()) {
+    return;
+  }
+  uint64_t sleepMicros = dutyCycle.sleepDuration(sensorUpdateInterval, wateringController.msUntilNextEvent());
+  if (sleepMicros > 0) {
+    dutyCycle.sleep(sleepMicros, config.getTouchSensorPin(), config.getTouchSensorThreshold());
+  }
+}
+
+// Same bring-up order as setup() on the device, minus WiFi and the web
+// server; sensors and storage come up with the io job
+static void setupController(bool dutyCycleMode) {
+  bool resumed;
+  {
+    BootProfile::Phase phase(bootProfile, "config");
+    if (!config.begin()) {
+      Serial.println("Failed to initialize configuration");
+    }
+    config.setDutyCycleMode(dutyCycleMode);
+    resumed = dutyCycle.begin(config.isDutyCycleMode());
+  }
+
+  relay1.setRelayPin(config.getRelay1Pin());
+  relay2.setRelayPin(config.getRelay2Pin());
+  relay3.setRelayPin(config.getRelay3Pin());
+  relay4.setRelayPin(config.getRelay4Pin());
+  relay1.init();
+  relay2.init();
+  relay3.init();
+  relay4.init();
+
+  {
+    BootProfile::Phase phase(bootProfile, "clock");
+    if (resumed) {
+      dutyCycle.restore();
+    } else {
+      timekeeper.begin();
+    }
+  }
+
+  soilSensor.setSensorPin(config.getSoilMoistureSensorPin());
+  soilSensor.setPowerPin(config.getSoilMoisturePowerPin());
+  soilSensor.calibrateDry(config.getSoilMoistureDryValue());
+  soilSensor.calibrateWet(config.getSoilMoistureWetValue());
+  liveConfig.applySoilCalibration();
+
+  touchSensor.setTouchPin(config.getTouchSensorPin());
+  touchSensor.setThreshold(config.getTouchSensorThreshold());
+  touchSensor.init();
+}
+
+// Jobs as startTasks() creates them; the io job starts with beginSensors()
+// and the first sensor cycle
+static void startTasks(SimTasks &tasks) {
+  {
+    BootProfile::Phase phase(bootProfile, "sensors");
+    if (!bme280.begin()) {
+      Serial.println("Could not find BME280 sensor!");
+    }
+    soilSensor.init();
+  }
+  tasks.lastSensorCycle = hal::millis();
+  tasks.readingsThisBoot = false;
+  tasks.storageStarted = false;
+  tasks.ioJob = tasks.scheduler.addJob("io", ioJob, &tasks);
+  tasks.controlJob = tasks.scheduler.addJob("control", controlJob, &tasks);
+  tasks.scheduler.scheduleIn(tasks.ioJob, 0);
+  tasks.scheduler.scheduleIn(tasks.controlJob, 0);
+  sensorAcquisition.start();
+}
+
+// As applyConfigChanges(), with the control and io parts run here rather
+// than posted to the tasks; the control job then re-plans, as a command
+// wakes the control task. False if a restart would be needed.
+static bool applyConfigChanges(SimTasks &tasks, uint8_t changes) {
+  uint8_t targets = LiveConfig::targets(changes);
+  uint32_t requestedAt = hal::micros();
+  if (targets & LiveConfig::TARGET_CONTROL) {
+    liveConfig.applyControl(changes, requestedAt);
+    tasks.scheduler.scheduleIn(tasks.controlJob, wateringController.msUntilNextEvent());
+  }
+  if (targets & LiveConfig::TARGET_IO) {
+    liveConfig.applyIo(changes, requestedAt);
+  }
+  return targets != 0;
+}
+
+// PATCH /api/config against the running controller: live changes must
+// not restart or lose the day's watering, boot-time ones must ask for a
+// restart and a bad value must change nothing. Restores the settings
+// afterwards. Returns the host time one live change took to apply.
+static double checkHotReconfig(SimTasks &tasks, SimStats &stats) {
+  DynamicJsonDocument original(2048);
+  config.exportJson(original);
+  int wateredDay = wateringController.getLastWateringDay();
+  uint8_t changes = 0;
+  String rejected;
+
+  auto patch = [&](const char *json) {
+    DynamicJsonDocument doc(512);
+    deserializeJson(doc, json);
+    changes = 0;
+    rejected = "";
+    return config.patchJson(doc.as<JsonObject>(), changes, rejected);
+  };
+
+  // Threshold, relay pin, probe calibration and touch pad in one request,
+  // with relay 3 on
+  relay3.turnOn();
+  int oldPin = relay3.getRelayPin();
+  auto start = std::chrono::steady_clock::now();
+  bool live = patch("{\"soilMoistureThreshold\":45,\"relay3Name\":\"Herbs\",\"relay3Pin\":14,"
+                    "\"soilMoistureDry\":2600,\"touchSensorThreshold\":35}") && applyConfigChanges(tasks, changes);
+  double applyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  if (!live || changes != (APPLY_SCHEDULE | APPLY_RELAYS | APPLY_SOIL_SENSOR | APPLY_TOUCH)) {
+    violation(stats, rtcTime(), "live settings change asked for a restart");
+  }
+  if (config.getSoilMoistureThreshold() != 45 || wateringController.getLastWateringDay() != wateredDay ||
+      (!wateringController.isWatering() && wateringController.msUntilNextEvent() != 0)) {
+    violation(stats, rtcTime(), "threshold change not picked up by the running schedule");
+  }
+  if (!relay3.getState() || hal::digitalRead(14) != HIGH || hal::digitalRead(oldPin) != LOW) {
+    violation(stats, rtcTime(), "relay not moved to its new pin in the same state");
+  }
+  if (!sensorAcquisition.isBusy() && (soilSensor.getDryValue() != 2600 || touchSensor.getThreshold() != 35)) {
+    violation(stats, rtcTime(), "probe calibration or touch threshold not applied");
+  }
+  relay3.turnOff();
+
+  // Boot-time settings need a restart
+  if (!patch("{\"i2cSdaPin\":5}") || applyConfigChanges(tasks, changes)) {
+    violation(stats, rtcTime(), "I2C pin change applied without a restart");
+  }
+
+  // One bad value refuses the whole request
+  int duration = config.getWateringDuration();
+  if (patch("{\"wateringDuration\":30,\"relay1Pin\":99}") || rejected != "relay1Pin" ||
+      config.getWateringDuration() != duration) {
+    violation(stats, rtcTime(), "partly invalid settings change applied");
+  }
+
+  config.importJson(original);
+  applyConfigChanges(tasks, APPLY_RELAYS | APPLY_SCHEDULE | APPLY_SOIL_SENSOR | APPLY_TOUCH);
+  return applyMs;
+}
+
+template <typename T, typename... Args>
+static void reconstruct(T &object, Args &... args) {
+  object.~T();
+  new (&object) T(args...);
+}
+
+// Every poll() step must fit the acquisition engine's budget, the slowest
+// one included; the step maximum covers this boot only
+static void checkStepBudget(SimStats &stats) {
+  if (sensorAcquisition.getMaxStepMicros() > SensorAcquisition::stepBudgetMicros) {
+    violation(stats, rtcTime(), "sensor acquisition step over its time budget");
+  }
+}
+
+// Deep sleep keeps only retained memory, so every controller object and
+// the task schedule start over after the wake, as on the device
+static void wakeAndReboot(SimTasks &tasks, bool dutyCycleMode) {
+  checkStepBudget(*tasks.stats);
+  sim::wake();
+
+  reconstruct(config);
+  reconstruct(soilSensor);
+  reconstruct(bme280);
+  reconstruct(touchSensor);
+  reconstruct(relay1);
+  reconstruct(relay2);
+  reconstruct(relay3);
+  reconstruct(relay4);
+  reconstruct(sensorAcquisition, bme280, soilSensor);
+  reconstruct(timekeeper);
+  reconstruct(wateringController, config, relay2, timekeeper);
+  reconstruct(liveConfig, config, relay1, relay2, relay3, relay4, wateringController, soilSensor,
+              sensorAcquisition, touchSensor);
+  reconstruct(historyStore);
+  reconstruct(rollupStore);
+  reconstruct(dutyCycle, timekeeper, sensorAcquisition, wateringController, rollupStore);
+  reconstruct(bootProfile);
+  setupController(dutyCycleMode);
+
+  reconstruct(tasks.scheduler);
+  startTasks(tasks);
+}
+
+int main(int argc, char **argv) {
+  SimOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    return 2;
+  }
+
+  sim::setFsRoot(options.fsRoot);
+  sim::reset(options.start);
+  sim::setRtcDriftPpm(options.rtcDriftPpm);
+  sim::setLogEnabled(options.verbose);
+
+  GardenModel garden(config.getSoilMoistureSensorPin(), config.getSoilMoisturePowerPin(),
+                     config.getRelay2Pin());
+  setSimGarden(&garden);
+  static SimBme280 bmeDevice;
+  sim::attachI2cDevice(SimBme280::address, &bmeDevice);
+  sim::setAnalogSource([&garden](int pin) { return garden.analogRead(pin); });
+
+  setupController(options.dutyCycle);
+
+  SimStats stats;
+
+  // The driver's integer compensation must match Bosch's reference values
+  stats.violations += checkBme280Compensation();
+  stats.violations += checkFilters();
+  stats.violations += checkSoilCalibration();
+  stats.violations += checkConfigStore();
+  stats.violations += checkConfigSchema();
+  stats.violations += checkRequestBody();
+  stats.violations += checkStaticAssets();
+  stats.violations += checkAssetCache();
+  stats.violations += checkPageTemplate(timekeeper);
+  stats.violations += checkMetrics();
+  const uint64_t endMicros = sim::nowMicros() + (uint64_t)options.days * 86400ULL * 1000000ULL;
+  const unsigned long maxPumpMs = config.getWateringDuration() * 1000UL;
+  bool pumpOn = false;
+  uint64_t pumpOnAt = 0;
+  int lastPumpDay = -1;
+
+  // Halfway through, the clock is set back an hour, as a DST change or a
+  // corrected fast clock does; not in a run so short that the step falls
+  // within the day the range query below reads back. Mid-hour, so it goes
+  // back into rollup buckets that were already closed.
+  const uint64_t clockStepAt = sim::nowMicros() + ((uint64_t)options.days * 43200ULL + 1800) * 1000000ULL;
+  bool clockStepped = options.days < 3;
+  uint32_t clockStepTo = 0;
+
+  static SimTasks tasks;
+  tasks.stats = &stats;
+  startTasks(tasks);
+
+  auto wallStart = std::chrono::steady_clock::now();
+
+  while (sim::nowMicros() < endMicros) {
+    stats.iterations++;
+    if (!clockStepped && sim::nowMicros() >= clockStepAt) {
+      clockStepped = true;
+      clockStepTo = timekeeper.unixtime() - 3600;
+      timekeeper.adjust(hal::wallTimeFromUnix(clockStepTo));
+    }
+    garden.update();
+    tasks.scheduler.runDue();
+
+    // Check the watering rules whenever the pump switches
+    bool pumpNow = sim::pinLevel(config.getRelay2Pin()) == HIGH;
+    if (pumpNow != pumpOn) {
+      hal::WallTime now = rtcTime();
+      if (pumpNow) {
+        stats.wateringCycles++;
+        pumpOnAt = sim::nowMicros();
+        if (now.dayOfWeek == 0) violation(stats, now, "watering on Sunday");
+        if (now.hour >= 22 || now.hour < 7) violation(stats, now, "watering at night");
+        if (now.day == lastPumpDay) violation(stats, now, "watered twice in one day");
+        lastPumpDay = now.day;
+      } else {
+        unsigned long onMs = (sim::nowMicros() - pumpOnAt) / 1000;
+        stats.pumpSeconds += onMs / 1000;
+        if (onMs > maxPumpMs) violation(stats, now, "pump ran longer than the configured duration");
+      }
+      pumpOn = pumpNow;
+    }
+
+    float moisture = garden.getSoilMoisture();
+    if (moisture < stats.minMoisture) stats.minMoisture = moisture;
+    if (moisture > stats.maxMoisture) stats.maxMoisture = moisture;
+
+    // Deep sleep ends in a reboot
+    if (sim::sleepRequested()) {
+      wakeAndReboot(tasks, options.dutyCycle);
+      continue;
+    }
+
+    // Sleep until the next deadline (scheduler time is uptime)
+    sim::advanceMicros(tasks.scheduler.nextDeadline() * 1000 - hal::uptimeMicros());
+  }
+
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+  // Read back the last day of history; it must be complete and in order.
+  // A run can end on a wake before that boot's first reading opened storage.
+  beginStorage(tasks);
+  uint32_t newest = historyStore.getNewestTimestamp();
+  static HistoryStore::Cursor cursor;
+  historyStore.seek(cursor, newest - 86399, newest);
+  HistoryRecord records[64];
+  uint32_t dayRecords = 0;
+  uint32_t previous = 0;
+  while (size_t count = historyStore.read(cursor, records, 64)) {
+    for (size_t i = 0; i < count; i++) {
+      if (records[i].timestamp <= previous) {
+        violation(stats, rtcTime(), "history out of order");
+      }
+      previous = records[i].timestamp;
+      dayRecords++;
+    }
+  }
+  // Until retention drops the oldest segments to free flash, every reading
+  // is kept, including those taken after the clock went back
+  bool allKept = historyStore.getOldestTimestamp() < options.start + 60;
+  if (allKept && historyStore.getRecordCount() != stats.sensorCycles) {
+    violation(stats, rtcTime(), "history lost samples");
+  }
+
+  // and those keep their real times: the hour the clock repeated holds
+  // both passes over it, about one sample per minute each (a wake that
+  // slips a second can put a third in one minute)
+  if (allKept && clockStepTo > 0) {
+    uint32_t perMinute[60] = {};
+    historyStore.seek(cursor, clockStepTo, clockStepTo + 3599);
+    while (size_t count = historyStore.read(cursor, records, 64)) {
+      for (size_t i = 0; i < count; i++) {
+        if (records[i].timestamp < clockStepTo || records[i].timestamp > clockStepTo + 3599) {
+          violation(stats, rtcTime(), "history range query returned a sample outside the range");
+          continue;
+        }
+        perMinute[(records[i].timestamp - clockStepTo) / 60]++;
+      }
+    }
+    for (int minute = 0; minute < 60; minute++) {
+      if (perMinute[minute] < 1 || perMinute[minute] > 3) {
+        violation(stats, rtcTime(), "history samples after the clock went back lost their time");
+        break;
+      }
+    }
+  }
+
+  // One sample per local minute; a drifting RTC day can hold one more or less
+  long expectedRecords = 86400 / (sensorUpdateInterval / 1000);
+  if (options.days > 0 && labs((long)dayRecords - expectedRecords) > (options.rtcDriftPpm != 0 ? 1 : 0)) {
+    violation(stats, rtcTime(), "history range query incomplete");
+  }
+
+  // A 30-day hourly chart from the rollups must account for every raw
+  // sample in the range, and a store rebuilt from flash must agree
+  int tier = rollupStore.selectTier(3600);
+  uint32_t period = RollupStore::tiers[tier].period;
+  uint32_t monthStart = newest - newest % period - 30 * 86400;
+  uint32_t monthRaw = 0;
+  historyStore.seek(cursor, monthStart, newest);
+  while (size_t count = historyStore.read(cursor, records, 64)) {
+    monthRaw += count;
+  }
+  RollupStore reopened;
+  reopened.begin(historyStore);
+  static RollupRecord buckets[800], rebuilt[800];
+  uint32_t next = monthStart;
+  size_t bucketCount = rollupStore.read(tier, next, newest, buckets, 800);
+  next = monthStart;
+  size_t rebuiltCount = reopened.read(tier, next, newest, rebuilt, 800);
+  uint32_t monthRolled = 0;
+  for (size_t i = 0; i < bucketCount; i++) {
+    monthRolled += buckets[i].count;
+  }
+  if (monthRolled != monthRaw) {
+    violation(stats, rtcTime(), "rollup counts do not match the history");
+  }
+  if (rebuiltCount != bucketCount || memcmp(buckets, rebuilt, bucketCount * sizeof(RollupRecord)) != 0) {
+    violation(stats, rtcTime(), "rollups differ after reopening");
+  }
+  double hotApplyMs = checkHotReconfig(tasks, stats);
+  checkStepBudget(stats);
+
+  printf("Simulated %lu days in %.2f s (%.0f days/s)\n",
+         options.days, elapsed, elapsed > 0 ? options.days / elapsed : 0.0);
+  printf("  wake-ups:        %lu (%.1f per minute)\n", stats.iterations,
+         stats.iterations / std::max(options.days * 1440.0, 1.0));
+  for (int i = 0; i < tasks.scheduler.getJobCount(); i++) {
+    Scheduler::JobReport report = tasks.scheduler.getReport(i);
+    printf("    %-8s %lu runs, max %lu us late\n", report.name,
+           (unsigned long)report.runs, (unsigned long)report.maxLatenessUs);
+  }
+  printf("  sensor cycles:   %lu\n", stats.sensorCycles);
+  printf("  watering cycles: %lu (%lu s pump time)\n", stats.wateringCycles, stats.pumpSeconds);
+  printf("  soil moisture:   %.1f%% .. %.1f%% (reading within %d raw counts of the probe)\n",
+         stats.minMoisture, stats.maxMoisture, stats.maxSoilErrorRaw);
+  printf("  soil probe:      powered %.1f ms per reading\n",
+         sim::pinHighMicros(config.getSoilMoisturePowerPin()) / 1000.0 / std::max(stats.sensorCycles, 1UL));
+  hal::I2cStats i2c = hal::i2cStats();
+  printf("  I2C transactions: %u (%u failed)\n", i2c.transactions, i2c.errors);
+  LatencyHistogram::Snapshot steps = sensorAcquisition.getStepTimes().snapshot();
+  LatencyHistogram::Snapshot cycles = sensorAcquisition.getCycleTimes().snapshot();
+  printf("  sensor timing:   %u cycles this boot; step p50 %.0f us, p99 %.0f us, max %lu us; cycle p50 %.0f ms, p99 %.0f ms\n",
+         cycles.count, steps.quantileMicros(0.5), steps.quantileMicros(0.99), sensorAcquisition.getMaxStepMicros(),
+         cycles.quantileMicros(0.5) / 1000, cycles.quantileMicros(0.99) / 1000);
+  printf("  clock:           %lu RTC syncs, drift %.1f ppm (actual %.1f), max error %ld ms\n",
+         (unsigned long)timekeeper.getSyncCount(), timekeeper.getDriftPpm(), options.rtcDriftPpm,
+         (long)stats.maxClockErrorMs);
+  DutyCycle::Report power = dutyCycle.getReport();
+  printf("  power:           %s, awake %.2f%% over %lu wakes, %.2f mA modelled average\n",
+         power.enabled ? "duty cycle" : "continuous",
+         100.0 * power.activeMicros / std::max(power.activeMicros + power.sleepMicros, (uint64_t)1),
+         (unsigned long)power.wakes, power.averageMa);
+  printf("  reading latency: %.0f ms mean, %.0f ms max (%s)\n", power.latencyMeanMs, power.latencyMaxMs,
+         power.enabled ? "from wake" : "from cycle start");
+  printf("  boot:            first reading %.1f ms after power-on; last boot:",
+         stats.firstReadingMicros / 1000.0);
+  for (int i = 0; i < bootProfile.getCount(); i++) {
+    BootProfile::Entry entry = bootProfile.getEntry(i);
+    if (!entry.milestone) {
+      printf(" %s %.1f ms", entry.name, entry.micros / 1000.0);
+    }
+  }
+  printf("\n");
+  printf("  hot reconfig:    relay pin, threshold, probe and touch pad applied live in %.2f ms (host), no restart\n",
+         hotApplyMs);
+  printf("  history:         %lu records in %d segments, %.1f days (last day: %lu records)\n",
+         (unsigned long)historyStore.getRecordCount(), historyStore.getSegmentCount(),
+         (historyStore.getNewestTimestamp() - historyStore.getOldestTimestamp()) / 86400.0,
+         (unsigned long)dayRecords);
+  printf("  history flash:   %lu bytes (%.2f bytes/sample)\n",
+         (unsigned long)historyStore.getStoredBytes(),
+         (double)historyStore.getStoredBytes() / std::max(historyStore.getRecordCount(), 1u));
+  printf("  rollups:         30 days at %lus = %lu buckets for %lu samples\n",
+         (unsigned long)period, (unsigned long)bucketCount, (unsigned long)monthRaw);
+
+  if (options.bench) {
+    std::vector<HistoryRecord> samples;
+    historyStore.seek(cursor, 0, UINT32_MAX);
+    while (size_t count = historyStore.read(cursor, records, 64)) {
+      samples.insert(samples.end(), records, records + count);
+    }
+    benchHistoryCodec(samples);
+    benchStateJson(config, timekeeper);
+    benchAssetCache();
+    benchBme280();
+    benchFilters();
+    benchConfig(config);
+  }
+  printf("  violations:      %d\n", stats.violations);
+
+  setSimGarden(NULL);
+  return stats.violations == 0 ? 0 : 1;
+}
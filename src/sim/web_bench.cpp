@@ -0,0 +1,542 @@
+#include "web_bench.h"
+#include <atomic>
+#include <chrono>
+#include <new>
+#include "web/state_json.h"
+#include "web/request_body.h"
+#include "web/static_assets.h"
+#include "web/asset_cache.h"
+#include "web/page_template.h"
+#include "web/metrics.h"
+#include "hal.h"
+
+// Every heap allocation in the sim goes through here so the benchmark
+// can count them
+static std::atomic<size_t> allocations{0};
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    allocations++;
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+struct BenchResult {
+    double nanos;
+    double allocations;
+};
+
+// Runs 'request' until enough time has passed to measure
+template <typename F>
+static BenchResult measure(F request) {
+    const int batch = 1000;
+    size_t calls = 0;
+    size_t allocated = 0;
+    double seconds = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (seconds < 0.2) {
+        size_t before = allocations;
+        for (int i = 0; i < batch; i++) {
+            request();
+        }
+        allocated += allocations - before;
+        calls += batch;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return { seconds * 1e9 / calls, (double)allocated / calls };
+}
+
+// Parse a collected body and apply it as the PATCH handler does
+static bool applyBody(RequestBody *body, ConfigRecord &record) {
+    DynamicJsonDocument doc(2048);
+    if (deserializeJson(doc, body->bytes(), body->total) || !doc.is<JsonObject>()) {
+        return false;
+    }
+    Config config;
+    uint8_t changes;
+    String rejected;
+    if (!config.patchJson(doc.as<JsonObject>(), changes, rejected)) {
+        return false;
+    }
+    record = config.getRecord();
+    return true;
+}
+
+int checkRequestBody() {
+    const size_t maxBody = 2048;
+    const size_t segment = 1460;   // Ethernet MTU less the IP and TCP headers
+    int failures = 0;
+
+    Config source;
+    source.setDeviceName("Allotment 7");
+    source.setRelay2Name("Pump \"north\" bed");
+    source.setWateringDuration(75);
+    source.setSoilMoistureThreshold(33.5f);
+    DynamicJsonDocument doc(2048);
+    source.writeApiJson(doc);
+    String json;
+    serializeJson(doc, json);
+    const uint8_t *bytes = (const uint8_t *)json.c_str();
+    size_t total = json.length();
+
+    // Whole body in one chunk, as the reference
+    void *slot = NULL;
+    ConfigRecord reference;
+    if (collectRequestBody(slot, bytes, total, 0, total, maxBody) != BODY_COMPLETE ||
+        !applyBody((RequestBody *)slot, reference)) {
+        printf("Request body: single-chunk body not parsed\n");
+        failures++;
+    }
+    free(slot);
+
+    for (size_t chunk = 1; chunk <= segment; chunk++) {
+        slot = NULL;
+        int completions = 0;
+        bool early = false;
+        for (size_t index = 0; index < total; index += chunk) {
+            size_t length = std::min(chunk, total - index);
+            RequestBodyStatus status = collectRequestBody(slot, bytes + index, length, index, total, maxBody);
+            if (status == BODY_COMPLETE) {
+                completions++;
+                early = early || index + length != total;
+            } else if (status != BODY_PARTIAL) {
+                early = true;
+            }
+        }
+        ConfigRecord record;
+        if (completions != 1 || early || !applyBody((RequestBody *)slot, record) ||
+            memcmp(&record, &reference, sizeof(record)) != 0) {
+            printf("Request body: %zu-byte chunks parsed differently\n", chunk);
+            failures++;
+        }
+        // The server frees the slot with the request
+        free(slot);
+    }
+
+    // Over the limit: refused on the first chunk, the rest ignored
+    slot = NULL;
+    if (collectRequestBody(slot, bytes, 10, 0, maxBody + 1, maxBody) != BODY_TOO_LARGE ||
+        collectRequestBody(slot, bytes + 10, 10, 10, maxBody + 1, maxBody) != BODY_IGNORED || slot != NULL) {
+        printf("Request body: oversized body not refused\n");
+        failures++;
+    }
+
+    // A gap or a repeat never completes the body
+    if (collectRequestBody(slot, bytes, 10, 0, total, maxBody) != BODY_PARTIAL ||
+        collectRequestBody(slot, bytes + 20, 10, 20, total, maxBody) != BODY_IGNORED ||
+        collectRequestBody(slot, bytes, 10, 0, total, maxBody) != BODY_PARTIAL ||
+        collectRequestBody(slot, bytes + 10, total - 10, 10, total, maxBody) != BODY_COMPLETE ||
+        collectRequestBody(slot, bytes + total, 0, total, total, maxBody) != BODY_IGNORED) {
+        printf("Request body: out-of-order chunk accepted\n");
+        failures++;
+    }
+    free(slot);
+    return failures;
+}
+
+int checkStaticAssets() {
+    int failures = 0;
+    const char *manifest =
+        "/css/style.css /css/style.50de6252.css.gz \"50de6252\" text/css 0\n"
+        "/css/style.50de6252.css /css/style.50de6252.css.gz \"50de6252\" text/css 1\n"
+        "/index.html /index.html.gz \"4e2df574\" text/html 0\n"
+        "/broken.html /broken.html.gz\n"
+        "/a-url-far-too-long-for-the-manifest-entry.html /x.gz \"00000000\" text/html 0\n"
+        "/setup.html /setup.html.gz \"c5b98a8c\" text/html 0";   // No final newline
+    static StaticAssets assets;
+    if (!assets.parse(manifest, strlen(manifest)) || assets.getCount() != 4) {
+        printf("Static assets: manifest parsed to %d entries, expected 4\n", assets.getCount());
+        failures++;
+    }
+
+    const StaticAsset *page = assets.find("/index.html");
+    const StaticAsset *hashed = assets.find("/css/style.50de6252.css");
+    const StaticAsset *setup = assets.find("/setup.html");
+    if (page == NULL || hashed == NULL || setup == NULL || assets.find("/broken.html") != NULL ||
+        assets.find("/index.htm") != NULL || strcmp(page->file, "/index.html.gz") != 0 ||
+        strcmp(setup->type, "text/html") != 0) {
+        printf("Static assets: lookup failed\n");
+        failures++;
+        return failures;
+    }
+
+    // Hashed URLs are cached for good; pages are revalidated against their ETag
+    if (strstr(StaticAssets::cacheControl(*hashed), "immutable") == NULL ||
+        strcmp(StaticAssets::cacheControl(*page), "no-cache") != 0) {
+        printf("Static assets: wrong Cache-Control\n");
+        failures++;
+    }
+    if (!StaticAssets::isCurrent(*page, "\"4e2df574\"") || !StaticAssets::isCurrent(*page, "\"1\", \"4e2df574\"") ||
+        !StaticAssets::isCurrent(*page, "*") || StaticAssets::isCurrent(*page, "\"c5b98a8c\"") ||
+        StaticAssets::isCurrent(*page, NULL)) {
+        printf("Static assets: If-None-Match matched wrongly\n");
+        failures++;
+    }
+    return failures;
+}
+
+// Manifest entry for a test file of 'size' bytes filled with 'fill'
+static StaticAsset writeAsset(const char *file, const char *etag, size_t size, uint8_t fill) {
+    static uint8_t data[4096];
+    memset(data, fill, size);
+    hal::fsWriteFile(file, data, size);
+    StaticAsset asset;
+    memset(&asset, 0, sizeof(asset));
+    snprintf(asset.url, sizeof(asset.url), "%s", file);
+    snprintf(asset.file, sizeof(asset.file), "%s", file);
+    snprintf(asset.etag, sizeof(asset.etag), "%s", etag);
+    snprintf(asset.type, sizeof(asset.type), "text/html");
+    return asset;
+}
+
+int checkAssetCache() {
+    int failures = 0;
+    StaticAsset a = writeAsset("/cache_a.gz", "\"a1\"", 400, 'a');
+    StaticAsset b = writeAsset("/cache_b.gz", "\"b1\"", 400, 'b');
+    StaticAsset c = writeAsset("/cache_c.gz", "\"c1\"", 400, 'c');
+    StaticAsset big = writeAsset("/cache_big.gz", "\"d1\"", 1200, 'd');
+    AssetCache cache(1000);
+
+    // Two files fit; the third evicts the least recently used
+    std::shared_ptr<const CachedAsset> first = cache.get(a);
+    std::shared_ptr<const CachedAsset> heldB = cache.get(b);
+    bool reused = cache.get(a) == first;
+    std::shared_ptr<const CachedAsset> third = cache.get(c);
+    AssetCache::Stats stats = cache.getStats();
+    if (!first || !heldB || !third || !reused || stats.hits != 1 || stats.misses != 3 || stats.evictions != 1 ||
+        stats.entries != 2 || stats.bytes != 800 || cache.get(a) != first) {
+        printf("Asset cache: wrong LRU order or counters\n");
+        failures++;
+    }
+
+    // The response still sending b keeps it readable after the eviction
+    if (heldB->length != 400 || heldB->data[0] != 'b' || heldB->data[399] != 'b') {
+        printf("Asset cache: evicted file freed while held\n");
+        failures++;
+    }
+
+    // A new image: same file, new content hash, so the old copy misses
+    StaticAsset newA = writeAsset("/cache_a.gz", "\"a2\"", 300, 'A');
+    std::shared_ptr<const CachedAsset> reloaded = cache.get(newA);
+    if (!reloaded || reloaded == first || reloaded->length != 300 || reloaded->data[0] != 'A' ||
+        cache.getStats().bytes > 1000) {
+        printf("Asset cache: stale copy served after the content changed\n");
+        failures++;
+    }
+
+    // Larger than the whole budget: streamed from flash, nothing evicted
+    stats = cache.getStats();
+    if (cache.get(big) || cache.getStats().entries != stats.entries) {
+        printf("Asset cache: over-budget file cached\n");
+        failures++;
+    }
+
+    cache.clear();
+    if (cache.getStats().entries != 0 || cache.getStats().bytes != 0) {
+        printf("Asset cache: clear left entries\n");
+        failures++;
+    }
+    const char *files[] = { a.file, b.file, c.file, big.file };
+    for (const char *file : files) {
+        hal::fsRemove(file);
+    }
+    return failures;
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t getLe32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+int checkPageTemplate(Timekeeper &clock) {
+    int failures = 0;
+    const char *prefix = "<html><body><script type=\"application/json\">";
+    const char *suffix = "</script></body></html>";
+    size_t prefixLength = strlen(prefix);
+    size_t suffixLength = strlen(suffix);
+
+    // Template as tools/build_assets.py lays it out, with the head as one
+    // non-final stored block instead of compressed ones
+    std::string file("PGT1", 4);
+    auto put32 = [&](uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            file += (char)(value >> (8 * i));
+        }
+    };
+    const char gzipHeader[] = "\x1f\x8b\x08\x00\x00\x00\x00\x00\x02\xff";
+    std::string head(gzipHeader, 10);
+    head += (char)0;
+    head += (char)prefixLength;
+    head += (char)(prefixLength >> 8);
+    head += (char)~prefixLength;
+    head += (char)(~prefixLength >> 8);
+    head += prefix;
+    put32(head.size());
+    put32(prefixLength);
+    put32(crc32((const uint8_t *)prefix, prefixLength));
+    put32(suffixLength);
+    file += std::string("\"pagehash\"\0\0", 12);
+    file += head;
+    file += suffix;
+
+    PageTemplate page;
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[file.size()]);
+    memcpy(buffer.get(), file.data(), file.size());
+    if (!page.parse(std::move(buffer), file.size()) || page.getHeadLength() != head.size()) {
+        printf("Page template: template refused\n");
+        return failures + 1;
+    }
+
+    // A name that would close the script element if spliced in as it is
+    Config config;
+    config.setDeviceName("</script><b>");
+    StateJsonCache states(config, clock);
+    SystemState state;
+    memset(&state, 0, sizeof(state));
+    state.generation = 7;
+    std::shared_ptr<const StateJson> body = states.get(state);
+    std::shared_ptr<const PageState> tail = page.get(body);
+
+    // Expected text after the prefix: escaped JSON, then the suffix
+    std::string expected;
+    for (size_t i = 0; i < body->length; i++) {
+        expected += body->json[i] == '<' ? std::string("\\u003c") : std::string(1, body->json[i]);
+    }
+    expected += suffix;
+    std::string plain = prefix + expected;
+
+    const uint8_t *bytes = tail->bytes;
+    size_t blockLength = bytes[1] | bytes[2] << 8;
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"pagehash-%s", body->etag + 1);
+    if (bytes[0] != 1 || blockLength != expected.size() || (uint16_t)~blockLength != (bytes[3] | bytes[4] << 8) ||
+        tail->length != 5 + blockLength + 8 || memcmp(bytes + 5, expected.data(), blockLength) != 0) {
+        printf("Page template: wrong final block\n");
+        failures++;
+    } else if (getLe32(bytes + 5 + blockLength) != crc32((const uint8_t *)plain.data(), plain.size()) ||
+               getLe32(bytes + 9 + blockLength) != plain.size()) {
+        printf("Page template: wrong gzip trailer\n");
+        failures++;
+    }
+    if (strcmp(tail->etag, etag) != 0) {
+        printf("Page template: ETag %s, expected %s\n", tail->etag, etag);
+        failures++;
+    }
+
+    // Same state: the same tail; a new generation: a new tail and ETag
+    bool reused = page.get(body) == tail;
+    state.generation++;
+    std::shared_ptr<const PageState> next = page.get(states.get(state));
+    if (!reused || next == tail || strcmp(next->etag, tail->etag) == 0) {
+        printf("Page template: tail not rebuilt with the state\n");
+        failures++;
+    }
+
+    // Truncated or foreign files are refused
+    std::unique_ptr<uint8_t[]> truncated(new uint8_t[file.size()]);
+    memcpy(truncated.get(), file.data(), file.size());
+    if (page.parse(std::move(truncated), file.size() - 1)) {
+        printf("Page template: truncated template accepted\n");
+        failures++;
+    }
+    return failures;
+}
+
+int checkMetrics() {
+    int failures = 0;
+
+    // Every duration falls in the bucket whose bounds hold it, and no
+    // bucket is wider than half its lower bound
+    for (uint64_t value = 0; value < (1ULL << 27); value = value < 64 ? value + 1 : value + value / 7) {
+        int bucket = LatencyHistogram::bucketFor(value);
+        if (value >= 1UL << LatencyHistogram::maxBits) {
+            if (bucket != LatencyHistogram::bucketCount) {
+                printf("Metrics: %llu us not counted past the top\n", (unsigned long long)value);
+                failures++;
+            }
+            continue;
+        }
+        uint32_t low = LatencyHistogram::lowerBound(bucket);
+        uint32_t high = LatencyHistogram::lowerBound(bucket + 1);
+        if (low > value || value >= high || high - low > std::max(low / 2, 1U)) {
+            printf("Metrics: %llu us in bucket %d [%u, %u)\n", (unsigned long long)value, bucket, low, high);
+            failures++;
+            break;
+        }
+    }
+
+    // 1000 .. 1999 us, evenly
+    LatencyHistogram histogram;
+    for (uint32_t micros = 1000; micros < 2000; micros++) {
+        histogram.record(micros);
+    }
+    LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+    double median = snapshot.quantileMicros(0.5);
+    double p99 = snapshot.quantileMicros(0.99);
+    if (snapshot.count != 1000 || snapshot.sumMicros != 1499500 || median < 1500 * 0.75 || median > 1500 * 1.25 ||
+        p99 < 1990 * 0.75 || p99 > 2048) {
+        printf("Metrics: count %u, sum %llu, p50 %.0f us, p99 %.0f us\n", snapshot.count,
+               (unsigned long long)snapshot.sumMicros, median, p99);
+        failures++;
+    }
+
+    // Cumulative buckets rising to +Inf, then _sum and _count
+    String text;
+    PrometheusText prometheus(text);
+    String labels = PrometheusText::label("path", "/a\"b\\c");
+    prometheus.histogram("test_seconds", labels, snapshot);
+    unsigned long previous = 0;
+    bool rising = true;
+    int buckets = 0;
+    for (size_t at = 0; (at = text.find("test_seconds_bucket{", at)) != std::string::npos; at++) {
+        unsigned long value = strtoul(text.c_str() + text.find("} ", at) + 2, NULL, 10);
+        rising = rising && value >= previous;
+        previous = value;
+        buckets++;
+    }
+    if (labels != "path=\"/a\\\"b\\\\c\"" || !rising || previous != 1000 || buckets < 3 ||
+        text.find("test_seconds_bucket{path=\"/a\\\"b\\\\c\",le=\"+Inf\"} 1000\n") == std::string::npos ||
+        text.find("test_seconds_sum{path=\"/a\\\"b\\\\c\"} 1.4995\n") == std::string::npos ||
+        text.find("test_seconds_count{path=\"/a\\\"b\\\\c\"} 1000\n") == std::string::npos) {
+        printf("Metrics: histogram text wrong:\n%s", text.c_str());
+        failures++;
+    }
+
+    // Any read size gives the items' text back whole and in order
+    const char *items[] = { "# first\n", "", "second 2\nthird 3\n", "x" };
+    std::string expected;
+    for (const char *item : items) {
+        expected += item;
+    }
+    auto produce = [&](int index, String &out) {
+        if (index >= 4) {
+            return false;
+        }
+        out.concat(items[index]);
+        return true;
+    };
+    for (size_t size = 1; size <= expected.size() + 1; size++) {
+        MetricsStream stream(produce);
+        std::string streamed;
+        uint8_t buffer[64];
+        while (size_t length = stream.read(buffer, size)) {
+            streamed.append((const char *)buffer, length);
+        }
+        if (streamed != expected || stream.read(buffer, size) != 0) {
+            printf("Metrics: %zu-byte reads streamed \"%s\"\n", size, streamed.c_str());
+            failures++;
+            break;
+        }
+    }
+    return failures;
+}
+
+void benchAssetCache() {
+    // The gzipped dashboard is about this size (tools/build_assets.py)
+    const size_t pageSize = 3712;
+    const size_t segment = 1460;
+    StaticAsset page = writeAsset("/bench_index.html.gz", "\"bench\"", pageSize, 'x');
+    AssetCache cache(24 * 1024);
+    uint8_t buffer[segment];
+    volatile size_t sink = 0;
+
+    // Read the file and hand it out a segment at a time, as the server does
+    std::vector<uint8_t> file(pageSize);
+    BenchResult flash = measure([&]() {
+        size_t length = 0;
+        hal::fsReadFile(page.file, file.data(), file.size(), &length);
+        for (size_t index = 0; index < length; index += segment) {
+            size_t chunk = std::min(segment, length - index);
+            memcpy(buffer, file.data() + index, chunk);
+            sink += buffer[0];
+        }
+    });
+    BenchResult ram = measure([&]() {
+        std::shared_ptr<const CachedAsset> cached = cache.get(page);
+        for (size_t index = 0; index < cached->length; index += segment) {
+            size_t chunk = std::min(segment, cached->length - index);
+            memcpy(buffer, cached->data.get() + index, chunk);
+            sink += buffer[0];
+        }
+    });
+    hal::fsRemove(page.file);
+
+    AssetCache::Stats stats = cache.getStats();
+    printf("Asset cache (/index.html, %zu bytes gzipped):\n", pageSize);
+    printf("  filesystem:  %.0f ns/request, %.1f allocations/request\n", flash.nanos, flash.allocations);
+    printf("  cache hit:   %.0f ns/request, %.1f allocations/request (%u hits, %u misses)\n", ram.nanos,
+           ram.allocations, stats.hits, stats.misses);
+}
+
+void benchStateJson(Config &config, Timekeeper &clock) {
+    StateJsonCache cache(config, clock);
+    SystemState state;
+    memset(&state, 0, sizeof(state));
+    state.generation = 1;
+    state.temperature = 21.5f;
+    state.humidity = 48.2f;
+    state.pressure = 1013.2f;
+    state.heatIndex = 21.3f;
+    state.soilMoistureRaw = 2310;
+    state.soilMoisturePercent = 41.7f;
+    state.relays[1] = true;
+
+    // Every request sees a new generation, so every request serializes
+    volatile size_t sink = 0;
+    BenchResult rebuild = measure([&]() {
+        state.generation++;
+        sink += cache.get(state)->length;
+    });
+
+    // Unchanged state: the cached body is handed out as is
+    const StateJson *first = cache.get(state).get();
+    bool stable = true;
+    BenchResult hit = measure([&]() {
+        std::shared_ptr<const StateJson> body = cache.get(state);
+        stable = stable && body.get() == first;
+        sink += body->length;
+    });
+
+    // Conditional request from a client holding the current ETag
+    char ifNoneMatch[sizeof(first->etag)];
+    strcpy(ifNoneMatch, first->etag);
+    size_t notModified = 0;
+    BenchResult conditional = measure([&]() {
+        std::shared_ptr<const StateJson> body = cache.get(state);
+        if (strcmp(ifNoneMatch, body->etag) == 0) {
+            notModified++;
+        }
+    });
+
+    printf("State JSON (/api/sensor-data body, %zu bytes, ETag %s):\n", first->length, first->etag);
+    printf("  rebuild:     %.0f ns/request, %.1f allocations/request\n", rebuild.nanos, rebuild.allocations);
+    printf("  cache hit:   %.0f ns/request, %.1f allocations/request\n", hit.nanos, hit.allocations);
+    printf("  304:         %.0f ns/request, %.1f allocations/request\n", conditional.nanos, conditional.allocations);
+    printf("  hit path:    %s\n", stable && hit.allocations == 0 && conditional.allocations == 0 && notModified > 0 ?
+           "zero-allocation" : "ALLOCATES");
+}
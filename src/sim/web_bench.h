@@ -0,0 +1,41 @@
+#ifndef WEB_BENCH_H
+#define WEB_BENCH_H
+
+#include "config.h"
+#include "timekeeper.h"
+
+// Time the /api/sensor-data body path: a rebuild per request (as before
+// the cache), a cache hit, and a conditional request answered with 304.
+// Prints latency and heap allocations per request.
+void benchStateJson(Config &config, Timekeeper &clock);
+
+// Feed a full /api/config body to the chunk collector in every chunk size
+// from one byte to a TCP segment; each must parse to the same settings as
+// the body in one piece. Also checks the size limit and out-of-order
+// chunks. Returns the number of failures.
+int checkRequestBody();
+
+// Parse an asset manifest as tools/build_assets.py writes it and check
+// lookups, ETag matching and cache headers. Returns the number of failures.
+int checkStaticAssets();
+
+// Check the static asset cache's LRU order, byte budget, ETag keying and
+// counters, and that a held file outlives its eviction. Returns the
+// number of failures.
+int checkAssetCache();
+
+// Splice a state body into a page template as the /index.html handler
+// does and check the gzip framing, CRC, escaping and ETag. Returns the
+// number of failures.
+int checkPageTemplate(Timekeeper &clock);
+
+// Check the latency histogram's buckets and percentiles, the Prometheus
+// text written from it and the item-by-item /api/metrics stream. Returns
+// the number of failures.
+int checkMetrics();
+
+// Time sending a dashboard-sized gzipped page from the filesystem against
+// sending it from the asset cache.
+void benchAssetCache();
+
+#endif
@@ -0,0 +1,121 @@
+#include "config_store.h"
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return crc;
+}
+
+ConfigStore::ConfigStore(const char *pathA, const char *pathB, uint16_t version, const Migration *migrations)
+    : version(version), migrations(migrations) {
+    paths[0] = pathA;
+    paths[1] = pathB;
+}
+
+uint32_t ConfigStore::checksum(const ConfigSlotHeader &header, const uint8_t *record) {
+    uint32_t crc = crc32Update(0xFFFFFFFF, (const uint8_t *)&header, offsetof(ConfigSlotHeader, crc));
+    return ~crc32Update(crc, record, header.size);
+}
+
+// Read a slot into buffer (header, then record); false if it is missing,
+// torn or from a newer schema
+bool ConfigStore::readSlot(int slot, uint8_t *buffer, ConfigSlotHeader &header) {
+    size_t length = 0;
+    if (!hal::fsReadFile(paths[slot], buffer, sizeof(ConfigSlotHeader) + maxRecordSize, &length) ||
+        length < sizeof(ConfigSlotHeader)) {
+        return false;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    return header.magic == magic && header.version >= 1 && header.version <= version &&
+           header.size == length - sizeof(ConfigSlotHeader) &&
+           header.crc == checksum(header, buffer + sizeof(ConfigSlotHeader));
+}
+
+bool ConfigStore::load(void *record, size_t size) {
+    uint8_t buffers[2][sizeof(ConfigSlotHeader) + maxRecordSize];
+    ConfigSlotHeader headers[2];
+    bool valid[2];
+    for (int slot = 0; slot < 2; slot++) {
+        valid[slot] = readSlot(slot, buffers[slot], headers[slot]);
+    }
+
+    // Sequence numbers compare across the 32-bit wrap
+    active = -1;
+    if (valid[0] && valid[1]) {
+        active = (int32_t)(headers[1].sequence - headers[0].sequence) > 0 ? 1 : 0;
+    } else if (valid[0] || valid[1]) {
+        active = valid[0] ? 0 : 1;
+    }
+    if (active < 0) {
+        sequence = 0;
+        return false;
+    }
+    if (!valid[1 - active] && hal::fsExists(paths[1 - active])) {
+        Serial.printf("Config: slot %c damaged, using slot %c\n", 'A' + (1 - active), 'A' + active);
+    }
+
+    const ConfigSlotHeader &header = headers[active];
+    sequence = header.sequence;
+    committedCrc = header.crc;
+    uint8_t *stored = buffers[active] + sizeof(ConfigSlotHeader);
+    size_t storedSize = header.size;
+    for (uint16_t from = header.version; from < version; from++) {
+        storedSize = migrations != NULL && migrations[from - 1] != NULL ? migrations[from - 1](stored, storedSize) : 0;
+        if (storedSize == 0) {
+            Serial.printf("Config: no migration from version %u\n", from);
+            return false;
+        }
+        Serial.printf("Config: migrated from version %u to %u\n", from, from + 1);
+
+        // Written back in the current layout on the next commit
+        committedCrc = 0;
+    }
+    if (storedSize != size) {
+        Serial.printf("Config: stored record is %u bytes, expected %u\n", (unsigned)storedSize, (unsigned)size);
+        return false;
+    }
+    memcpy(record, stored, size);
+    return true;
+}
+
+bool ConfigStore::commit(const void *record, size_t size) {
+    if (size > maxRecordSize) {
+        return false;
+    }
+
+    uint8_t buffer[sizeof(ConfigSlotHeader) + maxRecordSize];
+    ConfigSlotHeader header = { magic, version, (uint16_t)size, sequence + 1, 0 };
+    header.crc = checksum(header, (const uint8_t *)record);
+
+    // The sequence is in the CRC, so compare the record alone
+    if (active >= 0 && committedCrc != 0) {
+        ConfigSlotHeader current = header;
+        current.sequence = sequence;
+        if (checksum(current, (const uint8_t *)record) == committedCrc) {
+            return true;
+        }
+    }
+
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), record, size);
+    int slot = active == 0 ? 1 : 0;
+    if (!hal::fsWriteFile(paths[slot], buffer, sizeof(header) + size)) {
+        return false;
+    }
+    active = slot;
+    sequence = header.sequence;
+    committedCrc = header.crc;
+    return true;
+}
+
+void ConfigStore::erase() {
+    hal::fsRemove(paths[0]);
+    hal::fsRemove(paths[1]);
+    active = -1;
+    sequence = 0;
+    committedCrc = 0;
+}
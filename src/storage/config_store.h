@@ -0,0 +1,60 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include "hal.h"
+
+// Header in front of each stored copy of the configuration record
+struct __attribute__((packed)) ConfigSlotHeader {
+    uint32_t magic;
+    uint16_t version;    // Schema version of the record that follows
+    uint16_t size;       // Record bytes
+    uint32_t sequence;   // Commit counter; the higher of two valid slots wins
+    uint32_t crc;        // CRC-32 of the fields above and the record
+};
+
+// Fixed-size binary record kept in two slot files, A and B.
+//
+// A commit writes the slot not holding the current record, so a power
+// cut mid-write damages only the copy being replaced: its CRC fails and
+// load() falls back to the other slot. Records written under an older
+// schema version are brought up to date by the migration hooks.
+class ConfigStore {
+public:
+    static const uint32_t magic = 0x464E4F43;   // "CONF"
+    static const size_t maxRecordSize = 480;
+
+    // Upgrades a record of one version to the next in place (the buffer
+    // holds maxRecordSize bytes); returns its new size, or 0 if it can't
+    typedef size_t (*Migration)(uint8_t *record, size_t size);
+
+private:
+    const char *paths[2];
+    uint16_t version;
+    const Migration *migrations;   // migrations[v - 1] takes version v to v + 1
+    int active = -1;               // Slot holding the current record
+    uint32_t sequence = 0;
+    uint32_t committedCrc = 0;
+
+    static uint32_t checksum(const ConfigSlotHeader &header, const uint8_t *record);
+    bool readSlot(int slot, uint8_t *buffer, ConfigSlotHeader &header);
+
+public:
+    ConfigStore(const char *pathA, const char *pathB, uint16_t version, const Migration *migrations = NULL);
+
+    // Copy the newest intact record, migrated to the current version, into
+    // record; false (record untouched) if neither slot holds one
+    bool load(void *record, size_t size);
+
+    // Store the record in the other slot; a record equal to the current
+    // one is not written again
+    bool commit(const void *record, size_t size);
+
+    // Remove both slots
+    void erase();
+
+    uint32_t getSequence() const { return sequence; }
+    int getActiveSlot() const { return active; }
+};
+
+#endif
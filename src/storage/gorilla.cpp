@@ -0,0 +1,158 @@
+#include "gorilla.h"
+
+BitWriter::BitWriter(uint8_t *buffer, size_t capacity)
+    : buffer(buffer), capacity(capacity) {
+}
+
+bool BitWriter::write(uint32_t value, int bits) {
+    if (bitCount + bits > capacity * 8) {
+        return false;
+    }
+
+    for (int i = bits - 1; i >= 0; i--) {
+        size_t byte = bitCount >> 3;
+        int shift = 7 - (bitCount & 7);
+        if (shift == 7) {
+            buffer[byte] = 0;
+        }
+        buffer[byte] |= ((value >> i) & 1) << shift;
+        bitCount++;
+    }
+    return true;
+}
+
+size_t BitWriter::bytes() const {
+    return (bitCount + 7) >> 3;
+}
+
+BitReader::BitReader(const uint8_t *buffer, size_t length)
+    : buffer(buffer), lengthBits(length * 8) {
+}
+
+uint32_t BitReader::read(int bits) {
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++) {
+        value <<= 1;
+        if (position < lengthBits) {
+            value |= (buffer[position >> 3] >> (7 - (position & 7))) & 1;
+        }
+        position++;
+    }
+    return value;
+}
+
+bool BitReader::overrun() const {
+    return position > lengthBits;
+}
+
+bool TimestampEncoder::encode(BitWriter &writer, uint32_t timestamp) {
+    if (!started) {
+        started = true;
+        previous = timestamp;
+        return writer.write(timestamp, 32);
+    }
+
+    int32_t delta = (int32_t)(timestamp - previous);
+    int32_t deltaOfDelta = delta - previousDelta;
+    previous = timestamp;
+    previousDelta = delta;
+
+    // Buckets store the value offset so the range is asymmetric, as in Gorilla
+    if (deltaOfDelta == 0) {
+        return writer.write(0, 1);
+    }
+    if (deltaOfDelta >= -63 && deltaOfDelta <= 64) {
+        return writer.write(0x2, 2) && writer.write(deltaOfDelta + 63, 7);
+    }
+    if (deltaOfDelta >= -255 && deltaOfDelta <= 256) {
+        return writer.write(0x6, 3) && writer.write(deltaOfDelta + 255, 9);
+    }
+    if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048) {
+        return writer.write(0xE, 4) && writer.write(deltaOfDelta + 2047, 12);
+    }
+    return writer.write(0xF, 4) && writer.write((uint32_t)deltaOfDelta, 32);
+}
+
+uint32_t TimestampDecoder::decode(BitReader &reader) {
+    if (!started) {
+        started = true;
+        previous = reader.read(32);
+        return previous;
+    }
+
+    int32_t deltaOfDelta;
+    if (reader.read(1) == 0) {
+        deltaOfDelta = 0;
+    } else if (reader.read(1) == 0) {
+        deltaOfDelta = (int32_t)reader.read(7) - 63;
+    } else if (reader.read(1) == 0) {
+        deltaOfDelta = (int32_t)reader.read(9) - 255;
+    } else if (reader.read(1) == 0) {
+        deltaOfDelta = (int32_t)reader.read(12) - 2047;
+    } else {
+        deltaOfDelta = (int32_t)reader.read(32);
+    }
+
+    previousDelta += deltaOfDelta;
+    previous += previousDelta;
+    return previous;
+}
+
+static int leadingZeros16(uint16_t value) {
+    return __builtin_clz((uint32_t)value) - 16;
+}
+
+static int trailingZeros16(uint16_t value) {
+    return __builtin_ctz((uint32_t)value);
+}
+
+bool XorEncoder::encode(BitWriter &writer, uint16_t value) {
+    if (!started) {
+        started = true;
+        previous = value;
+        return writer.write(value, 16);
+    }
+
+    uint16_t x = value ^ previous;
+    previous = value;
+    if (x == 0) {
+        return writer.write(0, 1);
+    }
+
+    int newLeading = leadingZeros16(x);
+    int newTrailing = trailingZeros16(x);
+
+    // Reuse the previous window when the changed bits fall inside it
+    if (leading >= 0 && newLeading >= leading && newTrailing >= trailing) {
+        int meaningful = 16 - leading - trailing;
+        return writer.write(0x2, 2) && writer.write(x >> trailing, meaningful);
+    }
+
+    leading = newLeading;
+    trailing = newTrailing;
+    int meaningful = 16 - leading - trailing;
+    return writer.write(0x3, 2) && writer.write(leading, 4) &&
+           writer.write(meaningful - 1, 4) && writer.write(x >> trailing, meaningful);
+}
+
+uint16_t XorDecoder::decode(BitReader &reader) {
+    if (!started) {
+        started = true;
+        previous = reader.read(16);
+        return previous;
+    }
+
+    if (reader.read(1) == 0) {
+        return previous;
+    }
+
+    if (reader.read(1) == 1) {
+        leading = reader.read(4);
+        int meaningful = reader.read(4) + 1;
+        trailing = 16 - leading - meaningful;
+    }
+
+    int meaningful = 16 - leading - trailing;
+    previous ^= reader.read(meaningful) << trailing;
+    return previous;
+}
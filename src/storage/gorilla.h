@@ -0,0 +1,92 @@
+#ifndef GORILLA_H
+#define GORILLA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Bit-level primitives for Gorilla-style time-series compression
+// (Pelkonen et al., "Gorilla: A Fast, Scalable, In-Memory Time Series
+// Database"). Timestamps are stored as delta-of-delta, values as the XOR
+// with their predecessor; both decode as a stream with O(1) state.
+
+// MSB-first bit writer into a caller-owned buffer
+class BitWriter {
+private:
+    uint8_t *buffer;
+    size_t capacity;
+    size_t bitCount = 0;
+
+public:
+    BitWriter(uint8_t *buffer, size_t capacity);
+
+    // Append the low 'bits' bits of value; false once the buffer is full
+    bool write(uint32_t value, int bits);
+
+    // Bytes used so far, including a partially filled last byte
+    size_t bytes() const;
+};
+
+// MSB-first bit reader; reads past the end return zero bits
+class BitReader {
+private:
+    const uint8_t *buffer = nullptr;
+    size_t lengthBits = 0;
+    size_t position = 0;
+
+public:
+    BitReader() = default;
+    BitReader(const uint8_t *buffer, size_t length);
+
+    uint32_t read(int bits);
+    bool overrun() const;
+};
+
+// Timestamp column: first value raw, then delta-of-delta in buckets
+// 0 -> '0', [-63,64] -> '10'+7, [-255,256] -> '110'+9,
+// [-2047,2048] -> '1110'+12, otherwise '1111'+32
+class TimestampEncoder {
+private:
+    uint32_t previous = 0;
+    int32_t previousDelta = 0;
+    bool started = false;
+
+public:
+    bool encode(BitWriter &writer, uint32_t timestamp);
+};
+
+class TimestampDecoder {
+private:
+    uint32_t previous = 0;
+    int32_t previousDelta = 0;
+    bool started = false;
+
+public:
+    uint32_t decode(BitReader &reader);
+};
+
+// Value column over 16-bit samples: '0' if unchanged, '10' + meaningful
+// bits if the XOR fits the previous leading/trailing-zero window,
+// '11' + 4-bit leading zeros + 4-bit length + meaningful bits otherwise
+class XorEncoder {
+private:
+    uint16_t previous = 0;
+    int leading = -1;     // Window of the last stored XOR, -1 = none yet
+    int trailing = 0;
+    bool started = false;
+
+public:
+    bool encode(BitWriter &writer, uint16_t value);
+};
+
+class XorDecoder {
+private:
+    uint16_t previous = 0;
+    int leading = 0;
+    int trailing = 0;
+    bool started = false;
+
+public:
+    uint16_t decode(BitReader &reader);
+};
+
+#endif
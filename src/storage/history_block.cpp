@@ -0,0 +1,164 @@
+#include "history_block.h"
+
+// Fixed-point encoding, clamped to the field ranges
+static long toFixed(float value, float scale, long low, long high) {
+    if (isnan(value)) {
+        return 0;
+    }
+    return constrain(lroundf(value * scale), low, high);
+}
+
+HistoryRecord HistoryRecord::make(uint32_t timestamp, float temperature, float humidity,
+                                  float pressure, int soilRaw, float soilPercent, uint8_t relays) {
+    HistoryRecord record;
+    record.timestamp = timestamp;
+    record.temperature = toFixed(temperature, 100, INT16_MIN, INT16_MAX);
+    record.humidity = toFixed(humidity, 100, 0, UINT16_MAX);
+    record.pressure = toFixed(pressure, 10, 0, UINT16_MAX);
+    record.soilRaw = constrain(soilRaw, 0, UINT16_MAX);
+    record.soilPercent = toFixed(soilPercent, 100, 0, UINT16_MAX);
+    record.relays = relays;
+    record.checksum = 0;
+    return record;
+}
+
+// CRC-8 (polynomial 0x07); detects records torn by a power loss mid-write
+uint8_t historyRecordChecksum(const HistoryRecord &record) {
+    const uint8_t *bytes = (const uint8_t *)&record;
+    uint8_t crc = 0;
+    for (size_t i = 0; i < sizeof(HistoryRecord) - 1; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return crc;
+}
+
+uint32_t historyBlockCrc(const HistoryBlockHeader &header, const uint8_t *payload) {
+    uint32_t crc = crc32Update(0xFFFFFFFF, (const uint8_t *)&header, offsetof(HistoryBlockHeader, crc));
+    return ~crc32Update(crc, payload, header.payloadBytes);
+}
+
+// Column values as the XOR encoder sees them
+static uint16_t columnValue(const HistoryRecord &record, int column) {
+    switch (column) {
+        case 1: return (uint16_t)record.temperature;
+        case 2: return record.humidity;
+        case 3: return record.pressure;
+        case 4: return record.soilRaw;
+        case 5: return record.soilPercent;
+        default: return record.relays;
+    }
+}
+
+static void setColumnValue(HistoryRecord &record, int column, uint16_t value) {
+    switch (column) {
+        case 1: record.temperature = (int16_t)value; break;
+        case 2: record.humidity = value; break;
+        case 3: record.pressure = value; break;
+        case 4: record.soilRaw = value; break;
+        case 5: record.soilPercent = value; break;
+        default: record.relays = value; break;
+    }
+}
+
+size_t encodeHistoryBlock(const HistoryRecord *records, size_t count, uint8_t *out, size_t capacity) {
+    if (count == 0 || count > historyBlockRecords || capacity < sizeof(HistoryBlockHeader)) {
+        return 0;
+    }
+
+    HistoryBlockHeader header;
+    header.magic = historyBlockMagic;
+    header.count = count;
+    header.firstTime = records[0].timestamp;
+    header.lastTime = records[count - 1].timestamp;
+
+    uint8_t *payload = out + sizeof(HistoryBlockHeader);
+    size_t payloadCapacity = capacity - sizeof(HistoryBlockHeader);
+    size_t offset = 0;
+
+    for (int column = 0; column < historyColumns; column++) {
+        header.columnOffsets[column] = offset;
+        BitWriter writer(payload + offset, payloadCapacity - offset);
+
+        bool ok = true;
+        if (column == 0) {
+            TimestampEncoder encoder;
+            for (size_t i = 0; i < count && ok; i++) {
+                ok = encoder.encode(writer, records[i].timestamp);
+            }
+        } else {
+            XorEncoder encoder;
+            for (size_t i = 0; i < count && ok; i++) {
+                ok = encoder.encode(writer, columnValue(records[i], column));
+            }
+        }
+        if (!ok) {
+            return 0;
+        }
+        offset += writer.bytes();
+    }
+
+    header.payloadBytes = offset;
+    header.crc = historyBlockCrc(header, payload);
+    memcpy(out, &header, sizeof(header));
+    return sizeof(HistoryBlockHeader) + offset;
+}
+
+bool HistoryBlockDecoder::load(const HistoryBlockHeader &blockHeader, const uint8_t *blockPayload) {
+    loaded = false;
+    if (blockHeader.magic != historyBlockMagic || blockHeader.count == 0 ||
+        blockHeader.count > historyBlockRecords || blockHeader.payloadBytes > historyBlockMaxPayload) {
+        return false;
+    }
+
+    header = blockHeader;
+    if (blockPayload != payload) {
+        memcpy(payload, blockPayload, header.payloadBytes);
+    }
+    if (historyBlockCrc(header, payload) != header.crc) {
+        return false;
+    }
+
+    for (int column = 0; column < historyColumns; column++) {
+        size_t start = header.columnOffsets[column];
+        size_t end = (column + 1 < historyColumns) ? header.columnOffsets[column + 1] : header.payloadBytes;
+        if (start > end || end > header.payloadBytes) {
+            return false;
+        }
+        readers[column] = BitReader(payload + start, end - start);
+    }
+
+    timestamps = TimestampDecoder();
+    for (int i = 0; i < historyColumns - 1; i++) {
+        values[i] = XorDecoder();
+    }
+    decoded = 0;
+    loaded = true;
+    return true;
+}
+
+bool HistoryBlockDecoder::next(HistoryRecord &record) {
+    if (!loaded || decoded >= header.count) {
+        return false;
+    }
+
+    record.timestamp = timestamps.decode(readers[0]);
+    for (int column = 1; column < historyColumns; column++) {
+        setColumnValue(record, column, values[column - 1].decode(readers[column]));
+    }
+    record.checksum = historyRecordChecksum(record);
+    decoded++;
+    return true;
+}
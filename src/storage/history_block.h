@@ -0,0 +1,81 @@
+#ifndef HISTORY_BLOCK_H
+#define HISTORY_BLOCK_H
+
+#include <Arduino.h>
+#include "gorilla.h"
+
+// One sample, fixed point. Also the 16-byte journal format on flash.
+struct __attribute__((packed)) HistoryRecord {
+    uint32_t timestamp;     // Unix time
+    int16_t temperature;    // 0.01 °C
+    uint16_t humidity;      // 0.01 %
+    uint16_t pressure;      // 0.1 hPa
+    uint16_t soilRaw;
+    uint16_t soilPercent;   // 0.01 %
+    uint8_t relays;         // Bit n set = relay n+1 on
+    uint8_t checksum;       // CRC-8 of the preceding 15 bytes
+
+    static HistoryRecord make(uint32_t timestamp, float temperature, float humidity,
+                              float pressure, int soilRaw, float soilPercent, uint8_t relays);
+
+    float getTemperature() const { return temperature / 100.0f; }
+    float getHumidity() const { return humidity / 100.0f; }
+    float getPressure() const { return pressure / 10.0f; }
+    float getSoilPercent() const { return soilPercent / 100.0f; }
+};
+
+uint8_t historyRecordChecksum(const HistoryRecord &record);
+
+// Columnar compressed block of up to blockRecords samples.
+// Layout: HistoryBlockHeader, then one byte-aligned column per field:
+// timestamps (delta-of-delta) followed by the six value columns (XOR).
+const int historyColumns = 7;
+const uint16_t historyBlockMagic = 0x4248;  // "HB"
+const size_t historyBlockRecords = 120;     // Two hours at one sample per minute
+
+// Worst case per sample is 36 bits of timestamp and 26 bits per value
+const size_t historyBlockMaxPayload = historyBlockRecords * 24 + historyColumns;
+
+struct __attribute__((packed)) HistoryBlockHeader {
+    uint16_t magic;
+    uint16_t count;
+    uint32_t firstTime;
+    uint32_t lastTime;
+    uint16_t payloadBytes;
+    uint16_t columnOffsets[historyColumns];  // Byte offset of each column in the payload
+    uint32_t crc;                            // CRC-32 of the fields above and the payload
+};
+
+// Encode records into header + payload at 'out'; returns the total size
+// or 0 if it does not fit
+size_t encodeHistoryBlock(const HistoryRecord *records, size_t count, uint8_t *out, size_t capacity);
+
+// CRC-32 used for block integrity
+uint32_t historyBlockCrc(const HistoryBlockHeader &header, const uint8_t *payload);
+
+// Streams records out of one block; all columns advance together, so
+// memory is one payload buffer plus a few words of state per column
+class HistoryBlockDecoder {
+private:
+    HistoryBlockHeader header;
+    uint8_t payload[historyBlockMaxPayload];
+    BitReader readers[historyColumns];
+    TimestampDecoder timestamps;
+    XorDecoder values[historyColumns - 1];
+    uint16_t decoded = 0;
+    bool loaded = false;
+
+public:
+    // Takes the header and payload read from flash; false if corrupt
+    bool load(const HistoryBlockHeader &blockHeader, const uint8_t *blockPayload);
+
+    // Payload buffer that load() expects when filled in place
+    uint8_t *payloadBuffer() { return payload; }
+
+    bool next(HistoryRecord &record);
+    bool isLoaded() const { return loaded; }
+    void reset() { loaded = false; }
+    const HistoryBlockHeader &getHeader() const { return header; }
+};
+
+#endif
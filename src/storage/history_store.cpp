@@ -0,0 +1,593 @@
+#include "history_store.h"
+#include <algorithm>
+#include <vector>
+
+static const char *historyDir = "/history";
+static const char *indexFile = "/history/blocks.idx";
+static const char *indexTempFile = "/history/blocks.tmp";
+static const char *journalFile = "/history/journal";
+static const char *journalTempFile = "/history/journal.tmp";
+
+// Uncompressed format of the first history release: raw 16-byte records
+// in <id>.seg files indexed by /history/index. Converted on first boot.
+static const char *rawIndexFile = "/history/index";
+
+void HistoryStore::segmentPath(uint32_t id, char *path, size_t len) {
+    snprintf(path, len, "%s/%08lu.blk", historyDir, (unsigned long)id);
+}
+
+static void rawSegmentPath(uint32_t id, char *path, size_t len) {
+    snprintf(path, len, "%s/%08lu.seg", historyDir, (unsigned long)id);
+}
+
+HistoryStore::Segment &HistoryStore::segmentAt(int position) {
+    return segments[(segmentStart + position) % maxSegments];
+}
+
+bool HistoryStore::begin() {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!hal::fsMkdir(historyDir)) {
+        Serial.println("History: failed to create directory");
+        return false;
+    }
+
+    // Collect segment files; ids are assigned in increasing order
+    struct SegmentFile {
+        uint32_t id;
+        size_t size;
+    };
+    std::vector<SegmentFile> files;
+    std::vector<uint32_t> rawFiles;
+    hal::fsListDir(historyDir, [&](const char *name, size_t size) {
+        const char *base = strrchr(name, '/');
+        base = base ? base + 1 : name;
+        char *end;
+        unsigned long id = strtoul(base, &end, 10);
+        if (end == base) {
+            return;
+        }
+        if (strcmp(end, ".blk") == 0) {
+            files.push_back({ (uint32_t)id, size });
+        } else if (strcmp(end, ".seg") == 0) {
+            rawFiles.push_back(id);
+        }
+    });
+    std::sort(files.begin(), files.end(),
+              [](const SegmentFile &a, const SegmentFile &b) { return a.id < b.id; });
+    std::sort(rawFiles.begin(), rawFiles.end());
+
+    // Sealed segments as recorded in the index
+    std::vector<Segment> indexed(maxSegments);
+    size_t indexLength = 0;
+    if (!hal::fsReadFile(indexFile, (uint8_t *)indexed.data(), indexed.size() * sizeof(Segment), &indexLength)) {
+        indexLength = 0;
+    }
+    indexed.resize(indexLength / sizeof(Segment));
+
+    segmentStart = 0;
+    segmentCount = 0;
+    pendingCount = 0;
+    activeWritable = false;
+
+    bool recovered = false;
+    int fileCount = files.size();
+    for (int i = 0; i < fileCount; i++) {
+        uint32_t id = files[i].id;
+        size_t size = files[i].size;
+        nextSegmentId = id + 1;
+        char path[32];
+        segmentPath(id, path, sizeof(path));
+
+        // Keep only the newest maxSegments files
+        if (fileCount - i > maxSegments) {
+            hal::fsRemove(path);
+            continue;
+        }
+
+        Segment segment;
+        bool intact = false;
+        bool known = false;
+        for (const Segment &entry : indexed) {
+            // Sealed segments never grow; a torn tail stays beyond 'bytes'
+            if (entry.id == id && entry.bytes <= size) {
+                segment = entry;
+                intact = entry.bytes == size;
+                known = true;
+                break;
+            }
+        }
+
+        if (!known && !scanSegment(id, size, segment, intact)) {
+            Serial.printf("History: discarding unreadable segment %lu\n", (unsigned long)id);
+            hal::fsRemove(path);
+            continue;
+        }
+        recovered |= !known && !intact;
+
+        // A segment starting at or before the previous one's end is a new epoch
+        segmentAt(segmentCount++) = segment;
+        activeWritable = intact && segment.count < recordsPerSegment;
+    }
+
+    // Seal damaged segments in the index so they are not rescanned next boot
+    if (recovered) {
+        writeIndex();
+    }
+
+    ready = true;
+    replayJournal();
+    if (!rawFiles.empty()) {
+        migrateRawSegments(rawFiles.data(), rawFiles.size());
+    }
+
+    uint32_t records = pendingCount;
+    uint32_t bytes = pendingCount * sizeof(HistoryRecord);
+    for (int i = 0; i < segmentCount; i++) {
+        records += segmentAt(i).count;
+        bytes += segmentAt(i).bytes;
+    }
+    Serial.printf("History: %d segments, %lu records, %lu bytes\n", segmentCount,
+                  (unsigned long)records, (unsigned long)bytes);
+    return true;
+}
+
+// Rebuild a segment's index entry by walking its blocks. Blocks from the
+// first one failing its CRC on are excluded and the segment is not
+// appended to again; their samples are still in the journal.
+bool HistoryStore::scanSegment(uint32_t id, size_t fileSize, Segment &segment, bool &intact) {
+    char path[32];
+    segmentPath(id, path, sizeof(path));
+
+    segment.id = id;
+    segment.count = 0;
+    segment.bytes = 0;
+
+    HistoryBlockHeader header;
+    uint8_t *payload = blockBuffer + sizeof(header);
+    while (segment.bytes + sizeof(header) <= fileSize) {
+        if (!hal::fsReadAt(path, segment.bytes, (uint8_t *)&header, sizeof(header)) ||
+            header.magic != historyBlockMagic || header.payloadBytes > historyBlockMaxPayload ||
+            segment.bytes + sizeof(header) + header.payloadBytes > fileSize ||
+            !hal::fsReadAt(path, segment.bytes + sizeof(header), payload, header.payloadBytes) ||
+            historyBlockCrc(header, payload) != header.crc) {
+            break;
+        }
+
+        if (segment.count == 0) {
+            segment.firstTime = header.firstTime;
+        }
+        segment.lastTime = header.lastTime;
+        segment.count += header.count;
+        segment.bytes += sizeof(header) + header.payloadBytes;
+    }
+
+    intact = segment.bytes == fileSize;
+    return segment.count > 0;
+}
+
+bool HistoryStore::writeIndex() {
+    int sealed = segmentCount;
+    if (sealed > 0 && activeWritable) {
+        sealed--;
+    }
+
+    // The ring may wrap, so write it in up to two pieces.
+    // Write-then-rename so a power loss leaves either index intact.
+    int firstPiece = std::min(sealed, maxSegments - segmentStart);
+    bool ok = hal::fsWriteFile(indexTempFile, (const uint8_t *)&segments[segmentStart],
+                               firstPiece * sizeof(Segment));
+    if (ok && sealed > firstPiece) {
+        ok = hal::fsAppend(indexTempFile, (const uint8_t *)segments,
+                           (sealed - firstPiece) * sizeof(Segment));
+    }
+    return ok && hal::fsRename(indexTempFile, indexFile);
+}
+
+void HistoryStore::dropOldestSegment() {
+    char path[32];
+    segmentPath(segmentAt(0).id, path, sizeof(path));
+    hal::fsRemove(path);
+    segmentStart = (segmentStart + 1) % maxSegments;
+    segmentCount--;
+}
+
+bool HistoryStore::startSegment(size_t blockBytes, size_t blockRecords) {
+    // Abandon whatever was active (e.g. a segment with a torn tail);
+    // an empty one is removed, ids are never reused
+    if (segmentCount > 0 && segmentAt(segmentCount - 1).count == 0) {
+        char path[32];
+        segmentPath(segmentAt(segmentCount - 1).id, path, sizeof(path));
+        hal::fsRemove(path);
+        segmentCount--;
+    }
+
+    // Make room: segment limit first, then the filesystem budget for a
+    // segment of blocks like this one (scaled up from a short block that
+    // starts an epoch), with some margin
+    size_t payloadBytes = (blockBytes - sizeof(HistoryBlockHeader)) * historyBlockRecords / blockRecords;
+    size_t segmentBytes = (sizeof(HistoryBlockHeader) + payloadBytes) * (recordsPerSegment / historyBlockRecords) * 5 / 4;
+    while (segmentCount >= maxSegments) {
+        dropOldestSegment();
+    }
+    while (segmentCount > 0 &&
+           hal::fsUsedBytes() + segmentBytes + reservedBytes > hal::fsTotalBytes()) {
+        dropOldestSegment();
+    }
+
+    Segment &segment = segmentAt(segmentCount++);
+    segment.id = nextSegmentId++;
+    segment.firstTime = 0;
+    segment.lastTime = 0;
+    segment.count = 0;
+    segment.bytes = 0;
+    activeWritable = true;
+    return writeIndex();
+}
+
+// Compress the open block into the active segment
+bool HistoryStore::flushBlock() {
+    size_t size = encodeHistoryBlock(pending, pendingCount, blockBuffer, sizeof(blockBuffer));
+    if (size == 0) {
+        Serial.println("History: block encoding failed");
+        return false;
+    }
+
+    if (segmentCount == 0 || !activeWritable) {
+        startSegment(size, pendingCount);
+    }
+
+    Segment &segment = segmentAt(segmentCount - 1);
+    char path[32];
+    segmentPath(segment.id, path, sizeof(path));
+    if (!hal::fsAppend(path, blockBuffer, size)) {
+        Serial.println("History: block write failed");
+        activeWritable = false;
+        return false;
+    }
+
+    if (segment.count == 0) {
+        segment.firstTime = pending[0].timestamp;
+    }
+    segment.lastTime = pending[pendingCount - 1].timestamp;
+    segment.count += pendingCount;
+    segment.bytes += size;
+
+    // The samples are in the segment now; a crash before this remove is
+    // handled by replayJournal() skipping what the segment already has
+    hal::fsRemove(journalFile);
+    pendingCount = 0;
+
+    if (segment.count >= recordsPerSegment) {
+        activeWritable = false;
+        writeIndex();
+    }
+    return true;
+}
+
+// Add to the open block, flushing it first if a previous flush failed
+bool HistoryStore::addPending(const HistoryRecord &record) {
+    if (pendingCount == historyBlockRecords && !flushBlock()) {
+        return false;
+    }
+
+    pending[pendingCount++] = record;
+    if (pendingCount == historyBlockRecords) {
+        flushBlock();
+    }
+    return true;
+}
+
+uint32_t HistoryStore::newestTimestamp() {
+    if (pendingCount > 0) {
+        return pending[pendingCount - 1].timestamp;
+    }
+    return segmentCount > 0 ? segmentAt(segmentCount - 1).lastTime : 0;
+}
+
+bool HistoryStore::append(HistoryRecord record) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!ready) {
+        return false;
+    }
+
+    record.checksum = historyRecordChecksum(record);
+    uint32_t newest = newestTimestamp();
+    if (record.timestamp <= newest) {
+        return startEpoch(record, newest);
+    }
+
+    if (!hal::fsAppend(journalFile, (const uint8_t *)&record, sizeof(record))) {
+        Serial.println("History: journal write failed");
+    }
+    return addPending(record);
+}
+
+// Clock set back: close the open block and the active segment, then write
+// the record straight to a fresh segment as a block of its own. It is the
+// newest stored sample from then on, so the journal replay and later
+// appends compare against the new epoch.
+bool HistoryStore::startEpoch(const HistoryRecord &record, uint32_t newest) {
+    Serial.printf("History: clock stepped back %lu s, starting a new epoch\n",
+                  (unsigned long)(newest - record.timestamp));
+    if (pendingCount > 0 && !flushBlock()) {
+        return false;
+    }
+    activeWritable = false;
+    pending[pendingCount++] = record;
+    return flushBlock();
+}
+
+// Reload the open block after a restart. Torn or already flushed records
+// are dropped; if any were, the journal is rewritten clean.
+void HistoryStore::replayJournal() {
+    long size = hal::fsSize(journalFile);
+    if (size <= 0) {
+        return;
+    }
+
+    bool clean = size % sizeof(HistoryRecord) == 0;
+    HistoryRecord record;
+    for (long offset = 0; offset + (long)sizeof(record) <= size; offset += sizeof(record)) {
+        if (!hal::fsReadAt(journalFile, offset, (uint8_t *)&record, sizeof(record)) ||
+            record.checksum != historyRecordChecksum(record) ||
+            record.timestamp <= newestTimestamp()) {
+            clean = false;
+            continue;
+        }
+        addPending(record);
+    }
+
+    if (!clean &&
+        hal::fsWriteFile(journalTempFile, (const uint8_t *)pending, pendingCount * sizeof(HistoryRecord))) {
+        hal::fsRename(journalTempFile, journalFile);
+    }
+}
+
+// One-time conversion of raw segments. Each file is removed only after
+// its samples are in compressed segments or the journal, so an
+// interrupted conversion resumes where it stopped.
+void HistoryStore::migrateRawSegments(uint32_t *ids, int count) {
+    Serial.printf("History: converting %d raw segments\n", count);
+
+    HistoryRecord batch[32];
+    for (int i = 0; i < count; i++) {
+        char path[32];
+        rawSegmentPath(ids[i], path, sizeof(path));
+
+        long size = hal::fsSize(path);
+        for (long offset = 0; offset + (long)sizeof(HistoryRecord) <= size; offset += sizeof(batch)) {
+            size_t n = std::min((size_t)(size - offset) / sizeof(HistoryRecord), (size_t)32);
+            if (!hal::fsReadAt(path, offset, (uint8_t *)batch, n * sizeof(HistoryRecord))) {
+                break;
+            }
+            for (size_t j = 0; j < n; j++) {
+                if (batch[j].checksum == historyRecordChecksum(batch[j]) &&
+                    batch[j].timestamp > newestTimestamp()) {
+                    addPending(batch[j]);
+                }
+            }
+        }
+
+        hal::fsWriteFile(journalFile, (const uint8_t *)pending, pendingCount * sizeof(HistoryRecord));
+        hal::fsRemove(path);
+    }
+    hal::fsRemove(rawIndexFile);
+}
+
+int HistoryStore::findSegmentById(uint32_t id) {
+    int low = 0, high = segmentCount;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (segmentAt(mid).id < id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Within one epoch, where segment times increase
+int HistoryStore::findSegmentByTime(uint32_t timestamp, int low, int high) {
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (segmentAt(mid).count == 0 || segmentAt(mid).lastTime < timestamp) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+bool HistoryStore::readBlockHeader(uint32_t segmentId, uint32_t offset, HistoryBlockHeader &header) {
+    char path[32];
+    segmentPath(segmentId, path, sizeof(path));
+    return hal::fsReadAt(path, offset, (uint8_t *)&header, sizeof(header)) &&
+           header.magic == historyBlockMagic && header.payloadBytes <= historyBlockMaxPayload;
+}
+
+bool HistoryStore::loadBlock(uint32_t segmentId, uint32_t offset, HistoryBlockDecoder &decoder) {
+    HistoryBlockHeader header;
+    if (!readBlockHeader(segmentId, offset, header)) {
+        return false;
+    }
+
+    char path[32];
+    segmentPath(segmentId, path, sizeof(path));
+    return hal::fsReadAt(path, offset + sizeof(header), decoder.payloadBuffer(), header.payloadBytes) &&
+           decoder.load(header, decoder.payloadBuffer());
+}
+
+bool HistoryStore::startsEpoch(int position) {
+    return position > 0 && segmentAt(position).count > 0 &&
+           segmentAt(position).firstTime <= segmentAt(position - 1).lastTime;
+}
+
+int HistoryStore::epochEnd(int position) {
+    int end = position + 1;
+    while (end < segmentCount && !startsEpoch(end)) {
+        end++;
+    }
+    return std::min(end, segmentCount);
+}
+
+// Position the cursor at its 'from' in the epoch starting at 'position',
+// or in the first later epoch that reaches that far
+void HistoryStore::seekEpoch(Cursor &cursor, int position) {
+    cursor.after = cursor.from > 0 ? cursor.from - 1 : 0;
+    cursor.decoder.reset();
+
+    for (;;) {
+        int end = epochEnd(position);
+        int found = findSegmentByTime(cursor.from, position, end);
+        if (found < end) {
+            // Skip whole blocks that end before 'from' using their headers only
+            const Segment &segment = segmentAt(found);
+            cursor.segmentId = segment.id;
+            cursor.blockOffset = 0;
+            HistoryBlockHeader header;
+            while (cursor.blockOffset < segment.bytes &&
+                   readBlockHeader(segment.id, cursor.blockOffset, header) && header.lastTime < cursor.from) {
+                cursor.blockOffset += sizeof(header) + header.payloadBytes;
+            }
+            return;
+        }
+        if (end >= segmentCount) {
+            break;
+        }
+        position = end;
+    }
+
+    // Only the open block can hold the range; start past the last segment
+    cursor.segmentId = segmentCount > 0 ? segmentAt(segmentCount - 1).id : nextSegmentId;
+    cursor.blockOffset = segmentCount > 0 ? segmentAt(segmentCount - 1).bytes : 0;
+}
+
+void HistoryStore::seek(Cursor &cursor, uint32_t from, uint32_t to) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    cursor.from = from;
+    cursor.to = to;
+    cursor.done = from > to;
+    seekEpoch(cursor, 0);
+}
+
+size_t HistoryStore::read(Cursor &cursor, HistoryRecord *records, size_t maxRecords) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    size_t total = 0;
+    while (!cursor.done && total < maxRecords) {
+        // Stream records out of the loaded block
+        if (cursor.decoder.isLoaded()) {
+            HistoryRecord record;
+            if (!cursor.decoder.next(record)) {
+                cursor.blockOffset += sizeof(HistoryBlockHeader) + cursor.decoder.getHeader().payloadBytes;
+                cursor.decoder.reset();
+                continue;
+            }
+            if (record.timestamp <= cursor.after) {
+                continue;
+            }
+            if (record.timestamp > cursor.to) {
+                // Past the range in this epoch; a later one may cover it again
+                int next = epochEnd(findSegmentById(cursor.segmentId));
+                if (next >= segmentCount) {
+                    cursor.done = true;
+                    break;
+                }
+                seekEpoch(cursor, next);
+                continue;
+            }
+            records[total++] = record;
+            cursor.after = record.timestamp;
+            continue;
+        }
+
+        // Load the next block; the segment may have been dropped meanwhile
+        int position = findSegmentById(cursor.segmentId);
+        if (position < segmentCount && segmentAt(position).id == cursor.segmentId) {
+            const Segment &segment = segmentAt(position);
+            if (cursor.blockOffset < segment.bytes) {
+                if (!loadBlock(segment.id, cursor.blockOffset, cursor.decoder)) {
+                    Serial.printf("History: skipping corrupt block in segment %lu\n", (unsigned long)segment.id);
+                    cursor.blockOffset = segment.bytes;
+                }
+                continue;
+            }
+            position++;
+        }
+        if (position < segmentCount) {
+            if (startsEpoch(position)) {
+                seekEpoch(cursor, position);
+            } else {
+                cursor.segmentId = segmentAt(position).id;
+                cursor.blockOffset = 0;
+            }
+            continue;
+        }
+
+        // Past the last segment: serve the open block. The cursor stays at
+        // the end of the segments so a later call picks up a flushed block.
+        for (size_t i = 0; i < pendingCount && total < maxRecords; i++) {
+            if (pending[i].timestamp <= cursor.after) {
+                continue;
+            }
+            if (pending[i].timestamp > cursor.to) {
+                cursor.done = true;
+                break;
+            }
+            records[total++] = pending[i];
+            cursor.after = pending[i].timestamp;
+        }
+        if (total < maxRecords) {
+            cursor.done = true;
+        }
+        break;
+    }
+    return total;
+}
+
+uint32_t HistoryStore::getRecordCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    uint32_t count = pendingCount;
+    for (int i = 0; i < segmentCount; i++) {
+        count += segments[(segmentStart + i) % maxSegments].count;
+    }
+    return count;
+}
+
+uint32_t HistoryStore::getOldestTimestamp() const {
+    std::lock_guard<std::mutex> guard(lock);
+    uint32_t oldest = pendingCount > 0 ? pending[0].timestamp : UINT32_MAX;
+    for (int i = 0; i < segmentCount; i++) {
+        const Segment &segment = segments[(segmentStart + i) % maxSegments];
+        if (segment.count > 0) {
+            oldest = std::min(oldest, segment.firstTime);
+        }
+    }
+    return oldest == UINT32_MAX ? 0 : oldest;
+}
+
+uint32_t HistoryStore::getNewestTimestamp() const {
+    std::lock_guard<std::mutex> guard(lock);
+    if (pendingCount > 0) {
+        return pending[pendingCount - 1].timestamp;
+    }
+    return segmentCount > 0 ? segments[(segmentStart + segmentCount - 1) % maxSegments].lastTime : 0;
+}
+
+int HistoryStore::getSegmentCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return segmentCount;
+}
+
+uint32_t HistoryStore::getStoredBytes() const {
+    std::lock_guard<std::mutex> guard(lock);
+    uint32_t bytes = pendingCount * sizeof(HistoryRecord);
+    for (int i = 0; i < segmentCount; i++) {
+        bytes += segments[(segmentStart + i) % maxSegments].bytes;
+    }
+    return bytes;
+}
@@ -0,0 +1,112 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <Arduino.h>
+#include <mutex>
+#include "hal.h"
+#include "history_block.h"
+
+// Append-only circular log of sensor history on LittleFS.
+//
+// Samples collect in an open block of historyBlockRecords, journaled raw
+// to /history/journal so a power loss costs nothing. A full block is
+// compressed (history_block.h) and appended to the active segment file;
+// a segment holds recordsPerSegment samples. Sealed segments and their
+// time ranges are kept in /history/blocks.idx, so boot only rescans the
+// active segment. When the segment limit or the filesystem budget is
+// reached the oldest segment is deleted.
+//
+// Timestamps are strictly increasing within an epoch, so a range lookup
+// is a binary search over the epoch's segments, a walk over one segment's
+// block headers and decoding of a single block. Samples keep their real
+// time when the clock is set back (DST, a fast clock corrected, an RTC
+// that lost power): the open block and the active segment are closed and
+// a new epoch starts with a fresh segment, one whose first sample is not
+// after the previous segment's last. A range read covers each epoch in
+// turn, oldest first.
+//
+// Appends come from the io task, reads from web handlers; both lock.
+class HistoryStore {
+public:
+    static const uint32_t recordsPerSegment = 1440;  // One day at one sample per minute
+    static const int maxSegments = 366;
+    static const size_t reservedBytes = 64 * 1024;   // Left free for config and web assets
+
+    // Position of a range read; survives between calls, e.g. across
+    // chunks of an HTTP response. Holds one decoded block (~3 KB).
+    struct Cursor {
+        uint32_t segmentId;
+        uint32_t blockOffset;   // Offset of the loaded (or next) block in the segment
+        uint32_t after;         // Timestamp of the last record returned in this epoch
+        uint32_t from;
+        uint32_t to;
+        bool done;
+        HistoryBlockDecoder decoder;
+    };
+
+private:
+    struct Segment {
+        uint32_t id;
+        uint32_t firstTime;
+        uint32_t lastTime;
+        uint32_t count;
+        uint32_t bytes;
+    };
+
+    // Ring of segments ordered by id, oldest at segmentStart
+    Segment segments[maxSegments];
+    int segmentStart = 0;
+    int segmentCount = 0;
+    uint32_t nextSegmentId = 0;
+    bool activeWritable = false;   // False after a failed or torn block write
+    bool ready = false;
+
+    // Open block, not yet compressed
+    HistoryRecord pending[historyBlockRecords];
+    size_t pendingCount = 0;
+    uint8_t blockBuffer[sizeof(HistoryBlockHeader) + historyBlockMaxPayload];
+
+    mutable std::mutex lock;
+
+    Segment &segmentAt(int position);
+    int findSegmentById(uint32_t id);          // First segment with id >= given id
+    int findSegmentByTime(uint32_t timestamp, int low, int high);  // First in [low, high) ending at or after timestamp
+    bool startsEpoch(int position);
+    int epochEnd(int position);                // First segment of the next epoch, or segmentCount
+    void seekEpoch(Cursor &cursor, int position);
+    uint32_t newestTimestamp();
+
+    bool scanSegment(uint32_t id, size_t fileSize, Segment &segment, bool &intact);
+    bool readBlockHeader(uint32_t segmentId, uint32_t offset, HistoryBlockHeader &header);
+    bool loadBlock(uint32_t segmentId, uint32_t offset, HistoryBlockDecoder &decoder);
+    bool startSegment(size_t blockBytes, size_t blockRecords);
+    void dropOldestSegment();
+    bool writeIndex();
+    bool flushBlock();
+    bool addPending(const HistoryRecord &record);
+    bool startEpoch(const HistoryRecord &record, uint32_t newest);
+    void replayJournal();
+    void migrateRawSegments(uint32_t *ids, int count);
+
+    static void segmentPath(uint32_t id, char *path, size_t len);
+
+public:
+    // Load the segment index, recover the active segment and the journal
+    bool begin();
+
+    // Append a record; one at or before the newest starts a new epoch
+    bool append(HistoryRecord record);
+
+    // Range reads: position a cursor at the first record at or after
+    // 'from', then read batches until done (records after 'to' end it)
+    void seek(Cursor &cursor, uint32_t from, uint32_t to);
+    size_t read(Cursor &cursor, HistoryRecord *records, size_t maxRecords);
+
+    uint32_t getRecordCount() const;
+    uint32_t getOldestTimestamp() const;   // Earliest in any epoch
+    uint32_t getNewestTimestamp() const;   // The last appended
+    int getSegmentCount() const;
+    uint32_t getStoredBytes() const;   // Flash used by segments and the journal
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include "rollup_store.h"
+#include "history_store.h"
+#include <algorithm>
+
+static const char *rollupDir = "/rollup";
+
+const RollupStore::Tier RollupStore::tiers[RollupStore::tierCount] = {
+    { "/rollup/15m.bin", 900, 672 },     // 7 days
+    { "/rollup/1h.bin", 3600, 2160 },    // 90 days
+    { "/rollup/1d.bin", 86400, 1096 },   // 3 years
+};
+
+static float metricValue(const HistoryRecord &record, int metric) {
+    switch (metric) {
+        case ROLLUP_TEMPERATURE: return record.temperature;
+        case ROLLUP_HUMIDITY: return record.humidity;
+        case ROLLUP_PRESSURE: return record.pressure;
+        default: return record.soilPercent;
+    }
+}
+
+float RollupStore::statValue(RollupMetric metric, int16_t value) {
+    return metric == ROLLUP_PRESSURE ? value / 10.0f : value / 100.0f;
+}
+
+// Fletcher-16; an all-zero (never written) slot sums to 0
+uint16_t RollupStore::checksum(const RollupRecord &record) {
+    const uint8_t *bytes = (const uint8_t *)&record;
+    uint16_t sum1 = 0, sum2 = 0;
+    for (size_t i = 0; i < offsetof(RollupRecord, checksum); i++) {
+        sum1 = (sum1 + bytes[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+bool RollupStore::begin(HistoryStore &history, const Retained *retained) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!hal::fsMkdir(rollupDir)) {
+        Serial.println("Rollups: failed to create directory");
+        return false;
+    }
+
+    newest = history.getNewestTimestamp();
+    uint32_t floors[tierCount];
+    bool backfill = false;
+
+    for (int t = 0; t < tierCount; t++) {
+        const Tier &tier = tiers[t];
+        open[t].count = 0;
+        floors[t] = newest - newest % tiers[tierCount - 1].period;
+
+        // Preallocate the ring so every slot can be written in place
+        long size = tier.capacity * sizeof(RollupRecord);
+        if (hal::fsSize(tier.path) != size) {
+            uint8_t zeros[512] = {};
+            bool ok = hal::fsWriteFile(tier.path, zeros, 0);
+            for (long written = 0; ok && written < size; written += sizeof(zeros)) {
+                ok = hal::fsAppend(tier.path, zeros, std::min((long)sizeof(zeros), size - written));
+            }
+            if (!ok) {
+                Serial.printf("Rollups: failed to create %s\n", tier.path);
+                return false;
+            }
+
+            // New file: fill it from the history, within its retention
+            uint32_t retention = tier.period * tier.capacity;
+            floors[t] = newest > retention ? newest - retention : 0;
+            backfill = true;
+        }
+    }
+
+    if (newest == 0) {
+        return true;
+    }
+
+    if (retained != NULL && !backfill && retained->newest == newest) {
+        memcpy(open, retained->open, sizeof(open));
+        highest = retained->highest;
+        return true;
+    }
+
+    // Replay the history: new tiers get their retained range written,
+    // existing ones only rebuild their open buckets (the current day)
+    uint32_t from = newest - newest % tiers[tierCount - 1].period;
+    if (backfill) {
+        from = history.getOldestTimestamp();
+    }
+
+    for (int t = 0; t < tierCount; t++) {
+        writeFloors[t] = floors[t];
+    }
+
+    static HistoryStore::Cursor cursor;
+    HistoryRecord records[32];
+    history.seek(cursor, from, newest);
+    newest = 0;   // Replay ends with the history's newest sample
+    highest = 0;
+    uint32_t replayed = 0;
+    while (size_t count = history.read(cursor, records, 32)) {
+        for (size_t i = 0; i < count; i++) {
+            addLocked(records[i]);
+        }
+        replayed += count;
+    }
+    for (int t = 0; t < tierCount; t++) {
+        writeFloors[t] = 0;
+    }
+
+    Serial.printf("Rollups: replayed %lu samples\n", (unsigned long)replayed);
+    return true;
+}
+
+void RollupStore::add(const HistoryRecord &record) {
+    std::lock_guard<std::mutex> guard(lock);
+    addLocked(record);
+}
+
+void RollupStore::retain(Retained &retained) const {
+    std::lock_guard<std::mutex> guard(lock);
+    memcpy(retained.open, open, sizeof(open));
+    retained.newest = newest;
+    retained.highest = highest;
+}
+
+void RollupStore::addLocked(const HistoryRecord &record) {
+    newest = record.timestamp;
+    for (int t = 0; t < tierCount; t++) {
+        Accumulator &bucket = open[t];
+        uint32_t start = record.timestamp - record.timestamp % tiers[t].period;
+
+        if (bucket.count > 0 && start != bucket.start) {
+            closeBucket(t);
+        }
+
+        if (bucket.count == 0) {
+            bucket.start = start;
+            if (start <= highest) {
+                reopenBucket(t);
+            }
+        }
+        if (bucket.count == UINT16_MAX) {
+            continue;
+        }
+        bucket.count++;
+
+        for (int m = 0; m < ROLLUP_METRIC_COUNT; m++) {
+            float value = metricValue(record, m);
+            if (bucket.count == 1) {
+                bucket.min[m] = value;
+                bucket.max[m] = value;
+                bucket.mean[m] = value;
+            } else {
+                bucket.min[m] = std::min(bucket.min[m], value);
+                bucket.max[m] = std::max(bucket.max[m], value);
+                bucket.mean[m] += (value - bucket.mean[m]) / bucket.count;
+            }
+            bucket.last[m] = value;
+        }
+    }
+    highest = std::max(highest, record.timestamp);
+}
+
+RollupRecord RollupStore::toRecord(const Accumulator &bucket) const {
+    RollupRecord record;
+    record.start = bucket.start;
+    record.count = bucket.count;
+    for (int m = 0; m < ROLLUP_METRIC_COUNT; m++) {
+        record.stats[m].min = bucket.min[m];
+        record.stats[m].max = bucket.max[m];
+        record.stats[m].mean = lroundf(bucket.mean[m]);
+        record.stats[m].last = bucket.last[m];
+    }
+    record.checksum = checksum(record);
+    return record;
+}
+
+void RollupStore::closeBucket(int t) {
+    Accumulator &bucket = open[t];
+    const Tier &tier = tiers[t];
+
+    if (bucket.start >= writeFloors[t]) {
+        RollupRecord record = toRecord(bucket);
+        uint32_t slot = (bucket.start / tier.period) % tier.capacity;
+        if (!hal::fsWriteAt(tier.path, slot * sizeof(RollupRecord), (const uint8_t *)&record, sizeof(record))) {
+            Serial.printf("Rollups: failed to write %s\n", tier.path);
+        }
+    }
+    bucket.count = 0;
+}
+
+// The clock went back into a bucket that may have been closed already;
+// carry on from its stored aggregate rather than overwrite it
+void RollupStore::reopenBucket(int t) {
+    Accumulator &bucket = open[t];
+    const Tier &tier = tiers[t];
+    if (bucket.start < writeFloors[t]) {
+        return;
+    }
+
+    RollupRecord record;
+    uint32_t slot = (bucket.start / tier.period) % tier.capacity;
+    if (!hal::fsReadAt(tier.path, slot * sizeof(RollupRecord), (uint8_t *)&record, sizeof(record)) ||
+        record.start != bucket.start || record.checksum != checksum(record)) {
+        return;
+    }
+
+    bucket.count = record.count;
+    for (int m = 0; m < ROLLUP_METRIC_COUNT; m++) {
+        bucket.min[m] = record.stats[m].min;
+        bucket.max[m] = record.stats[m].max;
+        bucket.mean[m] = record.stats[m].mean;
+        bucket.last[m] = record.stats[m].last;
+    }
+}
+
+int RollupStore::selectTier(uint32_t resolution) const {
+    for (int t = tierCount - 1; t >= 0; t--) {
+        if (tiers[t].period <= resolution) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+size_t RollupStore::read(int t, uint32_t &next, uint32_t to, RollupRecord *records, size_t maxRecords) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (t < 0 || t >= tierCount) {
+        return 0;
+    }
+
+    const Tier &tier = tiers[t];
+    const Accumulator &bucket = open[t];
+    if (bucket.count == 0) {
+        return 0;  // Nothing recorded since boot replay, so nothing stored either
+    }
+
+    // Slots older than one lap of the ring have been overwritten
+    next -= next % tier.period;
+    uint32_t oldest = bucket.start - std::min(bucket.start, (tier.capacity - 1) * tier.period);
+    next = std::max(next, oldest);
+
+    size_t total = 0;
+    while (total < maxRecords && next <= to && next < bucket.start) {
+        // One read for a run of consecutive slots, up to the ring's end
+        uint32_t slot = (next / tier.period) % tier.capacity;
+        uint32_t run = std::min((uint32_t)(maxRecords - total), tier.capacity - slot);
+        run = std::min(run, (bucket.start - next) / tier.period);
+        run = std::min(run, (to - next) / tier.period + 1);
+
+        if (!hal::fsReadAt(tier.path, slot * sizeof(RollupRecord), (uint8_t *)(records + total),
+                           run * sizeof(RollupRecord))) {
+            break;
+        }
+
+        // Keep buckets that belong to this lap; empty periods are skipped
+        size_t kept = total;
+        for (uint32_t i = 0; i < run; i++) {
+            const RollupRecord &record = records[total + i];
+            if (record.start == next + i * tier.period && record.checksum == checksum(record)) {
+                records[kept++] = record;
+            }
+        }
+        total = kept;
+        next += run * tier.period;
+    }
+
+    // The open bucket comes last, as a partial aggregate
+    if (total < maxRecords && next <= to && next == bucket.start) {
+        records[total++] = toRecord(bucket);
+        next += tier.period;
+    }
+    return total;
+}
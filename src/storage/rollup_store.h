@@ -0,0 +1,110 @@
+#ifndef ROLLUP_STORE_H
+#define ROLLUP_STORE_H
+
+#include <Arduino.h>
+#include <mutex>
+#include "hal.h"
+#include "history_block.h"
+
+class HistoryStore;
+
+// Aggregated metrics, in the same fixed point as HistoryRecord
+enum RollupMetric {
+    ROLLUP_TEMPERATURE,
+    ROLLUP_HUMIDITY,
+    ROLLUP_PRESSURE,
+    ROLLUP_SOIL_MOISTURE,
+    ROLLUP_METRIC_COUNT
+};
+
+struct __attribute__((packed)) RollupStat {
+    int16_t min;
+    int16_t max;
+    int16_t mean;
+    int16_t last;
+};
+
+// One closed (or, from read(), still open) bucket: 40 bytes on flash
+struct __attribute__((packed)) RollupRecord {
+    uint32_t start;      // Bucket start, unix time
+    uint16_t count;      // Samples aggregated
+    RollupStat stats[ROLLUP_METRIC_COUNT];
+    uint16_t checksum;   // Fletcher-16 of the preceding bytes; 0 marks an empty slot
+};
+
+// Multi-resolution rollups of the sensor history.
+//
+// The 1-minute tier is the HistoryStore itself; the 15-minute, hourly
+// and daily tiers are maintained here as each sample arrives. Each tier
+// is a fixed-size ring file under /rollup with one slot per bucket, so a
+// range query reads exactly the buckets it covers. Open buckets live in
+// RAM and are rebuilt from the history on boot, or carried across deep
+// sleep in retained memory.
+class RollupStore {
+public:
+    struct Tier {
+        const char *path;
+        uint32_t period;    // Seconds per bucket
+        uint32_t capacity;  // Buckets retained
+    };
+
+    static const int tierCount = 3;
+    static const Tier tiers[tierCount];
+
+    // Running aggregate of the open bucket; the mean uses Welford's update
+    struct Accumulator {
+        uint32_t start;
+        uint16_t count;
+        float min[ROLLUP_METRIC_COUNT];
+        float max[ROLLUP_METRIC_COUNT];
+        float mean[ROLLUP_METRIC_COUNT];
+        float last[ROLLUP_METRIC_COUNT];
+    };
+
+    // Open buckets, the time of the last sample folded into them and the
+    // latest time folded so far (later than the last after a clock step)
+    struct Retained {
+        Accumulator open[tierCount];
+        uint32_t newest;
+        uint32_t highest;
+    };
+
+private:
+    Accumulator open[tierCount];
+    uint32_t newest = 0;
+    uint32_t highest = 0;   // Latest sample time folded; buckets up to it may be on flash
+    uint32_t writeFloors[tierCount] = {};  // Buckets starting earlier are not written (replay)
+    mutable std::mutex lock;
+
+    void addLocked(const HistoryRecord &record);
+    void closeBucket(int tier);
+    void reopenBucket(int tier);
+    RollupRecord toRecord(const Accumulator &accumulator) const;
+
+    static uint16_t checksum(const RollupRecord &record);
+
+public:
+    // Create the tier files; rebuild open buckets (or, for new files, the
+    // whole tier) from the history. Retained buckets that end at the
+    // history's newest sample are taken as they are instead.
+    bool begin(HistoryStore &history, const Retained *retained = NULL);
+
+    void retain(Retained &retained) const;
+
+    // Fold one sample into every tier. After the clock was set back a
+    // sample keeps its time, and a bucket it lands in that was already
+    // closed continues from its stored aggregate.
+    void add(const HistoryRecord &record);
+
+    // Coarsest tier whose period fits the requested resolution in
+    // seconds, or -1 when only the raw 1-minute history does
+    int selectTier(uint32_t resolution) const;
+
+    // Range read: 'next' is the start of the next bucket to return and
+    // advances with each call; 0 records means the range is exhausted
+    size_t read(int tier, uint32_t &next, uint32_t to, RollupRecord *records, size_t maxRecords);
+
+    static float statValue(RollupMetric metric, int16_t value);
+};
+
+#endif
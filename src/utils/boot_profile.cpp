@@ -0,0 +1,43 @@
+#include "boot_profile.h"
+
+BootProfile::Phase::Phase(BootProfile &profile, const char *name)
+    : profile(profile), name(name), startMicros(hal::uptimeMicros()), startCycles(hal::cycleCount()) {
+}
+
+BootProfile::Phase::~Phase() {
+    uint32_t cycles = hal::cycleCount() - startCycles;
+    profile.add(name, startMicros, cycles / hal::cpuMhz(), false);
+}
+
+void BootProfile::add(const char *name, uint32_t startMicros, uint32_t micros, bool milestone) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (count < maxEntries) {
+        entries[count++] = { name, startMicros, micros, milestone };
+    }
+}
+
+void BootProfile::milestone(const char *name) {
+    if (getMilestone(name) == 0) {
+        add(name, hal::uptimeMicros(), 0, true);
+    }
+}
+
+uint32_t BootProfile::getMilestone(const char *name) const {
+    std::lock_guard<std::mutex> guard(lock);
+    for (int i = 0; i < count; i++) {
+        if (entries[i].milestone && strcmp(entries[i].name, name) == 0) {
+            return entries[i].startMicros;
+        }
+    }
+    return 0;
+}
+
+int BootProfile::getCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return count;
+}
+
+BootProfile::Entry BootProfile::getEntry(int index) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return entries[index];
+}
@@ -0,0 +1,54 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <Arduino.h>
+#include <mutex>
+#include "hal.h"
+
+// Timeline of one boot: each phase's start (uptime, comparable across
+// tasks) and its length in CPU cycles of the core that ran it, plus
+// zero-length milestones such as the first reading. Phases on different
+// tasks may overlap; that is the point of running them there.
+class BootProfile {
+public:
+    static const int maxEntries = 24;
+
+    struct Entry {
+        const char *name;
+        uint32_t startMicros;    // Uptime when the phase began
+        uint32_t micros;         // Length, from the cycle counter; 0 for a milestone
+        bool milestone;
+    };
+
+    // Times a phase from construction to destruction
+    class Phase {
+    private:
+        BootProfile &profile;
+        const char *name;
+        uint32_t startMicros;
+        uint32_t startCycles;
+
+    public:
+        Phase(BootProfile &profile, const char *name);
+        ~Phase();
+    };
+
+private:
+    Entry entries[maxEntries];
+    int count = 0;
+    mutable std::mutex lock;
+
+    void add(const char *name, uint32_t startMicros, uint32_t micros, bool milestone);
+
+public:
+    // Record a point in time; only the first call per name counts
+    void milestone(const char *name);
+
+    // Uptime of a milestone in microseconds, or 0 if not reached
+    uint32_t getMilestone(const char *name) const;
+
+    int getCount() const;
+    Entry getEntry(int index) const;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "duty_cycle.h"
+#include <algorithm>
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return crc;
+}
+
+DutyCycle::DutyCycle(Timekeeper &clock, SensorAcquisition &acquisition, WateringController &watering,
+                     RollupStore &rollups)
+    : clock(clock), acquisition(acquisition), watering(watering), rollups(rollups) {
+    static_assert(sizeof(RetainedState) <= hal::retainedMemorySize, "retained state exceeds RTC memory");
+}
+
+// CRC-32 of the state with its crc field zeroed
+uint32_t DutyCycle::checksum(const RetainedState &state) {
+    RetainedState copy = state;
+    copy.crc = 0;
+    return ~crc32Update(0xFFFFFFFF, (const uint8_t *)&copy, sizeof(copy));
+}
+
+bool DutyCycle::begin(bool enabled) {
+    std::lock_guard<std::mutex> guard(lock);
+    this->enabled = enabled;
+    restored = false;
+    if (hal::wakeCause() == hal::WAKE_POWER_ON) {
+        return false;
+    }
+
+    // Take the state exactly once; a crash before the next sleep must not replay it
+    memcpy(&retained, hal::retainedMemory(), sizeof(retained));
+    memset(hal::retainedMemory(), 0, sizeof(retained));
+    if (!enabled || retained.magic != retainedMagic || retained.version != retainedVersion ||
+        retained.size != sizeof(retained) || retained.crc != checksum(retained)) {
+        Serial.println("Duty cycle: no retained state, cold start");
+        return false;
+    }
+    restored = true;
+
+    // Of the time since going to sleep, what is not uptime was spent
+    // asleep and then in the ROM and bootloader
+    uint64_t uptime = hal::uptimeMicros();
+    uint64_t sinceSleep = hal::microsSinceSleep();
+    uint64_t offline = sinceSleep > uptime ? sinceSleep - uptime : 0;
+    uint64_t slept = std::min(offline, retained.sleepMicros);
+    bootMicros = offline - slept;
+
+    stats = retained.power;
+    stats.wakes++;
+    stats.sleepMicros += slept;
+    stats.activeMicros += bootMicros + uptime;
+    accountedAt = uptime;
+    wakeLatencyMicros = retained.wakeLatencyMicros;
+    return true;
+}
+
+bool DutyCycle::isFastBoot() const {
+    return restored && hal::wakeCause() == hal::WAKE_TIMER;
+}
+
+const RollupStore::Retained *DutyCycle::getRetainedRollups() const {
+    return restored ? &retained.rollups : NULL;
+}
+
+void DutyCycle::restore() {
+    if (!restored) {
+        return;
+    }
+    clock.resume(retained.clock, hal::microsSinceSleep());
+    acquisition.restore(retained.acquisition);
+    watering.setLastWateringDay(retained.lastWateringDay);
+}
+
+void DutyCycle::account() {
+    uint64_t now = hal::uptimeMicros();
+    uint64_t elapsed = now - accountedAt;
+    stats.activeMicros += elapsed;
+    if (radioOn) {
+        stats.radioMicros += elapsed;
+    }
+    accountedAt = now;
+}
+
+void DutyCycle::recordReading(unsigned long cycleStart) {
+    std::lock_guard<std::mutex> guard(lock);
+    account();
+
+    // The first reading after a wake counts from the timer or touch that
+    // ended the sleep; otherwise from the start of its cycle
+    uint32_t latency;
+    if (restored && firstReading) {
+        latency = accountedAt + bootMicros;
+        wakeLatencyMicros = latency;
+    } else {
+        latency = (hal::millis() - cycleStart) * 1000UL;
+    }
+    firstReading = false;
+    lastReadingAt = accountedAt;
+
+    stats.readings++;
+    stats.latencySumMicros += latency;
+    stats.latencyMaxMicros = std::max(stats.latencyMaxMicros, latency);
+}
+
+uint64_t DutyCycle::sleepDuration(unsigned long readingInterval, unsigned long untilWatering) const {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!enabled || firstReading) {
+        return 0;
+    }
+
+    uint64_t sinceReading = hal::uptimeMicros() - lastReadingAt;
+    uint64_t interval = readingInterval * (uint64_t)1000;
+    uint64_t until = sinceReading < interval ? interval - sinceReading : 0;
+    until = std::min(until, untilWatering * (uint64_t)1000);
+    if (until < minSleepMs * (uint64_t)1000 + wakeLatencyMicros) {
+        return 0;
+    }
+    return until - wakeLatencyMicros;
+}
+
+void DutyCycle::sleep(uint64_t micros, int touchPin, int touchThreshold) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        account();
+
+        RetainedState &state = retained;
+        state.magic = retainedMagic;
+        state.version = retainedVersion;
+        state.size = sizeof(state);
+        clock.suspend(state.clock);
+        acquisition.retain(state.acquisition);
+        rollups.retain(state.rollups);
+        state.lastWateringDay = watering.getLastWateringDay();
+        state.power = stats;
+        state.sleepMicros = micros;
+        state.wakeLatencyMicros = wakeLatencyMicros;
+        state.crc = checksum(state);
+        memcpy(hal::retainedMemory(), &state, sizeof(state));
+    }
+
+    Serial.printf("Duty cycle: sleeping %lu ms\n", (unsigned long)(micros / 1000));
+    hal::deepSleep(micros, touchPin, touchThreshold);
+}
+
+void DutyCycle::tick(bool radio) {
+    std::lock_guard<std::mutex> guard(lock);
+    account();
+    radioOn = radio;
+}
+
+DutyCycle::Report DutyCycle::getReport() {
+    std::lock_guard<std::mutex> guard(lock);
+    account();
+
+    Report report;
+    report.enabled = enabled;
+    report.wakes = stats.wakes;
+    report.readings = stats.readings;
+    report.activeMicros = stats.activeMicros;
+    report.radioMicros = stats.radioMicros;
+    report.sleepMicros = stats.sleepMicros;
+
+    // Time-weighted mean of the state currents
+    double total = stats.activeMicros + stats.sleepMicros;
+    double charge = (double)(stats.activeMicros - stats.radioMicros) * activeMa +
+                    (double)stats.radioMicros * radioMa + (double)stats.sleepMicros * sleepMa;
+    report.averageMa = total > 0 ? charge / total : 0;
+    report.latencyMeanMs = stats.readings > 0 ? stats.latencySumMicros / 1000.0 / stats.readings : 0;
+    report.latencyMaxMs = stats.latencyMaxMicros / 1000.0f;
+    return report;
+}
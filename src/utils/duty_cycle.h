@@ -0,0 +1,131 @@
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+#include <Arduino.h>
+#include <mutex>
+#include "hal.h"
+#include "timekeeper.h"
+#include "sensor_acquisition.h"
+#include "watering_controller.h"
+#include "storage/rollup_store.h"
+
+// Optional duty-cycle mode: deep sleep between sensor readings and
+// watering windows instead of idling with the CPU and radio on.
+//
+// Before sleeping, the clock, the filter windows, the last readings, the
+// open rollup buckets and the last watering day are copied into RTC
+// memory behind a checksum. A timer wake restores them and takes the
+// fast path: no WiFi and no web server, one reading, then back to sleep.
+// A touch on the pad wakes the board too and brings the network up.
+//
+// Time spent awake, with the radio up and asleep is accounted across
+// sleeps. The supply current is not measured directly; the report
+// weighs those times with the module's typical currents.
+class DutyCycle {
+public:
+    static const unsigned long minSleepMs = 10000;   // Shorter gaps are not worth a reboot
+
+    // ESP32 module supply current, typical datasheet figures (mA)
+    static constexpr float activeMa = 50.0f;   // CPU at 240 MHz, radio off
+    static constexpr float radioMa = 120.0f;   // Soft-AP up, mostly listening
+    static constexpr float sleepMa = 0.15f;    // RTC timer, RTC memory and touch pad sampling
+
+    struct Report {
+        bool enabled;
+        uint32_t wakes;
+        uint32_t readings;
+        uint64_t activeMicros;     // Awake, boot and the radio time included
+        uint64_t radioMicros;
+        uint64_t sleepMicros;
+        float averageMa;
+        float latencyMeanMs;       // Wake to published reading (cycle start when awake)
+        float latencyMaxMs;
+    };
+
+private:
+    struct PowerStats {
+        uint64_t activeMicros;
+        uint64_t radioMicros;
+        uint64_t sleepMicros;
+        uint32_t wakes;
+        uint32_t readings;
+        uint64_t latencySumMicros;
+        uint32_t latencyMaxMicros;
+    };
+
+    struct RetainedState {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t size;
+        Timekeeper::Retained clock;
+        SensorAcquisition::Retained acquisition;
+        RollupStore::Retained rollups;
+        int32_t lastWateringDay;
+        PowerStats power;
+        uint64_t sleepMicros;         // Requested for the sleep this wake ends
+        uint32_t wakeLatencyMicros;   // Wake to reading, measured on the last wake
+        uint32_t crc;                 // CRC-32 of everything before it
+    };
+
+    static const uint32_t retainedMagic = 0x44555459;   // "DUTY"
+    static const uint16_t retainedVersion = 2;
+
+    Timekeeper &clock;
+    SensorAcquisition &acquisition;
+    WateringController &watering;
+    RollupStore &rollups;
+
+    bool enabled = false;
+    bool restored = false;
+    RetainedState retained;           // Copy taken at boot, valid when restored
+
+    PowerStats stats = {};
+    uint64_t accountedAt = 0;         // Uptime up to which stats are accounted
+    bool radioOn = false;
+    uint32_t bootMicros = 0;          // Wake to app start, from the sleep timer
+    bool firstReading = true;
+    uint32_t wakeLatencyMicros = 0;
+    uint64_t lastReadingAt = 0;
+    mutable std::mutex lock;
+
+    void account();
+    static uint32_t checksum(const RetainedState &state);
+
+public:
+    DutyCycle(Timekeeper &clock, SensorAcquisition &acquisition, WateringController &watering,
+              RollupStore &rollups);
+
+    // Take over the state left in RTC memory, if the mode is on and this
+    // boot is a wake from its sleep. Returns true if it was.
+    bool begin(bool enabled);
+
+    bool isEnabled() const { return enabled; }
+
+    // Timer wake with restored state: skip WiFi and the web server
+    bool isFastBoot() const;
+
+    // Open rollup buckets to start from, NULL unless restored
+    const RollupStore::Retained *getRetainedRollups() const;
+
+    // Hand the clock, filters, readings and watering day back to their owners
+    void restore();
+
+    // A reading was published; cycleStart is the millis() it started at
+    void recordReading(unsigned long cycleStart);
+
+    // Microseconds to sleep given the reading interval and the time (ms)
+    // until the controller next has work; 0 when too short to be worth it.
+    // Wakes early by the last measured wake-to-reading latency, so readings
+    // keep the interval.
+    uint64_t sleepDuration(unsigned long readingInterval, unsigned long untilWatering) const;
+
+    // Retain the state and enter deep sleep; returns only in the simulation
+    void sleep(uint64_t micros, int touchPin, int touchThreshold);
+
+    // Account time since the last call; radio is whether WiFi is up
+    void tick(bool radio);
+
+    Report getReport();
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+
+// Streaming sample filters, composed at compile time:
+//
+//   Pipeline<RangeGate<1, 4095>, Median<5>> soil;
+//   float value = reading;
+//   if (soil.process(value)) { ... value is the filtered sample ... }
+//
+// Each stage takes one sample and either passes a (possibly replaced)
+// value on or drops the sample. Window sizes are template parameters, so
+// storage is fixed and nothing is allocated.
+
+// Drops samples outside [Min, Max], e.g. a disconnected probe or an
+// implausible conversion
+template <int Min, int Max>
+class RangeGate {
+public:
+    bool process(float &value) {
+        return !isnan(value) && value >= Min && value <= Max;
+    }
+
+    void reset() {
+    }
+};
+
+// Fixed window of the most recent samples
+template <int N>
+class SampleWindow {
+    static_assert(N > 0 && N <= 32, "window size");
+
+protected:
+    float samples[N];
+    int count = 0;
+    int next = 0;
+
+    void add(float value) {
+        samples[next] = value;
+        next = (next + 1) % N;
+        if (count < N) {
+            count++;
+        }
+    }
+
+    // Median of the current window (insertion sort; N is small)
+    static float median(float *values, int n) {
+        for (int i = 1; i < n; i++) {
+            float v = values[i];
+            int j = i - 1;
+            while (j >= 0 && values[j] > v) {
+                values[j + 1] = values[j];
+                j--;
+            }
+            values[j + 1] = v;
+        }
+        return (n % 2) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    }
+
+public:
+    void reset() {
+        count = 0;
+        next = 0;
+    }
+};
+
+// Running median of the last N samples; rejects up to (N-1)/2 spikes per window
+template <int N>
+class Median : public SampleWindow<N> {
+public:
+    bool process(float &value) {
+        this->add(value);
+        float sorted[N];
+        for (int i = 0; i < this->count; i++) {
+            sorted[i] = this->samples[i];
+        }
+        value = this->median(sorted, this->count);
+        return true;
+    }
+};
+
+// Hampel identifier over the last N samples: a sample further than
+// K scaled median absolute deviations from the window median is replaced
+// by the median. Passes samples through until the window has three, or
+// while the window is flat (no spread to judge by).
+template <int N, int K = 3>
+class Hampel : public SampleWindow<N> {
+public:
+    bool process(float &value) {
+        this->add(value);
+        if (this->count < 3) {
+            return true;
+        }
+
+        float sorted[N];
+        for (int i = 0; i < this->count; i++) {
+            sorted[i] = this->samples[i];
+        }
+        float center = this->median(sorted, this->count);
+        for (int i = 0; i < this->count; i++) {
+            sorted[i] = fabsf(sorted[i] - center);
+        }
+        float spread = 1.4826f * this->median(sorted, this->count);
+
+        if (spread > 0 && fabsf(value - center) > K * spread) {
+            value = center;
+        }
+        return true;
+    }
+};
+
+// Exponentially weighted moving average, alpha = Num / Den
+template <int Num, int Den>
+class Ewma {
+    static_assert(Num > 0 && Num <= Den, "alpha must be in (0, 1]");
+
+private:
+    float average = 0;
+    bool primed = false;
+
+public:
+    bool process(float &value) {
+        if (!primed) {
+            average = value;
+            primed = true;
+        } else {
+            average += (value - average) * Num / Den;
+        }
+        value = average;
+        return true;
+    }
+
+    void reset() {
+        primed = false;
+    }
+};
+
+// Stages applied in order; a dropped sample stops at the stage that dropped it
+template <typename... Stages>
+class Pipeline;
+
+template <>
+class Pipeline<> {
+public:
+    bool process(float &value) {
+        (void)value;
+        return true;
+    }
+
+    void reset() {
+    }
+};
+
+template <typename First, typename... Rest>
+class Pipeline<First, Rest...> {
+private:
+    First first;
+    Pipeline<Rest...> rest;
+
+public:
+    bool process(float &value) {
+        return first.process(value) && rest.process(value);
+    }
+
+    void reset() {
+        first.reset();
+        rest.reset();
+    }
+};
+
+// Mean of a batch after dropping the lowest and highest `trim` samples;
+// sorts the batch in place. trim = count / 4 gives the interquartile mean.
+inline float trimmedMean(uint16_t *samples, size_t count, size_t trim) {
+    if (count == 0 || 2 * trim >= count) {
+        return NAN;
+    }
+    std::sort(samples, samples + count);
+
+    uint32_t sum = 0;
+    for (size_t i = trim; i < count - trim; i++) {
+        sum += samples[i];
+    }
+    return (float)sum / (count - 2 * trim);
+}
+
+#endif
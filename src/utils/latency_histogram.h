@@ -0,0 +1,100 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <stdint.h>
+#include "seqlock.h"
+
+// Log-linear histogram of durations in microseconds. Each power of two is
+// split into subBuckets equal parts, so a bucket is never wider than half
+// its lower bound, from 1 us up to maxBits (about 33 s); longer durations
+// are counted past the last bucket.
+//
+// Recorded from one task only; any task may read. Counts are plain
+// atomics and the 64-bit sum is published through a SeqLock, so the
+// recording task never waits; a reader only waits out a write in progress.
+class LatencyHistogram {
+public:
+    static const int subBucketBits = 1;
+    static const int subBuckets = 1 << subBucketBits;
+    static const int maxBits = 25;
+    static const int bucketCount = (maxBits - subBucketBits + 1) * subBuckets;
+
+    // Counts per bucket, the last past the top; a copy taken by a reader
+    struct Snapshot {
+        uint32_t counts[bucketCount + 1];
+        uint32_t count;
+        uint64_t sumMicros;
+
+        // Estimated duration below which the given fraction lies,
+        // interpolated within its bucket; 0 when empty
+        double quantileMicros(double quantile) const {
+            if (count == 0) {
+                return 0;
+            }
+            double rank = quantile * count;
+            uint32_t below = 0;
+            for (int i = 0; i < bucketCount; i++) {
+                if (counts[i] > 0 && below + counts[i] >= rank) {
+                    double fraction = (rank - below) / counts[i];
+                    return lowerBound(i) + fraction * (lowerBound(i + 1) - lowerBound(i));
+                }
+                below += counts[i];
+            }
+            return lowerBound(bucketCount);
+        }
+    };
+
+private:
+    std::atomic<uint32_t> counts[bucketCount + 1];
+    uint64_t sum = 0;               // Writer's copy
+    SeqLock<uint64_t> publishedSum;
+
+public:
+    LatencyHistogram() {
+        for (int i = 0; i <= bucketCount; i++) {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static int bucketFor(uint32_t micros) {
+        if (micros < (uint32_t)subBuckets) {
+            return micros;
+        }
+        if (micros >= 1UL << maxBits) {
+            return bucketCount;
+        }
+        int msb = 31 - __builtin_clz(micros);
+        int shift = msb - subBucketBits;
+        return (shift + 1) * subBuckets + (int)((micros >> shift) - subBuckets);
+    }
+
+    // Smallest duration in the bucket; bucket i holds [lowerBound(i), lowerBound(i + 1))
+    static uint32_t lowerBound(int bucket) {
+        if (bucket < subBuckets) {
+            return bucket;
+        }
+        int shift = bucket / subBuckets - 1;
+        return (uint32_t)(subBuckets + bucket % subBuckets) << shift;
+    }
+
+    void record(uint32_t micros) {
+        std::atomic<uint32_t> &bucket = counts[bucketFor(micros)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum += micros;
+        publishedSum.write(sum);
+    }
+
+    Snapshot snapshot() const {
+        Snapshot copy;
+        copy.count = 0;
+        for (int i = 0; i <= bucketCount; i++) {
+            copy.counts[i] = counts[i].load(std::memory_order_relaxed);
+            copy.count += copy.counts[i];
+        }
+        copy.sumMicros = publishedSum.read();
+        return copy;
+    }
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler() {
+    memset(slots, -1, sizeof(slots));
+}
+
+int Scheduler::addJob(const char *name, JobFunction function, void *context) {
+    if (jobCount >= maxJobs) {
+        return -1;
+    }
+
+    Job &job = jobs[jobCount];
+    memset(&job, 0, sizeof(job));
+    job.name = name;
+    job.function = function;
+    job.context = context;
+    job.level = -1;
+    return jobCount++;
+}
+
+// Coarsest level whose slot index still differs from the current one by
+// less than a full turn; a due time beyond the horizon parks in the last
+// slot and is re-filed when that slot comes up
+void Scheduler::insert(int id) {
+    Job &job = jobs[id];
+    uint64_t at = job.due < position ? position : job.due;
+    if (at - position > horizonMs) {
+        at = position + horizonMs;
+    }
+
+    int level = 0;
+    while (level < levels - 1 &&
+           (at >> (levelBits * level)) - (position >> (levelBits * level)) >= (uint64_t)slotsPerLevel) {
+        level++;
+    }
+    int slot = (at >> (levelBits * level)) & (slotsPerLevel - 1);
+
+    job.at = at;
+    job.level = level;
+    job.slot = slot;
+    job.prev = -1;
+    job.next = slots[level][slot];
+    if (job.next >= 0) {
+        jobs[job.next].prev = id;
+    }
+    slots[level][slot] = id;
+    occupied[level] |= 1ULL << slot;
+}
+
+void Scheduler::remove(int id) {
+    Job &job = jobs[id];
+    if (job.level < 0) {
+        return;
+    }
+
+    if (job.prev >= 0) {
+        jobs[job.prev].next = job.next;
+    } else {
+        slots[job.level][job.slot] = job.next;
+    }
+    if (job.next >= 0) {
+        jobs[job.next].prev = job.prev;
+    }
+    if (slots[job.level][job.slot] < 0) {
+        occupied[job.level] &= ~(1ULL << job.slot);
+    }
+    job.level = -1;
+}
+
+// Move the wheel forward. Jobs in each slot that is reached (or jumped
+// over, which only a job parked beyond the horizon can be in) drop to a
+// finer level.
+void Scheduler::advance(uint64_t to) {
+    if (to <= position) {
+        return;
+    }
+    uint64_t from = position;
+    position = to;
+
+    for (int level = 1; level < levels; level++) {
+        uint64_t first = (from >> (levelBits * level)) + 1;
+        uint64_t last = to >> (levelBits * level);
+        if (last >= first + slotsPerLevel) {
+            first = last - slotsPerLevel + 1;
+        }
+        for (uint64_t index = first; index <= last; index++) {
+            int id = slots[level][index & (slotsPerLevel - 1)];
+            while (id >= 0) {
+                int next = jobs[id].next;
+                remove(id);
+                insert(id);
+                id = next;
+            }
+        }
+    }
+}
+
+void Scheduler::scheduleAt(int id, uint64_t dueMs) {
+    if (id < 0 || id >= jobCount) {
+        return;
+    }
+
+    remove(id);
+
+    // An idle wheel can jump straight to the present
+    bool idle = true;
+    for (int level = 0; level < levels; level++) {
+        idle = idle && occupied[level] == 0;
+    }
+    if (idle) {
+        position = nowMs();
+    }
+
+    jobs[id].due = dueMs;
+    insert(id);
+}
+
+void Scheduler::scheduleIn(int id, unsigned long delayMs) {
+    scheduleAt(id, nowMs() + delayMs);
+}
+
+void Scheduler::cancel(int id) {
+    if (id >= 0 && id < jobCount) {
+        remove(id);
+    }
+}
+
+bool Scheduler::isPending(int id) const {
+    return id >= 0 && id < jobCount && jobs[id].level >= 0;
+}
+
+// First non-empty slot at or after the current one
+int Scheduler::firstOccupied(int level) const {
+    uint64_t bits = occupied[level];
+    if (bits == 0) {
+        return -1;
+    }
+    int current = (position >> (levelBits * level)) & (slotsPerLevel - 1);
+    uint64_t rotated = current == 0 ? bits : (bits >> current) | (bits << (slotsPerLevel - current));
+    return (current + __builtin_ctzll(rotated)) & (slotsPerLevel - 1);
+}
+
+// Slots at one level are in time order from the current one, so each
+// level's earliest job is in its first occupied slot. A job parked at the
+// horizon counts as due there, which is when it gets filed again.
+uint64_t Scheduler::nextDeadline() const {
+    uint64_t earliest = UINT64_MAX;
+    for (int level = 0; level < levels; level++) {
+        int slot = firstOccupied(level);
+        for (int id = slot < 0 ? -1 : slots[level][slot]; id >= 0; id = jobs[id].next) {
+            if (jobs[id].at < earliest) {
+                earliest = jobs[id].at;
+            }
+        }
+    }
+    return earliest;
+}
+
+unsigned long Scheduler::msUntilNext(unsigned long maxMs) const {
+    uint64_t deadline = nextDeadline();
+    uint64_t now = nowMs();
+    if (deadline <= now) {
+        return 0;
+    }
+    return deadline - now < maxMs ? deadline - now : maxMs;
+}
+
+int Scheduler::runDue() {
+    int ran = 0;
+    for (;;) {
+        uint64_t now = nowMs();
+        uint64_t deadline = nextDeadline();
+        if (deadline > now) {
+            advance(now);
+            return ran;
+        }
+
+        // Find the job with that deadline and take it off the wheel, so
+        // it can reschedule itself
+        int id = -1;
+        for (int level = 0; level < levels && id < 0; level++) {
+            int slot = firstOccupied(level);
+            for (int i = slot < 0 ? -1 : slots[level][slot]; i >= 0; i = jobs[i].next) {
+                if (jobs[i].at == deadline) {
+                    id = i;
+                    break;
+                }
+            }
+        }
+        remove(id);
+        advance(deadline);
+
+        Job &job = jobs[id];
+        if (job.due > deadline) {
+            insert(id);
+            continue;
+        }
+
+        uint64_t startMicros = hal::uptimeMicros();
+        uint64_t dueMicros = job.due * 1000;
+        job.lastLatenessUs = startMicros > dueMicros ? startMicros - dueMicros : 0;
+        if (job.lastLatenessUs > job.maxLatenessUs) {
+            job.maxLatenessUs = job.lastLatenessUs;
+        }
+        job.runs++;
+        job.function(job.context);
+        ran++;
+    }
+}
+
+Scheduler::JobReport Scheduler::getReport(int id) const {
+    JobReport report = {};
+    if (id >= 0 && id < jobCount) {
+        const Job &job = jobs[id];
+        report.name = job.name;
+        report.runs = job.runs;
+        report.lastLatenessUs = job.lastLatenessUs;
+        report.maxLatenessUs = job.maxLatenessUs;
+        report.pending = job.level >= 0;
+    }
+    return report;
+}
@@ -0,0 +1,91 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include "hal.h"
+
+// Job scheduler on a hierarchical timer wheel, so a task can sleep until
+// exactly its next deadline instead of polling.
+//
+// Five levels of 64 slots at 1 ms resolution reach about 12 days ahead.
+// A job sits in the coarsest slot that still tells it apart from the
+// current time and moves down a level as that slot comes up, so insert,
+// cancel and finding the next deadline never walk more than one slot per
+// level. Jobs keep their exact due time; lateness is recorded per job.
+//
+// Not thread-safe: each task owns its scheduler. Other tasks reach it
+// through that task's command queue.
+class Scheduler {
+public:
+    static const int maxJobs = 8;
+    typedef void (*JobFunction)(void *context);
+
+    struct JobReport {
+        const char *name;
+        uint32_t runs;
+        uint32_t lastLatenessUs;   // Start of the last run past its due time
+        uint32_t maxLatenessUs;
+        bool pending;
+    };
+
+private:
+    static const int levelBits = 6;
+    static const int slotsPerLevel = 1 << levelBits;
+    static const int levels = 5;
+    static const uint64_t horizonMs = (uint64_t)(slotsPerLevel - 1) << (levelBits * (levels - 1));
+
+    struct Job {
+        const char *name;
+        JobFunction function;
+        void *context;
+        uint64_t due;          // Uptime in ms
+        uint64_t at;           // Time it is filed under; before due only past the horizon
+        int8_t next;           // Slot list links, -1 terminated
+        int8_t prev;
+        int8_t level;          // -1 when not scheduled
+        uint8_t slot;
+        uint32_t runs;
+        uint32_t lastLatenessUs;
+        uint32_t maxLatenessUs;
+    };
+
+    Job jobs[maxJobs];
+    int jobCount = 0;
+    int8_t slots[levels][slotsPerLevel];
+    uint64_t occupied[levels] = {};   // Bit per non-empty slot
+    uint64_t position = 0;             // Wheel time; slots are relative to it
+
+    void insert(int id);
+    void remove(int id);
+    void advance(uint64_t to);
+    int firstOccupied(int level) const;
+
+public:
+    Scheduler();
+
+    // Register a job; returns its id, or -1 when full
+    int addJob(const char *name, JobFunction function, void *context = NULL);
+
+    // (Re)schedule a job; a job is due at most once until it runs again
+    void scheduleAt(int id, uint64_t dueMs);
+    void scheduleIn(int id, unsigned long delayMs);
+    void cancel(int id);
+    bool isPending(int id) const;
+
+    // Uptime in ms, the scheduler's time base
+    static uint64_t nowMs() { return hal::uptimeMicros() / 1000; }
+
+    // Earliest due time, or UINT64_MAX when idle
+    uint64_t nextDeadline() const;
+
+    // Time to sleep before the next job, at most maxMs
+    unsigned long msUntilNext(unsigned long maxMs) const;
+
+    // Run every job that is due; returns how many ran
+    int runDue();
+
+    int getJobCount() const { return jobCount; }
+    JobReport getReport(int id) const;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <string.h>
+#include "hal.h"
+
+// Single-writer sequence lock.
+// The writer never blocks; readers on any task or core copy the value and
+// retry if a write overlapped the copy. T must be trivially copyable.
+//
+// A reader that preempted the writer on the same core would spin forever,
+// since the writer cannot run to finish its write, so after a few failed
+// attempts the reader blocks for a tick and lets it.
+template <typename T>
+class SeqLock {
+public:
+    static const int spinAttempts = 8;
+
+private:
+    std::atomic<uint32_t> sequence{0};
+    T value;
+
+public:
+    SeqLock() {
+        memset(&value, 0, sizeof(T));
+    }
+
+    // Must only be called from one task
+    void write(const T &newValue) {
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+
+        // Odd sequence marks a write in progress
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        memcpy(&value, &newValue, sizeof(T));
+
+        std::atomic_thread_fence(std::memory_order_release);
+        sequence.store(seq + 2, std::memory_order_relaxed);
+    }
+
+    T read() const {
+        T copy;
+        for (int attempts = 1;; attempts++) {
+            uint32_t before = sequence.load(std::memory_order_acquire);
+
+            // Odd: the writer is mid-update
+            if (!(before & 1)) {
+                memcpy(&copy, &value, sizeof(T));
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint32_t after = sequence.load(std::memory_order_relaxed);
+                if (before == after) {
+                    return copy;
+                }
+            }
+
+            if (attempts % spinAttempts == 0) {
+                hal::yieldTick();
+            }
+        }
+    }
+
+    // Number of completed writes; cheap change detection without copying
+    uint32_t version() const {
+        return sequence.load(std::memory_order_acquire) >> 1;
+    }
+};
+
+#endif
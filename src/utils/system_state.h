@@ -0,0 +1,60 @@
+#ifndef SYSTEM_STATE_H
+#define SYSTEM_STATE_H
+
+#include <Arduino.h>
+#include "seqlock.h"
+
+// Consistent view of the sensor readings and actuator state.
+// Published by the control task, read by the web handlers.
+struct SystemState {
+    uint32_t generation;  // Increments on every publish
+
+    // Sensor readings
+    float temperature;
+    float humidity;
+    float pressure;
+    float heatIndex;
+    int soilMoistureRaw;
+    int soilMillivolts;
+    float soilMoisturePercent;
+    unsigned long lastSensorUpdate;  // millis() of the last completed reading
+
+    // Actuators
+    bool relays[4];
+    bool isWatering;
+    unsigned long wateringStartTime;
+    unsigned long wateringDuration;
+
+    // Seconds left in the current watering cycle at the given millis()
+    unsigned long wateringRemaining(unsigned long now) const {
+        if (!isWatering) {
+            return 0;
+        }
+        unsigned long elapsed = now - wateringStartTime;
+        return (elapsed < wateringDuration) ? (wateringDuration - elapsed) / 1000 : 0;
+    }
+};
+
+class SystemStatePublisher {
+private:
+    SeqLock<SystemState> state;
+    uint32_t generation = 0;
+
+public:
+    // Single writer: the control task
+    void publish(SystemState snapshot) {
+        snapshot.generation = ++generation;
+        state.write(snapshot);
+    }
+
+    // Lock-free, callable from any task
+    SystemState read() const {
+        return state.read();
+    }
+
+    uint32_t getGeneration() const {
+        return state.version();
+    }
+};
+
+#endif
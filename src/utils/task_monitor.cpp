@@ -0,0 +1,73 @@
+#include "task_monitor.h"
+#include "esp_timer.h"
+
+int TaskMonitor::registerTask(const char *name, TaskHandle_t handle, bool tracksWork) {
+    portENTER_CRITICAL(&lock);
+    int slot = -1;
+    if (taskCount < maxTasks) {
+        // Filled in before it is counted; readers check the count unlocked
+        slot = taskCount;
+        entries[slot].name = name;
+        entries[slot].handle = handle;
+        entries[slot].tracksWork = tracksWork;
+        entries[slot].busyMicros = 0;
+        entries[slot].workStart = 0;
+        taskCount = slot + 1;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (slot < 0) {
+        Serial.printf("Task monitor full, %s not tracked\n", name);
+    }
+    return slot;
+}
+
+void TaskMonitor::beginWork(int slot) {
+    if (slot < 0 || slot >= taskCount) {
+        return;
+    }
+    entries[slot].workStart = esp_timer_get_time();
+}
+
+void TaskMonitor::endWork(int slot) {
+    if (slot < 0 || slot >= taskCount) {
+        return;
+    }
+    int64_t elapsed = esp_timer_get_time() - entries[slot].workStart;
+    entries[slot].workTimes.record(elapsed < UINT32_MAX ? elapsed : UINT32_MAX);
+
+    // 64-bit counter is read from other tasks, so update it atomically
+    portENTER_CRITICAL(&lock);
+    entries[slot].busyMicros += elapsed;
+    portEXIT_CRITICAL(&lock);
+}
+
+int TaskMonitor::getTaskCount() {
+    return taskCount;
+}
+
+TaskReport TaskMonitor::getReport(int slot) {
+    TaskReport report = { "", 0, -1, 0 };
+    if (slot < 0 || slot >= taskCount) {
+        return report;
+    }
+
+    portENTER_CRITICAL(&lock);
+    report.name = entries[slot].name;
+    report.busyMicros = entries[slot].busyMicros;
+    bool tracksWork = entries[slot].tracksWork;
+    TaskHandle_t handle = entries[slot].handle;
+    portEXIT_CRITICAL(&lock);
+
+    // ESP-IDF reports the high-water mark in bytes, not words
+    if (handle != NULL) {
+        report.stackHighWater = uxTaskGetStackHighWaterMark(handle);
+    }
+
+    if (tracksWork) {
+        int64_t uptime = esp_timer_get_time();
+        report.cpuPercent = (uptime > 0) ? (100.0f * report.busyMicros / uptime) : 0;
+    }
+
+    return report;
+}
@@ -0,0 +1,52 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <Arduino.h>
+#include "latency_histogram.h"
+
+// Per-task runtime statistics.
+// The Arduino core is built without FreeRTOS run-time stats, so each task
+// brackets its own work with beginWork()/endWork() and the monitor derives
+// the CPU share from the accumulated busy time.
+struct TaskReport {
+    const char *name;
+    uint32_t stackHighWater;  // Minimum free stack ever seen, in bytes
+    float cpuPercent;         // Share of wall time spent working, -1 if not tracked
+    uint64_t busyMicros;
+};
+
+class TaskMonitor {
+public:
+    static const int maxTasks = 8;
+
+private:
+    struct Entry {
+        const char *name;
+        TaskHandle_t handle;
+        bool tracksWork;
+        uint64_t busyMicros;
+        int64_t workStart;
+        LatencyHistogram workTimes;   // Recorded by the task itself
+    };
+
+    Entry entries[maxTasks];
+    int taskCount = 0;
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+public:
+    // Register a task; returns its slot or -1 if the table is full.
+    // Tasks registered with tracksWork = false only report stack usage.
+    int registerTask(const char *name, TaskHandle_t handle, bool tracksWork = true);
+
+    // Bracket one unit of work from inside the task owning the slot
+    void beginWork(int slot);
+    void endWork(int slot);
+
+    int getTaskCount();
+    TaskReport getReport(int slot);
+
+    // Length of each unit of work, i.e. each pass of the task's loop
+    const LatencyHistogram &getWorkTimes(int slot) const { return entries[slot].workTimes; }
+};
+
+#endif
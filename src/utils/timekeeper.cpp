@@ -0,0 +1,153 @@
+#include "timekeeper.h"
+
+void Timekeeper::begin() {
+    std::lock_guard<std::mutex> guard(writeLock);
+    anchor();
+    Serial.printf("Timekeeper: anchored to RTC at %lu\n", (unsigned long)clock.read().anchorUnix);
+}
+
+// Place the anchor in the middle of the current RTC second; update()
+// moves it onto the next edge. anchorMicros may wrap below zero right
+// after boot, the unsigned difference still works.
+void Timekeeper::anchor() {
+    uint32_t rtc = hal::rtcNow().unixtime;
+
+    // The crystal keeps its rate across re-anchoring
+    Clock fresh = clock.read();
+    fresh.anchorUnix = rtc;
+    fresh.anchorMicros = hal::uptimeMicros() - 500000;
+    clock.write(fresh);
+    lastSync = hal::uptimeMicros();
+    edgeSecond = rtc;
+    onEdge = false;
+}
+
+int64_t Timekeeper::millisAt(const Clock &clock, uint64_t micros) {
+    int64_t elapsedMs = (micros - clock.anchorMicros) / 1000;
+    return clock.anchorUnix * 1000LL + elapsedMs + elapsedMs * clock.driftPpb / 1000000000LL;
+}
+
+uint32_t Timekeeper::unixAt(const Clock &clock, uint64_t micros) {
+    return millisAt(clock, micros) / 1000;
+}
+
+void Timekeeper::suspend(Retained &retained) const {
+    Clock current = clock.read();
+    retained.unixMs = millisAt(current, hal::uptimeMicros());
+    retained.driftPpb = current.driftPpb;
+}
+
+void Timekeeper::resume(const Retained &retained, uint64_t sleptMicros) {
+    std::lock_guard<std::mutex> guard(writeLock);
+    Clock fresh = clock.read();
+    fresh.driftPpb = retained.driftPpb;
+    clock.write(fresh);
+
+    // The sleep timer is far coarser than the crystal, so the RTC bounds
+    // the estimate to its current second
+    uint32_t rtc = hal::rtcNow().unixtime;
+    uint64_t at = hal::uptimeMicros();
+    int64_t estimateMs = retained.unixMs + (int64_t)(sleptMicros / 1000);
+    int64_t errorMs = estimateMs - rtc * 1000LL;
+    if (errorMs < -maxErrorMs || errorMs > maxErrorMs + 1000) {
+        Serial.printf("Timekeeper: %ld ms off the RTC after sleep, re-anchoring\n", (long)errorMs);
+        anchor();
+        return;
+    }
+    estimateMs = constrain(estimateMs, rtc * 1000LL, rtc * 1000LL + 999);
+
+    // anchorMicros may wrap below zero; the unsigned difference still works
+    fresh.anchorUnix = estimateMs / 1000;
+    fresh.anchorMicros = at - (estimateMs % 1000) * 1000;
+    clock.write(fresh);
+    lastSync = at;
+    onEdge = true;
+    lastReturned.store(fresh.anchorUnix, std::memory_order_relaxed);
+}
+
+unsigned long Timekeeper::msUntilUpdate() const {
+    if (!onEdge) {
+        return edgePollMs;
+    }
+    uint64_t since = (hal::uptimeMicros() - lastSync) / 1000;
+    return since < syncInterval * 1000ULL ? syncInterval * 1000ULL - since : 0;
+}
+
+void Timekeeper::update() {
+    // Anchor on the edge once the seconds register ticks over
+    if (!onEdge) {
+        std::lock_guard<std::mutex> guard(writeLock);
+        uint32_t rtc = hal::rtcNow().unixtime;
+        if (rtc != edgeSecond) {
+            Clock fresh = clock.read();
+            fresh.anchorUnix = rtc;
+            fresh.anchorMicros = hal::uptimeMicros();
+            clock.write(fresh);
+            lastSync = fresh.anchorMicros;
+            onEdge = true;
+        }
+        return;
+    }
+
+    if (hal::uptimeMicros() - lastSync < syncInterval * 1000000ULL) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(writeLock);
+    uint32_t rtc = hal::rtcNow().unixtime;
+    uint64_t at = hal::uptimeMicros();
+    lastSync = at;
+    syncCount++;
+
+    // The RTC second began somewhere in the last second; take its middle
+    Clock current = clock.read();
+    int64_t rtcMs = rtc * 1000LL + 500;
+    int64_t errorMs = rtcMs - millisAt(current, at);
+    lastErrorMs = errorMs;
+
+    if (errorMs > maxErrorMs || errorMs < -maxErrorMs) {
+        Serial.printf("Timekeeper: %ld ms off the RTC, re-anchoring\n", (long)errorMs);
+        anchor();
+        return;
+    }
+
+    // Rate that makes the local clock meet the RTC over the whole span
+    // since the anchor; the half-second uncertainty shrinks as it grows
+    int64_t localMs = (at - current.anchorMicros) / 1000;
+    if (localMs >= driftBaseline * 1000LL) {
+        int64_t rtcSpanMs = rtcMs - current.anchorUnix * 1000LL;
+        int64_t driftPpb = (rtcSpanMs - localMs) * 1000000000LL / localMs;
+        current.driftPpb = constrain(driftPpb, (int64_t)-maxDriftPpb, (int64_t)maxDriftPpb);
+        clock.write(current);
+    }
+}
+
+uint32_t Timekeeper::unixtime() const {
+    uint32_t time = unixAt(clock.read(), hal::uptimeMicros());
+
+    // Hold through a small backward correction instead of repeating a second
+    uint32_t last = lastReturned.load(std::memory_order_relaxed);
+    if (time < last && last - time <= maxErrorMs / 1000) {
+        return last;
+    }
+    lastReturned.store(time, std::memory_order_relaxed);
+    return time;
+}
+
+hal::WallTime Timekeeper::now() const {
+    return hal::wallTimeFromUnix(unixtime());
+}
+
+void Timekeeper::adjust(const hal::WallTime &time) {
+    std::lock_guard<std::mutex> guard(writeLock);
+    hal::rtcAdjust(time);
+
+    // Writing the seconds register restarts the RTC's second, so this is an edge
+    Clock fresh = clock.read();
+    fresh.anchorUnix = time.unixtime;
+    fresh.anchorMicros = hal::uptimeMicros();
+    clock.write(fresh);
+    lastSync = fresh.anchorMicros;
+    onEdge = true;
+    lastReturned.store(time.unixtime, std::memory_order_relaxed);
+}
@@ -0,0 +1,86 @@
+#ifndef TIMEKEEPER_H
+#define TIMEKEEPER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <mutex>
+#include "hal.h"
+#include "seqlock.h"
+
+// Wall clock kept from the local microsecond timer and disciplined by
+// the DS3231, so reading the time costs no I2C transaction.
+//
+// At boot one RTC read anchors the clock to the middle of the current
+// second; the io task then polls for the next seconds edge and moves the
+// anchor onto it, to well under a second, without holding up the boot.
+// After that the io task reads the RTC once an hour. Those reads refine the rate correction (drift of the local
+// crystal against the RTC, measured over the whole time since the
+// anchor) and re-anchor if the two disagree by more than a couple of
+// seconds, e.g. after the RTC was set elsewhere.
+class Timekeeper {
+public:
+    static const uint32_t syncInterval = 3600;          // Seconds between RTC reads
+    static const uint32_t driftBaseline = 6 * 3600;     // Shortest span used to estimate drift
+    static const int32_t maxDriftPpb = 200000;          // Beyond this the crystal or RTC is faulty
+    static const int32_t maxErrorMs = 2000;             // Larger disagreement re-anchors
+    static const unsigned long edgePollMs = 10;          // RTC polling while looking for an edge
+
+    // What survives a deep sleep: the time going to sleep and the crystal
+    // rate, so a wake needs one RTC read rather than a poll for an edge
+    struct Retained {
+        int64_t unixMs;
+        int32_t driftPpb;
+    };
+
+private:
+    struct Clock {
+        uint32_t anchorUnix;     // RTC time at a seconds edge
+        uint64_t anchorMicros;   // hal::uptimeMicros() at that edge
+        int32_t driftPpb;        // Local clock rate correction, parts per billion
+    };
+
+    // Readers are lock-free; writers (io task, web handlers) take writeLock
+    SeqLock<Clock> clock;
+    std::mutex writeLock;
+    mutable std::atomic<uint32_t> lastReturned{0};
+
+    uint64_t lastSync = 0;
+    uint32_t syncCount = 0;
+    int32_t lastErrorMs = 0;
+    bool onEdge = false;         // Anchor sits on a seconds edge, not a mid-second guess
+    uint32_t edgeSecond = 0;     // RTC second the anchor was guessed in
+
+    void anchor();
+    static uint32_t unixAt(const Clock &clock, uint64_t micros);
+    static int64_t millisAt(const Clock &clock, uint64_t micros);
+
+public:
+    // Anchor to the RTC with one read; update() refines it
+    void begin();
+
+    // Carry the clock across deep sleep. resume() extrapolates over the
+    // sleep and checks the estimate against a single RTC read, anchoring
+    // as begin() does if the two disagree.
+    void suspend(Retained &retained) const;
+    void resume(const Retained &retained, uint64_t sleptMicros);
+
+    // Called periodically from the io task; reads the RTC when a sync or
+    // the edge search is due
+    void update();
+
+    // Milliseconds until update() has work
+    unsigned long msUntilUpdate() const;
+
+    // Current time, no I2C; never steps back by less than a correction
+    uint32_t unixtime() const;
+    hal::WallTime now() const;
+
+    // Set the RTC and re-anchor
+    void adjust(const hal::WallTime &time);
+
+    float getDriftPpm() const { return clock.read().driftPpb / 1000.0f; }
+    uint32_t getSyncCount() const { return syncCount; }
+    int32_t getLastErrorMs() const { return lastErrorMs; }
+};
+
+#endif
@@ -22,14 +22,10 @@ WiFiManager::WiFiManager() {
 }
 
 bool WiFiManager::begin() {
-    // First explicitly turn WiFi off to clear any previous state
-    WiFi.mode(WIFI_OFF);
-    delay(100);
-    
-    // Initialize in station mode, but disconnected
+    // Initialize in station mode, but disconnected. The radio comes up
+    // in this state after a reset, so there is nothing to wait for.
     WiFi.mode(WIFI_STA);
     WiFi.disconnect(true); // true = also disconnect from and forget any AP
-    delay(100);
     
     Serial.println("WiFi initialized in disconnected state");
     return true;
@@ -44,11 +40,14 @@ void WiFiManager::startHotspot() {
     
     Serial.println("Starting WiFi hotspot...");
     
-    // Completely reset WiFi state
-    WiFi.mode(WIFI_OFF);
-    delay(100);
-    WiFi.disconnect(true);
-    delay(100);
+    // Tear down a station link first; straight after boot there is none
+    // and the mode switch below is enough
+    if (WiFi.status() == WL_CONNECTED) {
+        WiFi.mode(WIFI_OFF);
+        delay(100);
+        WiFi.disconnect(true);
+        delay(100);
+    }
     
     // Set up access point with credentials from class members
     WiFi.mode(WIFI_AP);
@@ -173,6 +172,12 @@ void WiFiManager::checkHotspotTimeout() {
     }
 }
 
+// When checkHotspotTimeout() next has something to do, barring new activity
+unsigned long WiFiManager::msUntilHotspotTimeout() {
+    unsigned long idle = millis() - lastClientActivity;
+    return (idle <= hotspotTimeout) ? hotspotTimeout - idle + 1 : 0;
+}
+
 void WiFiManager::resetClientActivityTimer() {
     lastClientActivity = millis();
     Serial.println("Client activity detected, resetting timeout timer");
@@ -205,4 +210,8 @@ bool WiFiManager::isInSetupMode() {
 
 bool WiFiManager::isHotspotRunning() {
     return isHotspotActive;
+}
+
+int WiFiManager::getClientCount() {
+    return isHotspotActive ? WiFi.softAPgetStationNum() : 0;
 }
\ No newline at end of file
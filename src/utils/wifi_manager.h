@@ -29,6 +29,7 @@ public:
     String getIPAddress();
     String getAPIPAddress();
     void checkHotspotTimeout();
+    unsigned long msUntilHotspotTimeout();
     void resetClientActivityTimer();
     void processDNS();
     
@@ -36,6 +37,7 @@ public:
     void setSetupMode(bool enabled);
     bool isInSetupMode();
     bool isHotspotRunning();
+    int getClientCount();   // Stations on the hotspot
     // Add to WiFiManager class
     void setAPCredentials(const String &apSSID, const String &apPassword) {
     this->apSSID = apSSID;
@@ -0,0 +1,93 @@
+#include "asset_cache.h"
+#include <new>
+#include "hal.h"
+
+int AssetCache::findLocked(const StaticAsset &asset) {
+    for (int i = 0; i < maxEntries; i++) {
+        const CachedAsset *cached = entries[i].asset.get();
+        if (cached != NULL && strcmp(cached->file, asset.file) == 0 && strcmp(cached->etag, asset.etag) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+std::shared_ptr<const CachedAsset> AssetCache::get(const StaticAsset &asset) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        int index = findLocked(asset);
+        if (index >= 0) {
+            hits++;
+            entries[index].lastUsed = ++useCount;
+            return entries[index].asset;
+        }
+        misses++;
+    }
+
+    // Read outside the lock; another request for the same file may read it
+    // too, and the second copy is dropped below
+    long size = hal::fsSize(asset.file);
+    if (size <= 0 || (size_t)size > budget) {
+        return NULL;
+    }
+    std::shared_ptr<CachedAsset> fresh(new (std::nothrow) CachedAsset());
+    if (!fresh) {
+        return NULL;
+    }
+    fresh->data.reset(new (std::nothrow) uint8_t[size]);
+    if (!fresh->data || !hal::fsReadFile(asset.file, fresh->data.get(), size, &fresh->length)) {
+        return NULL;
+    }
+    snprintf(fresh->file, sizeof(fresh->file), "%s", asset.file);
+    snprintf(fresh->etag, sizeof(fresh->etag), "%s", asset.etag);
+
+    std::lock_guard<std::mutex> guard(lock);
+    int index = findLocked(asset);
+    if (index >= 0) {
+        return entries[index].asset;
+    }
+
+    // Evict the least recently used until the file fits and a slot is free.
+    // Responses still sending an evicted file keep it alive until done.
+    int slot = -1;
+    while (true) {
+        int oldest = -1;
+        slot = -1;
+        for (int i = 0; i < maxEntries; i++) {
+            if (!entries[i].asset) {
+                slot = i;
+            } else if (oldest < 0 || (int32_t)(entries[i].lastUsed - entries[oldest].lastUsed) < 0) {
+                oldest = i;
+            }
+        }
+        if (slot >= 0 && bytes + fresh->length <= budget) {
+            break;
+        }
+        bytes -= entries[oldest].asset->length;
+        entries[oldest].asset.reset();
+        evictions++;
+    }
+    entries[slot].asset = fresh;
+    entries[slot].lastUsed = ++useCount;
+    bytes += fresh->length;
+    return fresh;
+}
+
+void AssetCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (int i = 0; i < maxEntries; i++) {
+        entries[i].asset.reset();
+    }
+    bytes = 0;
+}
+
+AssetCache::Stats AssetCache::getStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    Stats stats = { hits, misses, evictions, bytes, 0 };
+    for (int i = 0; i < maxEntries; i++) {
+        if (entries[i].asset) {
+            stats.entries++;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,63 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <Arduino.h>
+#include <memory>
+#include <mutex>
+#include "static_assets.h"
+
+// One stored asset file in RAM. Immutable once handed out, so a response
+// can stream from it while the cache moves on.
+struct CachedAsset {
+    char file[sizeof(StaticAsset::file)];
+    char etag[sizeof(StaticAsset::etag)];   // Content hash of what is held
+    size_t length;
+    std::unique_ptr<uint8_t[]> data;
+};
+
+// The most recently requested asset files, up to a byte budget, so a page
+// load does not read flash while the io task is writing to it. Entries are
+// matched by file and content hash: a new filesystem image brings a new
+// manifest, and the old copies miss and age out.
+class AssetCache {
+public:
+    static const int maxEntries = StaticAssets::maxAssets;
+
+    struct Stats {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t evictions;
+        size_t bytes;
+        int entries;
+    };
+
+private:
+    struct Entry {
+        std::shared_ptr<const CachedAsset> asset;
+        uint32_t lastUsed;
+    };
+
+    Entry entries[maxEntries];
+    size_t budget;
+    size_t bytes = 0;
+    uint32_t useCount = 0;
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;
+    std::mutex lock;
+
+    int findLocked(const StaticAsset &asset);
+
+public:
+    explicit AssetCache(size_t budget) : budget(budget) {}
+
+    // The asset's file from RAM, reading it in on a miss; NULL if it cannot
+    // be read or is larger than the whole budget (stream it from flash)
+    std::shared_ptr<const CachedAsset> get(const StaticAsset &asset);
+
+    void clear();
+
+    Stats getStats();
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "metrics.h"
+#include <algorithm>
+#include <new>
+
+LatencyHistogram *RouteMetrics::add(const char *path, const char *method, const char *handler) {
+    if (count == maxRoutes) {
+        Serial.printf("Route metrics full, %s not timed\n", path);
+        return NULL;
+    }
+    Route *route = new (std::nothrow) Route();
+    if (route == NULL) {
+        return NULL;
+    }
+    route->path = path;
+    route->method = method;
+    route->handler = handler;
+    routes[count++] = route;
+    return &route->latency;
+}
+
+void PrometheusText::append(const char *format, ...) {
+    char line[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    out.concat(line);
+}
+
+String PrometheusText::label(const char *name, const char *value) {
+    String text(name);
+    text.concat("=\"");
+    for (const char *p = value; *p; p++) {
+        if (*p == '\\' || *p == '"') {
+            text.concat('\\');
+            text.concat(*p);
+        } else if (*p == '\n') {
+            text.concat("\\n");
+        } else {
+            text.concat(*p);
+        }
+    }
+    text.concat('"');
+    return text;
+}
+
+void PrometheusText::family(const char *name, const char *type, const char *help) {
+    append("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void PrometheusText::sample(const char *name, const String &labels, double value) {
+    append(labels.length() ? "%s{%s} %.9g\n" : "%s%s %.9g\n", name, labels.c_str(), value);
+}
+
+void PrometheusText::sample(const char *name, const String &labels, uint64_t value) {
+    append(labels.length() ? "%s{%s} %llu\n" : "%s%s %llu\n", name, labels.c_str(), (unsigned long long)value);
+}
+
+void PrometheusText::histogram(const char *name, const String &labels, const LatencyHistogram::Snapshot &snapshot) {
+    const char *separator = labels.length() ? "," : "";
+    int first = 0;
+    int last = LatencyHistogram::bucketCount - 1;
+    while (first <= last && snapshot.counts[first] == 0) {
+        first++;
+    }
+    while (last >= first && snapshot.counts[last] == 0) {
+        last--;
+    }
+
+    uint32_t cumulative = 0;
+    for (int i = 0; i < first; i++) {
+        cumulative += snapshot.counts[i];
+    }
+    for (int i = first; i <= last; i++) {
+        cumulative += snapshot.counts[i];
+        append("%s_bucket{%s%sle=\"%.9g\"} %lu\n", name, labels.c_str(), separator,
+               LatencyHistogram::lowerBound(i + 1) / 1e6, (unsigned long)cumulative);
+    }
+    append("%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels.c_str(), separator, (unsigned long)snapshot.count);
+
+    String sum(name);
+    sum.concat("_sum");
+    sample(sum.c_str(), labels, snapshot.sumMicros / 1e6);
+    String count(name);
+    count.concat("_count");
+    sample(count.c_str(), labels, (uint64_t)snapshot.count);
+}
+
+void PrometheusText::summary(const char *name, const String &labels, const LatencyHistogram::Snapshot &snapshot) {
+    const char *separator = labels.length() ? "," : "";
+    const char *quantiles[] = { "0.5", "0.9", "0.99" };
+    for (const char *quantile : quantiles) {
+        append("%s{%s%squantile=\"%s\"} %.9g\n", name, labels.c_str(), separator, quantile,
+               snapshot.quantileMicros(atof(quantile)) / 1e6);
+    }
+
+    String sum(name);
+    sum.concat("_sum");
+    sample(sum.c_str(), labels, snapshot.sumMicros / 1e6);
+    String count(name);
+    count.concat("_count");
+    sample(count.c_str(), labels, (uint64_t)snapshot.count);
+}
+
+size_t MetricsStream::read(uint8_t *buffer, size_t maxLen) {
+    while (offset == pending.length() && !finished) {
+        pending = String();
+        offset = 0;
+        finished = !produce(nextItem++, pending);
+    }
+
+    size_t chunk = std::min(maxLen, (size_t)(pending.length() - offset));
+    memcpy(buffer, pending.c_str() + offset, chunk);
+    offset += chunk;
+    return chunk;
+}
@@ -0,0 +1,79 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <functional>
+#include "latency_histogram.h"
+
+// Handler latency per route, recorded by the web server task
+class RouteMetrics {
+public:
+    static const int maxRoutes = 40;
+
+    struct Route {
+        const char *path;
+        const char *method;
+        const char *handler;   // "request", or "body" for each body chunk
+        LatencyHistogram latency;
+    };
+
+private:
+    Route *routes[maxRoutes];
+    int count = 0;
+
+public:
+    // While the routes are set up, before the server starts; NULL once full.
+    // The path must outlive the server.
+    LatencyHistogram *add(const char *path, const char *method, const char *handler);
+
+    int getCount() const { return count; }
+    const Route &getRoute(int index) const { return *routes[index]; }
+};
+
+// Prometheus text format (version 0.0.4), appended to a String. Durations
+// are in seconds; labels are passed preformatted, e.g. from label().
+class PrometheusText {
+private:
+    String &out;
+
+    void append(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+public:
+    explicit PrometheusText(String &out) : out(out) {}
+
+    // name="value" with the value escaped
+    static String label(const char *name, const char *value);
+
+    // HELP and TYPE lines, once before a family's samples
+    void family(const char *name, const char *type, const char *help);
+
+    void sample(const char *name, const String &labels, double value);
+    void sample(const char *name, const String &labels, uint64_t value);
+
+    // Cumulative buckets from the first to the last non-empty one (the set
+    // only grows as the counts do), then +Inf, _sum and _count
+    void histogram(const char *name, const String &labels, const LatencyHistogram::Snapshot &snapshot);
+
+    // The 50th, 90th and 99th percentile estimated from the buckets
+    void summary(const char *name, const String &labels, const LatencyHistogram::Snapshot &snapshot);
+};
+
+// Serves text produced one item at a time, so a large exposition is never
+// held in RAM whole. 'produce' appends item 'index' to the string and
+// returns false once there are no more items.
+class MetricsStream {
+private:
+    std::function<bool(int index, String &out)> produce;
+    String pending;
+    size_t offset = 0;
+    int nextItem = 0;
+    bool finished = false;
+
+public:
+    explicit MetricsStream(std::function<bool(int index, String &out)> produce) : produce(produce) {}
+
+    // Up to maxLen bytes of the text; 0 at the end
+    size_t read(uint8_t *buffer, size_t maxLen);
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "page_template.h"
+#include <new>
+#include "hal.h"
+
+// Written by tools/build_assets.py, followed by the head and the suffix
+struct TemplateHeader {
+    char magic[4];
+    uint32_t headLength;
+    uint32_t plainLength;
+    uint32_t plainCrc;
+    uint32_t suffixLength;
+    char etag[12];
+};
+
+static const char templateMagic[4] = { 'P', 'G', 'T', '1' };
+static const size_t blockHeaderSize = 5;   // Final stored block: flags, length, its complement
+static const size_t trailerSize = 8;       // Gzip CRC-32 and length
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return crc;
+}
+
+static void putLe16(uint8_t *p, uint16_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void putLe32(uint8_t *p, uint32_t value) {
+    putLe16(p, value);
+    putLe16(p + 2, value >> 16);
+}
+
+bool PageTemplate::begin(const char *path) {
+    long size = hal::fsSize(path);
+    if (size <= (long)sizeof(TemplateHeader)) {
+        return false;
+    }
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[size]);
+    size_t length = 0;
+    if (!buffer || !hal::fsReadFile(path, buffer.get(), size, &length)) {
+        return false;
+    }
+    return parse(std::move(buffer), length);
+}
+
+bool PageTemplate::parse(std::unique_ptr<uint8_t[]> buffer, size_t length) {
+    TemplateHeader header;
+    if (length < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, buffer.get(), sizeof(header));
+    if (memcmp(header.magic, templateMagic, sizeof(templateMagic)) != 0 ||
+        header.etag[sizeof(header.etag) - 1] != 0 ||
+        (uint64_t)sizeof(header) + header.headLength + header.suffixLength != length) {
+        Serial.println("Page template: malformed");
+        return false;
+    }
+
+    // The block header, "null", the suffix and the trailer must always fit
+    if (header.suffixLength > sizeof(PageState::bytes) - blockHeaderSize - 4 - trailerSize) {
+        Serial.println("Page template: too much text after the state marker");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    data = std::move(buffer);
+    head = data.get() + sizeof(header);
+    headLength = header.headLength;
+    plainLength = header.plainLength;
+    plainCrc = header.plainCrc;
+    suffix = head + headLength;
+    suffixLength = header.suffixLength;
+    memcpy(pageEtag, header.etag, sizeof(pageEtag));
+    current.reset();
+    return true;
+}
+
+std::shared_ptr<const PageState> PageTemplate::get(const std::shared_ptr<const StateJson> &state) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (current && current->generation == state->generation &&
+        current->wateringRemaining == state->wateringRemaining) {
+        return current;
+    }
+
+    // Rebuild in place when no response still holds the old tail
+    if (!current || current.use_count() > 1) {
+        current = std::make_shared<PageState>();
+    }
+    current->generation = state->generation;
+    current->wateringRemaining = state->wateringRemaining;
+    current->length = render(*state, current->bytes, sizeof(current->bytes));
+
+    // "<page hash>-<state tag>", so either changing makes a new version
+    snprintf(current->etag, sizeof(current->etag), "%.*s-%s",
+             (int)strlen(pageEtag) - 1, pageEtag, state->etag + 1);
+    return current;
+}
+
+size_t PageTemplate::render(const StateJson &state, uint8_t *buffer, size_t capacity) {
+    uint8_t *out = buffer + blockHeaderSize;
+    uint8_t *end = buffer + capacity - trailerSize - suffixLength;
+
+    // '<' only occurs inside JSON strings, where < is the same character;
+    // a device or relay name can then never close the script element
+    bool fits = true;
+    for (size_t i = 0; i < state.length && fits; i++) {
+        if (state.json[i] != '<') {
+            fits = out < end;
+            if (fits) {
+                *out++ = state.json[i];
+            }
+        } else {
+            fits = end - out >= 6;
+            if (fits) {
+                memcpy(out, "\\u003c", 6);
+                out += 6;
+            }
+        }
+    }
+    if (!fits) {
+        // The page draws once the event stream delivers the state
+        out = buffer + blockHeaderSize;
+        memcpy(out, "null", 4);
+        out += 4;
+    }
+    memcpy(out, suffix, suffixLength);
+    out += suffixLength;
+
+    size_t blockLength = out - (buffer + blockHeaderSize);
+    buffer[0] = 1;   // Final block, stored
+    putLe16(buffer + 1, blockLength);
+    putLe16(buffer + 3, ~blockLength);
+
+    // The CRC of the text before the marker continues over the block
+    uint32_t crc = ~crc32Update(~plainCrc, buffer + blockHeaderSize, blockLength);
+    putLe32(out, crc);
+    putLe32(out + 4, plainLength + blockLength);
+    return out + trailerSize - buffer;
+}
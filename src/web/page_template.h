@@ -0,0 +1,55 @@
+#ifndef PAGE_TEMPLATE_H
+#define PAGE_TEMPLATE_H
+
+#include <Arduino.h>
+#include <memory>
+#include <mutex>
+#include "state_json.h"
+
+// End of the page for one state body: the escaped JSON and the rest of the
+// page as one final stored deflate block, then the gzip trailer. Immutable
+// once handed out, so a response can stream from it.
+struct PageState {
+    uint32_t generation;
+    unsigned long wateringRemaining;
+    size_t length;
+    char etag[64];                          // Page and state, quoted
+    uint8_t bytes[stateJsonCapacity * 2];
+};
+
+// A page from tools/build_assets.py with the current state in place of its
+// marker, so the dashboard draws without a first API round trip. The text
+// before the marker stays gzipped in RAM; only the tail is built per state,
+// and only when the state changes.
+class PageTemplate {
+private:
+    std::unique_ptr<uint8_t[]> data;
+    const uint8_t *head = NULL;     // Gzip header and deflate blocks, left open
+    size_t headLength = 0;
+    uint32_t plainLength = 0;       // Text before the marker
+    uint32_t plainCrc = 0;
+    const uint8_t *suffix = NULL;   // Text after the marker, sent uncompressed
+    size_t suffixLength = 0;
+    char pageEtag[12] = "";
+    std::shared_ptr<PageState> current;
+    std::mutex lock;
+
+    size_t render(const StateJson &state, uint8_t *buffer, size_t capacity);
+
+public:
+    // Load the .tpl file written next to the gzipped page; false without it.
+    // Responses stream the head from here, so load only before serving.
+    bool begin(const char *path);
+
+    // Take a template already in memory
+    bool parse(std::unique_ptr<uint8_t[]> buffer, size_t length);
+
+    bool isLoaded() const { return head != NULL; }
+
+    std::shared_ptr<const PageState> get(const std::shared_ptr<const StateJson> &state);
+
+    const uint8_t *getHead() const { return head; }
+    size_t getHeadLength() const { return headLength; }
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "request_body.h"
+
+RequestBodyStatus collectRequestBody(void *&slot, const uint8_t *data, size_t length,
+                                     size_t index, size_t total, size_t maxSize) {
+    if (index == 0) {
+        if (total > maxSize) {
+            return BODY_TOO_LARGE;
+        }
+        // One allocation for the whole body and its terminator
+        free(slot);
+        RequestBody *body = (RequestBody *)malloc(sizeof(RequestBody) + total + 1);
+        slot = body;
+        if (body == NULL) {
+            return BODY_TOO_LARGE;
+        }
+        body->total = total;
+        body->received = 0;
+    }
+
+    // Chunks of a refused body, or anything that does not continue the body
+    RequestBody *body = (RequestBody *)slot;
+    if (body == NULL || body->received == body->total || index != body->received ||
+        body->received + length > body->total) {
+        return BODY_IGNORED;
+    }
+    memcpy(body->bytes() + index, data, length);
+    body->received += length;
+    if (body->received < body->total) {
+        return BODY_PARTIAL;
+    }
+    body->bytes()[body->total] = 0;
+    return BODY_COMPLETE;
+}
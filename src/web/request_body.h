@@ -0,0 +1,30 @@
+#ifndef REQUEST_BODY_H
+#define REQUEST_BODY_H
+
+#include <Arduino.h>
+
+// A request body that arrives in chunks (one per TCP segment), gathered
+// into one buffer sized for the whole body on the first chunk. The buffer
+// is malloc'd into the request's slot (_tempObject), which the web server
+// frees with the request, so nothing outlives a dropped connection.
+struct RequestBody {
+    size_t total;      // Content-Length
+    size_t received;   // Bytes in order from the start
+
+    // The body, NUL-terminated once complete; parsers may modify it in place
+    char *bytes() { return (char *)(this + 1); }
+};
+
+enum RequestBodyStatus {
+    BODY_PARTIAL,     // More chunks to come
+    BODY_COMPLETE,    // The whole body is in the buffer: parse it now
+    BODY_TOO_LARGE,   // First chunk of a body over the limit: answer 413
+    BODY_IGNORED      // Chunk of a refused body, or one out of order
+};
+
+// Add one chunk (as the server's onBody handler gets it) to the body in
+// 'slot'. Returns BODY_COMPLETE exactly once per body.
+RequestBodyStatus collectRequestBody(void *&slot, const uint8_t *data, size_t length,
+                                     size_t index, size_t total, size_t maxSize);
+
+#endif
@@ -0,0 +1,79 @@
+#include "state_json.h"
+#include <ArduinoJson.h>
+#include "hal.h"
+
+std::shared_ptr<const StateJson> StateJsonCache::get(const SystemState &state) {
+    unsigned long remaining = state.wateringRemaining(hal::millis());
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (current && current->generation == state.generation &&
+        current->wateringRemaining == remaining) {
+        return current;
+    }
+
+    // Rebuild in place when no response still holds the old body
+    if (!current || current.use_count() > 1) {
+        current = std::make_shared<StateJson>();
+    }
+    if (bootId == 0) {
+        bootId = clock.unixtime();
+    }
+
+    current->generation = state.generation;
+    current->wateringRemaining = remaining;
+    current->length = build(state, remaining, current->json, sizeof(current->json));
+    snprintf(current->etag, sizeof(current->etag), "\"%lx-%lu-%lu\"",
+             (unsigned long)bootId, (unsigned long)state.generation, remaining);
+    builds++;
+    return current;
+}
+
+size_t StateJsonCache::build(const SystemState &state, unsigned long remaining, char *buffer, size_t capacity) {
+    DynamicJsonDocument doc(1024);
+
+    // Add device information
+    doc["deviceName"] = config.getDeviceName();
+
+    // Snapshot generation; unchanged generation means unchanged readings and relays
+    doc["generation"] = state.generation;
+
+    // BME280 sensor data
+    doc["temperature"] = state.temperature;
+    doc["humidity"] = state.humidity;
+    doc["pressure"] = state.pressure;
+    doc["heat_index"] = state.heatIndex;
+
+    // Soil data
+    doc["soil_raw"] = state.soilMoistureRaw;
+    doc["soil_mv"] = state.soilMillivolts;
+    doc["soil_moisture"] = state.soilMoisturePercent;
+
+    // Time the body was built, i.e. of the last change
+    hal::WallTime now = clock.now();
+    char timeStr[32];
+    snprintf(timeStr, sizeof(timeStr), "%02d/%02d/%04d %02d:%02d:%02d",
+             now.day, now.month, now.year, now.hour, now.minute, now.second);
+    doc["time_str"] = timeStr;
+    doc["timestamp"] = now.unixtime;
+
+    // Relay status
+    JsonArray relays = doc.createNestedArray("relays");
+    for (int i = 0; i < 4; i++) {
+        relays.add(state.relays[i]);
+    }
+
+    // Relay names
+    JsonArray relayNames = doc.createNestedArray("relay_names");
+    relayNames.add(config.getRelay1Name());
+    relayNames.add(config.getRelay2Name());
+    relayNames.add(config.getRelay3Name());
+    relayNames.add(config.getRelay4Name());
+
+    // Watering status
+    doc["watering_active"] = state.isWatering;
+    if (state.isWatering) {
+        doc["watering_remaining"] = remaining;
+    }
+
+    return serializeJson(doc, buffer, capacity);
+}
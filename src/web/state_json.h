@@ -0,0 +1,45 @@
+#ifndef STATE_JSON_H
+#define STATE_JSON_H
+
+#include <Arduino.h>
+#include <memory>
+#include <mutex>
+#include "config.h"
+#include "system_state.h"
+#include "timekeeper.h"
+
+const size_t stateJsonCapacity = 1024;
+
+// Serialized dashboard state, shared by /api/sensor-data and the "state"
+// event. Immutable once handed out, so a response can stream from it.
+struct StateJson {
+    uint32_t generation;
+    unsigned long wateringRemaining;
+    size_t length;
+    char etag[48];                  // Strong validator, quoted
+    char json[stateJsonCapacity];
+};
+
+// Caches the serialized state. The body depends only on the snapshot
+// generation and, while watering, the countdown second, so it is rebuilt
+// only when one of those changes; every other request is a pointer copy.
+class StateJsonCache {
+private:
+    Config &config;
+    Timekeeper &clock;
+    std::shared_ptr<StateJson> current;
+    std::mutex lock;
+    uint32_t bootId = 0;   // Keeps ETags from a previous boot from matching
+    uint32_t builds = 0;
+
+    size_t build(const SystemState &state, unsigned long remaining, char *buffer, size_t capacity);
+
+public:
+    StateJsonCache(Config &config, Timekeeper &clock) : config(config), clock(clock) {}
+
+    std::shared_ptr<const StateJson> get(const SystemState &state);
+
+    uint32_t getBuildCount() const { return builds; }
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "static_assets.h"
+#include "hal.h"
+
+static const char *manifestPath = "/assets.idx";
+
+bool StaticAssets::begin() {
+    char text[maxAssets * 128];
+    size_t length = 0;
+    if (!hal::fsReadFile(manifestPath, (uint8_t *)text, sizeof(text), &length)) {
+        return false;
+    }
+    return parse(text, length);
+}
+
+// Copy one space-separated field; false if it does not fit
+static bool takeField(const char *&p, const char *end, char *field, size_t capacity) {
+    while (p < end && *p == ' ') {
+        p++;
+    }
+    size_t length = 0;
+    while (p < end && *p != ' ' && *p != '\n' && *p != '\r') {
+        if (length + 1 >= capacity) {
+            return false;
+        }
+        field[length++] = *p++;
+    }
+    field[length] = 0;
+    return length > 0;
+}
+
+bool StaticAssets::parse(const char *text, size_t length) {
+    count = 0;
+    const char *p = text;
+    const char *end = text + length;
+    while (p < end) {
+        const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+        if (count == maxAssets) {
+            Serial.println("Static assets: manifest has too many entries");
+            return false;
+        }
+        StaticAsset &asset = assets[count];
+        char immutable[4];
+        if (takeField(p, lineEnd, asset.url, sizeof(asset.url)) &&
+            takeField(p, lineEnd, asset.file, sizeof(asset.file)) &&
+            takeField(p, lineEnd, asset.etag, sizeof(asset.etag)) &&
+            takeField(p, lineEnd, asset.type, sizeof(asset.type)) &&
+            takeField(p, lineEnd, immutable, sizeof(immutable))) {
+            asset.immutable = immutable[0] == '1';
+            count++;
+        }
+        p = lineEnd + 1;
+    }
+    return count > 0;
+}
+
+const StaticAsset *StaticAssets::find(const char *url) const {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(assets[i].url, url) == 0) {
+            return &assets[i];
+        }
+    }
+    return NULL;
+}
+
+bool StaticAssets::isCurrent(const StaticAsset &asset, const char *ifNoneMatch) {
+    return ifNoneMatch != NULL && (strcmp(ifNoneMatch, "*") == 0 || strstr(ifNoneMatch, asset.etag) != NULL);
+}
+
+const char *StaticAssets::cacheControl(const StaticAsset &asset) {
+    // Pages are revalidated on every load; a 304 is a few hundred bytes
+    return asset.immutable ? "public, max-age=31536000, immutable" : "no-cache";
+}
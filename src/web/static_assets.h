@@ -0,0 +1,42 @@
+#ifndef STATIC_ASSETS_H
+#define STATIC_ASSETS_H
+
+#include <Arduino.h>
+
+// One URL of the web interface, stored gzipped by tools/build_assets.py
+struct StaticAsset {
+    char url[40];
+    char file[44];        // Gzipped file on the filesystem
+    char etag[12];        // Content hash, quoted
+    char type[24];
+    bool immutable;       // Content-hashed URL: never changes
+};
+
+// The asset manifest (/assets.idx) in RAM, so a request finds its file,
+// type and validator without touching the filesystem
+class StaticAssets {
+public:
+    static const int maxAssets = 16;
+
+private:
+    StaticAsset assets[maxAssets];
+    int count = 0;
+
+public:
+    // Read the manifest; false if the filesystem was built without it
+    bool begin();
+
+    // Parse manifest text: "<url> <file> <etag> <type> <0|1>" per line
+    bool parse(const char *text, size_t length);
+
+    const StaticAsset *find(const char *url) const;
+    int getCount() const { return count; }
+    const StaticAsset &getAsset(int index) const { return assets[index]; }
+
+    // The client's If-None-Match names this version
+    static bool isCurrent(const StaticAsset &asset, const char *ifNoneMatch);
+
+    static const char *cacheControl(const StaticAsset &asset);
+};
+
+#endif
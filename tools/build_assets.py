@@ -0,0 +1,249 @@
+"""Build the web assets in data/ into the filesystem image.
+
+Every file is minified and gzipped. Pages keep their URLs; stylesheets and
+scripts also get a content-hashed URL, and pages are rewritten to use it,
+so the server can mark them immutable. The server finds everything
+through /assets.idx, one line per URL:
+
+    <url> <stored file> <etag> <content type> <immutable 0|1>
+
+A page with the state marker also gets a template (<stored file>.tpl)
+the device splices the current state into; the plain gzipped page has
+"null" in its place.
+
+Runs before every PlatformIO build of the device (extra_scripts) and
+points the filesystem image at its output. Standalone:
+
+    python tools/build_assets.py [source dir] [output dir]
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import shutil
+import struct
+import sys
+import zlib
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+}
+
+# Pages are entry points, so their URLs cannot carry a hash
+PAGE_EXTENSIONS = (".html",)
+
+# Where the device puts the current state into a page (see PageTemplate)
+STATE_MARKER = "{{STATE}}"
+
+# Template header: magic, head length, plain length and CRC-32 of the
+# text before the marker, length of the text after it, ETag
+TEMPLATE_HEADER = struct.Struct("<4sIIII12s")
+TEMPLATE_MAGIC = b"PGT1"
+
+# Weak softAP link the first-paint estimate assumes
+LINK_BITS_PER_SECOND = 1000000
+REQUEST_OVERHEAD_BYTES = 300   # Request and response headers, per file
+
+
+def strip_js_comments(text):
+    """Drop // and /* */ comments outside strings and template literals."""
+    out = []
+    i = 0
+    quote = None
+    while i < len(text):
+        c = text[i]
+        if quote:
+            out.append(c)
+            if c == "\\" and i + 1 < len(text):
+                out.append(text[i + 1])
+                i += 1
+            elif c == quote:
+                quote = None
+        elif c in "'\"`":
+            quote = c
+            out.append(c)
+        elif text.startswith("//", i):
+            while i < len(text) and text[i] != "\n":
+                i += 1
+            continue
+        elif text.startswith("/*", i):
+            end = text.find("*/", i + 2)
+            i = len(text) if end < 0 else end + 2
+            continue
+        else:
+            out.append(c)
+        i += 1
+    return "".join(out)
+
+
+def strip_lines(text):
+    """Trim every line and drop the empty ones; line breaks stay, so
+    semicolon insertion in scripts is unaffected."""
+    lines = (line.strip() for line in text.splitlines())
+    return "\n".join(line for line in lines if line)
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    return re.sub(r"\s*([{};,>])\s*", r"\1", text).replace(";}", "}").strip()
+
+
+def minify_js(text):
+    return strip_lines(strip_js_comments(text))
+
+
+def minify_html(text):
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+
+    def script(match):
+        return match.group(1) + minify_js(match.group(2)) + match.group(3)
+
+    def style(match):
+        return match.group(1) + minify_css(match.group(2)) + match.group(3)
+
+    text = re.sub(r"(<script[^>]*>)(.*?)(</script>)", script, text, flags=re.S | re.I)
+    text = re.sub(r"(<style[^>]*>)(.*?)(</style>)", style, text, flags=re.S | re.I)
+    return strip_lines(text)
+
+
+MINIFIERS = {".html": minify_html, ".css": minify_css, ".js": minify_js}
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:8]
+
+
+def hashed_url(url, digest):
+    stem, ext = os.path.splitext(url)
+    return "%s.%s%s" % (stem, digest, ext)
+
+
+def link_pattern(url):
+    # href="css/style.css", src="/js/app.js", ...
+    return re.compile(r"""((?:href|src)\s*=\s*["'])/?%s(["'])""" % re.escape(url.lstrip("/")))
+
+
+def page_template(prefix, suffix, etag):
+    """The text before the marker as a gzip stream left open on a byte
+    boundary, then the text after the marker as it is. The device sends
+    the head, then the state and the rest of the page as one final stored
+    block, then the trailer."""
+    # No file name or time; best compression, unknown OS
+    head = b"\x1f\x8b\x08\x00\x00\x00\x00\x00\x02\xff"
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -15)
+    head += compressor.compress(prefix) + compressor.flush(zlib.Z_FULL_FLUSH)
+    header = TEMPLATE_HEADER.pack(TEMPLATE_MAGIC, len(head), len(prefix), zlib.crc32(prefix),
+                                  len(suffix), etag.encode("ascii"))
+    return header + head + suffix
+
+
+def splice(template, state):
+    """What the device sends for a state JSON, to check the template."""
+    _, head_length, plain_length, plain_crc, _, _ = TEMPLATE_HEADER.unpack_from(template)
+    head = template[TEMPLATE_HEADER.size:TEMPLATE_HEADER.size + head_length]
+    tail = state + template[TEMPLATE_HEADER.size + head_length:]
+    block = struct.pack("<BHH", 1, len(tail), len(tail) ^ 0xFFFF)
+    trailer = struct.pack("<II", zlib.crc32(tail, plain_crc), (plain_length + len(tail)) & 0xFFFFFFFF)
+    return head + block + tail + trailer
+
+
+def build(source, output):
+    files = []
+    for root, _, names in os.walk(source):
+        for name in sorted(names):
+            path = os.path.join(root, name)
+            url = "/" + os.path.relpath(path, source).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                files.append((url, f.read()))
+
+    # Stylesheets and scripts first, so pages can link their hashed URLs
+    files.sort(key=lambda item: item[0].endswith(PAGE_EXTENSIONS))
+    renamed = {}
+    entries = []
+    report = []
+    for url, raw in files:
+        ext = os.path.splitext(url)[1].lower()
+        data = raw
+        if ext in MINIFIERS:
+            text = MINIFIERS[ext](raw.decode("utf-8"))
+            for original, hashed in renamed.items():
+                text = link_pattern(original).sub(r"\1%s\2" % hashed, text)
+            data = text.encode("utf-8")
+        page = url.endswith(PAGE_EXTENSIONS)
+        prefix, marker, suffix = data.partition(STATE_MARKER.encode("ascii"))
+        if page and marker:
+            data = prefix + b"null" + suffix
+        digest = content_hash(data)
+        packed = gzip.compress(data, 9, mtime=0)
+
+        stored = url if page else hashed_url(url, digest)
+        if not page:
+            renamed[url] = stored
+        target = os.path.join(output, stored.lstrip("/") + ".gz")
+        os.makedirs(os.path.dirname(target), exist_ok=True)
+        with open(target, "wb") as f:
+            f.write(packed)
+        if page and marker:
+            template = page_template(prefix, suffix, '"%s"' % digest)
+            state = b'{"generation":1}'
+            assert gzip.decompress(splice(template, state)) == prefix + state + suffix
+            with open(target[:-len(".gz")] + ".tpl", "wb") as f:
+                f.write(template)
+
+        content_type = CONTENT_TYPES.get(ext, "application/octet-stream")
+        etag = '"%s"' % digest
+        entries.append((url, stored + ".gz", etag, content_type, 0))
+        if not page:
+            entries.append((stored, stored + ".gz", etag, content_type, 1))
+        report.append((url, len(raw), len(data), len(packed)))
+
+    with open(os.path.join(output, "assets.idx"), "w", newline="\n") as f:
+        for entry in entries:
+            f.write("%s %s %s %s %d\n" % entry)
+    return report
+
+
+def print_report(report):
+    print("Web assets (raw -> minified -> gzip):")
+    for url, raw, minified, packed in report:
+        print("  %-24s %7d %7d %7d" % (url, raw, minified, packed))
+    raw = sum(r[1] for r in report)
+    packed = sum(r[3] for r in report)
+    print("  %-24s %7d %7s %7d (%.0f%% smaller)" % ("total", raw, "", packed, 100.0 - 100.0 * packed / raw))
+
+    # Dashboard first paint: index.html plus what it links, at the assumed link rate
+    pages = [r for r in report if r[0] == "/index.html"]
+    if pages:
+        def paint_ms(size):
+            return (size + REQUEST_OVERHEAD_BYTES) * 8 * 1000.0 / LINK_BITS_PER_SECOND
+        before, after = pages[0][1], pages[0][3]
+        print("  /index.html first paint at %d kbit/s: %.0f ms before, %.0f ms after; "
+              "repeat visits get a 304 (%.0f ms)" % (LINK_BITS_PER_SECOND / 1000, paint_ms(before),
+                                                     paint_ms(after), paint_ms(0)))
+
+
+def run(source, output):
+    shutil.rmtree(output, ignore_errors=True)
+    os.makedirs(output)
+    print_report(build(source, output))
+
+
+if __name__ == "__main__":
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    run(sys.argv[1] if len(sys.argv) > 1 else os.path.join(root, "data"),
+        sys.argv[2] if len(sys.argv) > 2 else os.path.join(root, ".pio", "assets"))
+else:
+    # PlatformIO extra script (no __file__ here): build the filesystem
+    # image from the processed assets
+    Import("env")  # noqa: F821
+    output = os.path.join(env.subst("$BUILD_DIR"), "assets")  # noqa: F821
+    run(os.path.join(env.subst("$PROJECT_DIR"), "data"), output)  # noqa: F821
+    env.Replace(PROJECT_DATA_DIR=output)  # noqa: F821